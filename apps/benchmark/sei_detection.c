@@ -0,0 +1,271 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * This application benchmarks how the validator classifies nalus and scans byte-streams, with each
+ * implementation of nalu_scan.c supported by the CPU. A byte-stream of small slices with a Signed
+ * Video SEI at a fixed interval is generated in memory, hence no GStreamer or Signed Video session
+ * is involved.
+ *
+ * For every implementation three benchmarks are run; 'classify' detects the prefix of every nalu
+ * and checks if it is a Signed Video SEI, 'find_start_code' splits the byte-stream into nalus and
+ * 'find_sei' searches the byte-stream for Signed Video SEIs. Each result, the best of a number of
+ * runs, is printed as one JSON object on stdout.
+ *
+ * Example to benchmark H.265 streams with 32 byte slices
+ *   $ ./sei_detection -c h265 -s 32
+ */
+
+#include <glib.h>
+#include <stdlib.h>  // atoi
+#include <string.h>  // memcpy, strcmp
+
+#include "nalu_scan.h"
+
+#define SEI_PAYLOAD_SIZE 64  // Bytes after the UUID, i.e., the actual Signed Video data
+
+typedef struct {
+  SignedVideoCodec codec;
+  guint num_nalus;
+  guint slice_size;  // Bytes of picture data per slice
+  guint sei_interval;  // A Signed Video SEI every |sei_interval| nalus
+  guint runs;
+} BenchConfig;
+
+typedef struct {
+  GByteArray *stream;
+  GArray *offsets;  // Offset of every nalu in |stream|, followed by the size of the stream
+  guint num_seis;
+} BenchStream;
+
+/* Appends a nalu with a start code, alternating between 3 and 4 bytes. The payload has zeros, but
+ * never two in a row, as if emulation prevention has been applied. */
+static void
+append_nalu(BenchStream *bench, const BenchConfig *config, bool is_sei, guint index)
+{
+  static const guint8 kStartCode[] = {0x00, 0x00, 0x00, 0x01};
+  const guint offset = bench->stream->len;
+
+  g_array_append_val(bench->offsets, offset);
+  g_byte_array_append(bench->stream, kStartCode + (index & 1), sizeof(kStartCode) - (index & 1));
+  if (is_sei) {
+    // SEI of type user data unregistered holding the Signed Video UUID.
+    static const guint8 kH264Header[] = {0x06, 0x05};
+    static const guint8 kH265Header[] = {0x4e, 0x01, 0x05};
+    const guint8 payload_size = sizeof(kUuidSignedVideo) + SEI_PAYLOAD_SIZE;
+    if (config->codec == SV_CODEC_H264) {
+      g_byte_array_append(bench->stream, kH264Header, sizeof(kH264Header));
+    } else {
+      g_byte_array_append(bench->stream, kH265Header, sizeof(kH265Header));
+    }
+    g_byte_array_append(bench->stream, &payload_size, 1);
+    g_byte_array_append(bench->stream, kUuidSignedVideo, sizeof(kUuidSignedVideo));
+    for (guint i = 0; i < SEI_PAYLOAD_SIZE; i++) {
+      guint8 byte = g_random_int_range(1, 256);
+      g_byte_array_append(bench->stream, &byte, 1);
+    }
+    bench->num_seis++;
+  } else {
+    // Non-IDR slice.
+    static const guint8 kH264Header[] = {0x41};
+    static const guint8 kH265Header[] = {0x02, 0x01};
+    guint8 previous = 0xff;
+    if (config->codec == SV_CODEC_H264) {
+      g_byte_array_append(bench->stream, kH264Header, sizeof(kH264Header));
+    } else {
+      g_byte_array_append(bench->stream, kH265Header, sizeof(kH265Header));
+    }
+    for (guint i = 0; i < config->slice_size; i++) {
+      guint8 byte = g_random_int_range(0, 8) == 0 ? 0 : g_random_int_range(1, 256);
+      if (byte == 0 && previous == 0) byte = 0x80;
+      g_byte_array_append(bench->stream, &byte, 1);
+      previous = byte;
+    }
+  }
+  // RBSP trailing bits.
+  g_byte_array_append(bench->stream, (const guint8 *)"\x80", 1);
+}
+
+static void
+generate_stream(BenchStream *bench, const BenchConfig *config)
+{
+  bench->stream = g_byte_array_new();
+  bench->offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint), config->num_nalus + 1);
+  for (guint i = 0; i < config->num_nalus; i++) {
+    append_nalu(bench, config, i % config->sei_interval == 0, i);
+  }
+  g_array_append_val(bench->offsets, bench->stream->len);
+}
+
+static guint
+run_classify(const BenchStream *bench, const BenchConfig *config)
+{
+  const guint *offsets = (const guint *)bench->offsets->data;
+  guint num_seis = 0;
+
+  for (guint i = 0; i + 1 < bench->offsets->len; i++) {
+    const guint8 *nalu = bench->stream->data + offsets[i];
+    gsize nalu_size = offsets[i + 1] - offsets[i];
+    gsize prefix_size = nalu_scan_prefix_size(nalu, nalu_size, NULL);
+    num_seis += nalu_scan_is_signed_video_sei(nalu, nalu_size, config->codec) && prefix_size > 0;
+  }
+  return num_seis;
+}
+
+static guint
+run_find_start_code(const BenchStream *bench, const BenchConfig __attribute__((unused)) *config)
+{
+  const gsize size = bench->stream->len;
+  gsize pos = nalu_scan_find_start_code(bench->stream->data, size, 0);
+  guint num_nalus = 0;
+
+  while (pos < size) {
+    num_nalus++;
+    pos = nalu_scan_find_start_code(bench->stream->data, size, pos + 3);
+  }
+  return num_nalus;
+}
+
+static guint
+run_find_sei(const BenchStream *bench, const BenchConfig *config)
+{
+  const gsize size = bench->stream->len;
+  gsize pos = nalu_scan_find_signed_video_sei(bench->stream->data, size, 0, config->codec);
+  guint num_seis = 0;
+
+  while (pos < size) {
+    num_seis++;
+    pos = nalu_scan_find_signed_video_sei(bench->stream->data, size, pos + 3, config->codec);
+  }
+  return num_seis;
+}
+
+/* Runs |func| |config|->runs times and prints the best run. Returns false if it did not find
+ * |expected| nalus, or SEIs. */
+static bool
+run_benchmark(const gchar *benchmark, guint (*func)(const BenchStream *, const BenchConfig *),
+    guint expected, const BenchStream *bench, const BenchConfig *config, const gchar *codec_str)
+{
+  gdouble best = G_MAXDOUBLE;
+  guint found = 0;
+
+  for (guint run = 0; run < config->runs; run++) {
+    gint64 start = g_get_monotonic_time();
+    found = func(bench, config);
+    best = MIN(best, (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC);
+  }
+  best = MAX(best, 1e-6);
+
+  g_print("{\"benchmark\": \"%s\", \"implementation\": \"%s\", \"codec\": \"%s\", "
+          "\"slice_size\": %u, \"sei_interval\": %u, \"nalus\": %u, \"bytes\": %u, "
+          "\"found\": %u, \"seconds\": %.6f, \"ns_per_nalu\": %.2f, \"mb_per_second\": %.1f}\n",
+      benchmark, nalu_scan_get_implementation(), codec_str, config->slice_size,
+      config->sei_interval, config->num_nalus, bench->stream->len, found, best,
+      best * 1e9 / config->num_nalus, bench->stream->len / 1e6 / best);
+  if (found != expected) {
+    g_warning("%s with %s found %u, expected %u", benchmark, nalu_scan_get_implementation(), found,
+        expected);
+    return false;
+  }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const gchar *kImplementations[] = {"avx2", "sse2", "scalar"};
+  int status = 1;
+  BenchConfig config = {SV_CODEC_H264, 200000, 64, 30, 20};
+  BenchStream bench = {0};
+  const gchar *codec_str = "h264";
+
+  int arg = 1;
+  gchar *usage = g_strdup_printf(
+      "Usage:\n%s [-h] [-c codec] [-n nalus] [-s slice_size] [-e sei_interval] [-r runs]\n\n"
+      "Optional\n"
+      "  -c codec        : 'h264' (default) or 'h265'\n"
+      "  -n nalus        : Number of nalus in the stream (default 200000)\n"
+      "  -s slice_size   : Bytes of picture data per slice (default 64)\n"
+      "  -e sei_interval : A Signed Video SEI every 'sei_interval' nalus (default 30)\n"
+      "  -r runs         : Runs per benchmark, of which the best is reported (default 20)\n",
+      argv[0]);
+
+  // Parse options from command-line.
+  while (arg < argc) {
+    if (strcmp(argv[arg], "-h") == 0) {
+      g_message("\n%s\n", usage);
+      status = 0;
+      goto out;
+    } else if (arg + 1 >= argc) {
+      g_warning("missing value of option %s\n%s", argv[arg], usage);
+      goto out;
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      codec_str = argv[++arg];
+    } else if (strcmp(argv[arg], "-n") == 0) {
+      config.num_nalus = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      config.slice_size = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-e") == 0) {
+      config.sei_interval = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-r") == 0) {
+      config.runs = atoi(argv[++arg]);
+    } else {
+      g_warning("unknown option: %s\n%s", argv[arg], usage);
+      goto out;
+    }
+    arg++;
+  }
+
+  if (strcmp(codec_str, "h264") == 0) {
+    config.codec = SV_CODEC_H264;
+  } else if (strcmp(codec_str, "h265") == 0) {
+    config.codec = SV_CODEC_H265;
+  } else {
+    g_warning("unsupported codec '%s'\n%s", codec_str, usage);
+    goto out;
+  }
+  if (config.num_nalus == 0 || config.sei_interval == 0 || config.runs == 0) {
+    g_warning("nalus, sei_interval and runs have to be larger than 0\n%s", usage);
+    goto out;
+  }
+
+  // The same stream for all implementations.
+  g_random_set_seed(42);
+  generate_stream(&bench, &config);
+
+  status = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(kImplementations); i++) {
+    if (!nalu_scan_set_implementation(kImplementations[i])) continue;
+    if (!run_benchmark("classify", run_classify, bench.num_seis, &bench, &config, codec_str) ||
+        !run_benchmark("find_start_code", run_find_start_code, config.num_nalus, &bench, &config,
+            codec_str) ||
+        !run_benchmark("find_sei", run_find_sei, bench.num_seis, &bench, &config, codec_str)) {
+      status = 1;
+    }
+  }
+
+out:
+  if (bench.stream) g_byte_array_free(bench.stream, TRUE);
+  if (bench.offsets) g_array_free(bench.offsets, TRUE);
+  g_free(usage);
+
+  return status;
+}
@@ -0,0 +1,179 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * This application measures the cost of signing with different settings of the signing element.
+ *
+ * Every file is run through a pipeline without signing to get a baseline, and then through the
+ * signing element once per configuration. For each run the CPU time spent per signed GOP, on top
+ * of the baseline, and the bitrate overhead of the SEIs are reported.
+ *
+ * The signing plugin has to be found through GST_PLUGIN_PATH.
+ *
+ * Example to benchmark the test files
+ *   $ ./signing_cost test-files/test_h264.mp4 test-files/test_h265.mp4
+ */
+
+#include <gst/gst.h>
+#include <string.h>  // strstr
+#include <sys/resource.h>  // getrusage
+
+#include "gstsigning_defines.h"
+
+/* Properties of the signing element to benchmark, in gst-launch syntax. */
+static const gchar *configurations[] = {
+    "",
+    "hash-algo=sha256",
+    "hash-algo=sha512",
+    "signing-frequency=2",
+    "signing-frequency=4",
+    "max-signing-frames=10",
+    "max-signing-frames=30",
+};
+
+typedef struct {
+  gdouble cpu_seconds;
+  guint64 gops_signed;
+  gdouble bitrate_overhead;
+} RunResult;
+
+static gdouble
+get_cpu_seconds(void)
+{
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+
+  return (gdouble)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+      (gdouble)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / G_USEC_PER_SEC;
+}
+
+/* Runs |filename| through a pipeline to the end. If |signing_properties| is NULL the signing
+ * element is left out. Returns FALSE on error. */
+static gboolean
+run_pipeline(const gchar *filename, const gchar *signing_properties, RunResult *result)
+{
+  const gchar *demux_str = strstr(filename, ".mkv") ? "matroskademux" : "qtdemux";
+  gchar *description = NULL;
+  GstElement *pipeline = NULL;
+  GstElement *signing = NULL;
+  GstBus *bus = NULL;
+  GstMessage *msg = NULL;
+  GError *error = NULL;
+  gboolean success = FALSE;
+  gdouble start = 0.0;
+
+  description = g_strdup_printf("filesrc location=\"%s\" ! %s ! %s %s ! fakesink sync=false",
+      filename, demux_str, signing_properties ? "signing name=signing" : "identity",
+      signing_properties ? signing_properties : "");
+  pipeline = gst_parse_launch(description, &error);
+  g_free(description);
+  if (!pipeline) {
+    g_printerr("Failed to create pipeline: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  start = get_cpu_seconds();
+  if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr("Failed to start pipeline for %s\n", filename);
+    goto out;
+  }
+  bus = gst_element_get_bus(pipeline);
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  gst_object_unref(bus);
+  result->cpu_seconds = get_cpu_seconds() - start;
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error(msg, &error, NULL);
+    g_printerr("Failed to run %s: %s\n", filename, error->message);
+    g_error_free(error);
+    goto out;
+  }
+
+  signing = gst_bin_get_by_name(GST_BIN(pipeline), "signing");
+  if (signing) {
+    GstStructure *stats = NULL;
+
+    g_object_get(G_OBJECT(signing), "stats", &stats, NULL);
+    gst_structure_get_uint64(stats, SIGNING_STATS_GOPS_SIGNED, &result->gops_signed);
+    gst_structure_get_double(stats, SIGNING_STATS_BITRATE_OVERHEAD, &result->bitrate_overhead);
+    gst_structure_free(stats);
+    gst_object_unref(signing);
+  }
+  success = TRUE;
+
+out:
+  if (msg) gst_message_unref(msg);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+
+  return success;
+}
+
+gint
+main(gint argc, gchar *argv[])
+{
+  GError *error = NULL;
+  int status = 0;
+
+  if (!gst_init_check(NULL, NULL, &error)) {
+    g_warning("gst_init failed: %s", error->message);
+    g_error_free(error);
+    return 1;
+  }
+  if (argc < 2) {
+    g_printerr("Usage:\n%s file [file ...]\n", argv[0]);
+    return 1;
+  }
+
+  g_print("%-32s %-24s %8s %14s %12s\n", "file", "configuration", "GOPs", "CPU ms / GOP",
+      "SEI overhead");
+  for (int arg = 1; arg < argc; arg++) {
+    const gchar *filename = argv[arg];
+    gchar *basename = g_path_get_basename(filename);
+    RunResult baseline = {0};
+
+    if (!run_pipeline(filename, NULL, &baseline)) {
+      status = 1;
+      g_free(basename);
+      continue;
+    }
+    for (guint n = 0; n < G_N_ELEMENTS(configurations); n++) {
+      RunResult result = {0};
+      gdouble cpu_ms_per_gop = 0.0;
+
+      if (!run_pipeline(filename, configurations[n], &result)) {
+        status = 1;
+        continue;
+      }
+      if (result.gops_signed > 0) {
+        cpu_ms_per_gop =
+            1000.0 * MAX(result.cpu_seconds - baseline.cpu_seconds, 0.0) / result.gops_signed;
+      }
+      g_print("%-32s %-24s %8" G_GUINT64_FORMAT " %14.3f %11.3f%%\n", basename,
+          configurations[n][0] ? configurations[n] : "default", result.gops_signed,
+          cpu_ms_per_gop, 100.0 * result.bitrate_overhead);
+    }
+    g_free(basename);
+  }
+
+  return status;
+}
@@ -0,0 +1,607 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Generator of synthetic H.264, H.265 and AV1 streams, used to benchmark without an encoder.
+ *
+ * The parameter sets, sequence headers and slice, or frame, headers are valid, whereas the picture
+ * data is filler. The streams can hence be signed and validated, but not decoded.
+ */
+
+#include "stream_generator.h"
+
+/* Picture size described by the parameter sets. */
+#define WIDTH 1280
+#define HEIGHT 720
+#define H264_NUM_MBS ((WIDTH / 16) * (HEIGHT / 16))
+#define H264_LOG2_MAX_FRAME_NUM 4
+#define H265_NUM_CTBS (((WIDTH + 63) / 64) * ((HEIGHT + 63) / 64))  // 64x64 CTBs
+#define H265_CTB_ADDRESS_BITS 8  // Ceil(Log2(H265_NUM_CTBS))
+#define H265_LOG2_MAX_POC_LSB 8
+
+/* H.26x nalu types. */
+#define H264_NALU_SLICE 1
+#define H264_NALU_IDR 5
+#define H264_NALU_SPS 7
+#define H264_NALU_PPS 8
+#define H265_NALU_TRAIL_R 1
+#define H265_NALU_IDR_W_RADL 19
+#define H265_NALU_VPS 32
+#define H265_NALU_SPS 33
+#define H265_NALU_PPS 34
+
+/* AV1 OBU types. */
+#define OBU_SEQUENCE_HEADER 1
+#define OBU_TEMPORAL_DELIMITER 2
+#define OBU_FRAME_HEADER 3
+#define OBU_TILE_GROUP 4
+#define OBU_FRAME 6
+
+/* Writes the bits of a nalu, or OBU, payload MSB first. */
+typedef struct {
+  GByteArray *bytes;
+  guint8 current;
+  guint n_bits;  // Bits written to |current|
+} BitWriter;
+
+static void
+put_bits(BitWriter *bw, guint32 value, guint n_bits)
+{
+  while (n_bits > 0) {
+    n_bits--;
+    bw->current = (guint8)((bw->current << 1) | ((value >> n_bits) & 1));
+    bw->n_bits++;
+    if (bw->n_bits == 8) {
+      g_byte_array_append(bw->bytes, &bw->current, 1);
+      bw->current = 0;
+      bw->n_bits = 0;
+    }
+  }
+}
+
+/* Unsigned Exp-Golomb code, ue(v). */
+static void
+put_ue(BitWriter *bw, guint32 value)
+{
+  guint32 code = value + 1;
+  guint len = 0;
+
+  while ((code >> len) > 1) len++;
+  put_bits(bw, 0, len);
+  put_bits(bw, code, len + 1);
+}
+
+/* Signed Exp-Golomb code, se(v). */
+static void
+put_se(BitWriter *bw, gint32 value)
+{
+  put_ue(bw, value > 0 ? (guint32)(2 * value - 1) : (guint32)(-2 * value));
+}
+
+/* Writes the stop bit and aligns to the next byte. */
+static void
+put_trailing_bits(BitWriter *bw)
+{
+  put_bits(bw, 1, 1);
+  while (bw->n_bits > 0) put_bits(bw, 0, 1);
+}
+
+/* Writes zero bits up to the next byte. */
+static void
+put_alignment_bits(BitWriter *bw)
+{
+  while (bw->n_bits > 0) put_bits(bw, 0, 1);
+}
+
+/* Appends |size| bytes of filler, which differs with |seed|. No byte is zero, hence no emulation
+ * prevention is needed, and the last byte holds a stop bit. */
+static void
+put_filler(BitWriter *bw, gsize size, guint32 seed)
+{
+  guint32 state = seed * 2654435761u | 1;
+  guint offset = bw->bytes->len;
+
+  g_assert(bw->n_bits == 0);
+  g_byte_array_set_size(bw->bytes, offset + size);
+  for (gsize i = 0; i < size; i++) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    bw->bytes->data[offset + i] = (guint8)state | 0x01;
+  }
+}
+
+/* Appends the nalu in |bw| with a 4 byte start code to |au|, inserting emulation prevention bytes
+ * where needed. The writer is reset. */
+static void
+append_nalu(GByteArray *au, BitWriter *bw)
+{
+  static const guint8 start_code[4] = {0, 0, 0, 1};
+  static const guint8 emulation_prevention = 3;
+  const guint8 *data = bw->bytes->data;
+  guint zeros = 0;
+  guint start = 0;
+
+  g_byte_array_append(au, start_code, sizeof(start_code));
+  for (guint i = 0; i < bw->bytes->len; i++) {
+    if (zeros >= 2 && data[i] <= 3) {
+      g_byte_array_append(au, &data[start], i - start);
+      g_byte_array_append(au, &emulation_prevention, 1);
+      start = i;
+      zeros = 0;
+    }
+    zeros = (data[i] == 0) ? zeros + 1 : 0;
+  }
+  g_byte_array_append(au, &data[start], bw->bytes->len - start);
+  g_byte_array_set_size(bw->bytes, 0);
+}
+
+static void
+put_leb128(GByteArray *bytes, gsize value)
+{
+  do {
+    guint8 byte = value & 0x7f;
+    value >>= 7;
+    if (value) byte |= 0x80;
+    g_byte_array_append(bytes, &byte, 1);
+  } while (value);
+}
+
+/* Appends the payload in |bw| as an OBU of |type| with a size field to |au|. The writer is
+ * reset. */
+static void
+append_obu(GByteArray *au, guint type, BitWriter *bw)
+{
+  guint8 header = (guint8)((type << 3) | 0x02);  // obu_has_size_field
+
+  g_byte_array_append(au, &header, 1);
+  put_leb128(au, bw->bytes->len);
+  g_byte_array_append(au, bw->bytes->data, bw->bytes->len);
+  g_byte_array_set_size(bw->bytes, 0);
+}
+
+/* Size of slice, or tile group, |idx| out of |num| sharing |au_size| bytes. */
+static gsize
+get_part_size(gsize au_size, guint idx, guint num)
+{
+  gsize size = au_size / num;
+
+  if (idx == num - 1) size += au_size % num;
+
+  return size > 0 ? size : 1;
+}
+
+/* H.264 */
+
+static void
+write_h264_sps(BitWriter *bw)
+{
+  put_bits(bw, 0x60 | H264_NALU_SPS, 8);  // nal_ref_idc = 3
+  put_bits(bw, 66, 8);  // profile_idc, Baseline
+  put_bits(bw, 0xc0, 8);  // constraint_set0_flag, constraint_set1_flag
+  put_bits(bw, 31, 8);  // level_idc
+  put_ue(bw, 0);  // seq_parameter_set_id
+  put_ue(bw, H264_LOG2_MAX_FRAME_NUM - 4);
+  put_ue(bw, 2);  // pic_order_cnt_type
+  put_ue(bw, 1);  // max_num_ref_frames
+  put_bits(bw, 0, 1);  // gaps_in_frame_num_value_allowed_flag
+  put_ue(bw, WIDTH / 16 - 1);  // pic_width_in_mbs_minus1
+  put_ue(bw, HEIGHT / 16 - 1);  // pic_height_in_map_units_minus1
+  put_bits(bw, 1, 1);  // frame_mbs_only_flag
+  put_bits(bw, 1, 1);  // direct_8x8_inference_flag
+  put_bits(bw, 0, 1);  // frame_cropping_flag
+  put_bits(bw, 0, 1);  // vui_parameters_present_flag
+  put_trailing_bits(bw);
+}
+
+static void
+write_h264_pps(BitWriter *bw)
+{
+  put_bits(bw, 0x60 | H264_NALU_PPS, 8);  // nal_ref_idc = 3
+  put_ue(bw, 0);  // pic_parameter_set_id
+  put_ue(bw, 0);  // seq_parameter_set_id
+  put_bits(bw, 0, 1);  // entropy_coding_mode_flag
+  put_bits(bw, 0, 1);  // bottom_field_pic_order_in_frame_present_flag
+  put_ue(bw, 0);  // num_slice_groups_minus1
+  put_ue(bw, 0);  // num_ref_idx_l0_default_active_minus1
+  put_ue(bw, 0);  // num_ref_idx_l1_default_active_minus1
+  put_bits(bw, 0, 1);  // weighted_pred_flag
+  put_bits(bw, 0, 2);  // weighted_bipred_idc
+  put_se(bw, 0);  // pic_init_qp_minus26
+  put_se(bw, 0);  // pic_init_qs_minus26
+  put_se(bw, 0);  // chroma_qp_index_offset
+  put_bits(bw, 1, 1);  // deblocking_filter_control_present_flag
+  put_bits(bw, 0, 1);  // constrained_intra_pred_flag
+  put_bits(bw, 0, 1);  // redundant_pic_cnt_present_flag
+  put_trailing_bits(bw);
+}
+
+static void
+write_h264_slice(BitWriter *bw, guint frame, guint gop, guint slice, gsize size, guint32 seed,
+    guint num_slices)
+{
+  gboolean is_idr = (frame == 0);
+
+  put_bits(bw, 0x40 | (is_idr ? H264_NALU_IDR : H264_NALU_SLICE), 8);  // nal_ref_idc = 2
+  put_ue(bw, slice * (H264_NUM_MBS / num_slices));  // first_mb_in_slice
+  put_ue(bw, is_idr ? 7 : 5);  // slice_type, all I or all P
+  put_ue(bw, 0);  // pic_parameter_set_id
+  put_bits(bw, frame, H264_LOG2_MAX_FRAME_NUM);  // frame_num
+  if (is_idr) {
+    put_ue(bw, gop & 1);  // idr_pic_id
+    put_bits(bw, 0, 1);  // no_output_of_prior_pics_flag
+    put_bits(bw, 0, 1);  // long_term_reference_flag
+  } else {
+    put_bits(bw, 0, 1);  // num_ref_idx_active_override_flag
+    put_bits(bw, 0, 1);  // ref_pic_list_modification_flag_l0
+    put_bits(bw, 0, 1);  // adaptive_ref_pic_marking_mode_flag
+  }
+  put_se(bw, 0);  // slice_qp_delta
+  put_ue(bw, 1);  // disable_deblocking_filter_idc
+  put_trailing_bits(bw);
+  put_filler(bw, size, seed);
+}
+
+static guint
+write_h264_au(const StreamGeneratorConfig *config, guint index, BitWriter *bw, GByteArray *au)
+{
+  guint frame = index % config->gop_length;
+  guint num_nalus = 0;
+
+  if (frame == 0) {
+    write_h264_sps(bw);
+    append_nalu(au, bw);
+    write_h264_pps(bw);
+    append_nalu(au, bw);
+    num_nalus += 2;
+  }
+  for (guint i = 0; i < config->nalus_per_au; i++) {
+    gsize size = get_part_size(config->au_size, i, config->nalus_per_au);
+    write_h264_slice(bw, frame % (1 << H264_LOG2_MAX_FRAME_NUM), index / config->gop_length, i,
+        size, index * config->nalus_per_au + i, config->nalus_per_au);
+    append_nalu(au, bw);
+    num_nalus++;
+  }
+
+  return num_nalus;
+}
+
+/* H.265 */
+
+static void
+put_h265_nalu_header(BitWriter *bw, guint type)
+{
+  put_bits(bw, type << 1, 8);  // forbidden_zero_bit, nal_unit_type, nuh_layer_id MSB
+  put_bits(bw, 1, 8);  // nuh_layer_id, nuh_temporal_id_plus1
+}
+
+static void
+put_h265_profile_tier_level(BitWriter *bw)
+{
+  put_bits(bw, 0, 2);  // general_profile_space
+  put_bits(bw, 0, 1);  // general_tier_flag
+  put_bits(bw, 1, 5);  // general_profile_idc, Main
+  put_bits(bw, 0x60000000, 32);  // general_profile_compatibility_flag[1, 2]
+  put_bits(bw, 1, 1);  // general_progressive_source_flag
+  put_bits(bw, 0, 1);  // general_interlaced_source_flag
+  put_bits(bw, 0, 1);  // general_non_packed_constraint_flag
+  put_bits(bw, 1, 1);  // general_frame_only_constraint_flag
+  put_bits(bw, 0, 32);  // general_reserved_zero_43bits and general_inbld_flag
+  put_bits(bw, 0, 12);
+  put_bits(bw, 93, 8);  // general_level_idc, 3.1
+}
+
+static void
+write_h265_vps(BitWriter *bw)
+{
+  put_h265_nalu_header(bw, H265_NALU_VPS);
+  put_bits(bw, 0, 4);  // vps_video_parameter_set_id
+  put_bits(bw, 1, 1);  // vps_base_layer_internal_flag
+  put_bits(bw, 1, 1);  // vps_base_layer_available_flag
+  put_bits(bw, 0, 6);  // vps_max_layers_minus1
+  put_bits(bw, 0, 3);  // vps_max_sub_layers_minus1
+  put_bits(bw, 1, 1);  // vps_temporal_id_nesting_flag
+  put_bits(bw, 0xffff, 16);  // vps_reserved_0xffff_16bits
+  put_h265_profile_tier_level(bw);
+  put_bits(bw, 1, 1);  // vps_sub_layer_ordering_info_present_flag
+  put_ue(bw, 1);  // vps_max_dec_pic_buffering_minus1
+  put_ue(bw, 0);  // vps_max_num_reorder_pics
+  put_ue(bw, 0);  // vps_max_latency_increase_plus1
+  put_bits(bw, 0, 6);  // vps_max_layer_id
+  put_ue(bw, 0);  // vps_num_layer_sets_minus1
+  put_bits(bw, 0, 1);  // vps_timing_info_present_flag
+  put_bits(bw, 0, 1);  // vps_extension_flag
+  put_trailing_bits(bw);
+}
+
+static void
+write_h265_sps(BitWriter *bw)
+{
+  put_h265_nalu_header(bw, H265_NALU_SPS);
+  put_bits(bw, 0, 4);  // sps_video_parameter_set_id
+  put_bits(bw, 0, 3);  // sps_max_sub_layers_minus1
+  put_bits(bw, 1, 1);  // sps_temporal_id_nesting_flag
+  put_h265_profile_tier_level(bw);
+  put_ue(bw, 0);  // sps_seq_parameter_set_id
+  put_ue(bw, 1);  // chroma_format_idc, 4:2:0
+  put_ue(bw, WIDTH);  // pic_width_in_luma_samples
+  put_ue(bw, HEIGHT);  // pic_height_in_luma_samples
+  put_bits(bw, 0, 1);  // conformance_window_flag
+  put_ue(bw, 0);  // bit_depth_luma_minus8
+  put_ue(bw, 0);  // bit_depth_chroma_minus8
+  put_ue(bw, H265_LOG2_MAX_POC_LSB - 4);
+  put_bits(bw, 1, 1);  // sps_sub_layer_ordering_info_present_flag
+  put_ue(bw, 1);  // sps_max_dec_pic_buffering_minus1
+  put_ue(bw, 0);  // sps_max_num_reorder_pics
+  put_ue(bw, 0);  // sps_max_latency_increase_plus1
+  put_ue(bw, 0);  // log2_min_luma_coding_block_size_minus3
+  put_ue(bw, 3);  // log2_diff_max_min_luma_coding_block_size, i.e., 64x64 CTBs
+  put_ue(bw, 0);  // log2_min_luma_transform_block_size_minus2
+  put_ue(bw, 3);  // log2_diff_max_min_luma_transform_block_size
+  put_ue(bw, 0);  // max_transform_hierarchy_depth_inter
+  put_ue(bw, 0);  // max_transform_hierarchy_depth_intra
+  put_bits(bw, 0, 1);  // scaling_list_enabled_flag
+  put_bits(bw, 0, 1);  // amp_enabled_flag
+  put_bits(bw, 0, 1);  // sample_adaptive_offset_enabled_flag
+  put_bits(bw, 0, 1);  // pcm_enabled_flag
+  put_ue(bw, 0);  // num_short_term_ref_pic_sets
+  put_bits(bw, 0, 1);  // long_term_ref_pics_present_flag
+  put_bits(bw, 0, 1);  // sps_temporal_mvp_enabled_flag
+  put_bits(bw, 0, 1);  // strong_intra_smoothing_enabled_flag
+  put_bits(bw, 0, 1);  // vui_parameters_present_flag
+  put_bits(bw, 0, 1);  // sps_extension_present_flag
+  put_trailing_bits(bw);
+}
+
+static void
+write_h265_pps(BitWriter *bw)
+{
+  put_h265_nalu_header(bw, H265_NALU_PPS);
+  put_ue(bw, 0);  // pps_pic_parameter_set_id
+  put_ue(bw, 0);  // pps_seq_parameter_set_id
+  put_bits(bw, 0, 1);  // dependent_slice_segments_enabled_flag
+  put_bits(bw, 0, 1);  // output_flag_present_flag
+  put_bits(bw, 0, 3);  // num_extra_slice_header_bits
+  put_bits(bw, 0, 1);  // sign_data_hiding_enabled_flag
+  put_bits(bw, 0, 1);  // cabac_init_present_flag
+  put_ue(bw, 0);  // num_ref_idx_l0_default_active_minus1
+  put_ue(bw, 0);  // num_ref_idx_l1_default_active_minus1
+  put_se(bw, 0);  // init_qp_minus26
+  put_bits(bw, 0, 1);  // constrained_intra_pred_flag
+  put_bits(bw, 0, 1);  // transform_skip_enabled_flag
+  put_bits(bw, 0, 1);  // cu_qp_delta_enabled_flag
+  put_se(bw, 0);  // pps_cb_qp_offset
+  put_se(bw, 0);  // pps_cr_qp_offset
+  put_bits(bw, 0, 1);  // pps_slice_chroma_qp_offsets_present_flag
+  put_bits(bw, 0, 1);  // weighted_pred_flag
+  put_bits(bw, 0, 1);  // weighted_bipred_flag
+  put_bits(bw, 0, 1);  // transquant_bypass_enabled_flag
+  put_bits(bw, 0, 1);  // tiles_enabled_flag
+  put_bits(bw, 0, 1);  // entropy_coding_sync_enabled_flag
+  put_bits(bw, 0, 1);  // pps_loop_filter_across_slices_enabled_flag
+  put_bits(bw, 0, 1);  // deblocking_filter_control_present_flag
+  put_bits(bw, 0, 1);  // pps_scaling_list_data_present_flag
+  put_bits(bw, 0, 1);  // lists_modification_present_flag
+  put_ue(bw, 0);  // log2_parallel_merge_level_minus2
+  put_bits(bw, 0, 1);  // slice_segment_header_extension_present_flag
+  put_bits(bw, 0, 1);  // pps_extension_present_flag
+  put_trailing_bits(bw);
+}
+
+static void
+write_h265_slice(BitWriter *bw, guint frame, guint slice, gsize size, guint32 seed,
+    guint num_slices)
+{
+  gboolean is_idr = (frame == 0);
+
+  put_h265_nalu_header(bw, is_idr ? H265_NALU_IDR_W_RADL : H265_NALU_TRAIL_R);
+  put_bits(bw, slice == 0, 1);  // first_slice_segment_in_pic_flag
+  if (is_idr) put_bits(bw, 0, 1);  // no_output_of_prior_pics_flag
+  put_ue(bw, 0);  // slice_pic_parameter_set_id
+  if (slice > 0) {
+    put_bits(bw, slice * (H265_NUM_CTBS / num_slices), H265_CTB_ADDRESS_BITS);
+  }
+  put_ue(bw, is_idr ? 2 : 1);  // slice_type, I or P
+  if (!is_idr) {
+    put_bits(bw, frame, H265_LOG2_MAX_POC_LSB);  // slice_pic_order_cnt_lsb
+    put_bits(bw, 0, 1);  // short_term_ref_pic_set_sps_flag
+    put_ue(bw, 1);  // num_negative_pics
+    put_ue(bw, 0);  // num_positive_pics
+    put_ue(bw, 0);  // delta_poc_s0_minus1
+    put_bits(bw, 1, 1);  // used_by_curr_pic_s0_flag
+    put_bits(bw, 0, 1);  // num_ref_idx_active_override_flag
+    put_ue(bw, 0);  // five_minus_max_num_merge_cand
+  }
+  put_se(bw, 0);  // slice_qp_delta
+  put_trailing_bits(bw);  // byte_alignment()
+  put_filler(bw, size, seed);
+}
+
+static guint
+write_h265_au(const StreamGeneratorConfig *config, guint index, BitWriter *bw, GByteArray *au)
+{
+  guint frame = index % config->gop_length;
+  guint num_nalus = 0;
+
+  if (frame == 0) {
+    write_h265_vps(bw);
+    append_nalu(au, bw);
+    write_h265_sps(bw);
+    append_nalu(au, bw);
+    write_h265_pps(bw);
+    append_nalu(au, bw);
+    num_nalus += 3;
+  }
+  for (guint i = 0; i < config->nalus_per_au; i++) {
+    gsize size = get_part_size(config->au_size, i, config->nalus_per_au);
+    write_h265_slice(bw, frame % (1 << H265_LOG2_MAX_POC_LSB), i, size,
+        index * config->nalus_per_au + i, config->nalus_per_au);
+    append_nalu(au, bw);
+    num_nalus++;
+  }
+
+  return num_nalus;
+}
+
+/* AV1 */
+
+static void
+write_av1_sequence_header(BitWriter *bw)
+{
+  put_bits(bw, 0, 3);  // seq_profile, Main
+  put_bits(bw, 0, 1);  // still_picture
+  put_bits(bw, 0, 1);  // reduced_still_picture_header
+  put_bits(bw, 0, 1);  // timing_info_present_flag
+  put_bits(bw, 0, 1);  // initial_display_delay_present_flag
+  put_bits(bw, 0, 5);  // operating_points_cnt_minus_1
+  put_bits(bw, 0, 12);  // operating_point_idc[0]
+  put_bits(bw, 8, 5);  // seq_level_idx[0], 4.0
+  put_bits(bw, 0, 1);  // seq_tier[0]
+  put_bits(bw, 10, 4);  // frame_width_bits_minus_1
+  put_bits(bw, 9, 4);  // frame_height_bits_minus_1
+  put_bits(bw, WIDTH - 1, 11);  // max_frame_width_minus_1
+  put_bits(bw, HEIGHT - 1, 10);  // max_frame_height_minus_1
+  put_bits(bw, 0, 1);  // frame_id_numbers_present_flag
+  put_bits(bw, 0, 1);  // use_128x128_superblock
+  put_bits(bw, 0, 1);  // enable_filter_intra
+  put_bits(bw, 0, 1);  // enable_intra_edge_filter
+  put_bits(bw, 0, 1);  // enable_interintra_compound
+  put_bits(bw, 0, 1);  // enable_masked_compound
+  put_bits(bw, 0, 1);  // enable_warped_motion
+  put_bits(bw, 0, 1);  // enable_dual_filter
+  put_bits(bw, 0, 1);  // enable_order_hint
+  put_bits(bw, 1, 1);  // seq_choose_screen_content_tools
+  put_bits(bw, 1, 1);  // seq_choose_integer_mv
+  put_bits(bw, 0, 1);  // enable_superres
+  put_bits(bw, 0, 1);  // enable_cdef
+  put_bits(bw, 0, 1);  // enable_restoration
+  put_bits(bw, 0, 1);  // high_bitdepth
+  put_bits(bw, 0, 1);  // mono_chrome
+  put_bits(bw, 0, 1);  // color_description_present_flag
+  put_bits(bw, 0, 1);  // color_range
+  put_bits(bw, 0, 2);  // chroma_sample_position
+  put_bits(bw, 0, 1);  // separate_uv_delta_q
+  put_bits(bw, 0, 1);  // film_grain_params_present
+  put_trailing_bits(bw);
+}
+
+static void
+write_av1_frame_header(BitWriter *bw, gboolean is_key)
+{
+  put_bits(bw, 0, 1);  // show_existing_frame
+  put_bits(bw, is_key ? 0 : 1, 2);  // frame_type, KEY_FRAME or INTER_FRAME
+  put_bits(bw, 1, 1);  // show_frame
+}
+
+static guint
+write_av1_tu(const StreamGeneratorConfig *config, guint index, BitWriter *bw, GByteArray *au)
+{
+  gboolean is_key = (index % config->gop_length == 0);
+  guint32 seed = index * config->nalus_per_au;
+  guint num_obus = 0;
+
+  append_obu(au, OBU_TEMPORAL_DELIMITER, bw);
+  num_obus++;
+  if (is_key) {
+    write_av1_sequence_header(bw);
+    append_obu(au, OBU_SEQUENCE_HEADER, bw);
+    num_obus++;
+  }
+  write_av1_frame_header(bw, is_key);
+  if (config->nalus_per_au == 1) {
+    // A frame OBU holds both the frame header and the tile group.
+    put_alignment_bits(bw);
+    put_filler(bw, config->au_size, seed);
+    append_obu(au, OBU_FRAME, bw);
+    num_obus++;
+  } else {
+    // A frame header OBU followed by tile group OBUs.
+    put_trailing_bits(bw);
+    append_obu(au, OBU_FRAME_HEADER, bw);
+    num_obus++;
+    for (guint i = 1; i < config->nalus_per_au; i++) {
+      put_filler(bw, get_part_size(config->au_size, i - 1, config->nalus_per_au - 1), seed + i);
+      append_obu(au, OBU_TILE_GROUP, bw);
+      num_obus++;
+    }
+  }
+
+  return num_obus;
+}
+
+GstCaps *
+stream_generator_get_caps(const StreamGeneratorConfig *config)
+{
+  const gchar *media_type = "video/x-h264,stream-format=byte-stream,alignment=au";
+  gchar *caps_str = NULL;
+  GstCaps *caps = NULL;
+
+  if (config->codec == SV_CODEC_H265) {
+    media_type = "video/x-h265,stream-format=byte-stream,alignment=au";
+  } else if (config->codec == SV_CODEC_AV1) {
+    media_type = "video/x-av1,stream-format=obu-stream,alignment=tu";
+  }
+  caps_str = g_strdup_printf(
+      "%s,width=%d,height=%d,framerate=%u/1", media_type, WIDTH, HEIGHT, config->fps);
+  caps = gst_caps_from_string(caps_str);
+  g_free(caps_str);
+
+  return caps;
+}
+
+GstBuffer *
+stream_generator_create_au(const StreamGeneratorConfig *config, guint index, guint *num_nalus)
+{
+  BitWriter bw = {g_byte_array_new(), 0, 0};
+  GByteArray *au = g_byte_array_sized_new(config->au_size + 256);
+  GstBuffer *buf = NULL;
+  gsize size = 0;
+  guint nalus = 0;
+
+  g_assert(config->gop_length > 0 && config->nalus_per_au > 0 && config->fps > 0);
+
+  switch (config->codec) {
+    case SV_CODEC_H264:
+      nalus = write_h264_au(config, index, &bw, au);
+      break;
+    case SV_CODEC_H265:
+      nalus = write_h265_au(config, index, &bw, au);
+      break;
+    case SV_CODEC_AV1:
+      nalus = write_av1_tu(config, index, &bw, au);
+      break;
+    default:
+      break;
+  }
+  g_byte_array_unref(bw.bytes);
+
+  size = au->len;
+  buf = gst_buffer_new_wrapped(g_byte_array_free(au, FALSE), size);
+  GST_BUFFER_PTS(buf) = gst_util_uint64_scale(index, GST_SECOND, config->fps);
+  GST_BUFFER_DTS(buf) = GST_BUFFER_PTS(buf);
+  GST_BUFFER_DURATION(buf) = gst_util_uint64_scale(1, GST_SECOND, config->fps);
+  GST_BUFFER_OFFSET(buf) = index;
+  if (index % config->gop_length != 0) GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  if (num_nalus) *num_nalus = nalus;
+
+  return buf;
+}
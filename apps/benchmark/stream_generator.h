@@ -0,0 +1,54 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STREAM_GENERATOR_H__
+#define __STREAM_GENERATOR_H__
+
+#include <gst/gst.h>
+#include <signed-video-framework/signed_video_common.h>
+
+G_BEGIN_DECLS
+
+/* Layout of a synthetic stream. Every GOP starts with a key frame carrying the parameter sets, or
+ * the AV1 sequence header, followed by |gop_length| - 1 delta frames. */
+typedef struct {
+  SignedVideoCodec codec;
+  guint gop_length;  // Access units per GOP
+  guint nalus_per_au;  // Slices, or OBUs, with picture data per access unit
+  gsize au_size;  // Bytes of picture data per access unit
+  guint num_aus;  // Access units in the stream
+  guint fps;  // Frame rate used for timestamps
+} StreamGeneratorConfig;
+
+/* Gets the caps of the stream, i.e., byte-stream for H.26x and obu-stream for AV1, both aligned on
+ * access units. */
+GstCaps *
+stream_generator_get_caps(const StreamGeneratorConfig *config);
+
+/* Creates access unit |index| of the stream as a buffer with a single memory. Timestamps and the
+ * delta unit flag are set, and the offset is set to |index|. If |num_nalus| is not NULL it is set
+ * to the number of nalus, or OBUs, in the access unit. */
+GstBuffer *
+stream_generator_create_au(const StreamGeneratorConfig *config, guint index, guint *num_nalus);
+
+G_END_DECLS
+
+#endif  // __STREAM_GENERATOR_H__
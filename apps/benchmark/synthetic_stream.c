@@ -0,0 +1,424 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * This application benchmarks signing and validation of synthetic streams, generated without an
+ * encoder. The length of the GOPs, the number of nalus, or OBUs, per access unit, the size of the
+ * access units and the duration of the stream are configurable.
+ *
+ * In 'sign' mode the stream is pushed through the signing element. In 'validate' mode the stream
+ * is first signed and then pushed through on_new_sample_from_sink() of the validator. The result
+ * is printed as one JSON object on stdout, holding nalus/s, MB/s, the p50 and p99 latency per
+ * access unit and the peak RSS of the process.
+ *
+ * The signing plugin has to be found through GST_PLUGIN_PATH.
+ *
+ * Example to benchmark validation of a two minutes long H.265 stream with four slices per frame
+ *   $ ./synthetic_stream -m validate -c h265 -n 4 -d 120
+ */
+
+#include <gst/app/gstappsrc.h>
+#include <gst/gst.h>
+#include <stdlib.h>  // atoi
+#include <string.h>  // strcmp
+#include <sys/resource.h>  // getrusage
+
+#include "stream_generator.h"
+#include "validation.h"
+
+typedef struct {
+  guint num_aus;
+  GstClockTime *entry_times;  // Per access unit, when it entered the signing element
+  GArray *latencies;  // Per access unit latencies in nanoseconds
+  GPtrArray *signed_aus;  // Output of the signing element, if collected
+  guint64 signed_nalus;
+  guint64 signed_bytes;
+  ValidationData *validation;
+} BenchData;
+
+typedef struct {
+  const gchar *benchmark;
+  guint64 nalus;
+  guint64 bytes;
+  gdouble seconds;
+} BenchResult;
+
+static GstPadProbeReturn
+on_signing_sink_buffer(GstPad __attribute__((unused)) *pad, GstPadProbeInfo *info,
+    BenchData *bench)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  guint64 offset = GST_BUFFER_OFFSET(buf);
+
+  if (offset < bench->num_aus) bench->entry_times[offset] = gst_util_get_timestamp();
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+on_signing_src_buffer(GstPad __attribute__((unused)) *pad, GstPadProbeInfo *info,
+    BenchData *bench)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  guint64 offset = GST_BUFFER_OFFSET(buf);
+
+  // SEIs pushed as standalone buffers have no offset and are not counted as access units.
+  if (offset < bench->num_aus && GST_CLOCK_TIME_IS_VALID(bench->entry_times[offset])) {
+    guint64 latency = gst_util_get_timestamp() - bench->entry_times[offset];
+    g_array_append_val(bench->latencies, latency);
+    bench->entry_times[offset] = GST_CLOCK_TIME_NONE;
+  }
+  if (bench->signed_aus) {
+    g_ptr_array_add(bench->signed_aus, gst_buffer_ref(buf));
+    bench->signed_nalus += gst_buffer_n_memory(buf);
+    bench->signed_bytes += gst_buffer_get_size(buf);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Times on_new_sample_from_sink() of the validator. */
+static GstFlowReturn
+on_new_sample(GstElement *elt, BenchData *bench)
+{
+  GstClockTime start = gst_util_get_timestamp();
+  GstFlowReturn ret = on_new_sample_from_sink(elt, bench->validation);
+  guint64 latency = gst_util_get_timestamp() - start;
+
+  g_array_append_val(bench->latencies, latency);
+
+  return ret;
+}
+
+/* The validator posts a result message per validation, which nobody reads here. */
+static GstBusSyncReply
+drop_element_messages(GstBus __attribute__((unused)) *bus, GstMessage *message,
+    gpointer __attribute__((unused)) user_data)
+{
+  return GST_MESSAGE_TYPE(message) == GST_MESSAGE_ELEMENT ? GST_BUS_DROP : GST_BUS_PASS;
+}
+
+/* Pushes all |aus| to the appsrc named 'src' of |pipeline|, and runs it until EOS. The ownership
+ * of the access units is transferred and |aus| is emptied. Returns the wall time, or a negative
+ * value on error. */
+static gdouble
+push_and_run(GstElement *pipeline, GstCaps *caps, GPtrArray *aus)
+{
+  GstElement *src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+  GstBus *bus = gst_element_get_bus(pipeline);
+  GstMessage *msg = NULL;
+  GstClockTime start = 0;
+  gdouble seconds = -1.0;
+
+  g_object_set(src, "format", GST_FORMAT_TIME, "max-bytes", (guint64)0, NULL);
+  gst_app_src_set_caps(GST_APP_SRC(src), caps);
+
+  start = gst_util_get_timestamp();
+  if (gst_element_set_state(pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE) {
+    g_warning("failed to start the pipeline");
+    goto out;
+  }
+  for (guint i = 0; i < aus->len; i++) {
+    gst_app_src_push_buffer(GST_APP_SRC(src), g_ptr_array_index(aus, i));
+  }
+  g_ptr_array_set_size(aus, 0);
+  gst_app_src_end_of_stream(GST_APP_SRC(src));
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
+    seconds = (gdouble)(gst_util_get_timestamp() - start) / GST_SECOND;
+  } else {
+    g_warning("pipeline failed before EOS");
+  }
+
+out:
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  if (msg) gst_message_unref(msg);
+  gst_object_unref(bus);
+  gst_object_unref(src);
+
+  return seconds;
+}
+
+static gint
+compare_latencies(gconstpointer a, gconstpointer b)
+{
+  guint64 lhs = *(const guint64 *)a;
+  guint64 rhs = *(const guint64 *)b;
+
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/* Gets the |percentile| of the sorted |latencies| in microseconds. */
+static gdouble
+get_percentile(GArray *latencies, guint percentile)
+{
+  if (latencies->len == 0) return 0.0;
+
+  return (gdouble)g_array_index(latencies, guint64, (latencies->len - 1) * percentile / 100) /
+      GST_USECOND;
+}
+
+static void
+print_result(const BenchResult *result, const StreamGeneratorConfig *config,
+    const gchar *codec_str, const gchar *signing_properties, BenchData *bench)
+{
+  GString *json = g_string_new(NULL);
+  gchar *properties = g_strescape(signing_properties, NULL);
+  struct rusage usage;
+  glong peak_rss_kb = 0;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0) peak_rss_kb = usage.ru_maxrss;
+  g_array_sort(bench->latencies, compare_latencies);
+
+  g_string_append_printf(json,
+      "{\"benchmark\": \"%s\", \"codec\": \"%s\", \"signing_properties\": \"%s\", "
+      "\"gop_length\": %u, \"nalus_per_au\": %u, \"au_size\": %" G_GSIZE_FORMAT ", "
+      "\"access_units\": %u, ",
+      result->benchmark, codec_str, properties, config->gop_length, config->nalus_per_au,
+      config->au_size, config->num_aus);
+  g_string_append_printf(json,
+      "\"nalus\": %" G_GUINT64_FORMAT ", \"bytes\": %" G_GUINT64_FORMAT ", \"seconds\": %.6f, "
+      "\"nalus_per_second\": %.1f, \"mb_per_second\": %.3f, ",
+      result->nalus, result->bytes, result->seconds, result->nalus / result->seconds,
+      result->bytes / 1e6 / result->seconds);
+  g_string_append_printf(json, "\"latency_us\": {\"p50\": %.1f, \"p99\": %.1f}, ",
+      get_percentile(bench->latencies, 50), get_percentile(bench->latencies, 99));
+  if (bench->validation) {
+    g_string_append_printf(json, "\"valid_gops\": %d, \"invalid_gops\": %d, ",
+        bench->validation->valid_gops, bench->validation->invalid_gops);
+  }
+  g_string_append_printf(json, "\"peak_rss_kb\": %ld}", peak_rss_kb);
+  g_print("%s\n", json->str);
+
+  g_free(properties);
+  g_string_free(json, TRUE);
+}
+
+int
+main(int argc, char **argv)
+{
+  int status = 1;
+  GError *error = NULL;
+  StreamGeneratorConfig config = {SV_CODEC_H264, 30, 1, 20000, 0, 30};
+  guint duration = 60;
+  const gchar *codec_str = "h264";
+  const gchar *mode_str = "sign";
+  const gchar *signing_properties = "";
+  gboolean validate = FALSE;
+  BenchData bench = {0};
+  BenchResult result = {0};
+  GPtrArray *aus = NULL;
+  GstCaps *caps = NULL;
+  GstElement *pipeline = NULL;
+  GstElement *element = NULL;
+  GstPad *pad = NULL;
+  GstBus *bus = NULL;
+  gchar *description = NULL;
+  guint64 input_nalus = 0;
+  guint64 input_bytes = 0;
+
+  int arg = 1;
+  gchar *usage = g_strdup_printf(
+      "Usage:\n%s [-h] [-m mode] [-c codec] [-g gop_length] [-n nalus_per_au] [-s au_size] "
+      "[-d duration] [-f fps] [-p properties]\n\n"
+      "Optional\n"
+      "  -m mode          : 'sign' (default) or 'validate'\n"
+      "  -c codec         : 'h264' (default), 'h265' or 'av1'\n"
+      "  -g gop_length    : Access units per GOP (default 30)\n"
+      "  -n nalus_per_au  : Slices, or OBUs, with picture data per access unit (default 1)\n"
+      "  -s au_size       : Bytes of picture data per access unit (default 20000)\n"
+      "  -d duration      : Duration of the stream in seconds (default 60)\n"
+      "  -f fps           : Frame rate (default 30)\n"
+      "  -p properties    : Properties of the signing element, e.g., 'hash-algo=sha512'\n",
+      argv[0]);
+
+  // Initialization.
+  if (!gst_init_check(NULL, NULL, &error)) {
+    g_warning("gst_init failed: %s", error->message);
+    goto out;
+  }
+
+  // Parse options from command-line.
+  while (arg < argc) {
+    if (strcmp(argv[arg], "-h") == 0) {
+      g_message("\n%s\n", usage);
+      status = 0;
+      goto out;
+    } else if (arg + 1 >= argc) {
+      g_warning("missing value of option %s\n%s", argv[arg], usage);
+      goto out;
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      mode_str = argv[++arg];
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      codec_str = argv[++arg];
+    } else if (strcmp(argv[arg], "-g") == 0) {
+      config.gop_length = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-n") == 0) {
+      config.nalus_per_au = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      config.au_size = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-d") == 0) {
+      duration = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      config.fps = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      signing_properties = argv[++arg];
+    } else {
+      g_warning("unknown option: %s\n%s", argv[arg], usage);
+      goto out;
+    }
+    arg++;
+  }
+
+  if (strcmp(codec_str, "h264") == 0) {
+    config.codec = SV_CODEC_H264;
+  } else if (strcmp(codec_str, "h265") == 0) {
+    config.codec = SV_CODEC_H265;
+  } else if (strcmp(codec_str, "av1") == 0) {
+    config.codec = SV_CODEC_AV1;
+  } else {
+    g_warning("unsupported codec format '%s'", codec_str);
+    goto out;
+  }
+  if (strcmp(mode_str, "sign") != 0 && strcmp(mode_str, "validate") != 0) {
+    g_warning("unsupported mode '%s'", mode_str);
+    goto out;
+  }
+  validate = (strcmp(mode_str, "validate") == 0);
+  if (config.gop_length == 0 || config.nalus_per_au == 0 || config.fps == 0 || duration == 0) {
+    g_warning("gop_length, nalus_per_au, duration and fps have to be positive");
+    goto out;
+  }
+  config.num_aus = duration * config.fps;
+
+  // Generate the stream up front, to not measure the generator.
+  aus = g_ptr_array_sized_new(config.num_aus);
+  for (guint i = 0; i < config.num_aus; i++) {
+    guint num_nalus = 0;
+    GstBuffer *au = stream_generator_create_au(&config, i, &num_nalus);
+    input_nalus += num_nalus;
+    input_bytes += gst_buffer_get_size(au);
+    g_ptr_array_add(aus, au);
+  }
+  caps = stream_generator_get_caps(&config);
+
+  bench.num_aus = config.num_aus;
+  bench.entry_times = g_new(GstClockTime, config.num_aus);
+  for (guint i = 0; i < config.num_aus; i++) bench.entry_times[i] = GST_CLOCK_TIME_NONE;
+  bench.latencies = g_array_sized_new(FALSE, FALSE, sizeof(guint64), config.num_aus);
+  if (validate) bench.signed_aus = g_ptr_array_sized_new(config.num_aus);
+
+  // Sign.
+  description = g_strdup_printf(
+      "appsrc name=src ! signing name=signing %s ! fakesink sync=false", signing_properties);
+  pipeline = gst_parse_launch(description, &error);
+  if (!pipeline) {
+    g_warning("failed to create pipeline '%s': %s", description, error ? error->message : "");
+    goto out;
+  }
+  element = gst_bin_get_by_name(GST_BIN(pipeline), "signing");
+  pad = gst_element_get_static_pad(element, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback)on_signing_sink_buffer, &bench, NULL);
+  gst_object_unref(pad);
+  pad = gst_element_get_static_pad(element, "src");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback)on_signing_src_buffer, &bench, NULL);
+  gst_object_unref(pad);
+  pad = NULL;
+  gst_object_unref(element);
+  element = NULL;
+
+  result.benchmark = "signing";
+  result.nalus = input_nalus;
+  result.bytes = input_bytes;
+  result.seconds = push_and_run(pipeline, caps, aus);
+  gst_object_unref(pipeline);
+  pipeline = NULL;
+  if (result.seconds <= 0.0) goto out;
+
+  if (!validate) {
+    print_result(&result, &config, codec_str, signing_properties, &bench);
+    status = 0;
+    goto out;
+  }
+
+  // Validate the signed stream.
+  for (guint i = 0; i < bench.signed_aus->len; i++) {
+    GstBuffer *au = g_ptr_array_index(bench.signed_aus, i);
+    if (config.codec == SV_CODEC_AV1 && gst_buffer_n_memory(au) > 1) {
+      // The validator parses AV1 OBUs from the first memory only.
+      g_ptr_array_index(bench.signed_aus, i) = gst_buffer_copy_region(
+          au, GST_BUFFER_COPY_ALL | GST_BUFFER_COPY_MERGE, 0, gst_buffer_get_size(au));
+      gst_buffer_unref(au);
+    }
+  }
+  bench.validation = validation_data_new(config.codec, true);
+  if (!bench.validation) {
+    g_warning("failed to create a Signed Video session");
+    goto out;
+  }
+  g_array_set_size(bench.latencies, 0);
+
+  pipeline = gst_parse_launch(
+      "appsrc name=src ! appsink name=validatorsink emit-signals=true sync=false", &error);
+  if (!pipeline) {
+    g_warning("failed to create validation pipeline: %s", error ? error->message : "");
+    goto out;
+  }
+  element = gst_bin_get_by_name(GST_BIN(pipeline), "validatorsink");
+  g_signal_connect(element, "new-sample", G_CALLBACK(on_new_sample), &bench);
+  gst_object_unref(element);
+  element = NULL;
+  bus = gst_element_get_bus(pipeline);
+  gst_bus_set_sync_handler(bus, drop_element_messages, NULL, NULL);
+  gst_object_unref(bus);
+
+  result.benchmark = "validation";
+  result.nalus = bench.signed_nalus;
+  result.bytes = bench.signed_bytes;
+  result.seconds = push_and_run(pipeline, caps, bench.signed_aus);
+  if (result.seconds <= 0.0) goto out;
+
+  print_result(&result, &config, codec_str, signing_properties, &bench);
+  status = 0;
+
+out:
+  if (pipeline) gst_object_unref(pipeline);
+  if (caps) gst_caps_unref(caps);
+  if (aus) g_ptr_array_free(aus, TRUE);
+  if (bench.signed_aus) {
+    for (guint i = 0; i < bench.signed_aus->len; i++) {
+      gst_buffer_unref(g_ptr_array_index(bench.signed_aus, i));
+    }
+    g_ptr_array_free(bench.signed_aus, TRUE);
+  }
+  if (bench.latencies) g_array_free(bench.latencies, TRUE);
+  g_free(bench.entry_times);
+  validation_data_free(bench.validation);
+  g_free(description);
+  g_free(usage);
+  if (error) g_error_free(error);
+
+  return status;
+}
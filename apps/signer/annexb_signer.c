@@ -0,0 +1,379 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "annexb_signer.h"
+
+#include <errno.h>  // errno, EINTR
+#include <fcntl.h>  // open
+#include <signed-video-framework/signed_video_sign.h>
+#include <string.h>  // memset
+#include <sys/uio.h>  // writev, struct iovec
+#include <unistd.h>  // close, read
+
+#include "gst-plugin/gstsigning_nalu.h"
+#include "gst-plugin/gstsigning_session.h"
+
+// Number of pieces, of the mapped input and of SEIs, written with one call to writev().
+#define MAX_IOVECS 1024
+// Bytes read at a time when following a growing file.
+#define FOLLOW_READ_SIZE (1024 * 1024)
+// Time to wait for a growing file to grow.
+#define FOLLOW_POLL_INTERVAL_USEC (100 * 1000)
+// Created by the recorder, next to the file, when it is done writing.
+#define CLOSE_MARKER_SUFFIX ".done"
+
+/* Collects pieces of the output and writes them with one system call. */
+typedef struct {
+  int fd;
+  struct iovec iov[MAX_IOVECS];
+  guint num_iov;
+  GPtrArray *seis;  // SEIs referenced by |iov|, freed once written
+  guint64 bytes_written;
+} AnnexBWriter;
+
+static gboolean
+flush_writer(AnnexBWriter *writer)
+{
+  struct iovec *iov = writer->iov;
+  guint num_iov = writer->num_iov;
+
+  while (num_iov > 0) {
+    ssize_t written = writev(writer->fd, iov, num_iov);
+
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return FALSE;
+    }
+    writer->bytes_written += written;
+    // Skip what was written, which may end in the middle of a piece.
+    while (num_iov > 0 && (gsize)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      num_iov--;
+    }
+    if (num_iov > 0) {
+      iov->iov_base = (guint8 *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  writer->num_iov = 0;
+  g_ptr_array_set_size(writer->seis, 0);
+
+  return TRUE;
+}
+
+/* Queues |size| bytes at |data| for writing. If |sei| is set the writer takes ownership of it. */
+static gboolean
+queue_data(AnnexBWriter *writer, const guint8 *data, gsize size, guint8 *sei)
+{
+  if (sei) g_ptr_array_add(writer->seis, sei);
+  if (size == 0) return TRUE;
+
+  writer->iov[writer->num_iov].iov_base = (void *)data;
+  writer->iov[writer->num_iov].iov_len = size;
+  writer->num_iov++;
+
+  return writer->num_iov < MAX_IOVECS || flush_writer(writer);
+}
+
+/* Signing of one byte-stream. */
+typedef struct {
+  const gchar *filename;
+  const gchar *outfilename;
+  signed_video_t *sv;
+  AnnexBWriter writer;
+  guint num_nalus;
+} AnnexBSession;
+
+/* Fetches all SEIs available from the lib and queues them for writing. The SEIs are added for
+ * signing, like any other nalu, unless at the end of the stream. */
+static gboolean
+get_and_add_seis(signed_video_t *sv, AnnexBWriter *writer, const guint8 *peek_nalu,
+    gsize peek_nalu_size, gboolean add)
+{
+  SignedVideoReturnCode sv_rc;
+  guint8 *sei = NULL;
+  gsize sei_size = 0;
+
+  sv_rc = signed_video_get_sei(sv, &sei, &sei_size, NULL, peek_nalu, peek_nalu_size, NULL);
+  while (sv_rc == SV_OK && sei && sei_size > 0) {
+    // The SEIs from the lib come with a start code, which is what a byte-stream needs.
+    const gsize prefix_size =
+        gst_signing_nalu_prefix_size(GST_SIGNING_NALU_FORMAT_START_CODE, sei, sei_size);
+
+    if (add && sei_size > prefix_size) {
+      sv_rc = signed_video_add_nalu_for_signing_with_timestamp(
+          sv, sei + prefix_size, sei_size - prefix_size, NULL);
+    }
+    if (!queue_data(writer, sei, sei_size, sei)) return FALSE;
+    sei = NULL;
+    sei_size = 0;
+    if (sv_rc != SV_OK) break;
+
+    sv_rc = signed_video_get_sei(sv, &sei, &sei_size, NULL, peek_nalu, peek_nalu_size, NULL);
+  }
+  g_free(sei);
+
+  return sv_rc == SV_OK;
+}
+
+static gboolean
+session_init(AnnexBSession *session, const gchar *filename, const gchar *outfilename,
+    SignedVideoCodec codec, const GstSigningKey *key)
+{
+  session->filename = filename;
+  session->outfilename = outfilename;
+  session->writer.fd = -1;
+  session->writer.seis = g_ptr_array_new_with_free_func(g_free);
+
+  session->sv = gst_signing_session_new(codec, key, NULL);
+  if (!session->sv) return FALSE;
+
+  session->writer.fd = open(outfilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (session->writer.fd < 0) {
+    g_warning("failed to open '%s' for writing", outfilename);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Closes the output. Returns FALSE if it could not be written. */
+static gboolean
+session_clear(AnnexBSession *session)
+{
+  gboolean success = TRUE;
+
+  // Nothing to clear if never initialized.
+  if (!session->writer.seis) return TRUE;
+  if (session->writer.fd >= 0 && close(session->writer.fd) != 0) {
+    g_warning("failed to write '%s': %s", session->outfilename, g_strerror(errno));
+    success = FALSE;
+  }
+  g_ptr_array_free(session->writer.seis, TRUE);
+  if (session->sv) signed_video_free(session->sv);
+  memset(session, 0, sizeof(*session));
+
+  return success;
+}
+
+/* Signs the nalus in |data| and queues them, and the SEIs, for writing. Unless |at_end|, the last
+ * nalu is left as is since it may not be complete yet. |consumed| is set to the end of the data
+ * queued, which has to stay valid until the writer is flushed. */
+static gboolean
+sign_nalus(
+    AnnexBSession *session, const guint8 *data, gsize size, gboolean at_end, gsize *consumed)
+{
+  AnnexBWriter *writer = &session->writer;
+  gsize pos = gst_signing_nalu_find_start_code(data, size, 0);
+  gsize written_pos = 0;  // End of the data queued for writing
+  gsize end = size;
+
+  while (pos < size) {
+    const gsize prefix_size =
+        gst_signing_nalu_prefix_size(GST_SIGNING_NALU_FORMAT_START_CODE, &data[pos], size - pos);
+    const gsize next = gst_signing_nalu_find_start_code(data, size, pos + prefix_size);
+    const guint8 *nalu = &data[pos + prefix_size];
+    const gsize nalu_size = next - pos - prefix_size;
+
+    // Without a following start code the nalu may still grow.
+    if (next == size && !at_end) break;
+
+    // Pull the SEIs ready to be sent before adding the current nalu, as the signing element does.
+    // They go in front of the start code, hence queue the input up to it first.
+    if (!queue_data(writer, &data[written_pos], pos - written_pos, NULL)) goto write_failed;
+    written_pos = pos;
+    if (!get_and_add_seis(session->sv, writer, nalu, nalu_size, TRUE)) goto sign_failed;
+    if (signed_video_add_nalu_for_signing_with_timestamp(session->sv, nalu, nalu_size, NULL) !=
+        SV_OK) {
+      goto sign_failed;
+    }
+    session->num_nalus++;
+    pos = next;
+  }
+
+  if (!at_end) {
+    // Keep the last nalu, or if there is no start code yet, what may be the start of one.
+    end = pos < size ? pos : (size > 3 ? size - 3 : 0);
+  }
+  if (!queue_data(writer, &data[written_pos], end - written_pos, NULL)) goto write_failed;
+  *consumed = end;
+
+  return TRUE;
+
+sign_failed:
+  g_warning("failed to sign nalu %u of '%s'", session->num_nalus, session->filename);
+  return FALSE;
+write_failed:
+  g_warning("failed to write '%s': %s", session->outfilename, g_strerror(errno));
+  return FALSE;
+}
+
+/* Ends the stream and writes what is left, including the SEIs of the last GOP, which have no
+ * following nalu and are appended to the end. */
+static gboolean
+session_finish(AnnexBSession *session)
+{
+  if (signed_video_set_end_of_stream(session->sv) != SV_OK ||
+      !get_and_add_seis(session->sv, &session->writer, NULL, 0, FALSE)) {
+    g_warning("failed to get the SEIs at the end of '%s'", session->filename);
+    return FALSE;
+  }
+  if (!flush_writer(&session->writer)) {
+    g_warning("failed to write '%s': %s", session->outfilename, g_strerror(errno));
+    return FALSE;
+  }
+  g_message("Signed %u nalus of '%s'", session->num_nalus, session->filename);
+
+  return TRUE;
+}
+
+gboolean
+annexb_signer_get_codec(const gchar *filename, SignedVideoCodec *codec)
+{
+  if (g_str_has_suffix(filename, ".h264") || g_str_has_suffix(filename, ".264")) {
+    *codec = SV_CODEC_H264;
+    return TRUE;
+  }
+  if (g_str_has_suffix(filename, ".h265") || g_str_has_suffix(filename, ".265") ||
+      g_str_has_suffix(filename, ".hevc")) {
+    *codec = SV_CODEC_H265;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+gboolean
+annexb_signer_sign_file(const gchar *filename, const gchar *outfilename, SignedVideoCodec codec,
+    const GstSigningKey *key, guint64 *bytes_written)
+{
+  gboolean success = FALSE;
+  GError *error = NULL;
+  GMappedFile *mapped_file = NULL;
+  AnnexBSession session = {0};
+  const guint8 *data = NULL;
+  gsize size = 0;
+  gsize consumed = 0;
+
+  g_return_val_if_fail(filename && outfilename && key, FALSE);
+
+  mapped_file = g_mapped_file_new(filename, FALSE, &error);
+  if (!mapped_file) {
+    g_warning("failed to map '%s': %s", filename, error->message);
+    g_error_free(error);
+    goto out;
+  }
+  data = (const guint8 *)g_mapped_file_get_contents(mapped_file);
+  size = g_mapped_file_get_length(mapped_file);
+  if (gst_signing_nalu_find_start_code(data, size, 0) == size) {
+    g_warning("no start code found in '%s'", filename);
+    goto out;
+  }
+
+  if (!session_init(&session, filename, outfilename, codec, key)) goto out;
+  // The whole file is mapped, hence all nalus are complete.
+  success = sign_nalus(&session, data, size, TRUE, &consumed) && session_finish(&session);
+  if (success && bytes_written) *bytes_written = session.writer.bytes_written;
+
+out:
+  if (!session_clear(&session)) success = FALSE;
+  if (mapped_file) g_mapped_file_unref(mapped_file);
+
+  return success;
+}
+
+gboolean
+annexb_signer_follow_file(const gchar *filename, const gchar *outfilename, SignedVideoCodec codec,
+    const GstSigningKey *key, guint idle_timeout, guint64 *bytes_written)
+{
+  gboolean success = FALSE;
+  AnnexBSession session = {0};
+  GByteArray *buffer = NULL;
+  gchar *marker = NULL;
+  gint64 last_growth = g_get_monotonic_time();
+  gboolean closed = FALSE;
+  gsize consumed = 0;
+  int fd = -1;
+
+  g_return_val_if_fail(filename && outfilename && key, FALSE);
+
+  buffer = g_byte_array_new();
+  marker = g_strconcat(filename, CLOSE_MARKER_SUFFIX, NULL);
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    g_warning("failed to open '%s': %s", filename, g_strerror(errno));
+    goto out;
+  }
+  if (!session_init(&session, filename, outfilename, codec, key)) goto out;
+
+  while (TRUE) {
+    const guint len = buffer->len;
+    ssize_t bytes_read = 0;
+
+    g_byte_array_set_size(buffer, len + FOLLOW_READ_SIZE);
+    bytes_read = read(fd, buffer->data + len, FOLLOW_READ_SIZE);
+    g_byte_array_set_size(buffer, len + MAX(bytes_read, 0));
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      g_warning("failed to read '%s': %s", filename, g_strerror(errno));
+      goto out;
+    }
+
+    if (bytes_read > 0) {
+      // Sign and write all complete nalus right away. The writer points into |buffer|, hence
+      // flush it before dropping what was written.
+      last_growth = g_get_monotonic_time();
+      if (!sign_nalus(&session, buffer->data, buffer->len, FALSE, &consumed)) goto out;
+      if (!flush_writer(&session.writer)) {
+        g_warning("failed to write '%s': %s", outfilename, g_strerror(errno));
+        goto out;
+      }
+      g_byte_array_remove_range(buffer, 0, consumed);
+      continue;
+    }
+
+    // At the current end of the file.
+    if (closed) break;
+    if (g_file_test(marker, G_FILE_TEST_EXISTS)) {
+      // Read once more, since the file may have grown before the marker was created.
+      closed = TRUE;
+      continue;
+    }
+    if (g_get_monotonic_time() - last_growth >= (gint64)idle_timeout * G_USEC_PER_SEC) {
+      g_message("'%s' has not grown for %u s, ending the stream", filename, idle_timeout);
+      break;
+    }
+    g_usleep(FOLLOW_POLL_INTERVAL_USEC);
+  }
+
+  success = sign_nalus(&session, buffer->data, buffer->len, TRUE, &consumed) &&
+      session_finish(&session);
+  if (success && bytes_written) *bytes_written = session.writer.bytes_written;
+
+out:
+  if (!session_clear(&session)) success = FALSE;
+  if (fd >= 0) close(fd);
+  g_byte_array_free(buffer, TRUE);
+  g_free(marker);
+
+  return success;
+}
@@ -0,0 +1,67 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ANNEXB_SIGNER_H__
+#define __ANNEXB_SIGNER_H__
+
+#include <glib.h>
+#include <signed-video-framework/signed_video_common.h>
+
+#include "gst-plugin/gstsigning_keystore.h"
+
+G_BEGIN_DECLS
+
+/* Gets the codec of a raw H264 (.h264, .264) or H265 (.h265, .265, .hevc) byte-stream from the
+ * file extension of |filename|. Returns FALSE if |filename| is not a raw byte-stream. */
+gboolean
+annexb_signer_get_codec(const gchar *filename, SignedVideoCodec *codec);
+
+/* Signs the raw byte-stream |filename|, i.e., nalus separated by start codes without any
+ * container, with |key| and writes it to |outfilename|.
+ *
+ * The input is memory-mapped and split into nalus on the start codes, which are fed to the Signed
+ * Video lib straight from the mapping. The output is the input with the SEIs inserted in front of
+ * the nalus they were fetched for, and is written with vectored I/O, so that the input is never
+ * copied. Since there are no timestamps in a byte-stream the nalus are signed without.
+ *
+ * If |bytes_written| is not NULL it is set to the size of the output file. Returns FALSE on
+ * failure. */
+gboolean
+annexb_signer_sign_file(const gchar *filename, const gchar *outfilename, SignedVideoCodec codec,
+    const GstSigningKey *key, guint64 *bytes_written);
+
+/* Signs the raw byte-stream |filename| while it is being written, like annexb_signer_sign_file().
+ *
+ * The file is read as it grows and every nalu is signed, and written to |outfilename|, as soon as
+ * the start code of the next nalu has been read. Hence, the output lags the input by about one
+ * nalu, apart from the SEIs that come once a GOP has ended. The stream ends once the recorder has
+ * created a close marker, i.e., |filename| with ".done" appended, or if the file has not grown for
+ * |idle_timeout| seconds. The file is polled, since that works on network file systems too.
+ *
+ * If |bytes_written| is not NULL it is set to the size of the output file. Returns FALSE on
+ * failure. */
+gboolean
+annexb_signer_follow_file(const gchar *filename, const gchar *outfilename, SignedVideoCodec codec,
+    const GstSigningKey *key, guint idle_timeout, guint64 *bytes_written);
+
+G_END_DECLS
+
+#endif  // __ANNEXB_SIGNER_H__
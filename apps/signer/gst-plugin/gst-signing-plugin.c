@@ -23,7 +23,7 @@
  * SECTION:plugin-signing
  * @short_description: Plugin definition for gst-plugins-signed-video
  *
- * Registers the "signing" element.
+ * Registers the "signing" and "signingmux" elements.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -31,11 +31,14 @@
 #endif
 
 #include "gstsigning.h"
+#include "gstsigningmux.h"
 
 static gboolean
 plugin_init(GstPlugin* plugin)
 {
-  return gst_element_register(plugin, "signing", GST_RANK_NONE, GST_TYPE_SIGNING);
+  if (!gst_element_register(plugin, "signing", GST_RANK_NONE, GST_TYPE_SIGNING)) return FALSE;
+
+  return gst_element_register(plugin, "signingmux", GST_RANK_NONE, GST_TYPE_SIGNING_MUX);
 }
 
 GST_PLUGIN_DEFINE(GST_VERSION_MAJOR,
@@ -23,23 +23,31 @@
  * SECTION:element-signing
  *
  * Add SEI nalus containing signatures for authentication.
+ *
+ * By default all signing work is done on the streaming thread. With the property
+ * "async-signing" set, the nalus are handed over to a dedicated worker thread through a bounded
+ * queue. The SEIs produced by the worker are added to the next access unit passing through the
+ * element, hence the streaming thread never waits for a signature to be computed.
+ *
+ * SEIs are written to memory recycled from a pool owned by the element. With the property
+ * "contiguous-output" set, each access unit is pushed as one single memory, taken from a pool of
+ * blocks, so that downstream elements never need to merge memories. The access unit is then copied
+ * once, which is counted in the "stats" property.
+ * The "new-gop" message reports the number of memory allocations made, and avoided, since the
+ * previous GOP.
  */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
-#include <stdio.h>  // FILE, etc
-#include <string.h>  // strstr, strcat
-#if defined(_WIN32) || defined(_WIN64)
-#include <direct.h>
-#define getcwd _getcwd  // "deprecation" warning
-#else
-#include <unistd.h>  // getcwd
-#endif
+#include <string.h>  // memcpy
 
 #include "gstsigning.h"
 #include "gstsigning_defines.h"
+#include "gstsigning_mempool.h"
+#include "gstsigning_nalu.h"
+#include "gstsigning_session.h"
+#include "gstsigning_stats.h"
 #include <signed-video-framework/signed_video_common.h>
-#include <signed-video-framework/signed_video_openssl.h>
 #include <signed-video-framework/signed_video_sign.h>
 
 GST_DEBUG_CATEGORY_STATIC(gst_signing_debug);
@@ -48,20 +56,73 @@ GST_DEBUG_CATEGORY_STATIC(gst_signing_debug);
 enum
 {
   PROP_0,
-  PROP_PROVISIONED
+  PROP_PROVISIONED,
+  PROP_ASYNC_SIGNING,
+  PROP_CONTIGUOUS_OUTPUT,
+  PROP_PRIVATE_KEY,
+  PROP_CERTIFICATE_CHAIN,
+  PROP_STATS,
+  PROP_HASH_ALGO,
+  PROP_SIGNING_FREQUENCY,
+  PROP_MAX_SIGNING_FRAMES,
+  PROP_LOW_LATENCY
 };
 #define DEFAULT_PROVISIONED 0  // Key is not provisioned
+#define DEFAULT_ASYNC_SIGNING FALSE
+// Maximum number of access units queued for the signing worker before the streaming thread blocks.
+#define ASYNC_QUEUE_MAX_SIZE 8
+#define DEFAULT_CONTIGUOUS_OUTPUT FALSE
+// Signing tunables default to zero, or NULL, which keeps the default of the Signed Video lib.
+#define DEFAULT_SIGNING_FREQUENCY 0
+#define DEFAULT_MAX_SIGNING_FRAMES 0
+#define DEFAULT_LOW_LATENCY FALSE
+// Initial size of pooled SEI memory. The pools grow if larger blocks are needed.
+#define SEI_POOL_BLOCK_SIZE 1024
+#define MEM_POOL_MAX_FREE 16
 
 struct _GstSigningPrivate {
   gint provisioned;
+  gboolean async_signing;
+  gboolean contiguous_output;
+  gboolean low_latency;
+  gchar *private_key_path;
+  gchar *certificate_chain_path;
+  GstSigningSettings settings;
+  // Held from the key store from NULL_TO_READY to READY_TO_NULL, hence kept while cycling between
+  // READY and PLAYING. Protected by the object lock.
+  const GstSigningKey *key;
   signed_video_t *signed_video;
+  SignedVideoCodec codec;
+  GstSigningNaluFormat nalu_format;  // Detected from the first access unit if not set by caps
   GstClockTime last_pts;
+  // SEIs pushed as a buffer of their own right after the current access unit, see
+  // gst_signing_generate_output(). Only used by the streaming thread.
+  GstBuffer *pending_seis;
+
+  /* Asynchronous signing. All members below are protected by |worker_lock|. */
+  GThread *worker;
+  GMutex worker_lock;
+  GCond worker_cond;
+  GQueue worker_queue;  // Access units waiting to be added for signing
+  GQueue ready_seis;  // SEIs produced by the worker, waiting to be added to the stream
+  gboolean worker_busy;
+  gboolean worker_stop;
+  GstFlowReturn worker_ret;
+
+  /* Memory recycling. The counters are protected by the object lock. */
+  GstSigningMemPool *sei_pool;
+  GstSigningMemPool *au_pool;
+  guint gop_allocations;  // Memory allocated since the last signed GOP
+  guint gop_allocations_avoided;  // Memory recycled since the last signed GOP
+
+  GstSigningStats stats;  // Protected by the object lock
 };
 
 #define TEMPLATE_CAPS \
   GST_STATIC_CAPS( \
       "video/x-h264, alignment=au; " \
-      "video/x-h265, alignment=au")
+      "video/x-h265, alignment=au; " \
+      "video/x-av1, stream-format=obu-stream, alignment=tu")
 
 static GstStaticPadTemplate sink_template =
     GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, TEMPLATE_CAPS);
@@ -73,6 +134,8 @@ G_DEFINE_TYPE_WITH_PRIVATE(GstSigning, gst_signing, GST_TYPE_BASE_TRANSFORM);
 
 static void
 gst_signing_finalize(GObject *object);
+static GstStateChangeReturn
+gst_signing_change_state(GstElement *element, GstStateChange transition);
 static gboolean
 gst_signing_start(GstBaseTransform *trans);
 static gboolean
@@ -81,12 +144,44 @@ static gboolean
 gst_signing_set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps);
 static GstFlowReturn
 gst_signing_transform_ip(GstBaseTransform *trans, GstBuffer *buffer);
+static GstFlowReturn
+gst_signing_generate_output(GstBaseTransform *trans, GstBuffer **outbuf);
 static gboolean
 gst_signing_sink_event(GstBaseTransform *trans, GstEvent *event);
 static gboolean
 setup_signing(GstSigning *signing, GstCaps *caps);
 static gboolean
 terminate_signing(GstSigning *signing);
+static gboolean
+start_signing_worker(GstSigning *signing);
+static void
+stop_signing_worker(GstSigning *signing);
+
+/* Gets the key given by the key properties, setting it up on first use. */
+static const GstSigningKey *
+get_key(GstSigning *signing)
+{
+  GstSigningPrivate *priv = signing->priv;
+  const GstSigningKey *key = NULL;
+
+  GST_OBJECT_LOCK(signing);
+  if (!priv->key) {
+    priv->key = gst_signing_key_store_get(
+        priv->private_key_path, priv->certificate_chain_path, priv->provisioned);
+  }
+  key = priv->key;
+  GST_OBJECT_UNLOCK(signing);
+
+  return key;
+}
+
+/* Releases the held key, if any. Must be called with the object lock held. */
+static void
+release_key_locked(GstSigning *signing)
+{
+  gst_signing_key_store_release(signing->priv->key);
+  signing->priv->key = NULL;
+}
 
 static void
 gst_signing_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
@@ -98,6 +193,33 @@ gst_signing_get_property(GObject * object, guint prop_id, GValue * value, GParam
     case PROP_PROVISIONED:
       g_value_set_int(value, signing->priv->provisioned);
       break;
+    case PROP_ASYNC_SIGNING:
+      g_value_set_boolean(value, signing->priv->async_signing);
+      break;
+    case PROP_CONTIGUOUS_OUTPUT:
+      g_value_set_boolean(value, signing->priv->contiguous_output);
+      break;
+    case PROP_PRIVATE_KEY:
+      g_value_set_string(value, signing->priv->private_key_path);
+      break;
+    case PROP_CERTIFICATE_CHAIN:
+      g_value_set_string(value, signing->priv->certificate_chain_path);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed(value, gst_signing_stats_to_structure(&signing->priv->stats));
+      break;
+    case PROP_HASH_ALGO:
+      g_value_set_string(value, signing->priv->settings.hash_algo);
+      break;
+    case PROP_SIGNING_FREQUENCY:
+      g_value_set_uint(value, signing->priv->settings.signing_frequency);
+      break;
+    case PROP_MAX_SIGNING_FRAMES:
+      g_value_set_uint(value, signing->priv->settings.max_signing_frames);
+      break;
+    case PROP_LOW_LATENCY:
+      g_value_set_boolean(value, signing->priv->low_latency);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -116,6 +238,46 @@ gst_signing_set_property(GObject * object, guint prop_id, const GValue * value,
     case PROP_PROVISIONED:
       priv->provisioned = g_value_get_int(value);
       GST_DEBUG_OBJECT(object, "new provisioned value: %d", priv->provisioned);
+      release_key_locked(signing);
+      break;
+    case PROP_ASYNC_SIGNING:
+      priv->async_signing = g_value_get_boolean(value);
+      GST_DEBUG_OBJECT(object, "new async-signing value: %d", priv->async_signing);
+      break;
+    case PROP_CONTIGUOUS_OUTPUT:
+      priv->contiguous_output = g_value_get_boolean(value);
+      GST_DEBUG_OBJECT(object, "new contiguous-output value: %d", priv->contiguous_output);
+      break;
+    case PROP_PRIVATE_KEY:
+      g_free(priv->private_key_path);
+      priv->private_key_path = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new private-key value: %s", priv->private_key_path);
+      release_key_locked(signing);
+      break;
+    case PROP_CERTIFICATE_CHAIN:
+      g_free(priv->certificate_chain_path);
+      priv->certificate_chain_path = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new certificate-chain value: %s", priv->certificate_chain_path);
+      release_key_locked(signing);
+      break;
+    case PROP_HASH_ALGO:
+      g_free(priv->settings.hash_algo);
+      priv->settings.hash_algo = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new hash-algo value: %s", priv->settings.hash_algo);
+      break;
+    case PROP_SIGNING_FREQUENCY:
+      priv->settings.signing_frequency = g_value_get_uint(value);
+      GST_DEBUG_OBJECT(
+          object, "new signing-frequency value: %u", priv->settings.signing_frequency);
+      break;
+    case PROP_MAX_SIGNING_FRAMES:
+      priv->settings.max_signing_frames = g_value_get_uint(value);
+      GST_DEBUG_OBJECT(
+          object, "new max-signing-frames value: %u", priv->settings.max_signing_frames);
+      break;
+    case PROP_LOW_LATENCY:
+      priv->low_latency = g_value_get_boolean(value);
+      GST_DEBUG_OBJECT(object, "new low-latency value: %d", priv->low_latency);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -134,10 +296,13 @@ gst_signing_class_init(GstSigningClass *klass)
   GST_DEBUG_CATEGORY_INIT(
       gst_signing_debug, "signing", 0, "Add SEI nalus containing signatures for authentication");
 
+  element_class->change_state = GST_DEBUG_FUNCPTR(gst_signing_change_state);
+
   transform_class->start = GST_DEBUG_FUNCPTR(gst_signing_start);
   transform_class->stop = GST_DEBUG_FUNCPTR(gst_signing_stop);
   transform_class->set_caps = GST_DEBUG_FUNCPTR(gst_signing_set_caps);
   transform_class->transform_ip = GST_DEBUG_FUNCPTR(gst_signing_transform_ip);
+  transform_class->generate_output = GST_DEBUG_FUNCPTR(gst_signing_generate_output);
   transform_class->sink_event = GST_DEBUG_FUNCPTR(gst_signing_sink_event);
 
   gst_element_class_set_static_metadata(element_class, "Signed Video", "Formatter/Video",
@@ -154,14 +319,66 @@ gst_signing_class_init(GstSigningClass *klass)
   // Install properties
   g_object_class_install_property(gobject_class, PROP_PROVISIONED,
       g_param_spec_int("provisioned", "Provisioned key", "Use pre-generated key and certificate",
-      0, 1, DEFAULT_PROVISIONED, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+      0, 1, DEFAULT_PROVISIONED,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_ASYNC_SIGNING,
+      g_param_spec_boolean("async-signing", "Asynchronous signing",
+          "Sign on a dedicated worker thread and add the SEIs to the next access unit",
+          DEFAULT_ASYNC_SIGNING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_CONTIGUOUS_OUTPUT,
+      g_param_spec_boolean("contiguous-output", "Contiguous output",
+          "Push each access unit, including its SEIs, as one single memory",
+          DEFAULT_CONTIGUOUS_OUTPUT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property(gobject_class, PROP_PRIVATE_KEY,
+      g_param_spec_string("private-key", "Private key",
+          "Path to a PEM file with the private key. Overrides provisioned",
+          NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_CERTIFICATE_CHAIN,
+      g_param_spec_string("certificate-chain", "Certificate chain",
+          "Path to a PEM file with the certificate chain of the private-key",
+          NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_STATS,
+      g_param_spec_boxed("stats", "Statistics",
+          "Counters and call time histograms accumulated since the element started",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property(gobject_class, PROP_HASH_ALGO,
+      g_param_spec_string("hash-algo", "Hash algorithm",
+          "Name of the hash algorithm, e.g., sha256 or sha512 (NULL = library default)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_SIGNING_FREQUENCY,
+      g_param_spec_uint("signing-frequency", "Signing frequency",
+          "Sign every Nth GOP, which lowers the CPU load (0 = library default)", 0, G_MAXUINT,
+          DEFAULT_SIGNING_FREQUENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_MAX_SIGNING_FRAMES,
+      g_param_spec_uint("max-signing-frames", "Max signing frames",
+          "Maximum number of frames covered by one signature (0 = library default)", 0,
+          G_MAXUINT, DEFAULT_MAX_SIGNING_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_LOW_LATENCY,
+      g_param_spec_boolean("low-latency", "Low latency",
+          "Push SEIs as buffers of their own as soon as they are available, instead of adding "
+          "them to the next access unit",
+          DEFAULT_LOW_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
 }
 
 static void
 gst_signing_init(GstSigning *signing)
 {
-  signing->priv = gst_signing_get_instance_private(signing);
-  signing->priv->last_pts = GST_CLOCK_TIME_NONE;
+  GstSigningPrivate *priv = gst_signing_get_instance_private(signing);
+
+  signing->priv = priv;
+  priv->last_pts = GST_CLOCK_TIME_NONE;
+  priv->async_signing = DEFAULT_ASYNC_SIGNING;
+  priv->contiguous_output = DEFAULT_CONTIGUOUS_OUTPUT;
+  priv->low_latency = DEFAULT_LOW_LATENCY;
+  g_mutex_init(&priv->worker_lock);
+  g_cond_init(&priv->worker_cond);
+  g_queue_init(&priv->worker_queue);
+  g_queue_init(&priv->ready_seis);
+  priv->worker_ret = GST_FLOW_OK;
 }
 
 static void
@@ -171,10 +388,54 @@ gst_signing_finalize(GObject *object)
 
   GST_DEBUG_OBJECT(object, "finalized");
   terminate_signing(signing);
+  GST_OBJECT_LOCK(signing);
+  release_key_locked(signing);
+  GST_OBJECT_UNLOCK(signing);
+  g_free(signing->priv->private_key_path);
+  g_free(signing->priv->certificate_chain_path);
+  g_free(signing->priv->settings.hash_algo);
+  g_mutex_clear(&signing->priv->worker_lock);
+  g_cond_clear(&signing->priv->worker_cond);
 
   G_OBJECT_CLASS(gst_signing_parent_class)->finalize(object);
 }
 
+/* The key is set up when going to READY and kept until NULL. An application signing one file after
+ * the other can hence reuse the element, going back to READY in between, without setting up the key
+ * again. */
+static GstStateChangeReturn
+gst_signing_change_state(GstElement *element, GstStateChange transition)
+{
+  GstSigning *signing = GST_SIGNING(element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!get_key(signing)) {
+        GST_ELEMENT_ERROR(signing, RESOURCE, SETTINGS, ("failed to get private key"), (NULL));
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS(gst_signing_parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      GST_OBJECT_LOCK(signing);
+      release_key_locked(signing);
+      GST_OBJECT_UNLOCK(signing);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_signing_start(GstBaseTransform *trans)
 {
@@ -183,6 +444,9 @@ gst_signing_start(GstBaseTransform *trans)
   gboolean res = TRUE;
 
   GST_DEBUG_OBJECT(signing, "start");
+  GST_OBJECT_LOCK(signing);
+  memset(&signing->priv->stats, 0, sizeof(signing->priv->stats));
+  GST_OBJECT_UNLOCK(signing);
   caps = gst_pad_get_current_caps(GST_BASE_TRANSFORM_SRC_PAD(trans));
   if (caps != NULL) {
     res = setup_signing(signing, caps);
@@ -223,15 +487,127 @@ create_buffer_with_current_time(GstSigning *signing)
   return buf;
 }
 
-/* Prepend seis fetched from Signed Video lib.
- * Returns the number of nalus that were prepended to @current_au,
- * or -1 on error. */
-static gint
-get_and_add_sei(GstSigning *signing, GstBuffer * current_au, gint idx, const guint8 * peek_nalu,
+/* Creates an empty buffer for SEIs pushed on their own right after |au|. The SEIs are not a frame
+ * of their own, hence the buffer gets the PTS of |au|, to which they are attached, but no DTS.
+ * Two buffers with the same DTS would otherwise look like two frames decoded at the same time. */
+static GstBuffer *
+create_sei_buffer(GstBuffer *au)
+{
+  GstBuffer *buf = gst_buffer_new();
+
+  GST_BUFFER_PTS(buf) = GST_BUFFER_PTS(au);
+  GST_BUFFER_DTS(buf) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+static void
+count_allocation(GstSigning *signing, gboolean reused)
+{
+  GST_OBJECT_LOCK(signing);
+  if (reused) {
+    signing->priv->gop_allocations_avoided++;
+  } else {
+    signing->priv->gop_allocations++;
+  }
+  GST_OBJECT_UNLOCK(signing);
+}
+
+/* Creates a memory holding a SEI fetched from the Signed Video lib, and frees |sei|. */
+static GstMemory *
+create_sei_memory(GstSigning *signing, guint8 *sei, gsize sei_size)
+{
+  gboolean reused = FALSE;
+  GstMemory *sei_mem = gst_signing_sei_memory_new(
+      signing->priv->sei_pool, signing->priv->nalu_format, sei, sei_size, &reused);
+
+  count_allocation(signing, reused);
+
+  return sei_mem;
+}
+
+/* Replaces all memories of |buf| with one single memory from the access unit pool, which grows to
+ * the largest access unit seen. The SEIs are placed in front of the first picture nalu, i.e., in
+ * the middle of the access unit, hence they cannot be written into headroom of the memory from
+ * upstream without moving the picture data anyway. Instead, the access unit is copied once, but
+ * only if it is split over several memories. */
+static gboolean
+make_access_unit_contiguous(GstSigning *signing, GstBuffer *buf)
+{
+  const gsize au_size = gst_buffer_get_size(buf);
+  const GstClockTime start = gst_util_get_timestamp();
+  GstMemory *au_mem = NULL;
+  GstMapInfo map_info;
+  gboolean reused = FALSE;
+
+  if (gst_buffer_n_memory(buf) <= 1) return TRUE;
+
+  au_mem = gst_signing_mem_pool_acquire(signing->priv->au_pool, au_size, &reused);
+  if (!au_mem) return FALSE;
+  gst_memory_resize(au_mem, 0, au_size);
+  if (!gst_memory_map(au_mem, &map_info, GST_MAP_WRITE)) {
+    gst_memory_unref(au_mem);
+    return FALSE;
+  }
+  gst_buffer_extract(buf, 0, map_info.data, au_size);
+  gst_memory_unmap(au_mem, &map_info);
+  gst_buffer_replace_all_memory(buf, au_mem);
+  count_allocation(signing, reused);
+
+  GST_OBJECT_LOCK(signing);
+  gst_signing_stats_add_time(signing->priv->stats.merge_time, start);
+  signing->priv->stats.bytes_merged += au_size;
+  GST_OBJECT_UNLOCK(signing);
+
+  return TRUE;
+}
+
+/* Calls signed_video_get_sei() and adds the time spent, and the SEI, to the statistics. */
+static SignedVideoReturnCode
+get_sei_timed(GstSigning *signing, guint8 **sei, gsize *sei_size, const guint8 *peek_nalu,
     gsize peek_nalu_size)
+{
+  GstSigningStats *stats = &signing->priv->stats;
+  const GstClockTime start = gst_util_get_timestamp();
+  SignedVideoReturnCode sv_rc = signed_video_get_sei(
+      signing->priv->signed_video, sei, sei_size, NULL, peek_nalu, peek_nalu_size, NULL);
+
+  GST_OBJECT_LOCK(signing);
+  gst_signing_stats_add_time(stats->get_sei_time, start);
+  if (sv_rc == SV_OK && *sei_size > 0 && *sei) {
+    stats->seis_added++;
+    stats->sei_bytes += *sei_size;
+  }
+  GST_OBJECT_UNLOCK(signing);
+
+  return sv_rc;
+}
+
+/* Calls signed_video_add_nalu_for_signing_with_timestamp() and adds the time spent to the
+ * statistics. */
+static SignedVideoReturnCode
+add_nalu_timed(GstSigning *signing, const guint8 *nalu, gsize nalu_size,
+    const gint64 *timestamp_usec)
+{
+  const GstClockTime start = gst_util_get_timestamp();
+  SignedVideoReturnCode sv_rc = signed_video_add_nalu_for_signing_with_timestamp(
+      signing->priv->signed_video, nalu, nalu_size, timestamp_usec);
+
+  GST_OBJECT_LOCK(signing);
+  gst_signing_stats_add_time(signing->priv->stats.add_nalu_time, start);
+  if (sv_rc == SV_OK) signing->priv->stats.nalus_hashed++;
+  GST_OBJECT_UNLOCK(signing);
+
+  return sv_rc;
+}
+
+/* Fetches the SEIs the Signed Video lib has ready, peeking at |peek_nalu|, and adds them as
+ * memories to the tail of |seis|. Returns FALSE on error. */
+static gboolean
+get_seis(GstSigning *signing, GQueue *seis, const guint8 *peek_nalu, gsize peek_nalu_size)
 {
   SignedVideoReturnCode sv_rc;
-  gint prepend_count = 0;
   guint8 *sei = NULL;
   gsize sei_size = 0;
 
@@ -240,44 +616,366 @@ get_and_add_sei(GstSigning *signing, GstBuffer * current_au, gint idx, const gui
    * signed_video_get_sei(signed_video_t *self, uint8_t **sei, size_t *sei_size,
    *     unsigned *payload_offset, const uint8_t *peek_nalu,
    *     size_t peek_nalu_size, unsigned *num_pending_seis); */
-  sv_rc = signed_video_get_sei (signing->priv->signed_video, &sei, &sei_size, NULL, peek_nalu,
-      peek_nalu_size, NULL);
+  sv_rc = get_sei_timed(signing, &sei, &sei_size, peek_nalu, peek_nalu_size);
   while (sv_rc == SV_OK && sei_size > 0 && sei) {
-    GstMemory *prepend_mem;
+    GST_DEBUG_OBJECT(signing, "got sei of size %" G_GSIZE_FORMAT, sei_size);
+    g_queue_push_tail(seis, create_sei_memory(signing, sei, sei_size));
+
+    sv_rc = get_sei_timed(signing, &sei, &sei_size, peek_nalu, peek_nalu_size);
+  }
+
+  if (sv_rc != SV_OK) {
+    GST_ERROR_OBJECT(signing, "signed_video_get_sei failed");
+    return FALSE;
+  }
 
-    /* Write size into nalu header. The size value should be the data size,
-     * minus the size of the size value itself. */
-    GST_WRITE_UINT32_BE(sei, (guint32)(sei_size - sizeof(guint32)));
+  return TRUE;
+}
 
-    GST_DEBUG_OBJECT(signing, "preped sei of size %" G_GSIZE_FORMAT " to current AU", sei_size);
-    prepend_mem = gst_memory_new_wrapped(0, sei, sei_size, 0, sei_size, sei, g_free);
-    gst_buffer_insert_memory(current_au, idx, prepend_mem);
-    prepend_count++;
+/* Appends the SEIs the Signed Video lib has ready to |buf|. Returns the number of SEIs appended,
+ * or -1 on error. */
+static gint
+append_seis(GstSigning *signing, GstBuffer *buf)
+{
+  GQueue seis = G_QUEUE_INIT;
+  gint count = 0;
 
-    sv_rc = signed_video_get_sei(signing->priv->signed_video, &sei, &sei_size, NULL, peek_nalu,
-        peek_nalu_size, NULL);
+  if (!get_seis(signing, &seis, NULL, 0)) {
+    g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+    return -1;
   }
+  while (!g_queue_is_empty(&seis)) {
+    gst_buffer_append_memory(buf, g_queue_pop_head(&seis));
+    count++;
+  }
+
+  return count;
+}
 
+/* Adds |sei_mem|, holding one SEI created by create_sei_memory(), for signing. */
+static gboolean
+add_sei_for_signing(GstSigning *signing, GstMemory *sei_mem, const gint64 *timestamp_usec)
+{
+  SignedVideoReturnCode sv_rc;
+  GstMapInfo map_info;
+  gsize prefix_size = 0;
+
+  if (G_UNLIKELY(!gst_memory_map(sei_mem, &map_info, GST_MAP_READ))) return FALSE;
+  prefix_size =
+      gst_signing_nalu_prefix_size(signing->priv->nalu_format, map_info.data, map_info.size);
+  sv_rc = add_nalu_timed(
+      signing, &(map_info.data[prefix_size]), map_info.size - prefix_size, timestamp_usec);
+  gst_memory_unmap(sei_mem, &map_info);
+
+  return sv_rc == SV_OK;
+}
+
+static void
+post_new_gop_message(GstSigning *signing)
+{
+  GstSigningPrivate *priv = signing->priv;
+  guint allocations = 0;
+  guint allocations_avoided = 0;
+
+  GST_OBJECT_LOCK(signing);
+  allocations = priv->gop_allocations;
+  allocations_avoided = priv->gop_allocations_avoided;
+  priv->gop_allocations = 0;
+  priv->gop_allocations_avoided = 0;
+  priv->stats.gops_signed++;
+  GST_OBJECT_UNLOCK(signing);
+  GST_DEBUG_OBJECT(signing, "GOP signed with %u allocations, %u avoided", allocations,
+      allocations_avoided);
+
+  // Push an event to produce a message saying SEIs have been added.
+  GstStructure *structure = gst_structure_new(SIGNING_STRUCTURE_NAME, SIGNING_FIELD_NAME,
+      G_TYPE_STRING, "signed", SIGNING_FIELD_ALLOCATIONS, G_TYPE_UINT, allocations,
+      SIGNING_FIELD_ALLOCATIONS_AVOIDED, G_TYPE_UINT, allocations_avoided, NULL);
+  if (!gst_element_post_message(
+          GST_ELEMENT(signing), gst_message_new_element(GST_OBJECT(signing), structure))) {
+    GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to push message"), (NULL));
+  }
+}
+
+/* Finds the first picture nalu in |buf|, which is where SEIs are inserted when the Signed Video lib
+ * cannot peek at the nalus. |idx| is set to its memory and |offset| to where it starts in that
+ * memory. If there is none, SEIs are appended. */
+static void
+find_sei_insert_position(GstSigning *signing, GstBuffer *buf, guint *idx, gsize *offset)
+{
+  guint n_memory = gst_buffer_n_memory(buf);
+
+  *offset = 0;
+  for (*idx = 0; *idx < n_memory; (*idx)++) {
+    GstMemory *mem = gst_buffer_peek_memory(buf, *idx);
+    GstSigningNaluIter iter;
+    GstMapInfo map_info;
+    const guint8 *nalu = NULL;
+    gsize nalu_size = 0;
+    gboolean found = FALSE;
+
+    if (!gst_memory_map(mem, &map_info, GST_MAP_READ)) continue;
+    gst_signing_nalu_iter_init(&iter, signing->priv->nalu_format, map_info.data, map_info.size);
+    while (!found && gst_signing_nalu_iter_next(&iter, offset, &nalu, &nalu_size)) {
+      found = nalu_size > 0 && gst_signing_is_picture_nalu(signing->priv->codec, nalu);
+    }
+    gst_memory_unmap(mem, &map_info);
+    if (found) return;
+  }
+  *offset = 0;
+}
+
+/* Adds all nalus of |au| for signing and moves the SEIs that become available to |seis|. Called
+ * by the signing worker, which is the only thread operating on the Signed Video session while
+ * asynchronous signing is active. */
+static gboolean
+add_access_unit_for_signing(GstSigning *signing, GstBuffer *au, GQueue *seis)
+{
+  GstSigningPrivate *priv = signing->priv;
+  SignedVideoReturnCode sv_rc = SV_OK;
+  const GstClockTime pts = GST_BUFFER_PTS(au);
+  const gint64 timestamp_usec = (const gint64)(pts / 1000);
+  const gint64 *timestamp_usec_ptr = pts == GST_CLOCK_TIME_NONE ? NULL : &timestamp_usec;
+
+  for (guint idx = 0; idx < gst_buffer_n_memory(au) && sv_rc == SV_OK; idx++) {
+    GstMemory *mem = gst_buffer_peek_memory(au, idx);
+    GstSigningNaluIter iter;
+    GstMapInfo map_info;
+    const guint8 *nalu = NULL;
+    gsize nalu_size = 0;
+    gsize offset = 0;
+
+    if (G_UNLIKELY(!gst_memory_map(mem, &map_info, GST_MAP_READ))) {
+      GST_ELEMENT_ERROR(signing, RESOURCE, FAILED, ("failed to map memory"), (NULL));
+      return FALSE;
+    }
+    // The nalus are passed without prefix, see sign_access_unit().
+    gst_signing_nalu_iter_init(&iter, priv->nalu_format, map_info.data, map_info.size);
+    while (sv_rc == SV_OK && gst_signing_nalu_iter_next(&iter, &offset, &nalu, &nalu_size)) {
+      sv_rc = add_nalu_timed(signing, nalu, nalu_size, timestamp_usec_ptr);
+    }
+    gst_memory_unmap(mem, &map_info);
+  }
   if (sv_rc != SV_OK) {
-    goto get_sei_failed;
+    GST_ELEMENT_ERROR(
+        signing, STREAM, FAILED, ("failed to add nalu for signing, error %d", sv_rc), (NULL));
+    return FALSE;
   }
 
-  return prepend_count;
+  if (!get_seis(signing, seis, NULL, 0)) {
+    GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to get SEIs"), (NULL));
+    return FALSE;
+  }
 
-get_sei_failed:
-  GST_ERROR_OBJECT(signing, "signed_video_get_sei failed");
-  return -1;
+  return TRUE;
+}
+
+static gpointer
+signing_worker_thread(gpointer user_data)
+{
+  GstSigning *signing = GST_SIGNING(user_data);
+  GstSigningPrivate *priv = signing->priv;
+
+  GST_DEBUG_OBJECT(signing, "signing worker started");
+  g_mutex_lock(&priv->worker_lock);
+  while (TRUE) {
+    GQueue seis = G_QUEUE_INIT;
+    GstBuffer *au = NULL;
+    gboolean success = FALSE;
+
+    while (!priv->worker_stop && g_queue_is_empty(&priv->worker_queue)) {
+      g_cond_wait(&priv->worker_cond, &priv->worker_lock);
+    }
+    if (priv->worker_stop) break;
+
+    au = g_queue_pop_head(&priv->worker_queue);
+    priv->worker_busy = TRUE;
+    // Wake up the streaming thread, which may be waiting for room in the queue.
+    g_cond_broadcast(&priv->worker_cond);
+    g_mutex_unlock(&priv->worker_lock);
+
+    success = add_access_unit_for_signing(signing, au, &seis);
+    gst_buffer_unref(au);
+
+    g_mutex_lock(&priv->worker_lock);
+    while (!g_queue_is_empty(&seis)) {
+      g_queue_push_tail(&priv->ready_seis, g_queue_pop_head(&seis));
+    }
+    if (!success) {
+      priv->worker_ret = GST_FLOW_ERROR;
+    }
+    priv->worker_busy = FALSE;
+    g_cond_broadcast(&priv->worker_cond);
+  }
+  g_mutex_unlock(&priv->worker_lock);
+  GST_DEBUG_OBJECT(signing, "signing worker stopped");
+
+  return NULL;
+}
+
+static gboolean
+start_signing_worker(GstSigning *signing)
+{
+  GstSigningPrivate *priv = signing->priv;
+  GError *error = NULL;
+
+  g_assert(priv->worker == NULL);
+
+  priv->worker_stop = FALSE;
+  priv->worker_ret = GST_FLOW_OK;
+  priv->worker = g_thread_try_new("signing-worker", signing_worker_thread, signing, &error);
+  if (!priv->worker) {
+    GST_ERROR_OBJECT(signing, "failed to start signing worker: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+stop_signing_worker(GstSigning *signing)
+{
+  GstSigningPrivate *priv = signing->priv;
+
+  if (!priv->worker) return;
+
+  g_mutex_lock(&priv->worker_lock);
+  priv->worker_stop = TRUE;
+  g_cond_broadcast(&priv->worker_cond);
+  g_mutex_unlock(&priv->worker_lock);
+
+  g_thread_join(priv->worker);
+  priv->worker = NULL;
+
+  g_queue_clear_full(&priv->worker_queue, (GDestroyNotify)gst_buffer_unref);
+  g_queue_clear_full(&priv->ready_seis, (GDestroyNotify)gst_memory_unref);
+}
+
+/* Blocks until the signing worker has processed all queued access units. */
+static void
+drain_signing_worker(GstSigning *signing)
+{
+  GstSigningPrivate *priv = signing->priv;
+
+  if (!priv->worker) return;
+
+  g_mutex_lock(&priv->worker_lock);
+  while (priv->worker_ret == GST_FLOW_OK &&
+      (priv->worker_busy || !g_queue_is_empty(&priv->worker_queue))) {
+    g_cond_wait(&priv->worker_cond, &priv->worker_lock);
+  }
+  g_mutex_unlock(&priv->worker_lock);
+}
+
+/* Moves all SEIs produced by the signing worker to |buf|, in front of the nalu at |offset| in
+ * memory |idx|. Returns the number of SEIs added. Must be called with |worker_lock| held. */
+static guint
+add_ready_seis(GstSigning *signing, GstBuffer *buf, guint idx, gsize offset)
+{
+  GstSigningPrivate *priv = signing->priv;
+  guint count = 0;
+
+  while (!g_queue_is_empty(&priv->ready_seis)) {
+    gst_signing_insert_memory(buf, &idx, offset, g_queue_pop_head(&priv->ready_seis));
+    offset = 0;
+    count++;
+  }
+
+  return count;
 }
 
 static GstFlowReturn
-gst_signing_transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+gst_signing_transform_ip_async(GstSigning *signing, GstBuffer *buf)
+{
+  GstSigningPrivate *priv = signing->priv;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint insert_idx = 0;
+  gsize insert_offset = 0;
+  guint sei_count = 0;
+  GstBuffer *seis = NULL;
+
+  find_sei_insert_position(signing, buf, &insert_idx, &insert_offset);
+  g_mutex_lock(&priv->worker_lock);
+  while (priv->worker_ret == GST_FLOW_OK &&
+      g_queue_get_length(&priv->worker_queue) >= ASYNC_QUEUE_MAX_SIZE) {
+    g_cond_wait(&priv->worker_cond, &priv->worker_lock);
+  }
+  ret = priv->worker_ret;
+  if (ret == GST_FLOW_OK) {
+    /* SEIs are added to the stream before the access unit is queued. In this way the worker adds
+     * them for signing in the same order as they appear in the stream. The worker gets a shallow
+     * copy, so |buf| stays writable. In low latency mode the SEIs follow the access unit in a
+     * buffer of their own, which is queued after it for the same reason. */
+    if (priv->low_latency) {
+      seis = create_sei_buffer(buf);
+      sei_count = add_ready_seis(signing, seis, 0, 0);
+    } else {
+      sei_count = add_ready_seis(signing, buf, insert_idx, insert_offset);
+    }
+    g_queue_push_tail(&priv->worker_queue, gst_buffer_copy(buf));
+    if (sei_count > 0 && seis) {
+      g_queue_push_tail(&priv->worker_queue, gst_buffer_copy(seis));
+    }
+    g_cond_broadcast(&priv->worker_cond);
+  }
+  g_mutex_unlock(&priv->worker_lock);
+
+  if (ret == GST_FLOW_OK && priv->contiguous_output && !make_access_unit_contiguous(signing, buf)) {
+    GST_ELEMENT_ERROR(signing, RESOURCE, FAILED, ("failed to merge access unit"), (NULL));
+    ret = GST_FLOW_ERROR;
+  }
+
+  if (sei_count > 0 && seis) {
+    gst_buffer_replace(&priv->pending_seis, seis);
+  }
+  if (seis) gst_buffer_unref(seis);
+
+  if (sei_count > 0) {
+    GST_DEBUG_OBJECT(signing, "added %u SEIs from signing worker", sei_count);
+    post_new_gop_message(signing);
+  }
+
+  return ret;
+}
+
+/* Fetches the SEIs that became available when adding the nalus of |au|. Without this they would
+ * wait for the next access unit, since SEIs are fetched when peeking at its nalus. The SEIs are
+ * added for signing, as they follow |au| in the stream, and stashed for
+ * gst_signing_generate_output(). Returns the number of SEIs, or -1 on error. */
+static gint
+stash_pending_seis(GstSigning *signing, GstBuffer *au)
+{
+  GstSigningPrivate *priv = signing->priv;
+  GstBuffer *seis = create_sei_buffer(au);
+  gint sei_count = append_seis(signing, seis);
+  const gint64 timestamp_usec = (const gint64)(priv->last_pts / 1000);
+  const gint64 *timestamp_usec_ptr =
+      priv->last_pts == GST_CLOCK_TIME_NONE ? NULL : &timestamp_usec;
+
+  for (gint idx = 0; idx < sei_count; idx++) {
+    if (!add_sei_for_signing(signing, gst_buffer_peek_memory(seis, idx), timestamp_usec_ptr)) {
+      sei_count = -1;
+      break;
+    }
+  }
+
+  if (sei_count > 0) {
+    GST_DEBUG_OBJECT(signing, "push %d SEIs right after current AU", sei_count);
+    gst_buffer_replace(&priv->pending_seis, seis);
+  }
+  gst_buffer_unref(seis);
+
+  return sei_count;
+}
+
+static GstFlowReturn
+sign_access_unit(GstSigning *signing, GstBuffer *buf)
 {
-  GstSigning *signing = GST_SIGNING(trans);
   GstSigningPrivate *priv = signing->priv;
   guint idx = 0;
-  GstMemory *nalu_mem = NULL;
-  GstMapInfo map_info;
   gboolean got_sei = false;
+  gboolean skip_peek = FALSE;
 
   priv->last_pts = GST_BUFFER_PTS(buf);
   // last_pts is an GstClockTime object, which is measured in nanoseconds.
@@ -286,99 +984,182 @@ gst_signing_transform_ip(GstBaseTransform *trans, GstBuffer *buf)
       priv->last_pts == GST_CLOCK_TIME_NONE ? NULL : &timestamp_usec;
 
   GST_DEBUG_OBJECT(signing, "got buffer with %d memories", gst_buffer_n_memory(buf));
-  while (idx < gst_buffer_n_memory(buf)) {
-    SignedVideoReturnCode sv_rc;
-
-    nalu_mem = gst_buffer_peek_memory(buf, idx);
+  if (!gst_signing_nalu_update_format(buf, &priv->nalu_format)) {
+    GST_ELEMENT_ERROR(signing, STREAM, FORMAT, ("failed to find nalus in access unit"), (NULL));
+    return GST_FLOW_ERROR;
+  }
+  if (priv->worker) {
+    return gst_signing_transform_ip_async(signing, buf);
+  }
 
-    if (G_UNLIKELY(!gst_memory_map(nalu_mem, &map_info, GST_MAP_READ))) {
+  /* The nalus are walked inside each memory, hence an access unit delivered as one memory is
+   * hashed nalu by nalu without copying. A memory is only split where SEIs are inserted. */
+  while (idx < gst_buffer_n_memory(buf)) {
+    GstMemory *mem = gst_buffer_peek_memory(buf, idx);
+    GQueue seis = G_QUEUE_INIT;
+    GstSigningNaluIter iter;
+    GstMapInfo map_info;
+    const guint8 *nalu = NULL;
+    gsize nalu_size = 0;
+    gsize offset = 0;
+    gboolean success = TRUE;
+
+    if (G_UNLIKELY(!gst_memory_map(mem, &map_info, GST_MAP_READ))) {
       GST_ELEMENT_ERROR(signing, RESOURCE, FAILED, ("failed to map memory"), (NULL));
-      goto map_failed;
-    }
-
-    /* SEIs generated by the Signed Video lib should be passed in as any nalu. The reason
-     * for this is that not all are signed and hence 'floating around' in the stream.
-     * Therefore, pull and add them before adding the current nalu. */
-    gint add_count = get_and_add_sei(signing, buf, idx, &(map_info.data[4]), map_info.size - 4);
-    if (add_count < 0) {
-      GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to add nalus"), (NULL));
-      goto get_and_add_sei_failed;
+      return GST_FLOW_ERROR;
     }
-    if (add_count > 0) {
-      gst_memory_unmap(nalu_mem, &map_info);
-      /* Get the newly added seis. They need to be added for signing like any other
-       * Bitstream Unit. */
-      nalu_mem = gst_buffer_peek_memory(buf, idx);
-      if (G_UNLIKELY(!gst_memory_map(nalu_mem, &map_info, GST_MAP_READ))) {
-        GST_ELEMENT_ERROR(signing, RESOURCE, FAILED, ("Failed to map memory"), (NULL));
-        goto map_failed;
+    gst_signing_nalu_iter_init(&iter, priv->nalu_format, map_info.data, map_info.size);
+    while (success && gst_signing_nalu_iter_next(&iter, &offset, &nalu, &nalu_size)) {
+      /* SEIs generated by the Signed Video lib should be passed in as any nalu. The reason
+       * for this is that not all are signed and hence 'floating around' in the stream.
+       * Therefore, pull and add them before adding the current nalu. */
+      if (!skip_peek) {
+        success = get_seis(signing, &seis, nalu, nalu_size);
+        if (!success) {
+          GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to add nalus"), (NULL));
+        }
+        if (!success || !g_queue_is_empty(&seis)) break;
       }
-      got_sei = true;
+      skip_peek = FALSE;
+
+      // Depending on bitstream format the start code is optional, hence libsigned-video supports
+      // both. Therefore, since the start code in the pipeline temporarily may have been replaced
+      // by the picture data size this format is violated. To pass in valid input data, the nalu
+      // is passed without its length prefix, or start code, which may be three or four bytes.
+      SignedVideoReturnCode sv_rc = add_nalu_timed(signing, nalu, nalu_size, timestamp_usec_ptr);
+      if (sv_rc != SV_OK) {
+        GST_ELEMENT_ERROR(
+            signing, STREAM, FAILED, ("failed to add nalu for signing, error %d", sv_rc), (NULL));
+        success = FALSE;
+      }
+    }
+    gst_memory_unmap(mem, &map_info);
+    if (!success) {
+      g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+      return GST_FLOW_ERROR;
+    }
+    if (g_queue_is_empty(&seis)) {
+      idx++;  // Go to next memory
+      continue;
     }
 
-    // Depending on bitstream format the start code is optional, hence libsigned-video supports
-    // both. Therefore, since the start code in the pipeline temporarily may have been replaced by
-    // the picture data size this format is violated. To pass in valid input data, skip the first
-    // four bytes.
-    sv_rc = signed_video_add_nalu_for_signing_with_timestamp(
-        signing->priv->signed_video, &(map_info.data[4]), map_info.size - 4, timestamp_usec_ptr);
-    if (sv_rc != SV_OK) {
-      GST_ELEMENT_ERROR(
-          signing, STREAM, FAILED, ("failed to add nalu for signing, error %d", sv_rc), (NULL));
-      goto add_nalu_failed;
+    /* Insert the SEIs in front of the nalu, and add them for signing like any other Bitstream
+     * Unit. Then continue with the nalu, which now starts memory |idx|, without peeking at it
+     * again. */
+    while (!g_queue_is_empty(&seis)) {
+      GstMemory *sei_mem = g_queue_pop_head(&seis);
+
+      if (!add_sei_for_signing(signing, sei_mem, timestamp_usec_ptr)) {
+        GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to add SEI for signing"), (NULL));
+        gst_memory_unref(sei_mem);
+        g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+        return GST_FLOW_ERROR;
+      }
+      gst_signing_insert_memory(buf, &idx, offset, sei_mem);
+      offset = 0;
     }
+    got_sei = true;
+    skip_peek = TRUE;
+  }
 
-    gst_memory_unmap(nalu_mem, &map_info);
+  if (priv->low_latency) {
+    gint sei_count = stash_pending_seis(signing, buf);
 
-    idx++;  // Go to next nalu
+    if (sei_count < 0) {
+      GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to add SEIs"), (NULL));
+      return GST_FLOW_ERROR;
+    }
+    got_sei |= sei_count > 0;
+  }
+  if (priv->contiguous_output && !make_access_unit_contiguous(signing, buf)) {
+    GST_ELEMENT_ERROR(signing, RESOURCE, FAILED, ("failed to merge access unit"), (NULL));
+    return GST_FLOW_ERROR;
   }
-
   if (got_sei) {
-    // Push an event to produce a message saying SEIs have been added.
-    GstStructure *structure = gst_structure_new(
-        SIGNING_STRUCTURE_NAME, SIGNING_FIELD_NAME, G_TYPE_STRING, "signed", NULL);
-    if (!gst_element_post_message(
-            GST_ELEMENT(trans), gst_message_new_element(GST_OBJECT(signing), structure))) {
-      GST_ELEMENT_ERROR(signing, STREAM, FAILED, ("failed to push message"), (NULL));
-    }
+    post_new_gop_message(signing);
   }
-  GST_DEBUG_OBJECT(signing, "push AU with %d Bitstream Units", gst_buffer_n_memory(buf));
+  GST_DEBUG_OBJECT(signing, "push AU with %d memories", gst_buffer_n_memory(buf));
 
   return GST_FLOW_OK;
+}
 
-get_and_add_sei_failed:
-add_nalu_failed:
-  gst_memory_unmap(nalu_mem, &map_info);
-map_failed:
-  return GST_FLOW_ERROR;
+static GstFlowReturn
+gst_signing_transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+{
+  GstSigning *signing = GST_SIGNING(trans);
+  GstFlowReturn ret = sign_access_unit(signing, buf);
+
+  GST_OBJECT_LOCK(signing);
+  if (ret == GST_FLOW_OK) {
+    signing->priv->stats.stream_bytes += gst_buffer_get_size(buf);
+  } else {
+    signing->priv->stats.errors++;
+  }
+  GST_OBJECT_UNLOCK(signing);
+
+  return ret;
+}
+
+/* Produces the transformed access unit first, and then any SEIs stashed while signing it. The base
+ * class keeps calling this function until no more output is produced. */
+static GstFlowReturn
+gst_signing_generate_output(GstBaseTransform *trans, GstBuffer **outbuf)
+{
+  GstSigning *signing = GST_SIGNING(trans);
+  GstSigningPrivate *priv = signing->priv;
+  GstFlowReturn ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS(gst_signing_parent_class)->generate_output(trans, outbuf);
+  if (ret != GST_FLOW_OK || *outbuf != NULL || !priv->pending_seis) return ret;
+
+  *outbuf = priv->pending_seis;
+  priv->pending_seis = NULL;
+  GST_OBJECT_LOCK(signing);
+  priv->stats.stream_bytes += gst_buffer_get_size(*outbuf);
+  GST_OBJECT_UNLOCK(signing);
+
+  return GST_FLOW_OK;
 }
 
 static void
 push_access_unit_at_eos(GstSigning *signing)
 {
+  GstSigningPrivate *priv = signing->priv;
   GstBaseTransform *trans = GST_BASE_TRANSFORM(signing);
   GstBuffer *au = NULL;
 
-  if (signed_video_set_end_of_stream(signing->priv->signed_video) != SV_OK) {
+  au = create_buffer_with_current_time(signing);
+
+  // Let the signing worker finish all pending work before operating on the session directly.
+  drain_signing_worker(signing);
+  g_mutex_lock(&priv->worker_lock);
+  add_ready_seis(signing, au, 0, 0);
+  g_mutex_unlock(&priv->worker_lock);
+
+  if (signed_video_set_end_of_stream(priv->signed_video) != SV_OK) {
     GST_ERROR_OBJECT(signing, "failed to set EOS");
     goto eos_failed;
   }
 
-  au = create_buffer_with_current_time(signing);
-  if (get_and_add_sei(signing, au, 0, NULL, 0) < 0) {
+  if (append_seis(signing, au) < 0) {
     GST_ERROR_OBJECT(signing, "failed to get SEIs");
     goto prepend_failed;
   }
 
   GST_DEBUG_OBJECT(signing, "push AU at EOS: %" GST_PTR_FORMAT, au);
+  GST_OBJECT_LOCK(signing);
+  priv->stats.stream_bytes += gst_buffer_get_size(au);
+  GST_OBJECT_UNLOCK(signing);
   gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(trans), au);
 
   return;
 
+eos_failed:
 prepend_failed:
+  GST_OBJECT_LOCK(signing);
+  priv->stats.errors++;
+  GST_OBJECT_UNLOCK(signing);
   gst_buffer_unref(au);
-eos_failed:
-  return;
 }
 
 static gboolean
@@ -386,6 +1167,10 @@ terminate_signing(GstSigning *signing)
 {
   GstSigningPrivate *priv = signing->priv;
 
+  stop_signing_worker(signing);
+  gst_buffer_replace(&priv->pending_seis, NULL);
+  g_clear_pointer(&priv->sei_pool, gst_signing_mem_pool_unref);
+  g_clear_pointer(&priv->au_pool, gst_signing_mem_pool_unref);
   if (priv->signed_video != NULL) {
     signed_video_free(priv->signed_video);
     priv->signed_video = NULL;
@@ -394,93 +1179,13 @@ terminate_signing(GstSigning *signing)
   return TRUE;
 }
 
-#define MAX_PATH_LENGTH 500
-static gboolean
-read_file_content(const char *filename, char **content, gsize *content_size)
-{
-  gboolean success = FALSE;
-  FILE *fp = NULL;
-  char full_path[MAX_PATH_LENGTH] = {0};
-  char cwd[MAX_PATH_LENGTH] = {0};
-
-  *content = NULL;
-  *content_size = 0;
-
-  if (!getcwd(cwd, sizeof(cwd))) {
-    goto done;
-  }
-
-  // Find the root location of the library.
-  char *lib_root = NULL;
-  char *next_lib_root = strstr(cwd, "signed-video-framework-examples");
-  if (!next_lib_root) {
-    // Current location is not inside signed-video-framework. Assuming current working directory is
-    // the parent directory, to give it another try. If that is not the case opening the |full_path|
-    // will fail, which is fine since the true location is not known anyhow.
-    strcat(cwd, "/signed-video-framework-examples");
-    next_lib_root = strstr(cwd, "signed-video-framework-examples");
-  }
-  while (next_lib_root) {
-    lib_root = next_lib_root;
-    next_lib_root = strstr(next_lib_root + 1, "signed-video-framework-examples");
-  }
-  if (!lib_root) {
-    goto done;
-  }
-  // Terminate string after lib root.
-  memset(lib_root + strlen("signed-video-framework-examples"), '\0', 1);
-
-  // Get certificate chain from folder test-files/.
-  strcat(full_path, cwd);
-  strcat(full_path, "/test-files/");
-  strcat(full_path, filename);
-
-  fp = fopen(full_path, "rb");
-  if (!fp) {
-    goto done;
-  }
-
-  fseek(fp, 0L, SEEK_END);
-  size_t file_size = ftell(fp);
-  if (file_size == 0) {
-    goto done;
-  }
-
-  *content = calloc(1, file_size + 1);  // One extra byte for '\0' in case the content is a string.
-  if (!(*content)) {
-    goto done;
-  }
-
-  rewind(fp);
-  if (fread(*content, sizeof(char), file_size / sizeof(char), fp) == 0) {
-    goto done;
-  }
-  *content_size = file_size;
-
-  success = TRUE;
-
-done:
-  if (fp) {
-    fclose(fp);
-  }
-  if (!success) {
-    free(*content);
-  }
-
-  return success;
-}
-
 static gboolean
 setup_signing(GstSigning *signing, GstCaps *caps)
 {
   GstSigningPrivate *priv = signing->priv;
-  GstStructure *structure = NULL;
-  const gchar *media_type = NULL;
   SignedVideoCodec codec;
-  char *private_key = NULL;
-  size_t private_key_size = 0;
-  char *certificate_chain = NULL;
-  size_t certificate_chain_size = 0;
+  const GstSigningKey *key = NULL;
+  GstSigningSettings settings;
 
   g_assert(caps != NULL);
 
@@ -491,72 +1196,49 @@ setup_signing(GstSigning *signing, GstCaps *caps)
 
   GST_DEBUG("set up Signed Video with caps %" GST_PTR_FORMAT, caps);
 
-  structure = gst_caps_get_structure(caps, 0);
-  media_type = gst_structure_get_name(structure);
-  if (!g_strcmp0(media_type, "video/x-h264")) {
-    codec = SV_CODEC_H264;
-  } else if (!g_strcmp0(media_type, "video/x-h265")) {
-    codec = SV_CODEC_H265;
-  } else {
+  if (!gst_signing_codec_from_caps(caps, &codec)) {
     GST_ERROR_OBJECT(signing, "unsupported video codec");
     goto unsupported_codec;
   }
 
-  GST_DEBUG_OBJECT(signing, "create Signed Video object");
-  priv->signed_video = signed_video_create(codec);
+  // The key is normally set up already in NULL_TO_READY, but may have been released if the key
+  // properties changed in READY.
+  key = get_key(signing);
+  if (!key) {
+    GST_ERROR_OBJECT(signing, "failed to get private key");
+    goto get_key_failed;
+  }
+
+  GST_OBJECT_LOCK(signing);
+  settings = priv->settings;
+  settings.hash_algo = g_strdup(priv->settings.hash_algo);
+  GST_OBJECT_UNLOCK(signing);
+
+  priv->codec = codec;
+  priv->nalu_format = gst_signing_nalu_format_from_caps(caps);
+  priv->signed_video = gst_signing_session_new(codec, key, &settings);
+  g_free(settings.hash_algo);
   if (!priv->signed_video) {
-    GST_ERROR_OBJECT(signing, "could not create Signed Video object");
+    GST_ERROR_OBJECT(signing, "could not create Signed Video session");
     goto create_failed;
   }
 
-  if (!priv->provisioned) {
-    if (signed_video_generate_ecdsa_private_key(PATH_TO_KEY_FILES, &private_key, &private_key_size) != SV_OK) {
-      GST_DEBUG_OBJECT(signing, "failed to generate pem file");
-      goto generate_private_key_failed;
-    }
-  } else {
-    if (!read_file_content("private_ecdsa_key.pem", &private_key, &private_key_size)) {
-      goto generate_private_key_failed;
-    }
-    if (!read_file_content("cert_chain.pem", &certificate_chain, &certificate_chain_size)) {
-      goto read_cert_failed;
-    }
-    // Use the Axis api to set the certificate chain without attestation. This will
-    // trigger factory provisioned signing in the library.
-    if (sv_vendor_axis_communications_set_attestation_report(priv->signed_video, NULL, 0,
-        certificate_chain) != SV_OK) {
-      GST_DEBUG_OBJECT(signing, "failed to set certificate chain content");
-      goto set_cert_failed;
-    }
-  }
-  if (signed_video_set_private_key(priv->signed_video, private_key, private_key_size) != SV_OK) {
-    GST_DEBUG_OBJECT(signing, "failed to set private key content");
-    goto set_private_key_failed;
-  }
+  priv->sei_pool = gst_signing_mem_pool_new(SEI_POOL_BLOCK_SIZE, MEM_POOL_MAX_FREE);
+  priv->au_pool = gst_signing_mem_pool_new(0, MEM_POOL_MAX_FREE);
 
-  // Send properties information to video library.
-  if (signed_video_set_product_info(priv->signed_video, "N/A", signed_video_get_version(), "N/A",
-          "Signed Video Framework",
-          "github.com/AxisCommunications/signed-video-framework") != SV_OK) {
-    GST_ERROR_OBJECT(signing, "failed to set properties");
-    goto product_info_failed;
+  if (priv->async_signing && !start_signing_worker(signing)) {
+    goto start_worker_failed;
   }
 
-  g_free(certificate_chain);
-  g_free(private_key);
-
   return TRUE;
 
-product_info_failed:
-set_private_key_failed:
-set_cert_failed:
-  g_free(certificate_chain);
-read_cert_failed:
-  g_free(private_key);
-generate_private_key_failed:
+start_worker_failed:
+  g_clear_pointer(&priv->sei_pool, gst_signing_mem_pool_unref);
+  g_clear_pointer(&priv->au_pool, gst_signing_mem_pool_unref);
   signed_video_free(priv->signed_video);
   priv->signed_video = NULL;
 create_failed:
+get_key_failed:
 unsupported_codec:
   return FALSE;
 }
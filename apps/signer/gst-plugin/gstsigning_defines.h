@@ -22,8 +22,24 @@
 #ifndef __GST_SIGNING__DEFINES_H__
 #define __GST_SIGNING__DEFINES_H__
 
-#define PATH_TO_KEY_FILES "./"
 #define SIGNING_STRUCTURE_NAME "new-gop"
 #define SIGNING_FIELD_NAME "sei"
+#define SIGNING_FIELD_ALLOCATIONS "allocations"
+#define SIGNING_FIELD_ALLOCATIONS_AVOIDED "allocations-avoided"
+
+// Structure returned by the "stats" property of the signing element.
+#define SIGNING_STATS_STRUCTURE_NAME "signing-stats"
+#define SIGNING_STATS_NALUS_HASHED "nalus-hashed"
+#define SIGNING_STATS_SEIS_ADDED "seis-added"
+#define SIGNING_STATS_SEI_BYTES "sei-bytes"
+#define SIGNING_STATS_STREAM_BYTES "stream-bytes"
+#define SIGNING_STATS_BITRATE_OVERHEAD "bitrate-overhead"  // sei-bytes / stream-bytes
+#define SIGNING_STATS_GOPS_SIGNED "gops-signed"
+#define SIGNING_STATS_ERRORS "errors"
+#define SIGNING_STATS_BYTES_MERGED "bytes-merged"  // Bytes copied by contiguous-output
+// Histograms in power of two microsecond buckets, see GST_SIGNING_STATS_HISTOGRAM_BUCKETS.
+#define SIGNING_STATS_ADD_NALU_TIME "add-nalu-time"
+#define SIGNING_STATS_GET_SEI_TIME "get-sei-time"
+#define SIGNING_STATS_MERGE_TIME "merge-time"
 
 #endif  // __GST_SIGNING__DEFINES_H__
@@ -0,0 +1,262 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstsigning_keystore
+ *
+ * A process-wide cache of signing keys. Reading, or generating, a key is done once no matter how
+ * many elements sign with it. Entries are reference counted and removed when the last user is
+ * gone.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>  // FILE, etc
+#include <string.h>  // strstr, strcat
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#define getcwd _getcwd  // "deprecation" warning
+#else
+#include <unistd.h>  // getcwd
+#endif
+
+#include "gstsigning_keystore.h"
+#include <signed-video-framework/signed_video_common.h>
+#include <signed-video-framework/signed_video_openssl.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_signing_keystore_debug);
+#define GST_CAT_DEFAULT gst_signing_keystore_debug
+
+typedef struct {
+  GstSigningKey key;  // Has to be the first member, see gst_signing_key_store_release()
+  gchar *id;
+  gint refcount;
+} KeyStoreEntry;
+
+G_LOCK_DEFINE_STATIC(key_store);
+static GHashTable *key_store = NULL;  // Maps an id to its KeyStoreEntry
+
+#define MAX_PATH_LENGTH 500
+static gboolean
+read_file_content(const char *filename, char **content, gsize *content_size)
+{
+  gboolean success = FALSE;
+  FILE *fp = NULL;
+  char full_path[MAX_PATH_LENGTH] = {0};
+  char cwd[MAX_PATH_LENGTH] = {0};
+
+  *content = NULL;
+  *content_size = 0;
+
+  if (!getcwd(cwd, sizeof(cwd))) {
+    goto done;
+  }
+
+  // Find the root location of the library.
+  char *lib_root = NULL;
+  char *next_lib_root = strstr(cwd, "signed-video-framework-examples");
+  if (!next_lib_root) {
+    // Current location is not inside signed-video-framework. Assuming current working directory is
+    // the parent directory, to give it another try. If that is not the case opening the |full_path|
+    // will fail, which is fine since the true location is not known anyhow.
+    strcat(cwd, "/signed-video-framework-examples");
+    next_lib_root = strstr(cwd, "signed-video-framework-examples");
+  }
+  while (next_lib_root) {
+    lib_root = next_lib_root;
+    next_lib_root = strstr(next_lib_root + 1, "signed-video-framework-examples");
+  }
+  if (!lib_root) {
+    goto done;
+  }
+  // Terminate string after lib root.
+  memset(lib_root + strlen("signed-video-framework-examples"), '\0', 1);
+
+  // Get certificate chain from folder test-files/.
+  strcat(full_path, cwd);
+  strcat(full_path, "/test-files/");
+  strcat(full_path, filename);
+
+  fp = fopen(full_path, "rb");
+  if (!fp) {
+    goto done;
+  }
+
+  fseek(fp, 0L, SEEK_END);
+  size_t file_size = ftell(fp);
+  if (file_size == 0) {
+    goto done;
+  }
+
+  *content = calloc(1, file_size + 1);  // One extra byte for '\0' in case the content is a string.
+  if (!(*content)) {
+    goto done;
+  }
+
+  rewind(fp);
+  if (fread(*content, sizeof(char), file_size / sizeof(char), fp) == 0) {
+    goto done;
+  }
+  *content_size = file_size;
+
+  success = TRUE;
+
+done:
+  if (fp) {
+    fclose(fp);
+  }
+  if (!success) {
+    free(*content);
+    *content = NULL;
+  }
+
+  return success;
+}
+
+static void
+key_store_entry_free(KeyStoreEntry *entry)
+{
+  g_free(entry->key.certificate_chain);
+  g_free(entry->key.private_key);
+  g_free(entry->id);
+  g_free(entry);
+}
+
+/* Reads the key from |private_key_path| and, if set, the certificate chain from
+ * |certificate_chain_path|. */
+static gboolean
+read_key_files(
+    GstSigningKey *key, const gchar *private_key_path, const gchar *certificate_chain_path)
+{
+  GError *error = NULL;
+
+  if (!g_file_get_contents(private_key_path, &key->private_key, &key->private_key_size, &error)) {
+    GST_ERROR("failed to read private key: %s", error->message);
+    goto read_failed;
+  }
+  if (certificate_chain_path && !g_file_get_contents(certificate_chain_path,
+      &key->certificate_chain, &key->certificate_chain_size, &error)) {
+    GST_ERROR("failed to read certificate chain: %s", error->message);
+    goto read_failed;
+  }
+
+  return TRUE;
+
+read_failed:
+  g_error_free(error);
+  return FALSE;
+}
+
+/* Sets up the key of a new entry. Called with the key store lock held, which serializes key
+ * generation as well. */
+static gboolean
+load_key(GstSigningKey *key, const gchar *private_key_path, const gchar *certificate_chain_path,
+    gboolean provisioned)
+{
+  if (private_key_path) {
+    GST_DEBUG("read private key from %s", private_key_path);
+    return read_key_files(key, private_key_path, certificate_chain_path);
+  }
+
+  if (provisioned) {
+    if (!read_file_content("private_ecdsa_key.pem", &key->private_key, &key->private_key_size)) {
+      GST_DEBUG("failed to read private key");
+      return FALSE;
+    }
+    if (!read_file_content(
+            "cert_chain.pem", &key->certificate_chain, &key->certificate_chain_size)) {
+      GST_DEBUG("failed to read certificate chain");
+      return FALSE;
+    }
+    return TRUE;
+  }
+
+  // Without a directory the key is only returned in memory and no files are written.
+  if (signed_video_generate_ecdsa_private_key(NULL, &key->private_key, &key->private_key_size) !=
+      SV_OK) {
+    GST_DEBUG("failed to generate private key");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+const GstSigningKey *
+gst_signing_key_store_get(
+    const gchar *private_key_path, const gchar *certificate_chain_path, gboolean provisioned)
+{
+  static gsize initialized = 0;
+  KeyStoreEntry *entry = NULL;
+  gchar *id = NULL;
+
+  if (g_once_init_enter(&initialized)) {
+    GST_DEBUG_CATEGORY_INIT(
+        gst_signing_keystore_debug, "signingkeystore", 0, "Signing keys shared in the process");
+    g_once_init_leave(&initialized, 1);
+  }
+
+  if (private_key_path) {
+    id = g_strdup_printf("file:%s:%s", private_key_path,
+        certificate_chain_path ? certificate_chain_path : "");
+  } else {
+    id = g_strdup(provisioned ? "provisioned" : "generated");
+  }
+
+  G_LOCK(key_store);
+  if (!key_store) key_store = g_hash_table_new(g_str_hash, g_str_equal);
+
+  entry = g_hash_table_lookup(key_store, id);
+  if (entry) {
+    GST_DEBUG("reuse key %s", id);
+    entry->refcount++;
+    g_free(id);
+  } else {
+    entry = g_new0(KeyStoreEntry, 1);
+    entry->id = id;
+    entry->refcount = 1;
+    if (!load_key(&entry->key, private_key_path, certificate_chain_path, provisioned)) {
+      key_store_entry_free(entry);
+      entry = NULL;
+    } else {
+      GST_DEBUG("added key %s", id);
+      g_hash_table_insert(key_store, entry->id, entry);
+    }
+  }
+  G_UNLOCK(key_store);
+
+  return entry ? &entry->key : NULL;
+}
+
+void
+gst_signing_key_store_release(const GstSigningKey *key)
+{
+  KeyStoreEntry *entry = (KeyStoreEntry *)key;
+
+  if (!entry) return;
+
+  G_LOCK(key_store);
+  if (--entry->refcount == 0) {
+    GST_DEBUG("remove key %s", entry->id);
+    g_hash_table_remove(key_store, entry->id);
+    key_store_entry_free(entry);
+  }
+  G_UNLOCK(key_store);
+}
@@ -0,0 +1,55 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_KEYSTORE_H__
+#define __GST_SIGNING_KEYSTORE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Signing key material, shared by all Signed Video sessions created from it. */
+typedef struct {
+  char *private_key;
+  size_t private_key_size;
+  char *certificate_chain;  // Only set if provisioned or given a certificate chain file
+  size_t certificate_chain_size;
+} GstSigningKey;
+
+/* Gets a key from the process-wide key store, which sets it up on first use.
+ *
+ * If |private_key_path| is set the key is read from that PEM file, together with the certificate
+ * chain in |certificate_chain_path| if set. Otherwise, if |provisioned| is set, the pre-generated
+ * key and certificate chain are read from test-files/. If neither, a new key is generated in
+ * memory without writing anything to disk.
+ *
+ * All callers asking for the same key share one copy, which is freed when the last of them
+ * releases it with gst_signing_key_store_release(). Returns NULL on failure. */
+const GstSigningKey *
+gst_signing_key_store_get(
+    const gchar *private_key_path, const gchar *certificate_chain_path, gboolean provisioned);
+
+void
+gst_signing_key_store_release(const GstSigningKey *key);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_KEYSTORE_H__
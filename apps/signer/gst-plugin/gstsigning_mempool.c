@@ -0,0 +1,173 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstsigning_mempool
+ *
+ * Recycling of GstMemory blocks. The dispose function of every memory handed out is overridden, so
+ * that dropping the last reference puts the memory back in the pool instead of freeing it. This is
+ * the same mechanism GstBufferPool uses for buffers.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstsigning_mempool.h"
+
+// Block sizes are rounded up to a multiple of this value to avoid growing the pool in small steps.
+#define BLOCK_SIZE_ALIGNMENT 1024
+
+struct _GstSigningMemPool {
+  gint refcount;  // One for the owner plus one for each memory in use
+  GMutex lock;
+  GQueue free_mems;
+  gsize block_size;
+  guint max_free;
+  gboolean flushing;
+};
+
+static GQuark
+mem_pool_quark(void)
+{
+  static GQuark quark = 0;
+
+  if (!quark) quark = g_quark_from_static_string("GstSigningMemPool");
+  return quark;
+}
+
+static void
+mem_pool_ref(GstSigningMemPool *pool)
+{
+  g_atomic_int_inc(&pool->refcount);
+}
+
+/* Frees a memory owned by the pool, bypassing the recycling. */
+static void
+mem_pool_release_memory(GstMemory *mem)
+{
+  GST_MINI_OBJECT_CAST(mem)->dispose = NULL;
+  gst_memory_unref(mem);
+}
+
+static void
+mem_pool_free(GstSigningMemPool *pool)
+{
+  g_queue_clear_full(&pool->free_mems, (GDestroyNotify)mem_pool_release_memory);
+  g_mutex_clear(&pool->lock);
+  g_free(pool);
+}
+
+static void
+mem_pool_unref(GstSigningMemPool *pool)
+{
+  if (g_atomic_int_dec_and_test(&pool->refcount)) mem_pool_free(pool);
+}
+
+/* Called when the last reference of a pooled memory is dropped. Returns FALSE if the memory was
+ * put back in the pool, and TRUE if it should be freed. */
+static gboolean
+mem_pool_memory_dispose(GstMemory *mem)
+{
+  GstSigningMemPool *pool = gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(mem), mem_pool_quark());
+  gboolean recycle = FALSE;
+
+  if (!pool) return TRUE;
+
+  g_mutex_lock(&pool->lock);
+  recycle = !pool->flushing && mem->maxsize >= pool->block_size &&
+      g_queue_get_length(&pool->free_mems) < pool->max_free;
+  if (recycle) {
+    // Keep the memory alive, the pool now holds the reference.
+    gst_memory_ref(mem);
+    g_queue_push_tail(&pool->free_mems, mem);
+  } else {
+    gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(mem), mem_pool_quark(), NULL, NULL);
+    GST_MINI_OBJECT_CAST(mem)->dispose = NULL;
+  }
+  g_mutex_unlock(&pool->lock);
+
+  // The memory is no longer in use.
+  mem_pool_unref(pool);
+
+  return !recycle;
+}
+
+GstSigningMemPool *
+gst_signing_mem_pool_new(gsize block_size, guint max_free)
+{
+  GstSigningMemPool *pool = g_new0(GstSigningMemPool, 1);
+
+  pool->refcount = 1;
+  g_mutex_init(&pool->lock);
+  g_queue_init(&pool->free_mems);
+  pool->block_size = block_size;
+  pool->max_free = max_free;
+
+  return pool;
+}
+
+void
+gst_signing_mem_pool_unref(GstSigningMemPool *pool)
+{
+  GQueue free_mems = G_QUEUE_INIT;
+
+  if (!pool) return;
+
+  g_mutex_lock(&pool->lock);
+  pool->flushing = TRUE;
+  free_mems = pool->free_mems;
+  g_queue_init(&pool->free_mems);
+  g_mutex_unlock(&pool->lock);
+
+  g_queue_clear_full(&free_mems, (GDestroyNotify)mem_pool_release_memory);
+  mem_pool_unref(pool);
+}
+
+GstMemory *
+gst_signing_mem_pool_acquire(GstSigningMemPool *pool, gsize size, gboolean *reused)
+{
+  GstMemory *mem = NULL;
+  gsize block_size = 0;
+
+  g_mutex_lock(&pool->lock);
+  if (size > pool->block_size) {
+    // Grow the pool. Smaller blocks are dropped as they are acquired, or released.
+    pool->block_size =
+        (size + BLOCK_SIZE_ALIGNMENT - 1) / BLOCK_SIZE_ALIGNMENT * BLOCK_SIZE_ALIGNMENT;
+  }
+  while ((mem = g_queue_pop_head(&pool->free_mems)) && mem->maxsize < pool->block_size) {
+    mem_pool_release_memory(mem);
+  }
+  block_size = pool->block_size;
+  g_mutex_unlock(&pool->lock);
+
+  *reused = (mem != NULL);
+  if (!mem) {
+    mem = gst_allocator_alloc(NULL, block_size, NULL);
+    if (!mem) return NULL;
+    gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(mem), mem_pool_quark(), pool, NULL);
+    GST_MINI_OBJECT_CAST(mem)->dispose = (GstMiniObjectDisposeFunction)mem_pool_memory_dispose;
+  }
+  gst_memory_resize(mem, -(gssize)mem->offset, size);
+  mem_pool_ref(pool);
+
+  return mem;
+}
@@ -0,0 +1,52 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_MEMPOOL_H__
+#define __GST_SIGNING_MEMPOOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A pool of recycled GstMemory blocks.
+ *
+ * Memory acquired from the pool is returned to it when its last reference is dropped, wherever in
+ * the pipeline that happens. The pool grows its block size to fit the largest request seen so far
+ * and keeps at most |max_free| unused blocks around.
+ */
+typedef struct _GstSigningMemPool GstSigningMemPool;
+
+GstSigningMemPool *
+gst_signing_mem_pool_new(gsize block_size, guint max_free);
+
+/* Drops the owner's reference. Memory still in use downstream is freed when it is released. */
+void
+gst_signing_mem_pool_unref(GstSigningMemPool *pool);
+
+/* Returns writable memory of |size| bytes. |reused| is set to TRUE if the memory was recycled,
+ * and FALSE if a new block had to be allocated. */
+GstMemory *
+gst_signing_mem_pool_acquire(GstSigningMemPool *pool, gsize size, gboolean *reused);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_MEMPOOL_H__
@@ -0,0 +1,290 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstsigning_nalu
+ *
+ * Finds the nalu boundaries of access units delivered as one memory. Length prefixed nalus are
+ * found by walking the sizes. Start codes are searched for with memchr(), which is vectorized in
+ * common C libraries, by looking for the 0x01 byte and then checking the preceding zeros. AV1 OBUs
+ * are found by walking the obu_size fields of their headers.
+ *
+ * The nalus are walked inside the mapped memory. A memory is only split where a SEI is inserted,
+ * since a buffer holds at most gst_buffer_get_max_memory() memories, and GStreamer merges all of
+ * them, by copying, when more are added.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>  // memchr
+
+#include "gstsigning_nalu.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_signing_nalu_debug);
+#define GST_CAT_DEFAULT gst_signing_nalu_debug
+
+#define LENGTH_PREFIX_SIZE 4
+
+static void
+ensure_debug_category(void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized)) {
+    GST_DEBUG_CATEGORY_INIT(
+        gst_signing_nalu_debug, "signingnalu", 0, "Nalu parsing of the signing elements");
+    g_once_init_leave(&initialized, 1);
+  }
+}
+
+GstSigningNaluFormat
+gst_signing_nalu_format_from_caps(const GstCaps *caps)
+{
+  const gchar *stream_format = NULL;
+
+  if (!caps || gst_caps_get_size(caps) == 0) return GST_SIGNING_NALU_FORMAT_UNKNOWN;
+
+  if (!g_strcmp0(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/x-av1")) {
+    return GST_SIGNING_NALU_FORMAT_OBU;
+  }
+  stream_format = gst_structure_get_string(gst_caps_get_structure(caps, 0), "stream-format");
+  if (!stream_format) return GST_SIGNING_NALU_FORMAT_UNKNOWN;
+  if (!g_strcmp0(stream_format, "byte-stream")) return GST_SIGNING_NALU_FORMAT_START_CODE;
+
+  // avc, avc3, hvc1 and hev1 all use length prefixed nalus.
+  return GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX;
+}
+
+/* Checks if the length prefixes of |data| add up to exactly |size| bytes. */
+static gboolean
+has_valid_length_prefixes(const guint8 *data, gsize size)
+{
+  gsize pos = 0;
+
+  while (pos + LENGTH_PREFIX_SIZE <= size) {
+    const gsize nalu_size = GST_READ_UINT32_BE(&data[pos]);
+
+    if (nalu_size > size - pos - LENGTH_PREFIX_SIZE) return FALSE;
+    pos += LENGTH_PREFIX_SIZE + nalu_size;
+  }
+
+  return pos == size;
+}
+
+GstSigningNaluFormat
+gst_signing_nalu_detect_format(const guint8 *data, gsize size)
+{
+  // A length prefix of 1 is theoretically possible, but a one byte nalu is not useful in practice.
+  if (size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1) {
+    return GST_SIGNING_NALU_FORMAT_START_CODE;
+  }
+  // Checked before three byte start codes, since, e.g., 0x00 0x00 0x01 0x20 is a valid size.
+  if (size >= LENGTH_PREFIX_SIZE && has_valid_length_prefixes(data, size)) {
+    return GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX;
+  }
+  if (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) {
+    return GST_SIGNING_NALU_FORMAT_START_CODE;
+  }
+
+  return size >= LENGTH_PREFIX_SIZE ? GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX
+                                    : GST_SIGNING_NALU_FORMAT_UNKNOWN;
+}
+
+gsize
+gst_signing_nalu_prefix_size(GstSigningNaluFormat format, const guint8 *data, gsize size)
+{
+  if (format == GST_SIGNING_NALU_FORMAT_OBU) return 0;
+  if (format == GST_SIGNING_NALU_FORMAT_START_CODE && size >= 3 && data[2] == 1) return 3;
+
+  return LENGTH_PREFIX_SIZE;
+}
+
+gsize
+gst_signing_nalu_find_start_code(const guint8 *data, gsize size, gsize offset)
+{
+  gsize pos = offset + 2;
+
+  while (pos < size) {
+    const guint8 *one = memchr(&data[pos], 0x01, size - pos);
+
+    if (!one) break;
+    pos = (gsize)(one - data);
+    if (data[pos - 1] == 0 && data[pos - 2] == 0) {
+      pos -= 2;
+      if (pos > offset && data[pos - 1] == 0) pos--;
+      return pos;
+    }
+    pos++;
+  }
+
+  return size;
+}
+
+/* Returns the size of the OBU at |data|, including its header, or 0 if it does not fit in |size|
+ * bytes. An OBU without obu_size field, which the low overhead format allows for the last OBU of a
+ * temporal unit, extends to the end of the data. */
+static gsize
+get_obu_size(const guint8 *data, gsize size)
+{
+  guint64 obu_size = 0;
+  gsize pos = 1;  // OBU header
+  guint shift = 0;
+  gboolean more = TRUE;
+
+  if (size < 1) return 0;
+  if (data[0] & 0x04) pos++;  // obu_extension_flag
+  if (pos > size) return 0;
+  if (!(data[0] & 0x02)) return size;  // obu_has_size_field
+
+  // obu_size is coded as leb128(), with at most 8 bytes.
+  while (more && shift < 56) {
+    if (pos >= size) return 0;
+    obu_size |= (guint64)(data[pos] & 0x7f) << shift;
+    more = (data[pos] & 0x80) != 0;
+    shift += 7;
+    pos++;
+  }
+  if (more || obu_size > size - pos) return 0;
+
+  return pos + (gsize)obu_size;
+}
+
+/* Returns the end of the nalu, or OBU, starting at |offset| of |data|, or 0 if the data is not
+ * valid for the format. */
+static gsize
+find_nalu_end(GstSigningNaluFormat format, const guint8 *data, gsize size, gsize offset)
+{
+  if (format == GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX) {
+    gsize nalu_size = 0;
+
+    if (size - offset < LENGTH_PREFIX_SIZE) return 0;
+    nalu_size = GST_READ_UINT32_BE(&data[offset]);
+    if (nalu_size > size - offset - LENGTH_PREFIX_SIZE) return 0;
+    return offset + LENGTH_PREFIX_SIZE + nalu_size;
+  }
+
+  if (format == GST_SIGNING_NALU_FORMAT_OBU) {
+    const gsize obu_size = get_obu_size(&data[offset], size - offset);
+
+    return obu_size > 0 ? offset + obu_size : 0;
+  }
+
+  // Later nalus start where the previous one ended, i.e., at a start code.
+  if (offset == 0 && gst_signing_nalu_find_start_code(data, size, 0) != 0) return 0;
+  return gst_signing_nalu_find_start_code(
+      data, size, offset + gst_signing_nalu_prefix_size(format, &data[offset], size - offset));
+}
+
+void
+gst_signing_nalu_iter_init(
+    GstSigningNaluIter *iter, GstSigningNaluFormat format, const guint8 *data, gsize size)
+{
+  ensure_debug_category();
+
+  iter->format = format;
+  iter->data = data;
+  iter->size = size;
+  iter->offset = 0;
+}
+
+gboolean
+gst_signing_nalu_iter_next(
+    GstSigningNaluIter *iter, gsize *offset, const guint8 **nalu, gsize *nalu_size)
+{
+  gsize end = 0;
+  gsize prefix_size = 0;
+
+  if (iter->offset >= iter->size) return FALSE;
+
+  end = find_nalu_end(iter->format, iter->data, iter->size, iter->offset);
+  if (end == 0) {
+    GST_WARNING("last %" G_GSIZE_FORMAT " bytes of memory could not be split into nalus",
+        iter->size - iter->offset);
+    end = iter->size;
+  }
+  prefix_size = MIN(gst_signing_nalu_prefix_size(
+                        iter->format, &iter->data[iter->offset], end - iter->offset),
+      end - iter->offset);
+  *offset = iter->offset;
+  *nalu = &iter->data[iter->offset + prefix_size];
+  *nalu_size = end - iter->offset - prefix_size;
+  iter->offset = end;
+
+  return TRUE;
+}
+
+gboolean
+gst_signing_nalu_update_format(GstBuffer *buf, GstSigningNaluFormat *format)
+{
+  GstMemory *mem = NULL;
+  GstMapInfo map_info;
+
+  ensure_debug_category();
+
+  if (*format != GST_SIGNING_NALU_FORMAT_UNKNOWN || gst_buffer_n_memory(buf) == 0) return TRUE;
+
+  mem = gst_buffer_peek_memory(buf, 0);
+  if (!gst_memory_map(mem, &map_info, GST_MAP_READ)) return FALSE;
+  *format = gst_signing_nalu_detect_format(map_info.data, map_info.size);
+  gst_memory_unmap(mem, &map_info);
+  GST_DEBUG("detected nalu format %d", *format);
+
+  return *format != GST_SIGNING_NALU_FORMAT_UNKNOWN;
+}
+
+/* Shares |size| bytes at |offset| of |mem|, or copies them if |mem| cannot be shared. */
+static GstMemory *
+share_memory(GstMemory *mem, gssize offset, gssize size)
+{
+  if (GST_MEMORY_FLAG_IS_SET(mem, GST_MEMORY_FLAG_NO_SHARE)) {
+    return gst_memory_copy(mem, offset, size);
+  }
+  return gst_memory_share(mem, offset, size);
+}
+
+void
+gst_signing_insert_memory(GstBuffer *buf, guint *idx, gsize offset, GstMemory *mem)
+{
+  // Room for |mem|, and for the second part of a split memory.
+  if (gst_buffer_n_memory(buf) + (offset > 0 ? 2 : 1) > gst_buffer_get_max_memory()) {
+    /* Only happens for access units delivered in many memories. Merge them, as GStreamer would do
+     * when inserting, but keep track of where the nalu is. */
+    for (guint n = 0; n < *idx; n++) {
+      offset += gst_memory_get_sizes(gst_buffer_peek_memory(buf, n), NULL, NULL);
+    }
+    GST_DEBUG("merging %u memories to make room for a SEI", gst_buffer_n_memory(buf));
+    gst_buffer_replace_all_memory(buf, gst_buffer_get_all_memory(buf));
+    *idx = 0;
+  }
+
+  if (offset > 0) {
+    GstMemory *nalu_mem = gst_buffer_get_memory(buf, *idx);
+    const gsize size = gst_memory_get_sizes(nalu_mem, NULL, NULL);
+
+    gst_buffer_replace_memory(buf, *idx, share_memory(nalu_mem, 0, offset));
+    gst_buffer_insert_memory(buf, *idx + 1, share_memory(nalu_mem, offset, size - offset));
+    gst_memory_unref(nalu_mem);
+    (*idx)++;
+  }
+  gst_buffer_insert_memory(buf, *idx, mem);
+  (*idx)++;
+}
@@ -0,0 +1,92 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_NALU_H__
+#define __GST_SIGNING_NALU_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* How the nalus of an access unit, or the OBUs of an AV1 temporal unit, are delimited. */
+typedef enum {
+  GST_SIGNING_NALU_FORMAT_UNKNOWN = 0,
+  GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX,  // 4 byte big-endian size, e.g., stream-format=avc
+  GST_SIGNING_NALU_FORMAT_START_CODE,  // 3 or 4 byte start code, i.e., stream-format=byte-stream
+  GST_SIGNING_NALU_FORMAT_OBU,  // AV1 OBUs with size fields, i.e., stream-format=obu-stream
+} GstSigningNaluFormat;
+
+/* Gets the nalu format from the media type and stream-format field of |caps|, or UNKNOWN if not
+ * set. */
+GstSigningNaluFormat
+gst_signing_nalu_format_from_caps(const GstCaps *caps);
+
+/* Guesses the nalu format from the first bytes of an access unit. */
+GstSigningNaluFormat
+gst_signing_nalu_detect_format(const guint8 *data, gsize size);
+
+/* Returns the size of the length prefix, or start code, in front of the nalu at |data|. OBUs have
+ * no prefix. */
+gsize
+gst_signing_nalu_prefix_size(GstSigningNaluFormat format, const guint8 *data, gsize size);
+
+/* Returns the offset of the first start code at, or after, |offset|, or |size| if there is none.
+ * A zero byte in front of a three byte start code is included, i.e., four byte start codes are
+ * returned as such. */
+gsize
+gst_signing_nalu_find_start_code(const guint8 *data, gsize size, gsize offset);
+
+/* Walks the nalus, or OBUs, of one mapped memory without copying. */
+typedef struct {
+  GstSigningNaluFormat format;
+  const guint8 *data;
+  gsize size;
+  gsize offset;  // Where the next nalu, including its prefix, starts
+} GstSigningNaluIter;
+
+void
+gst_signing_nalu_iter_init(
+    GstSigningNaluIter *iter, GstSigningNaluFormat format, const guint8 *data, gsize size);
+
+/* Gets the next nalu. |offset| is set to where the nalu, including its length prefix or start
+ * code, starts in the data, and |nalu| and |nalu_size| to the nalu without the prefix. Data that is
+ * not valid for the format is returned as one last nalu. Returns FALSE if there are no more nalus.
+ */
+gboolean
+gst_signing_nalu_iter_next(
+    GstSigningNaluIter *iter, gsize *offset, const guint8 **nalu, gsize *nalu_size);
+
+/* Detects the nalu format from the first memory of |buf| if |format| is UNKNOWN, and updates it.
+ * Returns FALSE if the format could not be detected. */
+gboolean
+gst_signing_nalu_update_format(GstBuffer *buf, GstSigningNaluFormat *format);
+
+/* Inserts |mem| in front of the nalu starting at |offset| in memory |*idx| of |buf|. If |offset|
+ * is not 0 the memory is first split in two, sharing its data. If |buf| is full, its memories are
+ * first merged, since GStreamer would otherwise do that without telling. |*idx| is updated to the
+ * memory starting with the nalu. Takes ownership of |mem|. |buf| has to be writable, and its
+ * memories must not be mapped. */
+void
+gst_signing_insert_memory(GstBuffer *buf, guint *idx, gsize offset, GstMemory *mem);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_NALU_H__
@@ -0,0 +1,186 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstsigning_session
+ *
+ * Helpers to set up Signed Video sessions for signing, shared by the signing elements.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>  // memcpy
+
+#include "gstsigning_session.h"
+#include <signed-video-framework/signed_video_sign.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_signing_session_debug);
+#define GST_CAT_DEFAULT gst_signing_session_debug
+
+static void
+ensure_debug_category(void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized)) {
+    GST_DEBUG_CATEGORY_INIT(
+        gst_signing_session_debug, "signingsession", 0, "Signed Video signing sessions");
+    g_once_init_leave(&initialized, 1);
+  }
+}
+
+/* Applies the members of |settings| that are set. */
+static gboolean
+apply_settings(signed_video_t *signed_video, const GstSigningSettings *settings)
+{
+  if (settings->hash_algo &&
+      signed_video_set_hash_algo(signed_video, settings->hash_algo) != SV_OK) {
+    GST_ERROR("failed to set hash algorithm %s", settings->hash_algo);
+    return FALSE;
+  }
+  if (settings->signing_frequency > 0 &&
+      signed_video_set_signing_frequency(signed_video, settings->signing_frequency) != SV_OK) {
+    GST_ERROR("failed to set signing frequency %u", settings->signing_frequency);
+    return FALSE;
+  }
+  if (settings->max_signing_frames > 0 &&
+      signed_video_set_max_signing_frames(signed_video, settings->max_signing_frames) != SV_OK) {
+    GST_ERROR("failed to set max signing frames %u", settings->max_signing_frames);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+signed_video_t *
+gst_signing_session_new(
+    SignedVideoCodec codec, const GstSigningKey *key, const GstSigningSettings *settings)
+{
+  signed_video_t *signed_video = NULL;
+
+  ensure_debug_category();
+
+  GST_DEBUG("create Signed Video object");
+  signed_video = signed_video_create(codec);
+  if (!signed_video) {
+    GST_ERROR("could not create Signed Video object");
+    goto create_failed;
+  }
+
+  if (key->certificate_chain) {
+    // Use the Axis api to set the certificate chain without attestation. This will
+    // trigger factory provisioned signing in the library.
+    if (sv_vendor_axis_communications_set_attestation_report(signed_video, NULL, 0,
+        key->certificate_chain) != SV_OK) {
+      GST_DEBUG("failed to set certificate chain content");
+      goto set_cert_failed;
+    }
+  }
+  if (signed_video_set_private_key(signed_video, key->private_key, key->private_key_size) !=
+      SV_OK) {
+    GST_DEBUG("failed to set private key content");
+    goto set_private_key_failed;
+  }
+
+  // Send properties information to video library.
+  if (signed_video_set_product_info(signed_video, "N/A", signed_video_get_version(), "N/A",
+          "Signed Video Framework",
+          "github.com/AxisCommunications/signed-video-framework") != SV_OK) {
+    GST_ERROR("failed to set properties");
+    goto product_info_failed;
+  }
+  if (settings && !apply_settings(signed_video, settings)) {
+    goto settings_failed;
+  }
+
+  return signed_video;
+
+settings_failed:
+product_info_failed:
+set_private_key_failed:
+set_cert_failed:
+  signed_video_free(signed_video);
+create_failed:
+  return NULL;
+}
+
+gboolean
+gst_signing_codec_from_caps(const GstCaps *caps, SignedVideoCodec *codec)
+{
+  const gchar *media_type = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+  if (!g_strcmp0(media_type, "video/x-h264")) {
+    *codec = SV_CODEC_H264;
+  } else if (!g_strcmp0(media_type, "video/x-h265")) {
+    *codec = SV_CODEC_H265;
+  } else if (!g_strcmp0(media_type, "video/x-av1")) {
+    *codec = SV_CODEC_AV1;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GstMemory *
+gst_signing_sei_memory_new(GstSigningMemPool *pool, GstSigningNaluFormat format, guint8 *sei,
+    gsize sei_size, gboolean *reused)
+{
+  GstMemory *sei_mem = NULL;
+  GstMapInfo map_info;
+
+  /* Write size into nalu header. The size value should be the data size,
+   * minus the size of the size value itself. A byte-stream keeps the start code, and AV1 OBUs have
+   * neither. */
+  if (format == GST_SIGNING_NALU_FORMAT_LENGTH_PREFIX) {
+    GST_WRITE_UINT32_BE(sei, (guint32)(sei_size - sizeof(guint32)));
+  }
+
+  *reused = FALSE;
+  sei_mem = pool ? gst_signing_mem_pool_acquire(pool, sei_size, reused) : NULL;
+  if (!sei_mem || !gst_memory_map(sei_mem, &map_info, GST_MAP_WRITE)) {
+    // Fall back to handing over the SEI as is.
+    if (sei_mem) gst_memory_unref(sei_mem);
+    *reused = FALSE;
+    return gst_memory_new_wrapped(0, sei, sei_size, 0, sei_size, sei, g_free);
+  }
+  memcpy(map_info.data, sei, sei_size);
+  gst_memory_unmap(sei_mem, &map_info);
+  g_free(sei);
+
+  return sei_mem;
+}
+
+gboolean
+gst_signing_is_picture_nalu(SignedVideoCodec codec, const guint8 *nalu)
+{
+  if (codec == SV_CODEC_H264) {
+    const guint8 nalu_type = nalu[0] & 0x1f;
+    return nalu_type >= 1 && nalu_type <= 5;
+  } else if (codec == SV_CODEC_AV1) {
+    // OBU_FRAME_HEADER, OBU_TILE_GROUP, OBU_FRAME and OBU_REDUNDANT_FRAME_HEADER.
+    const guint8 obu_type = (nalu[0] & 0x78) >> 3;
+    return obu_type == 3 || obu_type == 4 || obu_type == 6 || obu_type == 7;
+  } else {
+    const guint8 nalu_type = (nalu[0] & 0x7e) >> 1;
+    return nalu_type <= 31;
+  }
+}
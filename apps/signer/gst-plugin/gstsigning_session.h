@@ -0,0 +1,65 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_SESSION_H__
+#define __GST_SIGNING_SESSION_H__
+
+#include <gst/gst.h>
+#include <signed-video-framework/signed_video_common.h>
+
+#include "gstsigning_keystore.h"
+#include "gstsigning_mempool.h"
+#include "gstsigning_nalu.h"
+
+G_BEGIN_DECLS
+
+/* Tunables of a Signed Video session. Members left at zero, or NULL, keep the library default. */
+typedef struct {
+  gchar *hash_algo;  // Name of the hash algorithm, e.g., "sha256"
+  guint signing_frequency;  // Sign every |signing_frequency| GOP
+  guint max_signing_frames;  // Sign after at most this many frames, even if the GOP is longer
+} GstSigningSettings;
+
+/* Creates a Signed Video session for |codec| signing with |key|. |settings| may be NULL to use the
+ * library defaults. Returns NULL on failure. */
+signed_video_t *
+gst_signing_session_new(
+    SignedVideoCodec codec, const GstSigningKey *key, const GstSigningSettings *settings);
+
+/* Gets the Signed Video codec from the media type of |caps|. Returns FALSE if not supported. */
+gboolean
+gst_signing_codec_from_caps(const GstCaps *caps, SignedVideoCodec *codec);
+
+/* Creates a memory holding a SEI, or an AV1 OBU metadata, fetched from the Signed Video lib. If
+ * |format| is LENGTH_PREFIX the start code is replaced by the size. The data is copied to memory
+ * from |pool| if possible and |sei| is freed, otherwise the memory takes ownership of |sei|.
+ * |reused| is set to TRUE if pooled memory was recycled. */
+GstMemory *
+gst_signing_sei_memory_new(GstSigningMemPool *pool, GstSigningNaluFormat format, guint8 *sei,
+    gsize sei_size, gboolean *reused);
+
+/* Returns TRUE if |nalu|, pointing at the nalu, or OBU, header, is part of a coded picture. */
+gboolean
+gst_signing_is_picture_nalu(SignedVideoCodec codec, const guint8 *nalu);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_SESSION_H__
@@ -0,0 +1,86 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:gstsigning_stats
+ *
+ * Statistics exposed by the signing element through its "stats" property.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstsigning_defines.h"
+#include "gstsigning_stats.h"
+
+void
+gst_signing_stats_add_time(guint64 *histogram, GstClockTime start)
+{
+  guint64 elapsed_usec = (gst_util_get_timestamp() - start) / GST_USECOND;
+  guint bucket = 0;
+
+  // Find the first bucket with a limit, 2^bucket, above the elapsed time.
+  while (elapsed_usec > 0 && bucket < GST_SIGNING_STATS_HISTOGRAM_BUCKETS - 1) {
+    elapsed_usec >>= 1;
+    bucket++;
+  }
+  histogram[bucket]++;
+}
+
+static void
+set_histogram(GstStructure *structure, const gchar *fieldname, const guint64 *histogram)
+{
+  GValue array = G_VALUE_INIT;
+
+  g_value_init(&array, GST_TYPE_ARRAY);
+  for (guint n = 0; n < GST_SIGNING_STATS_HISTOGRAM_BUCKETS; n++) {
+    GValue count = G_VALUE_INIT;
+
+    g_value_init(&count, G_TYPE_UINT64);
+    g_value_set_uint64(&count, histogram[n]);
+    gst_value_array_append_and_take_value(&array, &count);
+  }
+  gst_structure_take_value(structure, fieldname, &array);
+}
+
+GstStructure *
+gst_signing_stats_to_structure(const GstSigningStats *stats)
+{
+  GstStructure *structure = NULL;
+  // SEI bytes relative to all bytes in the stream.
+  const gdouble overhead =
+      stats->stream_bytes > 0 ? (gdouble)stats->sei_bytes / (gdouble)stats->stream_bytes : 0.0;
+
+  structure = gst_structure_new(SIGNING_STATS_STRUCTURE_NAME,
+      SIGNING_STATS_NALUS_HASHED, G_TYPE_UINT64, stats->nalus_hashed,
+      SIGNING_STATS_SEIS_ADDED, G_TYPE_UINT64, stats->seis_added,
+      SIGNING_STATS_SEI_BYTES, G_TYPE_UINT64, stats->sei_bytes,
+      SIGNING_STATS_STREAM_BYTES, G_TYPE_UINT64, stats->stream_bytes,
+      SIGNING_STATS_BITRATE_OVERHEAD, G_TYPE_DOUBLE, overhead,
+      SIGNING_STATS_GOPS_SIGNED, G_TYPE_UINT64, stats->gops_signed,
+      SIGNING_STATS_ERRORS, G_TYPE_UINT64, stats->errors,
+      SIGNING_STATS_BYTES_MERGED, G_TYPE_UINT64, stats->bytes_merged, NULL);
+  set_histogram(structure, SIGNING_STATS_ADD_NALU_TIME, stats->add_nalu_time);
+  set_histogram(structure, SIGNING_STATS_GET_SEI_TIME, stats->get_sei_time);
+  set_histogram(structure, SIGNING_STATS_MERGE_TIME, stats->merge_time);
+
+  return structure;
+}
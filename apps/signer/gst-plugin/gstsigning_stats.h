@@ -0,0 +1,57 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_STATS_H__
+#define __GST_SIGNING_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Bucket |n| of a time histogram counts calls that took less than 2^n microseconds, and that did
+ * not fit in a previous bucket. The last bucket counts all slower calls. */
+#define GST_SIGNING_STATS_HISTOGRAM_BUCKETS 16
+
+/* Runtime statistics of a signing element, accumulated since it started. */
+typedef struct {
+  guint64 nalus_hashed;
+  guint64 seis_added;
+  guint64 sei_bytes;
+  guint64 stream_bytes;  // All bytes pushed, including the SEIs
+  guint64 gops_signed;
+  guint64 errors;
+  guint64 bytes_merged;  // Bytes copied to push access units as one single memory
+  guint64 add_nalu_time[GST_SIGNING_STATS_HISTOGRAM_BUCKETS];
+  guint64 get_sei_time[GST_SIGNING_STATS_HISTOGRAM_BUCKETS];
+  guint64 merge_time[GST_SIGNING_STATS_HISTOGRAM_BUCKETS];
+} GstSigningStats;
+
+/* Adds a call that started at |start|, as returned by gst_util_get_timestamp(), to |histogram|. */
+void
+gst_signing_stats_add_time(guint64 *histogram, GstClockTime start);
+
+/* Creates a structure named SIGNING_STATS_STRUCTURE_NAME with all statistics. */
+GstStructure *
+gst_signing_stats_to_structure(const GstSigningStats *stats);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_STATS_H__
@@ -0,0 +1,868 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * SECTION:element-signingmux
+ *
+ * Add SEI nalus containing signatures for authentication to multiple streams.
+ *
+ * Every requested sink pad "sink_%u" gets a matching source pad "src_%u" and its own Signed Video
+ * session. All sessions share one signing key, which is set up once, and one pool of worker
+ * threads. The access units of a stream are queued, and a stream with pending access units is
+ * scheduled on the worker pool. A worker signs and pushes everything queued for that stream in one
+ * batch, hence the number of signing threads scales with the number of cores rather than with the
+ * number of streams. Batching is per stream; every session still signs its own GOPs, since the
+ * signatures of different streams cannot be combined.
+ *
+ * The properties "hash-algo", "signing-frequency" and "max-signing-frames" tune the sessions of all
+ * streams, as for the signing element. They are read when a stream gets its caps.
+ *
+ * Example launch line
+ *   gst-launch-1.0 signingmux name=mux \
+ *     filesrc location=a.mp4 ! qtdemux ! mux.sink_0 mux.src_0 ! mp4mux ! \
+ *       filesink location=signed_a.mp4 \
+ *     filesrc location=b.mp4 ! qtdemux ! mux.sink_1 mux.src_1 ! mp4mux ! \
+ *       filesink location=signed_b.mp4
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstsigning_defines.h"
+#include "gstsigning_mempool.h"
+#include "gstsigning_nalu.h"
+#include "gstsigning_session.h"
+#include "gstsigningmux.h"
+#include <signed-video-framework/signed_video_common.h>
+#include <signed-video-framework/signed_video_sign.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_signing_mux_debug);
+#define GST_CAT_DEFAULT gst_signing_mux_debug
+
+enum
+{
+  PROP_0,
+  PROP_PROVISIONED,
+  PROP_N_THREADS,
+  PROP_PRIVATE_KEY,
+  PROP_CERTIFICATE_CHAIN,
+  PROP_HASH_ALGO,
+  PROP_SIGNING_FREQUENCY,
+  PROP_MAX_SIGNING_FRAMES
+};
+#define DEFAULT_PROVISIONED 0  // Key is not provisioned
+#define DEFAULT_N_THREADS 0  // One worker thread per core
+#define DEFAULT_SIGNING_FREQUENCY 0
+#define DEFAULT_MAX_SIGNING_FRAMES 0
+// Maximum number of access units queued per stream before its streaming thread blocks.
+#define STREAM_QUEUE_MAX_SIZE 8
+#define SEI_POOL_BLOCK_SIZE 1024
+#define SEI_POOL_MAX_FREE 64
+
+/* A stream is a sink and source pad pair with its own Signed Video session. */
+typedef struct {
+  GstSigningMux *mux;
+  GstPad *sinkpad;
+  GstPad *srcpad;
+  SignedVideoCodec codec;
+  GstSigningNaluFormat nalu_format;
+  signed_video_t *signed_video;  // Only used by the worker currently processing the stream
+  GstClockTime last_pts;
+
+  GMutex lock;
+  GCond cond;
+  GQueue queue;  // Buffers and serialized events waiting to be processed
+  gboolean scheduled;  // Set while the stream is pushed to, or processed by, the worker pool
+  gboolean flushing;
+  GstFlowReturn last_ret;
+} GstSigningMuxStream;
+
+struct _GstSigningMuxPrivate {
+  gint provisioned;
+  guint n_threads;
+  gchar *private_key_path;
+  gchar *certificate_chain_path;
+  GstSigningSettings settings;  // Used for the session of every stream
+  guint next_pad_id;
+
+  /* Shared by all streams. The key, held from the key store, is protected by the object lock. */
+  const GstSigningKey *key;
+  GThreadPool *workers;
+  GstSigningMemPool *sei_pool;
+};
+
+#define TEMPLATE_CAPS \
+  GST_STATIC_CAPS( \
+      "video/x-h264, alignment=au; " \
+      "video/x-h265, alignment=au; " \
+      "video/x-av1, stream-format=obu-stream, alignment=tu")
+
+static GstStaticPadTemplate sink_template =
+    GST_STATIC_PAD_TEMPLATE("sink_%u", GST_PAD_SINK, GST_PAD_REQUEST, TEMPLATE_CAPS);
+
+static GstStaticPadTemplate src_template =
+    GST_STATIC_PAD_TEMPLATE("src_%u", GST_PAD_SRC, GST_PAD_SOMETIMES, TEMPLATE_CAPS);
+
+G_DEFINE_TYPE_WITH_PRIVATE(GstSigningMux, gst_signing_mux, GST_TYPE_ELEMENT);
+
+static void
+gst_signing_mux_finalize(GObject *object);
+static GstStateChangeReturn
+gst_signing_mux_change_state(GstElement *element, GstStateChange transition);
+static GstPad *
+gst_signing_mux_request_new_pad(
+    GstElement *element, GstPadTemplate *templ, const gchar *name, const GstCaps *caps);
+static void
+gst_signing_mux_release_pad(GstElement *element, GstPad *pad);
+static void
+process_stream(gpointer data, gpointer user_data);
+
+static void
+gst_signing_mux_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+  GstSigningMux *mux = GST_SIGNING_MUX(object);
+
+  GST_OBJECT_LOCK(mux);
+  switch (prop_id) {
+    case PROP_PROVISIONED:
+      g_value_set_int(value, mux->priv->provisioned);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint(value, mux->priv->n_threads);
+      break;
+    case PROP_PRIVATE_KEY:
+      g_value_set_string(value, mux->priv->private_key_path);
+      break;
+    case PROP_CERTIFICATE_CHAIN:
+      g_value_set_string(value, mux->priv->certificate_chain_path);
+      break;
+    case PROP_HASH_ALGO:
+      g_value_set_string(value, mux->priv->settings.hash_algo);
+      break;
+    case PROP_SIGNING_FREQUENCY:
+      g_value_set_uint(value, mux->priv->settings.signing_frequency);
+      break;
+    case PROP_MAX_SIGNING_FRAMES:
+      g_value_set_uint(value, mux->priv->settings.max_signing_frames);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK(mux);
+}
+
+static void
+gst_signing_mux_set_property(
+    GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+  GstSigningMux *mux = GST_SIGNING_MUX(object);
+  GstSigningMuxPrivate *priv = mux->priv;
+
+  GST_OBJECT_LOCK(mux);
+  switch (prop_id) {
+    case PROP_PROVISIONED:
+      priv->provisioned = g_value_get_int(value);
+      GST_DEBUG_OBJECT(object, "new provisioned value: %d", priv->provisioned);
+      break;
+    case PROP_N_THREADS:
+      priv->n_threads = g_value_get_uint(value);
+      GST_DEBUG_OBJECT(object, "new n-threads value: %u", priv->n_threads);
+      break;
+    case PROP_PRIVATE_KEY:
+      g_free(priv->private_key_path);
+      priv->private_key_path = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new private-key value: %s", priv->private_key_path);
+      break;
+    case PROP_CERTIFICATE_CHAIN:
+      g_free(priv->certificate_chain_path);
+      priv->certificate_chain_path = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new certificate-chain value: %s", priv->certificate_chain_path);
+      break;
+    case PROP_HASH_ALGO:
+      g_free(priv->settings.hash_algo);
+      priv->settings.hash_algo = g_value_dup_string(value);
+      GST_DEBUG_OBJECT(object, "new hash-algo value: %s", priv->settings.hash_algo);
+      break;
+    case PROP_SIGNING_FREQUENCY:
+      priv->settings.signing_frequency = g_value_get_uint(value);
+      GST_DEBUG_OBJECT(
+          object, "new signing-frequency value: %u", priv->settings.signing_frequency);
+      break;
+    case PROP_MAX_SIGNING_FRAMES:
+      priv->settings.max_signing_frames = g_value_get_uint(value);
+      GST_DEBUG_OBJECT(
+          object, "new max-signing-frames value: %u", priv->settings.max_signing_frames);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK(mux);
+}
+
+static void
+gst_signing_mux_class_init(GstSigningMuxClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+
+  GST_DEBUG_CATEGORY_INIT(gst_signing_mux_debug, "signingmux", 0,
+      "Add SEI nalus containing signatures for authentication to multiple streams");
+
+  element_class->change_state = GST_DEBUG_FUNCPTR(gst_signing_mux_change_state);
+  element_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_signing_mux_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR(gst_signing_mux_release_pad);
+
+  gst_element_class_set_static_metadata(element_class, "Signed Video Mux", "Formatter/Video",
+      "Add SEIs containing signatures for authentication to multiple streams sharing one key.",
+      "Signed Video Framework <github.com/AxisCommunications/signed-video-framework-examples>");
+
+  gst_element_class_add_static_pad_template(element_class, &sink_template);
+  gst_element_class_add_static_pad_template(element_class, &src_template);
+
+  gobject_class->finalize = gst_signing_mux_finalize;
+  gobject_class->get_property = gst_signing_mux_get_property;
+  gobject_class->set_property = gst_signing_mux_set_property;
+
+  // Install properties
+  g_object_class_install_property(gobject_class, PROP_PROVISIONED,
+      g_param_spec_int("provisioned", "Provisioned key", "Use pre-generated key and certificate",
+          0, 1, DEFAULT_PROVISIONED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_N_THREADS,
+      g_param_spec_uint("n-threads", "Number of threads",
+          "Number of worker threads shared by all streams (0 = one per core)", 0, G_MAXUINT,
+          DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_PRIVATE_KEY,
+      g_param_spec_string("private-key", "Private key",
+          "Path to a PEM file with the private key. Overrides provisioned",
+          NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_CERTIFICATE_CHAIN,
+      g_param_spec_string("certificate-chain", "Certificate chain",
+          "Path to a PEM file with the certificate chain of the private-key",
+          NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_HASH_ALGO,
+      g_param_spec_string("hash-algo", "Hash algorithm",
+          "Name of the hash algorithm, e.g., sha256 or sha512 (NULL = library default)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_SIGNING_FREQUENCY,
+      g_param_spec_uint("signing-frequency", "Signing frequency",
+          "Sign every Nth GOP, which lowers the CPU load (0 = library default)", 0, G_MAXUINT,
+          DEFAULT_SIGNING_FREQUENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property(gobject_class, PROP_MAX_SIGNING_FRAMES,
+      g_param_spec_uint("max-signing-frames", "Max signing frames",
+          "Maximum number of frames covered by one signature (0 = library default)", 0,
+          G_MAXUINT, DEFAULT_MAX_SIGNING_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+}
+
+static void
+gst_signing_mux_init(GstSigningMux *mux)
+{
+  mux->priv = gst_signing_mux_get_instance_private(mux);
+  mux->priv->provisioned = DEFAULT_PROVISIONED;
+  mux->priv->n_threads = DEFAULT_N_THREADS;
+  mux->priv->settings.signing_frequency = DEFAULT_SIGNING_FREQUENCY;
+  mux->priv->settings.max_signing_frames = DEFAULT_MAX_SIGNING_FRAMES;
+}
+
+static void
+gst_signing_mux_finalize(GObject *object)
+{
+  GstSigningMux *mux = GST_SIGNING_MUX(object);
+
+  GST_DEBUG_OBJECT(object, "finalized");
+  gst_signing_key_store_release(mux->priv->key);
+  mux->priv->key = NULL;
+  g_free(mux->priv->private_key_path);
+  g_free(mux->priv->certificate_chain_path);
+  g_free(mux->priv->settings.hash_algo);
+
+  G_OBJECT_CLASS(gst_signing_mux_parent_class)->finalize(object);
+}
+
+/* Gets the key shared by all streams, setting it up on first use. */
+static const GstSigningKey *
+get_shared_key(GstSigningMux *mux)
+{
+  GstSigningMuxPrivate *priv = mux->priv;
+  const GstSigningKey *key = NULL;
+
+  GST_OBJECT_LOCK(mux);
+  if (!priv->key) {
+    GST_DEBUG_OBJECT(mux, "set up key shared by all streams");
+    priv->key = gst_signing_key_store_get(
+        priv->private_key_path, priv->certificate_chain_path, priv->provisioned);
+  }
+  key = priv->key;
+  GST_OBJECT_UNLOCK(mux);
+
+  return key;
+}
+
+/* Must be called with the stream lock held. */
+static void
+schedule_stream_locked(GstSigningMuxStream *stream)
+{
+  GError *error = NULL;
+
+  if (stream->scheduled) return;
+
+  stream->scheduled = TRUE;
+  if (!g_thread_pool_push(stream->mux->priv->workers, stream, &error)) {
+    GST_ERROR_OBJECT(stream->mux, "failed to schedule stream: %s", error->message);
+    g_error_free(error);
+    stream->scheduled = FALSE;
+    stream->last_ret = GST_FLOW_ERROR;
+  }
+}
+
+/* Queues a buffer or a serialized event and schedules the stream. Blocks while the queue is
+ * full. Takes ownership of |item|. */
+static GstFlowReturn
+queue_item(GstSigningMuxStream *stream, GstMiniObject *item)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_mutex_lock(&stream->lock);
+  while (!stream->flushing && stream->last_ret == GST_FLOW_OK &&
+      g_queue_get_length(&stream->queue) >= STREAM_QUEUE_MAX_SIZE) {
+    g_cond_wait(&stream->cond, &stream->lock);
+  }
+  if (stream->flushing) {
+    ret = GST_FLOW_FLUSHING;
+  } else if (GST_IS_BUFFER(item)) {
+    ret = stream->last_ret;
+  }
+  if (ret == GST_FLOW_OK) {
+    g_queue_push_tail(&stream->queue, item);
+    item = NULL;
+    schedule_stream_locked(stream);
+  }
+  g_mutex_unlock(&stream->lock);
+
+  if (item) gst_mini_object_unref(item);
+
+  return ret;
+}
+
+/* Blocks until no worker is processing the stream. */
+static void
+wait_for_stream_idle(GstSigningMuxStream *stream)
+{
+  g_mutex_lock(&stream->lock);
+  while (stream->scheduled) {
+    g_cond_wait(&stream->cond, &stream->lock);
+  }
+  g_mutex_unlock(&stream->lock);
+}
+
+static void
+set_stream_flushing(GstSigningMuxStream *stream, gboolean flushing)
+{
+  g_mutex_lock(&stream->lock);
+  stream->flushing = flushing;
+  if (flushing) {
+    g_queue_clear_full(&stream->queue, (GDestroyNotify)gst_mini_object_unref);
+  } else {
+    stream->last_ret = GST_FLOW_OK;
+  }
+  g_cond_broadcast(&stream->cond);
+  g_mutex_unlock(&stream->lock);
+}
+
+/* Fetches the SEIs the Signed Video lib has ready, peeking at |peek_nalu|, and adds them as
+ * memories to the tail of |seis|. Returns FALSE on error. */
+static gboolean
+get_seis(GstSigningMuxStream *stream, GQueue *seis, const guint8 *peek_nalu, gsize peek_nalu_size)
+{
+  SignedVideoReturnCode sv_rc;
+  guint8 *sei = NULL;
+  gsize sei_size = 0;
+  gboolean reused = FALSE;
+
+  sv_rc = signed_video_get_sei(
+      stream->signed_video, &sei, &sei_size, NULL, peek_nalu, peek_nalu_size, NULL);
+  while (sv_rc == SV_OK && sei_size > 0 && sei) {
+    g_queue_push_tail(seis, gst_signing_sei_memory_new(
+        stream->mux->priv->sei_pool, stream->nalu_format, sei, sei_size, &reused));
+
+    sv_rc = signed_video_get_sei(
+        stream->signed_video, &sei, &sei_size, NULL, peek_nalu, peek_nalu_size, NULL);
+  }
+
+  return sv_rc == SV_OK;
+}
+
+/* Adds |sei_mem|, holding one SEI, for signing. */
+static gboolean
+add_sei_for_signing(GstSigningMuxStream *stream, GstMemory *sei_mem, const gint64 *timestamp_usec)
+{
+  SignedVideoReturnCode sv_rc;
+  GstMapInfo map_info;
+  gsize prefix_size = 0;
+
+  if (G_UNLIKELY(!gst_memory_map(sei_mem, &map_info, GST_MAP_READ))) return FALSE;
+  prefix_size = gst_signing_nalu_prefix_size(stream->nalu_format, map_info.data, map_info.size);
+  sv_rc = signed_video_add_nalu_for_signing_with_timestamp(stream->signed_video,
+      &(map_info.data[prefix_size]), map_info.size - prefix_size, timestamp_usec);
+  gst_memory_unmap(sei_mem, &map_info);
+
+  return sv_rc == SV_OK;
+}
+
+static GstFlowReturn
+sign_and_push(GstSigningMuxStream *stream, GstBuffer *buf)
+{
+  GstSigningMux *mux = stream->mux;
+  guint idx = 0;
+  gboolean skip_peek = FALSE;
+
+  if (!stream->signed_video) {
+    GST_ELEMENT_ERROR(mux, CORE, NEGOTIATION, ("no Signed Video session for %s",
+        GST_PAD_NAME(stream->sinkpad)), (NULL));
+    gst_buffer_unref(buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  stream->last_pts = GST_BUFFER_PTS(buf);
+  // last_pts is an GstClockTime object, which is measured in nanoseconds.
+  const gint64 timestamp_usec = (const gint64)(stream->last_pts / 1000);
+  const gint64 *timestamp_usec_ptr =
+      stream->last_pts == GST_CLOCK_TIME_NONE ? NULL : &timestamp_usec;
+
+  // SEIs are inserted in |buf|, which may be shared upstream, e.g., by a tee.
+  buf = gst_buffer_make_writable(buf);
+  if (!gst_signing_nalu_update_format(buf, &stream->nalu_format)) {
+    GST_ELEMENT_ERROR(mux, STREAM, FORMAT, ("failed to find nalus in access unit"), (NULL));
+    goto failed;
+  }
+
+  // The nalus are walked inside each memory, see sign_access_unit() of the signing element.
+  while (idx < gst_buffer_n_memory(buf)) {
+    GstMemory *mem = gst_buffer_peek_memory(buf, idx);
+    GQueue seis = G_QUEUE_INIT;
+    GstSigningNaluIter iter;
+    GstMapInfo map_info;
+    const guint8 *nalu = NULL;
+    gsize nalu_size = 0;
+    gsize offset = 0;
+    gboolean success = TRUE;
+
+    if (G_UNLIKELY(!gst_memory_map(mem, &map_info, GST_MAP_READ))) {
+      GST_ELEMENT_ERROR(mux, RESOURCE, FAILED, ("failed to map memory"), (NULL));
+      goto failed;
+    }
+    gst_signing_nalu_iter_init(&iter, stream->nalu_format, map_info.data, map_info.size);
+    while (success && gst_signing_nalu_iter_next(&iter, &offset, &nalu, &nalu_size)) {
+      // SEIs are added for signing like any other nalu, before the nalu they are peeking at.
+      if (!skip_peek) {
+        success = get_seis(stream, &seis, nalu, nalu_size);
+        if (!success) GST_ELEMENT_ERROR(mux, STREAM, FAILED, ("failed to add nalus"), (NULL));
+        if (!success || !g_queue_is_empty(&seis)) break;
+      }
+      skip_peek = FALSE;
+
+      SignedVideoReturnCode sv_rc = signed_video_add_nalu_for_signing_with_timestamp(
+          stream->signed_video, nalu, nalu_size, timestamp_usec_ptr);
+      if (sv_rc != SV_OK) {
+        GST_ELEMENT_ERROR(
+            mux, STREAM, FAILED, ("failed to add nalu for signing, error %d", sv_rc), (NULL));
+        success = FALSE;
+      }
+    }
+    gst_memory_unmap(mem, &map_info);
+    if (!success) {
+      g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+      goto failed;
+    }
+    if (g_queue_is_empty(&seis)) {
+      idx++;  // Go to next memory
+      continue;
+    }
+
+    // Insert the SEIs in front of the nalu, and continue with the nalu without peeking again.
+    while (!g_queue_is_empty(&seis)) {
+      GstMemory *sei_mem = g_queue_pop_head(&seis);
+
+      if (!add_sei_for_signing(stream, sei_mem, timestamp_usec_ptr)) {
+        GST_ELEMENT_ERROR(mux, STREAM, FAILED, ("failed to add SEI for signing"), (NULL));
+        gst_memory_unref(sei_mem);
+        g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+        goto failed;
+      }
+      gst_signing_insert_memory(buf, &idx, offset, sei_mem);
+      offset = 0;
+    }
+    skip_peek = TRUE;
+  }
+
+  return gst_pad_push(stream->srcpad, buf);
+
+failed:
+  gst_buffer_unref(buf);
+  return GST_FLOW_ERROR;
+}
+
+static gboolean
+setup_stream(GstSigningMuxStream *stream, GstCaps *caps)
+{
+  GstSigningMux *mux = stream->mux;
+  const GstSigningKey *key = NULL;
+  GstSigningSettings settings;
+
+  if (stream->signed_video) return TRUE;
+
+  if (!gst_signing_codec_from_caps(caps, &stream->codec)) {
+    GST_ERROR_OBJECT(stream->sinkpad, "unsupported video codec");
+    return FALSE;
+  }
+  key = get_shared_key(mux);
+  if (!key) {
+    GST_ERROR_OBJECT(stream->sinkpad, "failed to get private key");
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK(mux);
+  settings = mux->priv->settings;
+  settings.hash_algo = g_strdup(mux->priv->settings.hash_algo);
+  GST_OBJECT_UNLOCK(mux);
+
+  stream->nalu_format = gst_signing_nalu_format_from_caps(caps);
+  stream->signed_video = gst_signing_session_new(stream->codec, key, &settings);
+  g_free(settings.hash_algo);
+  if (!stream->signed_video) {
+    GST_ERROR_OBJECT(stream->sinkpad, "could not create Signed Video session");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Fetches the remaining SEIs of a stream and pushes them as a last access unit. */
+static void
+push_access_unit_at_eos(GstSigningMuxStream *stream)
+{
+  GQueue seis = G_QUEUE_INIT;
+  GstBuffer *au = NULL;
+
+  if (!stream->signed_video) return;
+
+  if (signed_video_set_end_of_stream(stream->signed_video) != SV_OK) {
+    GST_ERROR_OBJECT(stream->sinkpad, "failed to set EOS");
+    return;
+  }
+
+  if (!get_seis(stream, &seis, NULL, 0) || g_queue_is_empty(&seis)) {
+    g_queue_clear_full(&seis, (GDestroyNotify)gst_memory_unref);
+    return;
+  }
+  au = gst_buffer_new();
+  GST_BUFFER_PTS(au) = stream->last_pts;
+  while (!g_queue_is_empty(&seis)) {
+    gst_buffer_append_memory(au, g_queue_pop_head(&seis));
+  }
+  GST_DEBUG_OBJECT(stream->srcpad, "push AU at EOS: %" GST_PTR_FORMAT, au);
+  gst_pad_push(stream->srcpad, au);
+}
+
+/* Handles a serialized event in the order it was received relative to the buffers. */
+static GstFlowReturn
+handle_serialized_event(GstSigningMuxStream *stream, GstEvent *event)
+{
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_CAPS: {
+      GstCaps *caps = NULL;
+
+      gst_event_parse_caps(event, &caps);
+      if (!setup_stream(stream, caps)) {
+        gst_event_unref(event);
+        return GST_FLOW_NOT_NEGOTIATED;
+      }
+      break;
+    }
+    case GST_EVENT_EOS:
+      push_access_unit_at_eos(stream);
+      break;
+    default:
+      break;
+  }
+  gst_pad_push_event(stream->srcpad, event);
+
+  return GST_FLOW_OK;
+}
+
+/* Worker pool function. Processes everything queued for a stream as one batch. */
+static void
+process_stream(gpointer data, gpointer user_data)
+{
+  GstSigningMuxStream *stream = data;
+  GstSigningMux *mux = GST_SIGNING_MUX(user_data);
+  guint batch_size = 0;
+
+  g_mutex_lock(&stream->lock);
+  while (!stream->flushing && !g_queue_is_empty(&stream->queue)) {
+    GstMiniObject *item = g_queue_pop_head(&stream->queue);
+    GstFlowReturn ret = GST_FLOW_OK;
+
+    // Wake up the streaming thread, which may be waiting for room in the queue.
+    g_cond_broadcast(&stream->cond);
+    g_mutex_unlock(&stream->lock);
+
+    if (GST_IS_BUFFER(item)) {
+      ret = sign_and_push(stream, GST_BUFFER_CAST(item));
+      batch_size++;
+    } else {
+      ret = handle_serialized_event(stream, GST_EVENT_CAST(item));
+    }
+
+    g_mutex_lock(&stream->lock);
+    if (ret != GST_FLOW_OK && stream->last_ret == GST_FLOW_OK) {
+      stream->last_ret = ret;
+    }
+  }
+  stream->scheduled = FALSE;
+  g_cond_broadcast(&stream->cond);
+  g_mutex_unlock(&stream->lock);
+
+  GST_LOG_OBJECT(mux, "processed %u access units of %s", batch_size,
+      GST_PAD_NAME(stream->sinkpad));
+}
+
+static GstFlowReturn
+gst_signing_mux_sink_chain(GstPad *pad, G_GNUC_UNUSED GstObject *parent, GstBuffer *buf)
+{
+  GstSigningMuxStream *stream = gst_pad_get_element_private(pad);
+
+  return queue_item(stream, GST_MINI_OBJECT_CAST(buf));
+}
+
+static gboolean
+gst_signing_mux_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+  GstSigningMuxStream *stream = gst_pad_get_element_private(pad);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_FLUSH_START:
+      set_stream_flushing(stream, TRUE);
+      return gst_pad_push_event(stream->srcpad, event);
+    case GST_EVENT_FLUSH_STOP:
+      wait_for_stream_idle(stream);
+      set_stream_flushing(stream, FALSE);
+      return gst_pad_push_event(stream->srcpad, event);
+    default:
+      break;
+  }
+
+  if (GST_EVENT_IS_SERIALIZED(event)) {
+    return queue_item(stream, GST_MINI_OBJECT_CAST(event)) == GST_FLOW_OK;
+  }
+
+  return gst_pad_event_default(pad, parent, event);
+}
+
+static GstIterator *
+gst_signing_mux_iterate_internal_links(GstPad *pad, G_GNUC_UNUSED GstObject *parent)
+{
+  GstSigningMuxStream *stream = gst_pad_get_element_private(pad);
+  GstIterator *it = NULL;
+  GValue val = G_VALUE_INIT;
+
+  g_value_init(&val, GST_TYPE_PAD);
+  g_value_set_object(&val, pad == stream->sinkpad ? stream->srcpad : stream->sinkpad);
+  it = gst_iterator_new_single(GST_TYPE_PAD, &val);
+  g_value_unset(&val);
+
+  return it;
+}
+
+static void
+free_stream(GstSigningMuxStream *stream)
+{
+  if (stream->signed_video) signed_video_free(stream->signed_video);
+  g_queue_clear_full(&stream->queue, (GDestroyNotify)gst_mini_object_unref);
+  g_mutex_clear(&stream->lock);
+  g_cond_clear(&stream->cond);
+  g_free(stream);
+}
+
+static GstPad *
+gst_signing_mux_request_new_pad(GstElement *element, GstPadTemplate *templ,
+    G_GNUC_UNUSED const gchar *name, G_GNUC_UNUSED const GstCaps *caps)
+{
+  GstSigningMux *mux = GST_SIGNING_MUX(element);
+  GstSigningMuxStream *stream = g_new0(GstSigningMuxStream, 1);
+  gchar *pad_name = NULL;
+  guint pad_id = 0;
+  gboolean is_running = FALSE;
+
+  GST_OBJECT_LOCK(mux);
+  pad_id = mux->priv->next_pad_id++;
+  is_running = GST_STATE(mux) > GST_STATE_READY || GST_STATE_NEXT(mux) == GST_STATE_PAUSED;
+  GST_OBJECT_UNLOCK(mux);
+
+  stream->mux = mux;
+  stream->last_pts = GST_CLOCK_TIME_NONE;
+  stream->last_ret = GST_FLOW_OK;
+  g_mutex_init(&stream->lock);
+  g_cond_init(&stream->cond);
+  g_queue_init(&stream->queue);
+
+  pad_name = g_strdup_printf("sink_%u", pad_id);
+  stream->sinkpad = gst_pad_new_from_template(templ, pad_name);
+  g_free(pad_name);
+  pad_name = g_strdup_printf("src_%u", pad_id);
+  stream->srcpad = gst_pad_new_from_static_template(&src_template, pad_name);
+  g_free(pad_name);
+  // The stream holds a reference of its own, since the element may remove the src pad when
+  // disposed, before releasing the sink pad.
+  gst_object_ref_sink(stream->srcpad);
+
+  gst_pad_set_element_private(stream->sinkpad, stream);
+  gst_pad_set_element_private(stream->srcpad, stream);
+  gst_pad_set_chain_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_signing_mux_sink_chain));
+  gst_pad_set_event_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_signing_mux_sink_event));
+  gst_pad_set_iterate_internal_links_function_full(stream->sinkpad,
+      GST_DEBUG_FUNCPTR(gst_signing_mux_iterate_internal_links), NULL, NULL);
+  gst_pad_set_iterate_internal_links_function_full(stream->srcpad,
+      GST_DEBUG_FUNCPTR(gst_signing_mux_iterate_internal_links), NULL, NULL);
+  GST_PAD_SET_PROXY_CAPS(stream->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION(stream->sinkpad);
+  GST_PAD_SET_PROXY_CAPS(stream->srcpad);
+
+  // Pads added to a running element have to be activated, otherwise their data is refused.
+  if (is_running) {
+    gst_pad_set_active(stream->srcpad, TRUE);
+    gst_pad_set_active(stream->sinkpad, TRUE);
+  }
+  gst_element_add_pad(element, stream->srcpad);
+  gst_element_add_pad(element, stream->sinkpad);
+  GST_DEBUG_OBJECT(mux, "added stream %u", pad_id);
+
+  return stream->sinkpad;
+}
+
+static void
+gst_signing_mux_release_pad(GstElement *element, GstPad *pad)
+{
+  GstSigningMuxStream *stream = gst_pad_get_element_private(pad);
+
+  GST_DEBUG_OBJECT(element, "release stream %s", GST_PAD_NAME(pad));
+  set_stream_flushing(stream, TRUE);
+  wait_for_stream_idle(stream);
+
+  if (stream->srcpad) {
+    if (GST_OBJECT_PARENT(stream->srcpad) == GST_OBJECT_CAST(element)) {
+      gst_element_remove_pad(element, stream->srcpad);
+    }
+    gst_object_unref(stream->srcpad);
+    stream->srcpad = NULL;
+  }
+  gst_element_remove_pad(element, stream->sinkpad);
+  free_stream(stream);
+}
+
+/* GCopyFunc taking a reference to |pad|. */
+static gpointer
+ref_pad(gconstpointer pad, gpointer __attribute__((unused)) user_data)
+{
+  return gst_object_ref((gpointer)pad);
+}
+
+/* Flushes all streams and frees their sessions, so that a restart begins from a clean state. */
+static void
+reset_streams(GstSigningMux *mux)
+{
+  GList *sinkpads = NULL;
+  GList *walk = NULL;
+
+  // Workers may need the object lock, hence do not hold it while waiting for them.
+  GST_OBJECT_LOCK(mux);
+  sinkpads = g_list_copy_deep(GST_ELEMENT(mux)->sinkpads, ref_pad, NULL);
+  GST_OBJECT_UNLOCK(mux);
+
+  for (walk = sinkpads; walk; walk = walk->next) {
+    GstSigningMuxStream *stream = gst_pad_get_element_private(GST_PAD(walk->data));
+
+    set_stream_flushing(stream, TRUE);
+    wait_for_stream_idle(stream);
+    if (stream->signed_video) {
+      signed_video_free(stream->signed_video);
+      stream->signed_video = NULL;
+    }
+    stream->last_pts = GST_CLOCK_TIME_NONE;
+    set_stream_flushing(stream, FALSE);
+  }
+  g_list_free_full(sinkpads, gst_object_unref);
+}
+
+static GstStateChangeReturn
+gst_signing_mux_change_state(GstElement *element, GstStateChange transition)
+{
+  GstSigningMux *mux = GST_SIGNING_MUX(element);
+  GstSigningMuxPrivate *priv = mux->priv;
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY: {
+      GError *error = NULL;
+      guint n_threads = priv->n_threads > 0 ? priv->n_threads : g_get_num_processors();
+
+      GST_DEBUG_OBJECT(mux, "start %u worker threads", n_threads);
+      priv->workers = g_thread_pool_new(process_stream, mux, (gint)n_threads, FALSE, &error);
+      if (!priv->workers) {
+        GST_ERROR_OBJECT(mux, "failed to create worker threads: %s", error->message);
+        g_error_free(error);
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      priv->sei_pool = gst_signing_mem_pool_new(SEI_POOL_BLOCK_SIZE, SEI_POOL_MAX_FREE);
+      break;
+    }
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS(gst_signing_mux_parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      reset_streams(mux);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      // Wait for all scheduled streams to be processed before stopping the workers.
+      g_thread_pool_free(priv->workers, FALSE, TRUE);
+      priv->workers = NULL;
+      g_clear_pointer(&priv->sei_pool, gst_signing_mem_pool_unref);
+      GST_OBJECT_LOCK(mux);
+      gst_signing_key_store_release(priv->key);
+      priv->key = NULL;
+      GST_OBJECT_UNLOCK(mux);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
@@ -0,0 +1,55 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_SIGNING_MUX_H__
+#define __GST_SIGNING_MUX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SIGNING_MUX (gst_signing_mux_get_type())
+#define GST_SIGNING_MUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SIGNING_MUX, GstSigningMux))
+#define GST_SIGNING_MUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SIGNING_MUX, GstSigningMuxClass))
+#define GST_IS_SIGNING_MUX(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SIGNING_MUX))
+#define GST_IS_SIGNING_MUX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SIGNING_MUX))
+
+typedef struct _GstSigningMux GstSigningMux;
+typedef struct _GstSigningMuxClass GstSigningMuxClass;
+typedef struct _GstSigningMuxPrivate GstSigningMuxPrivate;
+
+struct _GstSigningMux {
+  GstElement parent;
+  GstSigningMuxPrivate *priv;
+};
+
+struct _GstSigningMuxClass {
+  GstElementClass parent_class;
+};
+
+GType
+gst_signing_mux_get_type(void);
+
+G_END_DECLS
+
+#endif  // __GST_SIGNING_MUX_H__
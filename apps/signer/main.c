@@ -25,20 +25,121 @@
  * The output file name is the input file name prepended with 'signed_', that is, <filename> in
  * becomes signed_<filename> out.
  *
- * Supported video codecs are H264 and H265 and the recording should be an .mp4 file. Other file
- * formats may also work, but have not been tested.
+ * Supported video codecs are H264, H265 and AV1 and the recording should be an .mp4 file. Other
+ * file formats may also work, but have not been tested.
  *
- * Example to sign a H264 (default) video stored in file.mp4
+ * The codec is read from the file, hence -c is only used for live streams, see -i below.
+ *
+ * Example to sign a video stored in file.mp4
  *   $ ./signer.exe /path/to/file.mp4
  *
- * Example to sign a H265 video stored in file.mp4
- *   $ ./signer.exe -c h265 /path/to/file.mp4
+ * Given a directory, or several files, the files are signed in batch mode, running one pipeline per
+ * core concurrently. Example to sign all recordings in a directory with four pipelines
+ *   $ ./signer.exe -j 4 /path/to/recordings/
+ *
+ * With -n, MP4 files are signed natively, splicing the SEIs into the file without demuxing and
+ * remuxing it. Files the native path does not handle are signed through GStreamer.
+ *
+ * Raw H264 and H265 byte-streams (.h264, .264, .h265, .265, .hevc) are always signed natively.
+ * Example to sign a byte-stream dumped by an encoder
+ *   $ ./signer.exe /path/to/file.h264
+ *
+ * With -f a raw byte-stream still being recorded is followed and signed as it grows, until the
+ * recorder creates <filename>.done or the file has not grown for the time given by -t.
+ *   $ ./signer.exe -f -t 10 /path/to/recording.h264
+ *
+ * With -i the app signs a live stream from a local encoder instead of a file. The input and the
+ * output, given by -o, are either a file descriptor, fd:<n>, or a shared memory socket,
+ * shm:<socket path>. The latency added by the signing element is reported every few seconds.
+ * Ctrl-C ends the stream, which is then signed to the end.
+ *   $ ./signer.exe -c h264 -i shm:/tmp/encoder -o shm:/tmp/signed
  */
 
+#include <glib-unix.h>  // g_unix_signal_add
+#include <glib/gstdio.h>  // g_stat
 #include <gst/gst.h>
+#include <signal.h>  // SIGINT
 #include <string.h>  // strcmp, strncmp
 
+#include "annexb_signer.h"
 #include "gst-plugin/gstsigning_defines.h"
+#include "gst-plugin/gstsigning_keystore.h"
+#include "mp4_signer.h"
+
+// Seconds without growth before a followed file is considered done.
+#define DEFAULT_IDLE_TIMEOUT 10
+// Seconds between the latency reports in live mode.
+#define LIVE_REPORT_INTERVAL 5
+
+/* Settings of the signing element, common to all files. */
+typedef struct {
+  gboolean provisioned;
+  gboolean async_signing;
+  gboolean contiguous_output;
+  gboolean low_latency;
+  gboolean native;  // Sign MP4 files without a pipeline if possible
+  gboolean follow;  // Sign a raw byte-stream while it is being written
+  guint idle_timeout;  // Seconds without growth before a followed file is done
+  const gchar *private_key_path;
+  const gchar *certificate_chain_path;
+} SignerOptions;
+
+typedef struct _SignerBatch SignerBatch;
+
+/* One of the pipelines running concurrently in batch mode. The pipeline is reused for the next
+ * file, going back to READY in between, as long as the container does not change. */
+typedef struct {
+  SignerBatch *batch;
+  GstElement *pipeline;
+  const gchar *demux_str;
+  const gchar *filename;  // File currently being signed, or NULL if idle
+  guint bus_watch_id;
+} SignerJob;
+
+struct _SignerBatch {
+  const SignerOptions *options;
+  GMainLoop *loop;
+  GPtrArray *files;
+  guint next_file;
+  guint running;
+  guint files_signed;
+  guint files_failed;
+  guint64 bytes_signed;
+};
+
+/* Files signed natively in batch mode, on a thread pool sharing one signing key. */
+typedef struct {
+  const SignerOptions *options;
+  const GstSigningKey *key;
+  GMutex lock;
+  GPtrArray *unsupported;  // Files left to sign through GStreamer
+  guint files_signed;
+  guint files_failed;
+  guint64 bytes_signed;
+} NativeBatch;
+
+/* An access unit that entered the signing element in live mode. */
+typedef struct {
+  GstClockTime pts;
+  GstClockTime entry_time;
+} LiveEntry;
+
+/* Wall-clock time spent by access units in the signing element in live mode. The probes run on the
+ * streaming thread, or the signing worker thread, and the reports on the main loop. */
+typedef struct {
+  GMutex lock;
+  GQueue entries;  // LiveEntry of the access units in the element, in order
+  GArray *latencies;  // Latencies, in microseconds, since the last report
+  guint64 num_aus;
+  guint64 max_latency;
+} LiveLatency;
+
+/* What Ctrl-C acts on in live mode. */
+typedef struct {
+  GstElement *pipeline;
+  GMainLoop *loop;
+  gboolean is_interrupted;
+} LiveInterrupt;
 
 /* Callback to get and read messages on the bus. */
 static gboolean
@@ -71,7 +172,12 @@ bus_call(GstBus __attribute__((unused)) *bus, GstMessage *msg, gpointer data)
       const GstStructure *s = gst_message_get_structure(msg);
       if (strcmp(gst_structure_get_name(s), SIGNING_STRUCTURE_NAME) == 0) {
         const gchar *result = gst_structure_get_string(s, SIGNING_FIELD_NAME);
-        g_message("GOP %s", result);
+        guint allocations = 0;
+        guint allocations_avoided = 0;
+        gst_structure_get_uint(s, SIGNING_FIELD_ALLOCATIONS, &allocations);
+        gst_structure_get_uint(s, SIGNING_FIELD_ALLOCATIONS_AVOIDED, &allocations_avoided);
+        g_message("GOP %s (memory allocations: %u, avoided: %u)", result, allocations,
+            allocations_avoided);
       }
       break;
     }
@@ -88,177 +194,314 @@ pad_added_cb(GstElement __attribute__((unused)) *element, GstPad *pad, gpointer
 {
   GstElement *sink_element = data;
   GstPad *sinkpad = gst_element_get_static_pad(sink_element, "sink");
-  if (gst_pad_link(pad, sinkpad) != GST_PAD_LINK_OK) g_printerr("Failed to link demux and parser");
+  if (gst_pad_link(pad, sinkpad) != GST_PAD_LINK_OK) g_printerr("Failed to link demux and signing");
   gst_object_unref(sinkpad);
 }
 
-gint
-main(gint argc, gchar *argv[])
+/* Gets the name of the signed file, that is, |filename| with 'signed_' prepended to the file name.
+ * Returns NULL if the path is invalid. */
+static gchar *
+get_outfilename(const gchar *filename)
 {
-  int arg = 1;
-  int status = 1;
-
-  gchar *usage = g_strdup_printf(
-      "Usage:\n%s [-h] [-c codec] filename\n\n"
-      "Optional\n"
-      "  -c codec  : 'h264' (default) or 'h265'\n"
-      "  -p        : provisioned key, i.e., public key in cert (needs lib to be built with Axis)'\n"
-      "Required\n"
-      "  filename  : Name of the file to be signed.\n",
-      argv[0]);
-
-  GError *error = NULL;
-  gchar *codec_str = "h264";
-  gchar *demux_str = "qtdemux";
-  gchar *mux_str = "mp4mux";
-  gchar *filename = NULL;
   gchar *outfilename = NULL;
-  gboolean provisioned = FALSE;
+  // Extract filename from path. Try both Windows and Linux style.
+  gchar *pathname = g_strdup(filename);
+  gchar *end_path_name_linux = strrchr(pathname, '/');
+  gchar *end_path_name_win = strrchr(pathname, '\\');
 
-  GstElement *pipeline = NULL;
-  GstElement *filesrc = NULL;
-  GstElement *demuxer = NULL;
-  GstElement *parser = NULL;
-  GstElement *signedvideo = NULL;
-  GstElement *muxer = NULL;
-  GstElement *filesink = NULL;
+  if (end_path_name_linux && end_path_name_win) {
+    g_warning("Filename %s has invalid characters", filename);
+  } else if (end_path_name_linux) {
+    *end_path_name_linux = '\0';
+    outfilename = g_strdup_printf("%s/signed_%s", pathname, end_path_name_linux + 1);
+  } else if (end_path_name_win) {
+    *end_path_name_win = '\0';
+    outfilename = g_strdup_printf("%s\\signed_%s", pathname, end_path_name_win + 1);
+  } else {
+    outfilename = g_strdup_printf("signed_%s", filename);
+  }
+  g_free(pathname);
 
-  GstBus *bus = NULL;
-  GMainLoop *loop = NULL;
+  return outfilename;
+}
 
-  // Initialization
-  if (!gst_init_check(NULL, NULL, &error)) {
-    g_warning("gst_init failed: %s", error->message);
-    goto out_at_once;
+/* Gets the demuxer and muxer of the container of |filename|. */
+static void
+get_container(const gchar *filename, const gchar **demux_str, const gchar **mux_str)
+{
+  // Determine if file is a Matroska container (.mkv or .webm)
+  if (strstr(filename, ".mkv") || strstr(filename, ".webm")) {
+    *demux_str = "matroskademux";
+    *mux_str = "matroskamux";
+  } else {
+    *demux_str = "qtdemux";
+    *mux_str = "mp4mux";
   }
+}
 
-  // Parse options from command-line.
-  while (arg < argc) {
-    if (strcmp(argv[arg], "-h") == 0) {
-      g_message("\n%s\n", usage);
-      status = 0;
-      goto out_at_once;
-    } else if (strcmp(argv[arg], "-c") == 0) {
-      arg++;
-      codec_str = argv[arg];
-    } else if (strcmp(argv[arg], "-p") == 0) {
-      provisioned = TRUE;
-    } else if (strncmp(argv[arg], "-", 1) == 0) {
-      // Unknown option.
-      g_message("Unknown option: %s\n%s", argv[arg], usage);
-    } else {
-      // End of options.
-      break;
-    }
-    arg++;
+/* Sets the properties of the signing element |signedvideo| from |options|. */
+static void
+configure_signing(const SignerOptions *options, GstElement *signedvideo)
+{
+  if (options->provisioned) {
+    g_object_set(G_OBJECT(signedvideo), "provisioned", 1, NULL);
   }
-
-  // Parse filename.
-  if (arg < argc) {
-    filename = argv[arg];
-    // Extract filename from path. Try both Windows and Linux style.
-    gchar *pathname = g_strdup(filename);
-    gchar *end_path_name_linux = strrchr(pathname, '/');
-    gchar *end_path_name_win = strrchr(pathname, '\\');
-    if (end_path_name_linux && end_path_name_win) {
-      g_error("Filename %s has invalid characters", filename);
-    }
-    if (end_path_name_linux) {
-      *end_path_name_linux = '\0';
-      outfilename = g_strdup_printf("%s/signed_%s", pathname, end_path_name_linux + 1);
-    } else if (end_path_name_win) {
-      *end_path_name_win = '\0';
-      outfilename = g_strdup_printf("%s\\signed_%s", pathname, end_path_name_win + 1);
-    } else {
-      outfilename = g_strdup_printf("signed_%s", filename);
-    }
-    g_free(pathname);
-    g_message(
-        "\nThe result of signing '%s' will be written to '%s'.\n"
-        "Private and public key stored at '%s'",
-        filename, outfilename, PATH_TO_KEY_FILES);
+  if (options->async_signing) {
+    g_object_set(G_OBJECT(signedvideo), "async-signing", TRUE, NULL);
   }
-
-  if (!filename || !outfilename) {
-    g_warning("no filename was specified\n%s", usage);
-    goto out_at_once;
+  if (options->contiguous_output) {
+    g_object_set(G_OBJECT(signedvideo), "contiguous-output", TRUE, NULL);
   }
-  g_free(usage);
-  usage = NULL;
-
-  // Determine if file is a Matroska container (.mkv)
-  if (strstr(filename, ".mkv")) {
-    demux_str = "matroskademux";
-    mux_str = "matroskamux";
+  if (options->low_latency) {
+    g_object_set(G_OBJECT(signedvideo), "low-latency", TRUE, NULL);
   }
+  if (options->private_key_path) {
+    g_object_set(G_OBJECT(signedvideo), "private-key", options->private_key_path, NULL);
+  }
+  if (options->certificate_chain_path) {
+    g_object_set(
+        G_OBJECT(signedvideo), "certificate-chain", options->certificate_chain_path, NULL);
+  }
+}
 
-  // Create a main loop to run the application in.
-  loop = g_main_loop_new(NULL, FALSE);
-  if (!loop) {
-    g_error("failed creating a main loop");
-    goto out;
+/* Prints the statistics of the signing element named "signing" in |pipeline|. */
+static void
+print_signing_stats(GstElement *pipeline)
+{
+  GstElement *signedvideo = gst_bin_get_by_name(GST_BIN(pipeline), "signing");
+  GstStructure *stats = NULL;
+
+  if (!signedvideo) return;
+  g_object_get(G_OBJECT(signedvideo), "stats", &stats, NULL);
+  if (stats) {
+    gchar *stats_str = gst_structure_to_string(stats);
+    g_message("Signing statistics: %s", stats_str);
+    g_free(stats_str);
+    gst_structure_free(stats);
   }
+  gst_object_unref(signedvideo);
+}
+
+/* Creates the pipeline 'filesrc name=src ! demux ! signing name=signing ! mux ! filesink
+ * name=sink'. The locations of the source and sink are left to the caller. Returns NULL on
+ * failure. */
+static GstElement *
+create_pipeline(const SignerOptions *options, const gchar *demux_str, const gchar *mux_str)
+{
+  GstElement *pipeline = NULL;
+  GstElement *filesrc = NULL;
+  GstElement *demuxer = NULL;
+  GstElement *signedvideo = NULL;
+  GstElement *muxer = NULL;
+  GstElement *filesink = NULL;
 
   // Create pipeline.
   pipeline = gst_pipeline_new(NULL);
   if (!pipeline) {
-    g_error("failed creating an empty pipeline");
-    goto out;
+    g_warning("failed creating an empty pipeline");
+    return NULL;
   }
 
-  // Watch for messages on the pipeline's bus (note that this will only work like this when a GLib
-  // main loop is running)
-  bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-  gst_bus_add_watch(bus, bus_call, loop);
-
   // Create elements and populate the pipeline.
-  filesrc = gst_element_factory_make("filesrc", NULL);
+  filesrc = gst_element_factory_make("filesrc", "src");
   demuxer = gst_element_factory_make(demux_str, NULL);
-  if (strcmp(codec_str, "h264") == 0) {
-    parser = gst_element_factory_make("h264parse", NULL);
-  } else {
-    parser = gst_element_factory_make("h265parse", NULL);
-  }
-  signedvideo = gst_element_factory_make("signing", NULL);
-  if (provisioned) {
-    g_object_set(G_OBJECT(signedvideo), "provisioned", 1, NULL);
-  }
+  signedvideo = gst_element_factory_make("signing", "signing");
   muxer = gst_element_factory_make(mux_str, NULL);
-  filesink = gst_element_factory_make("filesink", NULL);
+  filesink = gst_element_factory_make("filesink", "sink");
 
-  if (!filesrc || !demuxer || !parser || !muxer || !filesink) {
+  if (!filesrc || !demuxer || !muxer || !filesink) {
     if (!filesrc) g_message("GStreamer element 'filesrc' not found");
     if (!demuxer) g_message("GStreamer element '%s' not found", demux_str);
-    if (!parser) g_message("GStreamer element '%sparse' not found", codec_str);
     if (!muxer) g_message("GStreamer element '%s' not found", mux_str);
     if (!filesink) g_message("GStreamer element 'filesink' not found");
 
-    goto out;
+    goto error;
   } else if (!signedvideo) {
     g_message(
         "The gstsigning element could not be found. Make sure it is installed "
         "correctly in $(libdir)/gstreamer-1.0/ or ~/.gstreamer-1.0/plugins/ or in your "
         "GST_PLUGIN_PATH, and that gst-inspect-1.0 lists it. If it does not, check with "
         "'GST_DEBUG=*:2 gst-inspect-1.0' for the reason why it is not being loaded.");
-    goto out;
+    goto error;
   }
 
-  // Set file names locations of src and sink.
-  g_object_set(G_OBJECT(filesrc), "location", filename, NULL);
-  g_object_set(G_OBJECT(filesink), "location", outfilename, NULL);
+  configure_signing(options, signedvideo);
 
   // Add all elements to the pipeline bin.
-  gst_bin_add_many(GST_BIN(pipeline), filesrc, demuxer, parser, signedvideo, muxer, filesink, NULL);
+  gst_bin_add_many(GST_BIN(pipeline), filesrc, demuxer, signedvideo, muxer, filesink, NULL);
 
   // Link everything together
   if (!gst_element_link_many(filesrc, demuxer, NULL) ||
-      !gst_element_link_many(parser, signedvideo, muxer, filesink, NULL)) {
+      !gst_element_link_many(signedvideo, muxer, filesink, NULL)) {
     g_message("Failed to link the elements!");
+    gst_object_unref(pipeline);
+    return NULL;
+  }
+
+  // Add a callback to link demuxer and signing when pads exist. The demuxer delivers each access
+  // unit as one memory, in which the signing element finds the nalus, hence no parser is needed.
+  g_signal_connect(demuxer, "pad-added", G_CALLBACK(pad_added_cb), signedvideo);
+
+  return pipeline;
+
+error:
+  if (filesrc) gst_object_unref(filesrc);
+  if (demuxer) gst_object_unref(demuxer);
+  if (signedvideo) gst_object_unref(signedvideo);
+  if (muxer) gst_object_unref(muxer);
+  if (filesink) gst_object_unref(filesink);
+  gst_object_unref(pipeline);
+  return NULL;
+}
+
+/* Sets the locations of the source and sink of |pipeline|. */
+static void
+set_locations(GstElement *pipeline, const gchar *filename, const gchar *outfilename)
+{
+  GstElement *filesrc = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+  GstElement *filesink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+
+  g_object_set(G_OBJECT(filesrc), "location", filename, NULL);
+  g_object_set(G_OBJECT(filesink), "location", outfilename, NULL);
+  gst_object_unref(filesrc);
+  gst_object_unref(filesink);
+}
+
+/* Returns TRUE if |filename| is signed without a pipeline, i.e., a raw byte-stream or, with -n, an
+ * MP4 file. */
+static gboolean
+is_native_file(const SignerOptions *options, const gchar *filename)
+{
+  SignedVideoCodec codec;
+
+  return annexb_signer_get_codec(filename, &codec) ||
+      (options->native && g_str_has_suffix(filename, ".mp4"));
+}
+
+/* Signs |filename| without a pipeline if it is a raw byte-stream or an MP4 file. If |key| is NULL
+ * a key is fetched from the key store for this file only. Returns MP4_SIGNER_UNSUPPORTED if the
+ * file has to be signed through GStreamer. */
+static Mp4SignerResult
+sign_file_native(const SignerOptions *options, const gchar *filename, const GstSigningKey *key,
+    guint64 *bytes_written)
+{
+  Mp4SignerResult result = MP4_SIGNER_ERROR;
+  const GstSigningKey *own_key = NULL;
+  gchar *outfilename = NULL;
+  SignedVideoCodec codec;
+
+  if (!is_native_file(options, filename)) return MP4_SIGNER_UNSUPPORTED;
+
+  outfilename = get_outfilename(filename);
+  if (!outfilename) goto out;
+  if (!key) {
+    own_key = gst_signing_key_store_get(
+        options->private_key_path, options->certificate_chain_path, options->provisioned);
+    if (!own_key) {
+      g_warning("failed to set up the signing key");
+      goto out;
+    }
+    key = own_key;
+  }
+
+  if (annexb_signer_get_codec(filename, &codec)) {
+    result = annexb_signer_sign_file(filename, outfilename, codec, key, bytes_written) ?
+        MP4_SIGNER_OK :
+        MP4_SIGNER_ERROR;
+  } else {
+    result = mp4_signer_sign_file(filename, outfilename, key, bytes_written);
+  }
+
+out:
+  if (own_key) gst_signing_key_store_release(own_key);
+  g_free(outfilename);
+
+  return result;
+}
+
+/* Signs the raw byte-stream |filename| while it is being written. Returns 0 on success. */
+static int
+follow_file(const SignerOptions *options, const gchar *filename)
+{
+  int status = 1;
+  SignedVideoCodec codec;
+  const GstSigningKey *key = NULL;
+  gchar *outfilename = NULL;
+
+  // Containers cannot be followed, since an MP4 file is not playable until its moov is written.
+  if (!annexb_signer_get_codec(filename, &codec)) {
+    g_warning("only raw H264 and H265 byte-streams can be followed");
+    return 1;
+  }
+  outfilename = get_outfilename(filename);
+  if (!outfilename) goto out;
+  key = gst_signing_key_store_get(
+      options->private_key_path, options->certificate_chain_path, options->provisioned);
+  if (!key) {
+    g_warning("failed to set up the signing key");
     goto out;
   }
+  g_message("\nFollowing '%s', the result is written to '%s' as it grows.\n", filename,
+      outfilename);
+
+  if (annexb_signer_follow_file(filename, outfilename, codec, key, options->idle_timeout, NULL)) {
+    status = 0;
+  }
+
+out:
+  if (key) gst_signing_key_store_release(key);
+  g_free(outfilename);
+
+  return status;
+}
+
+/* Signs one file, printing the result of every signed GOP. Returns 0 on success. */
+static int
+sign_file(const SignerOptions *options, const gchar *filename)
+{
+  int status = 1;
+  GError *error = NULL;
+  const gchar *demux_str = NULL;
+  const gchar *mux_str = NULL;
+  gchar *outfilename = NULL;
+
+  GstElement *pipeline = NULL;
+
+  GstBus *bus = NULL;
+  GMainLoop *loop = NULL;
+
+  outfilename = get_outfilename(filename);
+  if (!outfilename) goto out;
+  g_message("\nThe result of signing '%s' will be written to '%s'.\n", filename, outfilename);
+
+  if (is_native_file(options, filename)) {
+    Mp4SignerResult result = sign_file_native(options, filename, NULL, NULL);
+
+    if (result != MP4_SIGNER_UNSUPPORTED) {
+      status = result == MP4_SIGNER_OK ? 0 : 1;
+      goto out;
+    }
+  }
 
-  // Add a callback to link demuxer and parser when pads exist.
-  g_signal_connect(demuxer, "pad-added", G_CALLBACK(pad_added_cb), parser);
+  get_container(filename, &demux_str, &mux_str);
+
+  // Create a main loop to run the application in.
+  loop = g_main_loop_new(NULL, FALSE);
+  if (!loop) {
+    g_error("failed creating a main loop");
+    goto out;
+  }
+
+  pipeline = create_pipeline(options, demux_str, mux_str);
+  if (!pipeline) goto out;
+
+  // Watch for messages on the pipeline's bus (note that this will only work like this when a GLib
+  // main loop is running)
+  bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+  gst_bus_add_watch(bus, bus_call, loop);
+
+  // Set file names locations of src and sink.
+  set_locations(pipeline, filename, outfilename);
 
   // Set playing state and start the main loop.
   if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
@@ -277,18 +520,710 @@ main(gint argc, gchar *argv[])
 
   g_main_loop_run(loop);
 
+  print_signing_stats(pipeline);
+
   gst_element_set_state(pipeline, GST_STATE_NULL);
 
   status = 0;
 
 out:
   // End of session. Free objects.
-  gst_object_unref(bus);
+  if (bus) gst_object_unref(bus);
+  if (pipeline) gst_object_unref(pipeline);
+  if (loop) g_main_loop_unref(loop);
+  g_free(outfilename);
+  if (error) g_error_free(error);
+
+  return status;
+}
+
+static GstPadProbeReturn
+on_live_sink_buffer(GstPad __attribute__((unused)) *pad, GstPadProbeInfo *info, gpointer data)
+{
+  LiveLatency *latency = data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  LiveEntry *entry = NULL;
+
+  if (!GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+
+  entry = g_new(LiveEntry, 1);
+  entry->pts = GST_BUFFER_PTS(buf);
+  entry->entry_time = gst_util_get_timestamp();
+  g_mutex_lock(&latency->lock);
+  g_queue_push_tail(&latency->entries, entry);
+  g_mutex_unlock(&latency->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+on_live_src_buffer(GstPad __attribute__((unused)) *pad, GstPadProbeInfo *info, gpointer data)
+{
+  LiveLatency *latency = data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  LiveEntry *entry = NULL;
+
+  g_mutex_lock(&latency->lock);
+  // Access units leave in the order they entered. SEIs pushed as standalone buffers, with the
+  // timestamp of the access unit before them, do not match and are not counted.
+  entry = g_queue_peek_head(&latency->entries);
+  if (entry && entry->pts == GST_BUFFER_PTS(buf)) {
+    guint64 latency_us = (gst_util_get_timestamp() - entry->entry_time) / GST_USECOND;
+
+    g_array_append_val(latency->latencies, latency_us);
+    latency->num_aus++;
+    latency->max_latency = MAX(latency->max_latency, latency_us);
+    g_free(g_queue_pop_head(&latency->entries));
+  }
+  g_mutex_unlock(&latency->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gint
+compare_latencies(gconstpointer a, gconstpointer b)
+{
+  const guint64 latency_a = *(const guint64 *)a;
+  const guint64 latency_b = *(const guint64 *)b;
+
+  return latency_a < latency_b ? -1 : (latency_a > latency_b ? 1 : 0);
+}
+
+/* Prints the latency added by the signing element since the last report. */
+static gboolean
+report_live_latency(gpointer data)
+{
+  LiveLatency *latency = data;
+  GArray *latencies = latency->latencies;
+  guint64 sum = 0;
+
+  g_mutex_lock(&latency->lock);
+  if (latencies->len > 0) {
+    for (guint i = 0; i < latencies->len; i++) sum += g_array_index(latencies, guint64, i);
+    g_array_sort(latencies, compare_latencies);
+    g_message("Signing latency of %u access units: mean %.0f us, p50 %" G_GUINT64_FORMAT
+              " us, p99 %" G_GUINT64_FORMAT " us (max %" G_GUINT64_FORMAT
+              " us over %" G_GUINT64_FORMAT " access units)",
+        latencies->len, (gdouble)sum / latencies->len,
+        g_array_index(latencies, guint64, latencies->len / 2),
+        g_array_index(latencies, guint64, MIN(latencies->len - 1, latencies->len * 99 / 100)),
+        latency->max_latency, latency->num_aus);
+    g_array_set_size(latencies, 0);
+  }
+  g_mutex_unlock(&latency->lock);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Gets the element description of a live |endpoint|, which is fd:<n> or shm:<socket path>. Returns
+ * NULL if not valid. */
+static gchar *
+get_live_element(const gchar *endpoint, gboolean is_src)
+{
+  if (g_str_has_prefix(endpoint, "fd:")) {
+    // Timestamp the access units on arrival, since a pipe carries no timestamps.
+    return is_src ? g_strdup_printf("fdsrc fd=%s do-timestamp=true", endpoint + 3) :
+                    g_strdup_printf("fdsink fd=%s sync=false", endpoint + 3);
+  }
+  if (g_str_has_prefix(endpoint, "shm:")) {
+    return is_src ? g_strdup_printf(
+                        "shmsrc socket-path=\"%s\" is-live=true do-timestamp=true", endpoint + 4) :
+                    g_strdup_printf(
+                        "shmsink socket-path=\"%s\" wait-for-connection=false sync=false",
+                        endpoint + 4);
+  }
+
+  return NULL;
+}
+
+/* Gets the parser, and the caps the signing element is fed with, of |codec_str|. */
+static const gchar *
+get_live_parser(const gchar *codec_str)
+{
+  if (strcmp(codec_str, "h264") == 0) {
+    return "h264parse ! video/x-h264,stream-format=byte-stream,alignment=au";
+  }
+  if (strcmp(codec_str, "h265") == 0) {
+    return "h265parse ! video/x-h265,stream-format=byte-stream,alignment=au";
+  }
+  if (strcmp(codec_str, "av1") == 0) {
+    return "av1parse ! video/x-av1,stream-format=obu-stream,alignment=tu";
+  }
+
+  return NULL;
+}
+
+/* Called on Ctrl-C in live mode. A live source never ends, hence the stream is ended here, so that
+ * the last SEIs are still pushed. */
+static gboolean
+on_live_interrupt(gpointer user_data)
+{
+  LiveInterrupt *interrupt = user_data;
+
+  if (interrupt->is_interrupted) {
+    // Interrupted again, e.g., since the stream does not end. Quit right away.
+    g_main_loop_quit(interrupt->loop);
+  } else {
+    g_message("Interrupted, ending the live stream");
+    gst_element_send_event(interrupt->pipeline, gst_event_new_eos());
+    interrupt->is_interrupted = TRUE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+/* Signs the live stream |input|, of codec |codec_str|, and writes it to |output|. The sink does
+ * not sync against the clock, so that every access unit is passed on as soon as it is signed, and
+ * the latency added by the signing element is measured with pad probes. Runs until the end of the
+ * stream, or Ctrl-C. Returns 0 on success. */
+static int
+sign_live(const SignerOptions *options, const gchar *codec_str, const gchar *input,
+    const gchar *output)
+{
+  int status = 1;
+  gchar *src_str = get_live_element(input, TRUE);
+  gchar *sink_str = get_live_element(output, FALSE);
+  const gchar *parser_str = get_live_parser(codec_str);
+  gchar *pipeline_str = NULL;
+  GError *error = NULL;
+  GstElement *pipeline = NULL;
+  GstElement *signedvideo = NULL;
+  GstPad *pad = NULL;
+  GstBus *bus = NULL;
+  GMainLoop *loop = NULL;
+  LiveLatency latency = {0};
+  LiveInterrupt interrupt = {0};
+  guint report_id = 0;
+  guint interrupt_id = 0;
+
+  if (!src_str || !sink_str || !parser_str) {
+    g_warning("invalid live input '%s', output '%s' or codec '%s'", input, output, codec_str);
+    goto out;
+  }
+  g_mutex_init(&latency.lock);
+  g_queue_init(&latency.entries);
+  latency.latencies = g_array_new(FALSE, FALSE, sizeof(guint64));
+
+  pipeline_str =
+      g_strdup_printf("%s ! %s ! signing name=signing ! %s", src_str, parser_str, sink_str);
+  pipeline = gst_parse_launch(pipeline_str, &error);
+  if (!pipeline || error) {
+    g_warning("failed to create the live pipeline '%s': %s", pipeline_str,
+        error ? error->message : "unknown error");
+    goto out;
+  }
+  signedvideo = gst_bin_get_by_name(GST_BIN(pipeline), "signing");
+  configure_signing(options, signedvideo);
+  pad = gst_element_get_static_pad(signedvideo, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_live_sink_buffer, &latency, NULL);
+  gst_object_unref(pad);
+  pad = gst_element_get_static_pad(signedvideo, "src");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_live_src_buffer, &latency, NULL);
+  gst_object_unref(pad);
+  gst_object_unref(signedvideo);
+
+  loop = g_main_loop_new(NULL, FALSE);
+  bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+  gst_bus_add_watch(bus, bus_call, loop);
+  report_id = g_timeout_add_seconds(LIVE_REPORT_INTERVAL, report_live_latency, &latency);
+  interrupt.pipeline = pipeline;
+  interrupt.loop = loop;
+  interrupt_id = g_unix_signal_add(SIGINT, on_live_interrupt, &interrupt);
+
+  g_message("Signing live stream from '%s' to '%s'", input, output);
+  if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_warning("failed to start the live pipeline");
+    goto out;
+  }
+  g_main_loop_run(loop);
+
+  report_live_latency(&latency);
+  print_signing_stats(pipeline);
+  status = 0;
+
+out:
+  if (report_id) g_source_remove(report_id);
+  if (interrupt_id) g_source_remove(interrupt_id);
+  if (pipeline) gst_element_set_state(pipeline, GST_STATE_NULL);
+  if (bus) {
+    gst_bus_remove_watch(bus);
+    gst_object_unref(bus);
+  }
   if (pipeline) gst_object_unref(pipeline);
   if (loop) g_main_loop_unref(loop);
+  if (latency.latencies) {
+    gpointer entry = NULL;
+    while ((entry = g_queue_pop_head(&latency.entries)) != NULL) g_free(entry);
+    g_array_free(latency.latencies, TRUE);
+    g_mutex_clear(&latency.lock);
+  }
+  if (error) g_error_free(error);
+  g_free(pipeline_str);
+  g_free(src_str);
+  g_free(sink_str);
+
+  return status;
+}
+
+static void
+start_next_file(SignerJob *job);
+
+/* Ends the current file of |job| and moves on to the next one. */
+static void
+finish_file(SignerJob *job)
+{
+  GstBus *bus = gst_element_get_bus(job->pipeline);
+
+  // Going back to READY keeps the signing key. Messages still queued belong to the finished file.
+  gst_element_set_state(job->pipeline, GST_STATE_READY);
+  gst_bus_set_flushing(bus, TRUE);
+  gst_bus_set_flushing(bus, FALSE);
+  gst_object_unref(bus);
+
+  job->filename = NULL;
+  job->batch->running--;
+  start_next_file(job);
+}
+
+/* Callback to get and read messages on the bus of a pipeline in batch mode. */
+static gboolean
+job_bus_call(GstBus __attribute__((unused)) *bus, GstMessage *msg, gpointer data)
+{
+  SignerJob *job = data;
+  SignerBatch *batch = job->batch;
+
+  if (!job->filename) return TRUE;
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_EOS: {
+      GStatBuf stat_buf;
+
+      if (g_stat(job->filename, &stat_buf) == 0) batch->bytes_signed += stat_buf.st_size;
+      batch->files_signed++;
+      g_message("Signed '%s'", job->filename);
+      finish_file(job);
+      break;
+    }
+    case GST_MESSAGE_ERROR: {
+      GError *err = NULL;
+
+      gst_message_parse_error(msg, &err, NULL);
+      g_message("Failed to sign '%s': %s", job->filename, err->message);
+      g_error_free(err);
+      batch->files_failed++;
+      finish_file(job);
+      break;
+    }
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+/* Replaces the pipeline of |job| if it does not fit the container of |filename|, and starts
+ * signing |filename|. Returns FALSE if the file could not be started. */
+static gboolean
+start_file(SignerJob *job, const gchar *filename)
+{
+  const gchar *demux_str = NULL;
+  const gchar *mux_str = NULL;
+  gchar *outfilename = get_outfilename(filename);
+
+  if (!outfilename) return FALSE;
+
+  get_container(filename, &demux_str, &mux_str);
+  if (!job->pipeline || strcmp(job->demux_str, demux_str) != 0) {
+    GstElement *pipeline = create_pipeline(job->batch->options, demux_str, mux_str);
+    // Set up the new pipeline before stopping the old one, for the signing key to be reused.
+    if (!pipeline || gst_element_set_state(pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE) {
+      if (pipeline) gst_object_unref(pipeline);
+      g_free(outfilename);
+      return FALSE;
+    }
+    if (job->pipeline) {
+      g_source_remove(job->bus_watch_id);
+      gst_element_set_state(job->pipeline, GST_STATE_NULL);
+      gst_object_unref(job->pipeline);
+    }
+    GstBus *bus = gst_element_get_bus(pipeline);
+    job->bus_watch_id = gst_bus_add_watch(bus, job_bus_call, job);
+    gst_object_unref(bus);
+    job->pipeline = pipeline;
+    job->demux_str = demux_str;
+  }
+
+  set_locations(job->pipeline, filename, outfilename);
   g_free(outfilename);
+  if (gst_element_set_state(job->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    gst_element_set_state(job->pipeline, GST_STATE_READY);
+    return FALSE;
+  }
+  job->filename = filename;
+  job->batch->running++;
 
-out_at_once:
+  return TRUE;
+}
+
+/* Starts the next file not yet signed on |job|. Quits the main loop when all files are done. */
+static void
+start_next_file(SignerJob *job)
+{
+  SignerBatch *batch = job->batch;
+
+  while (batch->next_file < batch->files->len) {
+    const gchar *filename = g_ptr_array_index(batch->files, batch->next_file++);
+    if (start_file(job, filename)) return;
+    g_message("Failed to start signing '%s'", filename);
+    batch->files_failed++;
+  }
+
+  if (batch->running == 0) g_main_loop_quit(batch->loop);
+}
+
+static gint
+compare_filenames(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/* Adds |path| to |files|. If |path| is a directory, all recordings in it, not already signed, are
+ * added instead. Returns FALSE if the directory could not be read. */
+static gboolean
+collect_files(const gchar *path, GPtrArray *files)
+{
+  GError *error = NULL;
+  GDir *dir = NULL;
+  const gchar *name = NULL;
+  guint first = files->len;
+  SignedVideoCodec codec;
+
+  if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+    g_ptr_array_add(files, g_strdup(path));
+    return TRUE;
+  }
+
+  dir = g_dir_open(path, 0, &error);
+  if (!dir) {
+    g_warning("failed to open directory: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    if (g_str_has_prefix(name, "signed_")) continue;
+    if (!g_str_has_suffix(name, ".mp4") && !g_str_has_suffix(name, ".mkv") &&
+        !g_str_has_suffix(name, ".webm") && !annexb_signer_get_codec(name, &codec)) {
+      continue;
+    }
+    g_ptr_array_add(files, g_build_filename(path, name, NULL));
+  }
+  g_dir_close(dir);
+  // Sign in a predictable order.
+  if (files->len > first) {
+    GPtrArray *added = g_ptr_array_new();
+    for (guint i = first; i < files->len; i++) g_ptr_array_add(added, g_ptr_array_index(files, i));
+    g_ptr_array_sort(added, compare_filenames);
+    for (guint i = 0; i < added->len; i++) {
+      g_ptr_array_index(files, first + i) = g_ptr_array_index(added, i);
+    }
+    g_ptr_array_free(added, TRUE);
+  }
+
+  return TRUE;
+}
+
+static void
+sign_native_job(gpointer data, gpointer user_data)
+{
+  const gchar *filename = data;
+  NativeBatch *batch = user_data;
+  guint64 bytes_written = 0;
+  Mp4SignerResult result = sign_file_native(batch->options, filename, batch->key, &bytes_written);
+
+  g_mutex_lock(&batch->lock);
+  switch (result) {
+    case MP4_SIGNER_OK:
+      batch->files_signed++;
+      batch->bytes_signed += bytes_written;
+      break;
+    case MP4_SIGNER_UNSUPPORTED:
+      g_ptr_array_add(batch->unsupported, (gpointer)filename);
+      break;
+    default:
+      g_message("Failed to sign '%s'", filename);
+      batch->files_failed++;
+      break;
+  }
+  g_mutex_unlock(&batch->lock);
+}
+
+/* Signs the raw byte-streams, and with -n the MP4 files, among |files| natively on |num_jobs|
+ * threads, all using the same signing key. The files left to sign through GStreamer are added to
+ * |unsupported|. Returns FALSE if any file failed. */
+static gboolean
+sign_batch_native(
+    const SignerOptions *options, GPtrArray *files, guint num_jobs, GPtrArray *unsupported)
+{
+  NativeBatch batch = {0};
+  GThreadPool *pool = NULL;
+  gint64 start_time = 0;
+  gdouble seconds = 0.0;
+  guint num_native = 0;
+
+  batch.options = options;
+  batch.unsupported = unsupported;
+  batch.key = gst_signing_key_store_get(
+      options->private_key_path, options->certificate_chain_path, options->provisioned);
+  if (!batch.key) {
+    g_warning("failed to set up the signing key");
+    return FALSE;
+  }
+  g_mutex_init(&batch.lock);
+  pool = g_thread_pool_new(sign_native_job, &batch, num_jobs, TRUE, NULL);
+
+  start_time = g_get_monotonic_time();
+  for (guint i = 0; i < files->len; i++) {
+    gchar *filename = g_ptr_array_index(files, i);
+
+    if (is_native_file(options, filename)) {
+      g_thread_pool_push(pool, filename, NULL);
+      num_native++;
+    } else {
+      g_ptr_array_add(unsupported, filename);
+    }
+  }
+  // Wait for all files to be signed.
+  g_thread_pool_free(pool, FALSE, TRUE);
+  seconds = (gdouble)(g_get_monotonic_time() - start_time) / G_USEC_PER_SEC;
+
+  g_mutex_clear(&batch.lock);
+  gst_signing_key_store_release(batch.key);
+  // The fallback is signed in the same order as without -n.
+  g_ptr_array_sort(unsupported, compare_filenames);
+
+  if (seconds <= 0.0) seconds = 1.0 / G_USEC_PER_SEC;
+  g_message("Signed %u of %u files natively in %.2f s: %.2f files/s, %.2f MB/s",
+      batch.files_signed, num_native, seconds, batch.files_signed / seconds,
+      batch.bytes_signed / 1e6 / seconds);
+
+  return batch.files_failed == 0;
+}
+
+/* Signs all |files| with |num_jobs| pipelines running concurrently, and prints a summary of the
+ * throughput. Returns 0 if all files were signed. */
+static int
+sign_batch(const SignerOptions *options, GPtrArray *files, guint num_jobs)
+{
+  SignerBatch batch = {0};
+  SignerJob *jobs = NULL;
+  gint64 start_time = 0;
+  gdouble seconds = 0.0;
+
+  if (num_jobs > files->len) num_jobs = files->len;
+  if (num_jobs == 0) {
+    g_warning("no files to sign");
+    return 1;
+  }
+  g_message("Signing %u files with %u concurrent pipelines", files->len, num_jobs);
+
+  batch.options = options;
+  batch.files = files;
+  batch.loop = g_main_loop_new(NULL, FALSE);
+  jobs = g_new0(SignerJob, num_jobs);
+
+  start_time = g_get_monotonic_time();
+  for (guint i = 0; i < num_jobs; i++) {
+    jobs[i].batch = &batch;
+    start_next_file(&jobs[i]);
+  }
+  if (batch.running > 0) g_main_loop_run(batch.loop);
+  seconds = (gdouble)(g_get_monotonic_time() - start_time) / G_USEC_PER_SEC;
+
+  for (guint i = 0; i < num_jobs; i++) {
+    if (!jobs[i].pipeline) continue;
+    g_source_remove(jobs[i].bus_watch_id);
+    gst_element_set_state(jobs[i].pipeline, GST_STATE_NULL);
+    gst_object_unref(jobs[i].pipeline);
+  }
+  g_free(jobs);
+  g_main_loop_unref(batch.loop);
+
+  if (seconds <= 0.0) seconds = 1.0 / G_USEC_PER_SEC;
+  g_message("Signed %u of %u files in %.2f s: %.2f files/s, %.2f MB/s", batch.files_signed,
+      files->len, seconds, batch.files_signed / seconds, batch.bytes_signed / 1e6 / seconds);
+
+  return batch.files_failed > 0 ? 1 : 0;
+}
+
+static gboolean
+has_native_files(const SignerOptions *options, GPtrArray *files)
+{
+  for (guint i = 0; i < files->len; i++) {
+    if (is_native_file(options, g_ptr_array_index(files, i))) return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Parses |str| as a decimal number in the range [|min|, |max|]. Returns FALSE if it is not. */
+static gboolean
+parse_uint(const gchar *str, guint min, guint max, guint *value)
+{
+  guint64 number = 0;
+
+  if (!str || !g_ascii_string_to_unsigned(str, 10, min, max, &number, NULL)) return FALSE;
+  *value = (guint)number;
+
+  return TRUE;
+}
+
+gint
+main(gint argc, gchar *argv[])
+{
+  int arg = 1;
+  int status = 1;
+
+  gchar *usage = g_strdup_printf(
+      "Usage:\n%s [-h] [-c codec] [-j jobs] [-n] [-f [-t seconds]] filename [filename ...]\n"
+      "       %s [-c codec] -i input [-o output]\n\n"
+      "Optional\n"
+      "  -c codec  : 'h264' (default), 'h265' or 'av1', only used in live mode since otherwise\n"
+      "              read from the file\n"
+      "  -p        : provisioned key, i.e., public key in cert (needs lib to be built with Axis)'\n"
+      "  -a        : sign asynchronously on a worker thread instead of the streaming thread\n"
+      "  -m        : push each access unit as one contiguous memory\n"
+      "  -l        : low latency, push SEIs as soon as they are available\n"
+      "  -k file   : private key PEM file, instead of generating a new key in memory\n"
+      "  -C file   : certificate chain PEM file of the private key given by -k\n"
+      "  -j jobs   : number of files signed concurrently in batch mode (default: one per core)\n"
+      "  -n        : sign MP4 files natively, without demuxing and remuxing them\n"
+      "  -f        : follow a raw byte-stream being recorded and sign it as it grows\n"
+      "  -t seconds: end a followed file if it has not grown for this long (default: 10)\n"
+      "  -i input  : sign a live stream from fd:<n> or shm:<socket path> instead of a file,\n"
+      "              until it ends, or Ctrl-C\n"
+      "  -o output : where to write the live stream, fd:<n> or shm:<socket path> (default: fd:1)\n"
+      "Required\n"
+      "  filename  : Name of the file to be signed. Batch mode is used if several files, or a\n"
+      "              directory, are given.\n",
+      argv[0], argv[0]);
+
+  GError *error = NULL;
+  SignerOptions options = {0};
+  const gchar *codec_str = "h264";
+  const gchar *live_input = NULL;
+  const gchar *live_output = "fd:1";
+  guint num_jobs = g_get_num_processors();
+  GPtrArray *files = NULL;
+
+  // Initialization
+  if (!gst_init_check(NULL, NULL, &error)) {
+    g_warning("gst_init failed: %s", error->message);
+    goto out;
+  }
+
+  // Parse options from command-line.
+  options.idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  while (arg < argc) {
+    if (strcmp(argv[arg], "-h") == 0) {
+      g_message("\n%s\n", usage);
+      status = 0;
+      goto out;
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      // Only used in live mode. Otherwise, the codec is read from the caps of the demuxed stream.
+      arg++;
+      if (arg < argc) codec_str = argv[arg];
+    } else if (strcmp(argv[arg], "-i") == 0) {
+      arg++;
+      if (arg < argc) live_input = argv[arg];
+    } else if (strcmp(argv[arg], "-o") == 0) {
+      arg++;
+      if (arg < argc) live_output = argv[arg];
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      options.provisioned = TRUE;
+    } else if (strcmp(argv[arg], "-a") == 0) {
+      options.async_signing = TRUE;
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      options.contiguous_output = TRUE;
+    } else if (strcmp(argv[arg], "-l") == 0) {
+      options.low_latency = TRUE;
+    } else if (strcmp(argv[arg], "-k") == 0) {
+      arg++;
+      if (arg < argc) options.private_key_path = argv[arg];
+    } else if (strcmp(argv[arg], "-C") == 0) {
+      arg++;
+      if (arg < argc) options.certificate_chain_path = argv[arg];
+    } else if (strcmp(argv[arg], "-n") == 0) {
+      options.native = TRUE;
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      options.follow = TRUE;
+    } else if (strcmp(argv[arg], "-t") == 0) {
+      arg++;
+      if (!parse_uint(arg < argc ? argv[arg] : NULL, 1, G_MAXUINT, &options.idle_timeout)) {
+        g_warning("-t needs a number of seconds larger than 0\n%s", usage);
+        goto out;
+      }
+    } else if (strcmp(argv[arg], "-j") == 0) {
+      arg++;
+      if (!parse_uint(arg < argc ? argv[arg] : NULL, 0, G_MAXUINT, &num_jobs)) {
+        g_warning("-j needs a number of jobs\n%s", usage);
+        goto out;
+      }
+      if (num_jobs == 0) num_jobs = g_get_num_processors();
+    } else if (strncmp(argv[arg], "-", 1) == 0) {
+      // Unknown option.
+      g_message("Unknown option: %s\n%s", argv[arg], usage);
+    } else {
+      // End of options.
+      break;
+    }
+    arg++;
+  }
+
+  if (live_input) {
+    g_free(usage);
+    usage = NULL;
+    status = sign_live(&options, codec_str, live_input, live_output);
+    goto out;
+  }
+
+  // Parse filenames.
+  if (arg >= argc) {
+    g_warning("no filename was specified\n%s", usage);
+    goto out;
+  }
+  g_free(usage);
+  usage = NULL;
+
+  if (options.follow) {
+    if (argc - arg != 1) {
+      g_warning("only one file can be followed");
+      goto out;
+    }
+    status = follow_file(&options, argv[arg]);
+    goto out;
+  }
+  if (argc - arg == 1 && !g_file_test(argv[arg], G_FILE_TEST_IS_DIR)) {
+    status = sign_file(&options, argv[arg]);
+    goto out;
+  }
+
+  // Batch mode.
+  files = g_ptr_array_new_with_free_func(g_free);
+  for (; arg < argc; arg++) {
+    if (!collect_files(argv[arg], files)) goto out;
+  }
+  if (has_native_files(&options, files)) {
+    GPtrArray *unsupported = g_ptr_array_new();
+    gboolean native_ok = sign_batch_native(&options, files, num_jobs, unsupported);
+
+    status = unsupported->len > 0 ? sign_batch(&options, unsupported, num_jobs) : 0;
+    if (!native_ok) status = 1;
+    g_ptr_array_free(unsupported, TRUE);
+  } else {
+    status = sign_batch(&options, files, num_jobs);
+  }
+
+out:
+  if (files) g_ptr_array_free(files, TRUE);
   if (error) g_error_free(error);
   g_free(usage);
 
@@ -0,0 +1,987 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Signs the video track of an MP4 file without a GStreamer pipeline.
+ *
+ * Signing only adds a few hundred bytes of SEI per GOP, so demuxing and remuxing the whole file is
+ * mostly wasted work. Instead, the input is memory-mapped and only the boxes on the path to the
+ * sample tables, i.e., moov/trak/mdia/minf/stbl, are parsed. The samples of the video track are
+ * read in decode order straight from the mapped mdat and their length prefixed nalus are fed to
+ * the Signed Video lib. The SEIs it hands back are recorded as insertions at a sample offset.
+ *
+ * The output keeps all top-level boxes, and all boxes within moov, in the input order. Only the
+ * sample sizes (stsz) of the video track and the chunk offsets (stco/co64) of all tracks are
+ * rewritten. The first mdat is replaced by one holding all chunks in the input order, with the
+ * SEIs spliced into the samples of the video track while copying, and any other mdat is dropped.
+ */
+
+#include "mp4_signer.h"
+
+#include <glib/gstdio.h>  // g_fopen
+#include <signed-video-framework/signed_video_sign.h>
+#include <stdio.h>  // FILE, fwrite
+#include <string.h>  // memcpy, memset
+
+#include "gst-plugin/gstsigning_session.h"
+
+#define FOURCC(a, b, c, d) \
+  (((guint32)(a) << 24) | ((guint32)(b) << 16) | ((guint32)(c) << 8) | (guint32)(d))
+
+#define BOX_MOOV FOURCC('m', 'o', 'o', 'v')
+#define BOX_MOOF FOURCC('m', 'o', 'o', 'f')
+#define BOX_MDAT FOURCC('m', 'd', 'a', 't')
+#define BOX_TRAK FOURCC('t', 'r', 'a', 'k')
+#define BOX_MDIA FOURCC('m', 'd', 'i', 'a')
+#define BOX_MDHD FOURCC('m', 'd', 'h', 'd')
+#define BOX_HDLR FOURCC('h', 'd', 'l', 'r')
+#define BOX_MINF FOURCC('m', 'i', 'n', 'f')
+#define BOX_STBL FOURCC('s', 't', 'b', 'l')
+#define BOX_STSD FOURCC('s', 't', 's', 'd')
+#define BOX_STTS FOURCC('s', 't', 't', 's')
+#define BOX_CTTS FOURCC('c', 't', 't', 's')
+#define BOX_STSC FOURCC('s', 't', 's', 'c')
+#define BOX_STSZ FOURCC('s', 't', 's', 'z')
+#define BOX_STCO FOURCC('s', 't', 'c', 'o')
+#define BOX_CO64 FOURCC('c', 'o', '6', '4')
+#define BOX_AVCC FOURCC('a', 'v', 'c', 'C')
+#define BOX_HVCC FOURCC('h', 'v', 'c', 'C')
+#define HANDLER_VIDEO FOURCC('v', 'i', 'd', 'e')
+
+#define BOX_HEADER_SIZE 8
+#define FULL_BOX_HEADER_SIZE 4  // Version and flags
+// Size of the VisualSampleEntry fields, in front of its child boxes.
+#define VISUAL_SAMPLE_ENTRY_SIZE 78
+// Only 4 byte nalu lengths are handled, since the SEIs from the lib have a 4 byte start code.
+#define NALU_LENGTH_SIZE 4
+#define WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+
+typedef struct _Mp4Box Mp4Box;
+
+/* A box of the input file. The container boxes leading to the sample tables are parsed into
+ * |children|. All other boxes are copied as is to the output, unless |rewritten| is set. */
+struct _Mp4Box {
+  guint32 type;
+  const guint8 *data;  // Start of the box, including the header
+  guint64 size;  // Size of the box, including the header
+  guint header_size;
+  GPtrArray *children;
+  GByteArray *rewritten;  // Replaces the whole box, including the header
+};
+
+typedef struct {
+  guint32 handler;
+  guint32 timescale;
+  Mp4Box *stsd;
+  Mp4Box *stts;
+  Mp4Box *ctts;  // NULL if the presentation order equals the decode order
+  Mp4Box *stsc;
+  Mp4Box *stsz;
+  Mp4Box *stco;  // Either stco or co64
+  gboolean use_co64;  // Write the chunk offsets as co64
+  guint32 num_samples;
+  guint32 *sample_sizes;
+  guint32 *new_sample_sizes;  // Sample sizes including the SEIs, only set for the signed track
+  guint32 num_chunks;
+  guint64 *chunk_offsets;
+  guint64 *new_chunk_offsets;
+  guint32 *chunk_samples;  // Number of samples in each chunk
+  guint32 *chunk_first_sample;
+} Mp4Track;
+
+/* A chunk of a track, listed in the order of the input file. */
+typedef struct {
+  Mp4Track *track;
+  guint32 chunk;
+} Mp4ChunkRef;
+
+/* A SEI to insert in front of the nalu at |offset| in |sample|. */
+typedef struct {
+  guint32 sample;
+  guint32 offset;
+  guint8 *sei;  // Length prefixed SEI
+  gsize sei_size;
+} Mp4Insertion;
+
+/* Iterates the (sample count, value) pairs of stts and ctts. */
+typedef struct {
+  const guint8 *entries;
+  guint32 num_entries;
+  guint32 entry;
+  guint32 samples_left;  // Samples left in the current entry
+} Mp4TableCursor;
+
+typedef struct {
+  const guint8 *data;
+  guint64 size;
+  const gchar *reason;  // Why the file cannot be signed natively
+  GPtrArray *boxes;  // Top-level boxes
+  Mp4Box *moov;
+  Mp4Box *mdat;  // First mdat, replaced by the output mdat
+  GPtrArray *tracks;
+  Mp4Track *video;  // The signed track
+  SignedVideoCodec codec;
+  signed_video_t *sv;
+  GArray *insertions;
+  guint32 *first_insertion;  // Index of the first insertion of each sample
+  GArray *chunks;
+  guint64 mdat_payload_size;
+  guint mdat_header_size;
+  FILE *out;
+  guint64 bytes_written;
+} Mp4Signer;
+
+static void
+box_free(gpointer data)
+{
+  Mp4Box *box = data;
+
+  if (!box) return;
+  if (box->children) g_ptr_array_free(box->children, TRUE);
+  if (box->rewritten) g_byte_array_free(box->rewritten, TRUE);
+  g_free(box);
+}
+
+static void
+track_free(gpointer data)
+{
+  Mp4Track *track = data;
+
+  if (!track) return;
+  g_free(track->sample_sizes);
+  g_free(track->new_sample_sizes);
+  g_free(track->chunk_offsets);
+  g_free(track->new_chunk_offsets);
+  g_free(track->chunk_samples);
+  g_free(track->chunk_first_sample);
+  g_free(track);
+}
+
+static gboolean
+is_container(guint32 type)
+{
+  return type == BOX_MOOV || type == BOX_TRAK || type == BOX_MDIA || type == BOX_MINF ||
+      type == BOX_STBL;
+}
+
+/* Reads the header of the box at |data|, with |available| bytes left of its parent. */
+static gboolean
+parse_box_header(const guint8 *data, guint64 available, Mp4Box *box)
+{
+  if (available < BOX_HEADER_SIZE) return FALSE;
+
+  box->data = data;
+  box->size = GST_READ_UINT32_BE(data);
+  box->type = GST_READ_UINT32_BE(data + 4);
+  box->header_size = BOX_HEADER_SIZE;
+  if (box->size == 1) {
+    if (available < BOX_HEADER_SIZE + 8) return FALSE;
+    box->size = GST_READ_UINT64_BE(data + BOX_HEADER_SIZE);
+    box->header_size += 8;
+  } else if (box->size == 0) {
+    // The box extends to the end of the file.
+    box->size = available;
+  }
+
+  return box->size >= box->header_size && box->size <= available;
+}
+
+/* Parses the boxes in |data| into |boxes|, descending into container boxes. */
+static gboolean
+parse_boxes(const guint8 *data, guint64 size, GPtrArray *boxes)
+{
+  guint64 pos = 0;
+
+  while (pos < size) {
+    Mp4Box *box = g_new0(Mp4Box, 1);
+
+    g_ptr_array_add(boxes, box);
+    if (!parse_box_header(data + pos, size - pos, box)) return FALSE;
+    if (is_container(box->type)) {
+      box->children = g_ptr_array_new_with_free_func(box_free);
+      if (!parse_boxes(box->data + box->header_size, box->size - box->header_size,
+              box->children)) {
+        return FALSE;
+      }
+    }
+    pos += box->size;
+  }
+
+  return TRUE;
+}
+
+static Mp4Box *
+find_child(const Mp4Box *box, guint32 type)
+{
+  if (!box || !box->children) return NULL;
+
+  for (guint i = 0; i < box->children->len; i++) {
+    Mp4Box *child = g_ptr_array_index(box->children, i);
+    if (child->type == type) return child;
+  }
+
+  return NULL;
+}
+
+/* Returns the payload of a full box, i.e., after version and flags, and sets |size| to its size.
+ * Returns NULL if the box is too small to hold |min_size| bytes of payload. */
+static const guint8 *
+full_box_payload(const Mp4Box *box, guint64 min_size, guint64 *size)
+{
+  if (!box || box->size - box->header_size < FULL_BOX_HEADER_SIZE + min_size) return NULL;
+
+  *size = box->size - box->header_size - FULL_BOX_HEADER_SIZE;
+  return box->data + box->header_size + FULL_BOX_HEADER_SIZE;
+}
+
+static gboolean
+cursor_init(Mp4TableCursor *cursor, const Mp4Box *box)
+{
+  const guint8 *payload = NULL;
+  guint64 size = 0;
+
+  memset(cursor, 0, sizeof(*cursor));
+  // A missing table gives zero for all samples.
+  if (!box) return TRUE;
+
+  payload = full_box_payload(box, 4, &size);
+  if (!payload) return FALSE;
+  cursor->num_entries = GST_READ_UINT32_BE(payload);
+  if ((size - 4) / 8 < cursor->num_entries) return FALSE;
+  cursor->entries = payload + 4;
+  if (cursor->num_entries > 0) cursor->samples_left = GST_READ_UINT32_BE(cursor->entries);
+
+  return TRUE;
+}
+
+/* Returns the value of the next sample, or zero if the table has run out. */
+static guint32
+cursor_next(Mp4TableCursor *cursor)
+{
+  while (cursor->samples_left == 0) {
+    if (cursor->entry + 1 >= cursor->num_entries) return 0;
+    cursor->entry++;
+    cursor->samples_left = GST_READ_UINT32_BE(cursor->entries + 8 * cursor->entry);
+  }
+  cursor->samples_left--;
+
+  return GST_READ_UINT32_BE(cursor->entries + 8 * cursor->entry + 4);
+}
+
+/* Reads the sample sizes of |track|. The samples have to fit in the |file_size| bytes of the file,
+ * since a constant sample size leaves the number of samples unchecked by the table. */
+static gboolean
+load_sample_sizes(Mp4Track *track, guint64 file_size)
+{
+  guint64 size = 0;
+  const guint8 *payload = full_box_payload(track->stsz, 8, &size);
+
+  if (!payload) return FALSE;
+
+  const guint32 sample_size = GST_READ_UINT32_BE(payload);
+  track->num_samples = GST_READ_UINT32_BE(payload + 4);
+  if (sample_size == 0 && (size - 8) / 4 < track->num_samples) return FALSE;
+  if (sample_size != 0 && (guint64)track->num_samples * sample_size > file_size) return FALSE;
+
+  track->sample_sizes = g_new(guint32, track->num_samples);
+  for (guint32 i = 0; i < track->num_samples; i++) {
+    track->sample_sizes[i] =
+        sample_size != 0 ? sample_size : GST_READ_UINT32_BE(payload + 8 + 4 * i);
+  }
+
+  return TRUE;
+}
+
+/* Reads the chunk offsets and expands the sample-to-chunk table to the number of samples in each
+ * chunk. */
+static gboolean
+load_chunks(Mp4Track *track)
+{
+  const guint entry_size = track->use_co64 ? 8 : 4;
+  guint64 size = 0;
+  const guint8 *payload = full_box_payload(track->stco, 4, &size);
+  guint64 total_samples = 0;
+
+  if (!payload) return FALSE;
+  track->num_chunks = GST_READ_UINT32_BE(payload);
+  if ((size - 4) / entry_size < track->num_chunks) return FALSE;
+
+  track->chunk_offsets = g_new(guint64, track->num_chunks);
+  track->new_chunk_offsets = g_new0(guint64, track->num_chunks);
+  track->chunk_samples = g_new0(guint32, track->num_chunks);
+  track->chunk_first_sample = g_new0(guint32, track->num_chunks);
+  for (guint32 i = 0; i < track->num_chunks; i++) {
+    const guint8 *entry = payload + 4 + (guint64)entry_size * i;
+    track->chunk_offsets[i] =
+        track->use_co64 ? GST_READ_UINT64_BE(entry) : GST_READ_UINT32_BE(entry);
+  }
+
+  payload = full_box_payload(track->stsc, 4, &size);
+  if (!payload) return FALSE;
+  const guint32 num_entries = GST_READ_UINT32_BE(payload);
+  if ((size - 4) / 12 < num_entries) return FALSE;
+
+  for (guint32 i = 0; i < num_entries; i++) {
+    const guint8 *entry = payload + 4 + 12 * (guint64)i;
+    // The first chunk of each entry is 1-based and the entry runs until the next entry.
+    const guint64 first_chunk = GST_READ_UINT32_BE(entry);
+    const guint64 next_first_chunk =
+        i + 1 < num_entries ? GST_READ_UINT32_BE(entry + 12) : (guint64)track->num_chunks + 1;
+    const guint32 samples_per_chunk = GST_READ_UINT32_BE(entry + 4);
+
+    if (first_chunk == 0 || next_first_chunk <= first_chunk) return FALSE;
+    for (guint64 chunk = first_chunk - 1; chunk < next_first_chunk - 1; chunk++) {
+      if (chunk >= track->num_chunks) break;
+      track->chunk_samples[chunk] = samples_per_chunk;
+    }
+  }
+
+  for (guint32 i = 0; i < track->num_chunks; i++) {
+    track->chunk_first_sample[i] = (guint32)total_samples;
+    total_samples += track->chunk_samples[i];
+    if (total_samples > track->num_samples) return FALSE;
+  }
+
+  return total_samples == track->num_samples;
+}
+
+static gboolean
+load_track(const Mp4Box *trak, Mp4Track *track, guint64 file_size)
+{
+  const guint8 *payload = NULL;
+  guint64 size = 0;
+  Mp4Box *mdia = find_child(trak, BOX_MDIA);
+  Mp4Box *mdhd = find_child(mdia, BOX_MDHD);
+  Mp4Box *hdlr = find_child(mdia, BOX_HDLR);
+  Mp4Box *stbl = find_child(find_child(mdia, BOX_MINF), BOX_STBL);
+
+  if (!mdhd || !hdlr || !stbl) return FALSE;
+
+  // The timescale follows the creation and modification times, which are 64 bits in version 1.
+  payload = full_box_payload(mdhd, 20, &size);
+  if (!payload) return FALSE;
+  track->timescale = GST_READ_UINT32_BE(payload + (mdhd->data[mdhd->header_size] == 1 ? 16 : 8));
+
+  // The handler type follows a pre-defined field.
+  payload = full_box_payload(hdlr, 8, &size);
+  if (!payload) return FALSE;
+  track->handler = GST_READ_UINT32_BE(payload + 4);
+
+  track->stsd = find_child(stbl, BOX_STSD);
+  track->stts = find_child(stbl, BOX_STTS);
+  track->ctts = find_child(stbl, BOX_CTTS);
+  track->stsc = find_child(stbl, BOX_STSC);
+  track->stsz = find_child(stbl, BOX_STSZ);
+  track->stco = find_child(stbl, BOX_STCO);
+  if (!track->stco) track->stco = find_child(stbl, BOX_CO64);
+  // Compact sample sizes (stz2) are not handled.
+  if (!track->stsd || !track->stsc || !track->stsz || !track->stco) return FALSE;
+  track->use_co64 = track->stco->type == BOX_CO64;
+
+  return load_sample_sizes(track, file_size) && load_chunks(track);
+}
+
+/* Gets the codec of |track| from its sample description, and checks that its nalus have 4 byte
+ * length prefixes. */
+static gboolean
+get_video_codec(Mp4Signer *self, const Mp4Track *track, SignedVideoCodec *codec)
+{
+  guint64 size = 0;
+  const guint8 *payload = full_box_payload(track->stsd, 4, &size);
+  Mp4Box entry = {0};
+  guint32 config_type = 0;
+  guint length_size_offset = 0;
+
+  if (!payload || GST_READ_UINT32_BE(payload) != 1) {
+    self->reason = "the video track has more than one sample description";
+    return FALSE;
+  }
+  if (!parse_box_header(payload + 4, size - 4, &entry)) {
+    self->reason = "the sample description could not be parsed";
+    return FALSE;
+  }
+
+  switch (entry.type) {
+    case FOURCC('a', 'v', 'c', '1'):
+    case FOURCC('a', 'v', 'c', '3'):
+      *codec = SV_CODEC_H264;
+      config_type = BOX_AVCC;
+      length_size_offset = 4;
+      break;
+    case FOURCC('h', 'v', 'c', '1'):
+    case FOURCC('h', 'e', 'v', '1'):
+      *codec = SV_CODEC_H265;
+      config_type = BOX_HVCC;
+      length_size_offset = 21;
+      break;
+    default:
+      self->reason = "the video codec is not H264 or H265";
+      return FALSE;
+  }
+
+  // Look for the decoder configuration among the child boxes of the sample entry.
+  guint64 pos = entry.header_size + VISUAL_SAMPLE_ENTRY_SIZE;
+  while (pos < entry.size) {
+    Mp4Box child = {0};
+
+    if (!parse_box_header(entry.data + pos, entry.size - pos, &child)) break;
+    if (child.type == config_type) {
+      if (child.size - child.header_size <= length_size_offset) break;
+      if ((child.data[child.header_size + length_size_offset] & 0x03) + 1 != NALU_LENGTH_SIZE) {
+        self->reason = "the nalu length size is not 4 bytes";
+        return FALSE;
+      }
+      return TRUE;
+    }
+    pos += child.size;
+  }
+
+  self->reason = "the decoder configuration is missing";
+  return FALSE;
+}
+
+/* Parses the boxes of the mapped input and finds the video track. */
+static gboolean
+parse_file(Mp4Signer *self)
+{
+  self->boxes = g_ptr_array_new_with_free_func(box_free);
+  self->tracks = g_ptr_array_new_with_free_func(track_free);
+  if (!parse_boxes(self->data, self->size, self->boxes)) {
+    self->reason = "the boxes could not be parsed";
+    return FALSE;
+  }
+
+  for (guint i = 0; i < self->boxes->len; i++) {
+    Mp4Box *box = g_ptr_array_index(self->boxes, i);
+
+    if (box->type == BOX_MOOF) {
+      self->reason = "fragmented files are not handled";
+      return FALSE;
+    }
+    if (box->type == BOX_MOOV && !self->moov) self->moov = box;
+    if (box->type == BOX_MDAT && !self->mdat) self->mdat = box;
+  }
+  if (!self->moov || !self->mdat) {
+    self->reason = "moov or mdat is missing";
+    return FALSE;
+  }
+
+  for (guint i = 0; i < self->moov->children->len; i++) {
+    Mp4Box *trak = g_ptr_array_index(self->moov->children, i);
+    Mp4Track *track = NULL;
+
+    if (trak->type != BOX_TRAK) continue;
+    track = g_new0(Mp4Track, 1);
+    g_ptr_array_add(self->tracks, track);
+    if (!load_track(trak, track, self->size)) {
+      self->reason = "the sample tables could not be parsed";
+      return FALSE;
+    }
+    if (track->handler == HANDLER_VIDEO && !self->video) {
+      if (!get_video_codec(self, track, &self->codec)) return FALSE;
+      self->video = track;
+    }
+  }
+  if (!self->video || self->video->num_samples == 0) {
+    self->reason = "there is no video to sign";
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Fetches all SEIs available from the lib and records them as insertions in front of |offset| in
+ * |sample|. The SEIs are added for signing, like any other nalu, unless at the end of the
+ * stream. */
+static gboolean
+get_and_add_seis(Mp4Signer *self, guint32 sample, guint32 offset, const guint8 *peek_nalu,
+    gsize peek_nalu_size, const gint64 *timestamp_usec)
+{
+  SignedVideoReturnCode sv_rc;
+  Mp4Track *video = self->video;
+  Mp4Insertion insertion = {sample, offset, NULL, 0};
+
+  sv_rc = signed_video_get_sei(self->sv, &insertion.sei, &insertion.sei_size, NULL, peek_nalu,
+      peek_nalu_size, NULL);
+  while (sv_rc == SV_OK && insertion.sei && insertion.sei_size > NALU_LENGTH_SIZE) {
+    // The samples are length prefixed, hence replace the start code with the size.
+    GST_WRITE_UINT32_BE(insertion.sei, insertion.sei_size - NALU_LENGTH_SIZE);
+    g_array_append_val(self->insertions, insertion);
+    if (video->new_sample_sizes[sample] > G_MAXUINT32 - insertion.sei_size) return FALSE;
+    video->new_sample_sizes[sample] += insertion.sei_size;
+
+    if (timestamp_usec) {
+      sv_rc = signed_video_add_nalu_for_signing_with_timestamp(self->sv,
+          insertion.sei + NALU_LENGTH_SIZE, insertion.sei_size - NALU_LENGTH_SIZE, timestamp_usec);
+      if (sv_rc != SV_OK) break;
+    }
+    insertion.sei = NULL;
+    insertion.sei_size = 0;
+    sv_rc = signed_video_get_sei(self->sv, &insertion.sei, &insertion.sei_size, NULL, peek_nalu,
+        peek_nalu_size, NULL);
+  }
+  g_free(insertion.sei);
+
+  return sv_rc == SV_OK;
+}
+
+static gboolean
+sign_sample(Mp4Signer *self, guint32 sample, const guint8 *data, guint32 size,
+    gint64 timestamp_usec)
+{
+  guint32 pos = 0;
+
+  while (pos < size) {
+    if (size - pos < NALU_LENGTH_SIZE) return FALSE;
+
+    const guint32 nalu_size = GST_READ_UINT32_BE(data + pos);
+    const guint8 *nalu = data + pos + NALU_LENGTH_SIZE;
+    if (nalu_size > size - pos - NALU_LENGTH_SIZE) return FALSE;
+
+    // Pull the SEIs ready to be sent before adding the current nalu, as the signing element does.
+    if (!get_and_add_seis(self, sample, pos, nalu, nalu_size, &timestamp_usec)) return FALSE;
+    if (signed_video_add_nalu_for_signing_with_timestamp(
+            self->sv, nalu, nalu_size, &timestamp_usec) != SV_OK) {
+      return FALSE;
+    }
+    pos += NALU_LENGTH_SIZE + nalu_size;
+  }
+
+  return TRUE;
+}
+
+/* Feeds all samples of the video track to the Signed Video lib in decode order. */
+static Mp4SignerResult
+sign_video_track(Mp4Signer *self, const GstSigningKey *key)
+{
+  Mp4Track *video = self->video;
+  Mp4TableCursor stts;
+  Mp4TableCursor ctts;
+  guint64 decode_time = 0;
+  guint32 sample = 0;
+
+  if (!cursor_init(&stts, video->stts) || !cursor_init(&ctts, video->ctts)) {
+    self->reason = "the time to sample tables could not be parsed";
+    return MP4_SIGNER_UNSUPPORTED;
+  }
+
+  self->sv = gst_signing_session_new(self->codec, key, NULL);
+  if (!self->sv) return MP4_SIGNER_ERROR;
+
+  self->insertions = g_array_new(FALSE, FALSE, sizeof(Mp4Insertion));
+  video->new_sample_sizes = g_new(guint32, video->num_samples);
+  memcpy(video->new_sample_sizes, video->sample_sizes, sizeof(guint32) * video->num_samples);
+  for (guint32 chunk = 0; chunk < video->num_chunks; chunk++) {
+    guint64 offset = video->chunk_offsets[chunk];
+
+    for (guint32 i = 0; i < video->chunk_samples[chunk]; i++, sample++) {
+      const guint32 size = video->sample_sizes[sample];
+      // Composition offsets are signed in version 1 of ctts, and in practice also in version 0.
+      const gint64 pts = (gint64)decode_time + (gint32)cursor_next(&ctts);
+      const gint64 timestamp_usec = video->timescale == 0 ?
+          0 :
+          (gint64)gst_util_uint64_scale(MAX(pts, 0), G_USEC_PER_SEC, video->timescale);
+
+      if (offset > self->size || size > self->size - offset) {
+        self->reason = "a sample is outside the file";
+        return MP4_SIGNER_UNSUPPORTED;
+      }
+      if (!sign_sample(self, sample, self->data + offset, size, timestamp_usec)) {
+        g_warning("failed to sign sample %u", sample);
+        return MP4_SIGNER_ERROR;
+      }
+      offset += size;
+      decode_time += cursor_next(&stts);
+    }
+  }
+
+  // The SEIs of the last GOP have no following nalu to go in front of, hence append them to the
+  // last sample.
+  if (signed_video_set_end_of_stream(self->sv) != SV_OK ||
+      !get_and_add_seis(
+          self, sample - 1, video->sample_sizes[sample - 1], NULL, 0, NULL)) {
+    g_warning("failed to get the SEIs at the end of the stream");
+    return MP4_SIGNER_ERROR;
+  }
+
+  // The insertions are recorded in sample order, so index the first one of each sample.
+  self->first_insertion = g_new0(guint32, video->num_samples + 1);
+  for (guint i = 0; i < self->insertions->len; i++) {
+    self->first_insertion[g_array_index(self->insertions, Mp4Insertion, i).sample + 1]++;
+  }
+  for (guint32 i = 0; i < video->num_samples; i++) {
+    self->first_insertion[i + 1] += self->first_insertion[i];
+  }
+
+  return MP4_SIGNER_OK;
+}
+
+static guint64
+chunk_size(const Mp4Track *track, guint32 chunk, gboolean output)
+{
+  const guint32 *sizes = output && track->new_sample_sizes ? track->new_sample_sizes :
+                                                              track->sample_sizes;
+  const guint32 first = track->chunk_first_sample[chunk];
+  guint64 size = 0;
+
+  for (guint32 i = first; i < first + track->chunk_samples[chunk]; i++) {
+    size += sizes[i];
+  }
+
+  return size;
+}
+
+static gint
+compare_chunks(gconstpointer a, gconstpointer b)
+{
+  const Mp4ChunkRef *chunk_a = a;
+  const Mp4ChunkRef *chunk_b = b;
+  const guint64 offset_a = chunk_a->track->chunk_offsets[chunk_a->chunk];
+  const guint64 offset_b = chunk_b->track->chunk_offsets[chunk_b->chunk];
+
+  return offset_a < offset_b ? -1 : (offset_a > offset_b ? 1 : 0);
+}
+
+/* Lists the chunks of all tracks in the order of the input file. */
+static void
+collect_chunks(Mp4Signer *self)
+{
+  self->chunks = g_array_new(FALSE, FALSE, sizeof(Mp4ChunkRef));
+  for (guint i = 0; i < self->tracks->len; i++) {
+    Mp4Track *track = g_ptr_array_index(self->tracks, i);
+
+    for (guint32 chunk = 0; chunk < track->num_chunks; chunk++) {
+      Mp4ChunkRef ref = {track, chunk};
+      g_array_append_val(self->chunks, ref);
+      self->mdat_payload_size += chunk_size(track, chunk, TRUE);
+    }
+  }
+  g_array_sort(self->chunks, compare_chunks);
+  self->mdat_header_size =
+      self->mdat_payload_size > G_MAXUINT32 - BOX_HEADER_SIZE ? BOX_HEADER_SIZE + 8 :
+                                                                BOX_HEADER_SIZE;
+}
+
+static GByteArray *
+new_full_box(guint32 type, guint64 payload_size)
+{
+  const guint64 size = BOX_HEADER_SIZE + FULL_BOX_HEADER_SIZE + payload_size;
+  GByteArray *box = g_byte_array_sized_new(size);
+
+  g_byte_array_set_size(box, size);
+  GST_WRITE_UINT32_BE(box->data, size);
+  GST_WRITE_UINT32_BE(box->data + 4, type);
+  // Version and flags.
+  GST_WRITE_UINT32_BE(box->data + BOX_HEADER_SIZE, 0);
+
+  return box;
+}
+
+static void
+rewrite_sample_sizes(Mp4Track *track)
+{
+  GByteArray *box = new_full_box(BOX_STSZ, 8 + 4 * (guint64)track->num_samples);
+  guint8 *payload = box->data + BOX_HEADER_SIZE + FULL_BOX_HEADER_SIZE;
+
+  // The sample sizes are no longer constant, so a sample size of zero and the full table.
+  GST_WRITE_UINT32_BE(payload, 0);
+  GST_WRITE_UINT32_BE(payload + 4, track->num_samples);
+  for (guint32 i = 0; i < track->num_samples; i++) {
+    GST_WRITE_UINT32_BE(payload + 8 + 4 * i, track->new_sample_sizes[i]);
+  }
+
+  if (track->stsz->rewritten) g_byte_array_free(track->stsz->rewritten, TRUE);
+  track->stsz->rewritten = box;
+}
+
+static void
+rewrite_chunk_offsets(Mp4Track *track)
+{
+  const guint entry_size = track->use_co64 ? 8 : 4;
+  GByteArray *box = new_full_box(
+      track->use_co64 ? BOX_CO64 : BOX_STCO, 4 + (guint64)entry_size * track->num_chunks);
+  guint8 *payload = box->data + BOX_HEADER_SIZE + FULL_BOX_HEADER_SIZE;
+
+  GST_WRITE_UINT32_BE(payload, track->num_chunks);
+  for (guint32 i = 0; i < track->num_chunks; i++) {
+    guint8 *entry = payload + 4 + (guint64)entry_size * i;
+    if (track->use_co64) {
+      GST_WRITE_UINT64_BE(entry, track->new_chunk_offsets[i]);
+    } else {
+      GST_WRITE_UINT32_BE(entry, (guint32)track->new_chunk_offsets[i]);
+    }
+  }
+
+  if (track->stco->rewritten) g_byte_array_free(track->stco->rewritten, TRUE);
+  track->stco->rewritten = box;
+}
+
+static guint64
+box_output_size(const Mp4Box *box)
+{
+  guint64 size = BOX_HEADER_SIZE;
+
+  if (box->rewritten) return box->rewritten->len;
+  if (!box->children) return box->size;
+
+  for (guint i = 0; i < box->children->len; i++) {
+    size += box_output_size(g_ptr_array_index(box->children, i));
+  }
+
+  return size;
+}
+
+/* Serializes |box| as it is written to the output. Container boxes get a 32 bit size, which is
+ * enough for anything but mdat. */
+static void
+serialize_box(GByteArray *out, const Mp4Box *box)
+{
+  guint8 header[BOX_HEADER_SIZE];
+
+  if (box->rewritten) {
+    g_byte_array_append(out, box->rewritten->data, box->rewritten->len);
+    return;
+  }
+  if (!box->children) {
+    g_byte_array_append(out, box->data, box->size);
+    return;
+  }
+
+  GST_WRITE_UINT32_BE(header, box_output_size(box));
+  GST_WRITE_UINT32_BE(header + 4, box->type);
+  g_byte_array_append(out, header, sizeof(header));
+  for (guint i = 0; i < box->children->len; i++) {
+    serialize_box(out, g_ptr_array_index(box->children, i));
+  }
+}
+
+/* Sets the output chunk offsets and rewrites the sample tables. The offsets depend on the size of
+ * moov if it comes before mdat, and the size of moov depends on whether the offsets fit in stco.
+ * Hence, tracks are switched to co64 until the offsets fit, which ends after at most one round per
+ * track. */
+static void
+layout_output(Mp4Signer *self)
+{
+  gboolean done = FALSE;
+
+  rewrite_sample_sizes(self->video);
+  while (!done) {
+    guint64 mdat_offset = 0;
+    guint64 offset = 0;
+
+    for (guint i = 0; i < self->tracks->len; i++) {
+      rewrite_chunk_offsets(g_ptr_array_index(self->tracks, i));
+    }
+    for (guint i = 0; i < self->boxes->len; i++) {
+      Mp4Box *box = g_ptr_array_index(self->boxes, i);
+
+      if (box == self->mdat) break;
+      // Any other mdat is dropped.
+      if (box->type != BOX_MDAT) mdat_offset += box_output_size(box);
+    }
+
+    offset = mdat_offset + self->mdat_header_size;
+    for (guint i = 0; i < self->chunks->len; i++) {
+      Mp4ChunkRef *ref = &g_array_index(self->chunks, Mp4ChunkRef, i);
+      ref->track->new_chunk_offsets[ref->chunk] = offset;
+      offset += chunk_size(ref->track, ref->chunk, TRUE);
+    }
+
+    done = TRUE;
+    for (guint i = 0; i < self->tracks->len; i++) {
+      Mp4Track *track = g_ptr_array_index(self->tracks, i);
+
+      if (track->use_co64 || track->num_chunks == 0) continue;
+      if (track->new_chunk_offsets[track->num_chunks - 1] > G_MAXUINT32) {
+        track->use_co64 = TRUE;
+        done = FALSE;
+      }
+    }
+  }
+
+  // Write the final offsets.
+  for (guint i = 0; i < self->tracks->len; i++) {
+    rewrite_chunk_offsets(g_ptr_array_index(self->tracks, i));
+  }
+}
+
+static gboolean
+write_data(Mp4Signer *self, const guint8 *data, guint64 size)
+{
+  if (size == 0) return TRUE;
+  if (fwrite(data, 1, size, self->out) != size) return FALSE;
+  self->bytes_written += size;
+
+  return TRUE;
+}
+
+/* Copies the samples of a chunk of the video track, splicing in the SEIs. */
+static gboolean
+write_video_chunk(Mp4Signer *self, guint32 chunk)
+{
+  const Mp4Track *video = self->video;
+  const guint8 *data = self->data + video->chunk_offsets[chunk];
+  const guint32 first = video->chunk_first_sample[chunk];
+
+  for (guint32 sample = first; sample < first + video->chunk_samples[chunk]; sample++) {
+    guint32 pos = 0;
+
+    for (guint i = self->first_insertion[sample]; i < self->first_insertion[sample + 1]; i++) {
+      const Mp4Insertion *insertion = &g_array_index(self->insertions, Mp4Insertion, i);
+
+      if (!write_data(self, data + pos, insertion->offset - pos) ||
+          !write_data(self, insertion->sei, insertion->sei_size)) {
+        return FALSE;
+      }
+      pos = insertion->offset;
+    }
+    if (!write_data(self, data + pos, video->sample_sizes[sample] - pos)) return FALSE;
+    data += video->sample_sizes[sample];
+  }
+
+  return TRUE;
+}
+
+static gboolean
+write_mdat(Mp4Signer *self)
+{
+  guint8 header[BOX_HEADER_SIZE + 8];
+  const guint64 size = self->mdat_header_size + self->mdat_payload_size;
+
+  if (self->mdat_header_size == BOX_HEADER_SIZE) {
+    GST_WRITE_UINT32_BE(header, size);
+  } else {
+    GST_WRITE_UINT32_BE(header, 1);
+    GST_WRITE_UINT64_BE(header + BOX_HEADER_SIZE, size);
+  }
+  GST_WRITE_UINT32_BE(header + 4, BOX_MDAT);
+  if (!write_data(self, header, self->mdat_header_size)) return FALSE;
+
+  for (guint i = 0; i < self->chunks->len; i++) {
+    const Mp4ChunkRef *ref = &g_array_index(self->chunks, Mp4ChunkRef, i);
+    const guint64 offset = ref->track->chunk_offsets[ref->chunk];
+    const guint64 size = chunk_size(ref->track, ref->chunk, FALSE);
+
+    if (ref->track == self->video) {
+      if (!write_video_chunk(self, ref->chunk)) return FALSE;
+      continue;
+    }
+    if (offset > self->size || size > self->size - offset) return FALSE;
+    if (!write_data(self, self->data + offset, size)) return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+write_output(Mp4Signer *self, const gchar *outfilename)
+{
+  gboolean success = FALSE;
+
+  self->out = g_fopen(outfilename, "wb");
+  if (!self->out) {
+    g_warning("failed to open '%s' for writing", outfilename);
+    return FALSE;
+  }
+  // Large writes, since most of the output is copied straight from the mapped input.
+  setvbuf(self->out, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+  for (guint i = 0; i < self->boxes->len; i++) {
+    const Mp4Box *box = g_ptr_array_index(self->boxes, i);
+
+    if (box == self->moov) {
+      GByteArray *moov = g_byte_array_sized_new(box_output_size(box));
+
+      serialize_box(moov, box);
+      success = write_data(self, moov->data, moov->len);
+      g_byte_array_free(moov, TRUE);
+    } else if (box == self->mdat) {
+      success = write_mdat(self);
+    } else if (box->type == BOX_MDAT) {
+      success = TRUE;
+    } else {
+      success = write_data(self, box->data, box->size);
+    }
+    if (!success) break;
+  }
+
+  if (fclose(self->out) != 0) success = FALSE;
+  self->out = NULL;
+  if (!success) g_warning("failed to write '%s'", outfilename);
+
+  return success;
+}
+
+Mp4SignerResult
+mp4_signer_sign_file(const gchar *filename, const gchar *outfilename, const GstSigningKey *key,
+    guint64 *bytes_written)
+{
+  Mp4SignerResult result = MP4_SIGNER_ERROR;
+  Mp4Signer self = {0};
+  GError *error = NULL;
+  GMappedFile *mapped_file = NULL;
+
+  g_return_val_if_fail(filename && outfilename && key, MP4_SIGNER_ERROR);
+
+  mapped_file = g_mapped_file_new(filename, FALSE, &error);
+  if (!mapped_file) {
+    g_warning("failed to map '%s': %s", filename, error->message);
+    g_error_free(error);
+    goto out;
+  }
+  self.data = (const guint8 *)g_mapped_file_get_contents(mapped_file);
+  self.size = g_mapped_file_get_length(mapped_file);
+
+  if (!parse_file(&self)) {
+    result = MP4_SIGNER_UNSUPPORTED;
+    goto out;
+  }
+  result = sign_video_track(&self, key);
+  if (result != MP4_SIGNER_OK) goto out;
+
+  collect_chunks(&self);
+  layout_output(&self);
+  if (!write_output(&self, outfilename)) {
+    result = MP4_SIGNER_ERROR;
+    goto out;
+  }
+  if (bytes_written) *bytes_written = self.bytes_written;
+  g_message("Signed '%s' with %u SEIs", filename, self.insertions->len);
+
+out:
+  if (result == MP4_SIGNER_UNSUPPORTED) {
+    g_message("'%s' cannot be signed natively: %s", filename, self.reason ? self.reason : "");
+  }
+  if (self.insertions) {
+    for (guint i = 0; i < self.insertions->len; i++) {
+      g_free(g_array_index(self.insertions, Mp4Insertion, i).sei);
+    }
+    g_array_free(self.insertions, TRUE);
+  }
+  if (self.sv) signed_video_free(self.sv);
+  g_free(self.first_insertion);
+  if (self.chunks) g_array_free(self.chunks, TRUE);
+  if (self.tracks) g_ptr_array_free(self.tracks, TRUE);
+  if (self.boxes) g_ptr_array_free(self.boxes, TRUE);
+  if (mapped_file) g_mapped_file_unref(mapped_file);
+
+  return result;
+}
@@ -0,0 +1,52 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MP4_SIGNER_H__
+#define __MP4_SIGNER_H__
+
+#include <glib.h>
+
+#include "gst-plugin/gstsigning_keystore.h"
+
+G_BEGIN_DECLS
+
+typedef enum {
+  MP4_SIGNER_OK = 0,
+  MP4_SIGNER_UNSUPPORTED,  // The file layout is not handled, sign through GStreamer instead
+  MP4_SIGNER_ERROR,
+} Mp4SignerResult;
+
+/* Signs the video track of the MP4 file |filename| with |key| without demuxing and remuxing it.
+ *
+ * The input is memory-mapped and the samples of the video track are fed to the Signed Video lib
+ * one nalu at a time. The SEIs are spliced into the samples and the output is written to
+ * |outfilename| in one pass, with the same boxes as the input except for updated sample sizes
+ * (stsz) and chunk offsets (stco/co64). Fragmented files, AV1 and nalu length sizes other than
+ * four bytes are not handled and return MP4_SIGNER_UNSUPPORTED, in which case nothing is written.
+ *
+ * If |bytes_written| is not NULL it is set to the size of the output file. */
+Mp4SignerResult
+mp4_signer_sign_file(const gchar *filename, const gchar *outfilename, const GstSigningKey *key,
+    guint64 *bytes_written);
+
+G_END_DECLS
+
+#endif  // __MP4_SIGNER_H__
@@ -0,0 +1,265 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * This test signs a raw H264 byte-stream while it is being recorded, i.e., the follow mode, -f,
+ * of the signer.
+ *
+ * A stand-in recorder demuxes an MP4 file to an Annex-B byte-stream and appends it, a chunk at a
+ * time, to a file in a temporary directory, while the signer follows that file. The chunks are not
+ * aligned with the nalus, hence the signer also reads nalus which are only partly written. When all
+ * is written the recorder creates the close marker, which has to end the signer well before its
+ * idle timeout. Finally, the signed output has to validate.
+ *
+ * Example to run the test
+ *   $ ./follow_signing path/to/signer path/to/validator test-files/test_h264.mp4
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>  // g_remove, g_rmdir
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+#include <stdio.h>  // FILE, fclose, fflush, fopen, fwrite
+#include <string.h>  // strstr
+#include <sys/wait.h>  // waitpid, WEXITSTATUS, WIFEXITED
+
+#define RECORDING_NAME "recording.h264"
+#define SIGNED_RECORDING_NAME "signed_" RECORDING_NAME
+// Written by the validator to its working directory.
+#define RESULTS_NAME "validation_results.txt"
+
+// Bytes appended to the recording at a time, and the pause in between. The signer polls every
+// 100 ms, hence it sees the recording grow many times.
+#define CHUNK_SIZE 3000
+#define CHUNK_INTERVAL_USEC (20 * 1000)
+// Seconds without growth before the signer ends the stream. The close marker has to come first.
+#define IDLE_TIMEOUT 30
+
+/* Appends |size| bytes of |data| to |out|, pausing every time |CHUNK_SIZE| bytes have been
+ * written. |unflushed| is the number of bytes written since the latest pause. */
+static gboolean
+append(FILE *out, const guint8 *data, gsize size, gsize *unflushed)
+{
+  while (size > 0) {
+    const gsize len = MIN(size, CHUNK_SIZE - *unflushed);
+
+    if (fwrite(data, 1, len, out) != len) return FALSE;
+    data += len;
+    size -= len;
+    *unflushed += len;
+    if (*unflushed == CHUNK_SIZE) {
+      if (fflush(out) != 0) return FALSE;
+      *unflushed = 0;
+      g_usleep(CHUNK_INTERVAL_USEC);
+    }
+  }
+
+  return TRUE;
+}
+
+/* Appends the H264 stream of the MP4 file |input| to |filename| as an Annex-B byte-stream, as a
+ * recorder would. Returns TRUE on success. */
+static gboolean
+record(const gchar *input, const gchar *filename)
+{
+  gboolean success = FALSE;
+  GError *error = NULL;
+  gchar *pipeline_str = NULL;
+  GstElement *pipeline = NULL;
+  GstElement *sink = NULL;
+  GstSample *sample = NULL;
+  gsize unflushed = 0;
+  FILE *out = NULL;
+
+  out = fopen(filename, "ab");
+  if (!out) {
+    g_warning("failed to open '%s'", filename);
+    goto out;
+  }
+  pipeline_str = g_strdup_printf("filesrc location=\"%s\" ! qtdemux ! h264parse ! "
+                                 "video/x-h264,stream-format=byte-stream,alignment=au ! "
+                                 "appsink name=recordersink sync=false",
+      input);
+  pipeline = gst_parse_launch(pipeline_str, &error);
+  if (!pipeline) {
+    g_warning("failed to create the recorder pipeline: %s", error->message);
+    goto out;
+  }
+  sink = gst_bin_get_by_name(GST_BIN(pipeline), "recordersink");
+  if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_warning("failed to start the recorder pipeline");
+    goto out;
+  }
+
+  while ((sample = gst_app_sink_pull_sample(GST_APP_SINK(sink)))) {
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    gboolean written = FALSE;
+
+    if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+      written = append(out, map.data, map.size, &unflushed);
+      gst_buffer_unmap(buffer, &map);
+    }
+    gst_sample_unref(sample);
+    if (!written) {
+      g_warning("failed to append to '%s'", filename);
+      goto out;
+    }
+  }
+  // No more samples is also what an error in the pipeline looks like.
+  if (!gst_app_sink_is_eos(GST_APP_SINK(sink))) {
+    g_warning("failed to read '%s' to the end", input);
+    goto out;
+  }
+
+  success = TRUE;
+out:
+  if (out && fclose(out) != 0) success = FALSE;
+  if (pipeline) gst_element_set_state(pipeline, GST_STATE_NULL);
+  if (sink) gst_object_unref(sink);
+  if (pipeline) gst_object_unref(pipeline);
+  if (error) g_error_free(error);
+  g_free(pipeline_str);
+
+  return success;
+}
+
+/* Removes |dir| and the files in it. */
+static void
+remove_dir(const gchar *dir)
+{
+  GDir *handle = g_dir_open(dir, 0, NULL);
+  const gchar *name = NULL;
+
+  while (handle && (name = g_dir_read_name(handle))) {
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_remove(path);
+    g_free(path);
+  }
+  if (handle) g_dir_close(handle);
+  g_rmdir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+  int status = 1;
+  GError *error = NULL;
+  gchar *dir = NULL;
+  gchar *recording = NULL;
+  gchar *marker = NULL;
+  gchar *results = NULL;
+  gchar *results_contents = NULL;
+  gchar *signer_argv[] = {NULL, "-f", "-t", G_STRINGIFY(IDLE_TIMEOUT), RECORDING_NAME, NULL};
+  gchar *validator_argv[] = {NULL, "-c", "h264", SIGNED_RECORDING_NAME, NULL};
+  GPid signer_pid = 0;
+  int wait_status = 0;
+  gint64 marker_time = 0;
+  gint64 signer_seconds = 0;
+  gboolean recorded = FALSE;
+
+  if (argc != 4) {
+    g_warning("Usage: %s signer validator input.mp4", argv[0]);
+    return 1;
+  }
+  signer_argv[0] = argv[1];
+  validator_argv[0] = argv[2];
+  if (!gst_init_check(NULL, NULL, &error)) {
+    g_warning("gst_init failed: %s", error->message);
+    goto out;
+  }
+  dir = g_dir_make_tmp("follow_signing_XXXXXX", &error);
+  if (!dir) {
+    g_warning("failed to create a temporary directory: %s", error->message);
+    goto out;
+  }
+  recording = g_build_filename(dir, RECORDING_NAME, NULL);
+  marker = g_strconcat(recording, ".done", NULL);
+  results = g_build_filename(dir, RESULTS_NAME, NULL);
+
+  // The signer opens the recording once, hence it has to exist before the signer starts.
+  if (!g_file_set_contents(recording, "", 0, &error)) {
+    g_warning("failed to create '%s': %s", recording, error->message);
+    goto out;
+  }
+  if (!g_spawn_async(dir, signer_argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &signer_pid,
+          &error)) {
+    g_warning("failed to start the signer: %s", error->message);
+    goto out;
+  }
+
+  recorded = record(argv[3], recording);
+  // Also a failed recording is closed, hence the signer ends either way.
+  if (!g_file_set_contents(marker, "", 0, &error)) {
+    g_warning("failed to create '%s': %s", marker, error->message);
+    g_clear_error(&error);
+  }
+  marker_time = g_get_monotonic_time();
+  if (waitpid(signer_pid, &wait_status, 0) < 0) {
+    g_warning("failed to wait for the signer");
+    goto out;
+  }
+  g_spawn_close_pid(signer_pid);
+  signer_pid = 0;
+  signer_seconds = (g_get_monotonic_time() - marker_time) / G_USEC_PER_SEC;
+  if (!recorded) goto out;
+  if (!WIFEXITED(wait_status) || WEXITSTATUS(wait_status) != 0) {
+    g_warning("the signer failed");
+    goto out;
+  }
+  if (signer_seconds >= IDLE_TIMEOUT) {
+    g_warning("the signer did not end at the close marker, but after %" G_GINT64_FORMAT " s",
+        signer_seconds);
+    goto out;
+  }
+
+  if (!g_spawn_sync(dir, validator_argv, NULL, G_SPAWN_DEFAULT, NULL, NULL, NULL, NULL,
+          &wait_status, &error)) {
+    g_warning("failed to run the validator: %s", error->message);
+    goto out;
+  }
+  if (!WIFEXITED(wait_status) || WEXITSTATUS(wait_status) != 0) {
+    g_warning("the validator failed");
+    goto out;
+  }
+  if (!g_file_get_contents(results, &results_contents, NULL, &error)) {
+    g_warning("failed to read '%s': %s", results, error->message);
+    goto out;
+  }
+  if (!strstr(results_contents, "VIDEO IS VALID!\n")) {
+    g_warning("the signed recording did not validate:\n%s", results_contents);
+    goto out;
+  }
+  g_message("The followed recording was signed and validates");
+
+  status = 0;
+out:
+  if (signer_pid) g_spawn_close_pid(signer_pid);
+  if (dir) remove_dir(dir);
+  if (error) g_error_free(error);
+  g_free(results_contents);
+  g_free(results);
+  g_free(marker);
+  g_free(recording);
+  g_free(dir);
+
+  return status;
+}
@@ -0,0 +1,470 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Validation of a batch of files on a pool of worker threads. Each worker validates one file at a
+ * time, start to end. Files are read by the built-in container reader if possible, otherwise by a
+ * pipeline with its own main context, so the workers do not share anything but the options.
+ *
+ * A file stops being validated if it takes longer than the time limit, or if more data than the
+ * memory limit has been added to its Signed Video session since its latest validated GOP, since
+ * the session keeps track of all nalus until they are validated.
+ */
+
+#include "batch_validation.h"
+
+#include <gst/gst.h>
+#include <stdio.h>  // FILE, fopen, fclose
+#include <string.h>  // strlen
+
+#include "checkpoint.h"
+#include "container_reader.h"
+#include "reporter.h"
+#include "sample_queue.h"
+#include "validation.h"
+
+typedef enum {
+  BATCH_STATUS_VALID = 0,
+  BATCH_STATUS_VALID_WITH_MISSING,
+  BATCH_STATUS_INVALID,
+  BATCH_STATUS_UNSIGNED,
+  BATCH_STATUS_NO_GOPS,
+  BATCH_STATUS_ERROR,
+  BATCH_STATUS_TIMEOUT,
+  BATCH_STATUS_MEMORY_LIMIT,
+} BatchStatus;
+
+static const gchar *kBatchStatusNames[] = {"valid", "valid_with_missing", "invalid", "unsigned",
+    "no_gops", "error", "timeout", "memory_limit"};
+
+typedef struct {
+  const BatchOptions *options;
+  guint index;
+  const gchar *filename;
+  gchar *results_file;
+
+  ValidationData *data;  // Only set while the file is validated
+  gint64 deadline;  // Monotonic time in microseconds
+  gint num_gops;  // Number of GOPs counted when |validated_bytes| was updated
+  gsize validated_bytes;  // Total bytes when the latest GOP was validated
+  bool limit_exceeded;  // Set when |status| is TIMEOUT or MEMORY_LIMIT
+  bool timed_out;  // Set by the timeout source of the pipeline
+  bool eos;
+
+  // Results.
+  BatchStatus status;
+  gint valid_gops;
+  gint valid_gops_with_missing;
+  gint invalid_gops;
+  gint no_sign_gops;
+  gsize total_bytes;
+  gsize sei_bytes;
+  gdouble seconds;
+  bool has_results_file;
+} BatchJob;
+
+/* Checks the limits of |job|. Returns false, and sets the status, if one has been exceeded. */
+static bool
+check_limits(BatchJob *job)
+{
+  const ValidationData *data = job->data;
+  gint num_gops =
+      data->valid_gops + data->valid_gops_with_missing + data->invalid_gops + data->no_sign_gops;
+
+  if (job->limit_exceeded) return false;
+
+  if (num_gops != job->num_gops) {
+    job->num_gops = num_gops;
+    job->validated_bytes = data->total_bytes;
+  }
+  if (job->options->memory_limit &&
+      data->total_bytes - job->validated_bytes > job->options->memory_limit) {
+    g_warning("'%s' exceeded the memory limit", job->filename);
+    job->status = BATCH_STATUS_MEMORY_LIMIT;
+    job->limit_exceeded = true;
+  } else if (g_get_monotonic_time() > job->deadline) {
+    g_warning("'%s' exceeded the time limit", job->filename);
+    job->status = BATCH_STATUS_TIMEOUT;
+    job->limit_exceeded = true;
+  }
+
+  return !job->limit_exceeded;
+}
+
+/* Called for every nalu, or OBU, read by the built-in container reader. */
+static gboolean
+on_nalu_from_reader(const guint8 *nalu, gsize nalu_size, gpointer user_data)
+{
+  BatchJob *job = (BatchJob *)user_data;
+
+  // Results are counted by the quiet reporter, hence nothing is returned.
+  g_free(validation_validate_nalu(job->data, nalu, nalu_size));
+
+  return check_limits(job);
+}
+
+/* Called from the validation thread of the pipeline of |job|. Stops the pipeline, with an error,
+ * if a limit has been exceeded. */
+static gboolean
+on_sample(GstAppSink *sink, GstSample *sample, gpointer user_data)
+{
+  BatchJob *job = (BatchJob *)user_data;
+
+  return validation_validate_sample(job->data, sink, sample) && check_limits(job);
+}
+
+/* Catches pipelines that stall without delivering any samples. */
+static gboolean
+on_timeout(gpointer user_data)
+{
+  BatchJob *job = (BatchJob *)user_data;
+
+  job->timed_out = true;
+  g_main_loop_quit(job->data->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+on_job_message(GstBus __attribute__((unused)) *bus, GstMessage *message, BatchJob *job)
+{
+  GError *error = NULL;
+
+  switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_EOS:
+      job->eos = true;
+      g_main_loop_quit(job->data->loop);
+      break;
+    case GST_MESSAGE_ERROR:
+      // Errors caused by an exceeded limit have already been reported.
+      if (!job->limit_exceeded) {
+        gst_message_parse_error(message, &error, NULL);
+        g_warning("failed to validate '%s': %s", job->filename, error->message);
+        g_error_free(error);
+      }
+      g_main_loop_quit(job->data->loop);
+      break;
+    default:
+      break;
+  }
+  return TRUE;
+}
+
+/* Validates the file of |job| with a pipeline run by a main loop of its own. Returns true if EOS
+ * was reached. */
+static bool
+run_pipeline(BatchJob *job)
+{
+  const BatchOptions *options = job->options;
+  ValidationData *data = job->data;
+  GMainContext *context = g_main_context_new();
+  GSource *timeout = NULL;
+  GstElement *validatorsink = NULL;
+  GstBus *bus = NULL;
+  gchar *pipeline = NULL;
+
+  // The bus watch and the timeout are attached to the context of this worker.
+  g_main_context_push_thread_default(context);
+
+  pipeline = validation_pipeline_description(job->filename, options->codec, options->codec_str);
+  data->loop = g_main_loop_new(context, FALSE);
+  data->source = gst_parse_launch(pipeline, NULL);
+  if (!data->source) {
+    g_warning("failed to create pipeline: %s", pipeline);
+    goto out;
+  }
+  bus = gst_element_get_bus(data->source);
+  gst_bus_add_watch(bus, (GstBusFunc)on_job_message, job);
+
+  validatorsink = gst_bin_get_by_name(GST_BIN(data->source), "validatorsink");
+  g_object_set(G_OBJECT(validatorsink), "sync", FALSE, NULL);
+  data->queue =
+      sample_queue_new(GST_APP_SINK(validatorsink), SAMPLE_QUEUE_CAPACITY, on_sample, job);
+  gst_object_unref(validatorsink);
+
+  if (options->time_limit) {
+    timeout = g_timeout_source_new_seconds(options->time_limit);
+    g_source_set_callback(timeout, on_timeout, job, NULL);
+    g_source_attach(timeout, context);
+  }
+
+  if (gst_element_set_state(data->source, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_warning("failed to start up pipeline of '%s'", job->filename);
+    gst_element_set_state(data->source, GST_STATE_NULL);
+    goto out;
+  }
+  g_main_loop_run(data->loop);
+  // Also joins the streaming thread. The queued samples are validated before the limits are
+  // checked, hence |job| is no longer touched by either thread.
+  gst_element_set_state(data->source, GST_STATE_NULL);
+  sample_queue_finish(data->queue);
+
+  if (job->timed_out && !job->limit_exceeded) {
+    g_warning("'%s' exceeded the time limit", job->filename);
+    job->status = BATCH_STATUS_TIMEOUT;
+    job->limit_exceeded = true;
+  }
+
+out:
+  if (timeout) {
+    g_source_destroy(timeout);
+    g_source_unref(timeout);
+  }
+  if (bus) {
+    gst_bus_remove_watch(bus);
+    gst_object_unref(bus);
+  }
+  if (data->source) gst_object_unref(data->source);
+  data->source = NULL;
+  g_main_loop_unref(data->loop);
+  data->loop = NULL;
+  g_main_context_pop_thread_default(context);
+  g_main_context_unref(context);
+  g_free(pipeline);
+
+  return job->eos;
+}
+
+/* Gets the status of a validated file from its counters, as summarized in its results file. */
+static BatchStatus
+status_from_counters(const BatchJob *job)
+{
+  if (job->invalid_gops > 0) return BATCH_STATUS_INVALID;
+  if (job->valid_gops_with_missing > 0) return BATCH_STATUS_VALID_WITH_MISSING;
+  if (job->valid_gops > 0) return BATCH_STATUS_VALID;
+  if (job->no_sign_gops > 0 || (job->total_bytes > 0 && job->sei_bytes == 0)) {
+    return BATCH_STATUS_UNSIGNED;
+  }
+  return BATCH_STATUS_NO_GOPS;
+}
+
+/* Worker function of the thread pool. */
+static void
+validate_file(gpointer job_data, gpointer __attribute__((unused)) user_data)
+{
+  BatchJob *job = (BatchJob *)job_data;
+  const BatchOptions *options = job->options;
+  const gchar *demux_str = validation_demux_from_filename(job->filename);
+  ContainerReaderResult reader_result = CONTAINER_READER_UNSUPPORTED;
+  ContainerReader *reader = NULL;
+  Checkpoint *checkpoint = NULL;
+  gint64 start = g_get_monotonic_time();
+  bool success = false;
+
+  job->status = BATCH_STATUS_ERROR;
+  job->deadline = options->time_limit ? start + options->time_limit * G_USEC_PER_SEC : G_MAXINT64;
+  if (!g_file_test(job->filename, G_FILE_TEST_EXISTS)) {
+    g_warning("file '%s' does not exist", job->filename);
+    return;
+  }
+  job->data = validation_data_new(options->codec, strlen(demux_str) == 0);
+  if (!job->data) return;
+  // Only the counters are of interest, hence skip formatting the result of every GOP.
+  job->data->reporter = reporter_new(REPORTER_FORMAT_QUIET, NULL);
+
+  if (strlen(demux_str) > 0 && !options->use_gstreamer) {
+    reader = container_reader_new(job->filename, options->codec, &reader_result);
+  }
+  if (reader && options->use_checkpoints) {
+    checkpoint = checkpoint_new(job->filename, reader, options->codec);
+  }
+  if (checkpoint) {
+    success = checkpoint_run(checkpoint, reader, job->data, on_nalu_from_reader, job) ==
+        CONTAINER_READER_OK;
+    // Also at a limit, the checkpoint is at the latest validated GOP.
+    success &= checkpoint_save(checkpoint, reader);
+  } else if (reader) {
+    success = container_reader_run(reader, on_nalu_from_reader, job) == CONTAINER_READER_OK;
+  } else if (reader_result != CONTAINER_READER_ERROR) {
+    success = run_pipeline(job);
+  }
+
+  // Results of a stopped file are written as well, they cover everything up to the stop.
+  job->has_results_file = validation_write_results(job->data, job->results_file);
+  job->valid_gops = job->data->valid_gops;
+  job->valid_gops_with_missing = job->data->valid_gops_with_missing;
+  job->invalid_gops = job->data->invalid_gops;
+  job->no_sign_gops = job->data->no_sign_gops;
+  job->total_bytes = job->data->total_bytes;
+  job->sei_bytes = job->data->sei_bytes;
+  if (job->has_results_file && success) {
+    job->status = status_from_counters(job);
+  } else if (!job->limit_exceeded) {
+    job->status = BATCH_STATUS_ERROR;
+  }
+  job->seconds = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+  g_message("Validated '%s' in %.2f s: %s", job->filename, job->seconds,
+      kBatchStatusNames[job->status]);
+
+  checkpoint_free(checkpoint);
+  container_reader_free(reader);
+  validation_data_free(job->data);
+  job->data = NULL;
+}
+
+static gdouble
+megabytes_per_second(gsize bytes, gdouble seconds)
+{
+  return seconds > 0.0 ? bytes / seconds / 1000000.0 : 0.0;
+}
+
+/* Writes |str| as a CSV field, quoted since file names may contain commas. */
+static void
+write_csv_string(FILE *out, const gchar *str)
+{
+  fputc('"', out);
+  for (const gchar *c = str; *c; c++) {
+    if (*c == '"') fputc('"', out);
+    fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+static bool
+write_csv(const gchar *filename, const BatchJob *jobs, guint num_jobs)
+{
+  FILE *f = fopen(filename, "w");
+
+  if (!f) {
+    g_warning("Could not open %s for writing", filename);
+    return false;
+  }
+  fprintf(f, "file,status,valid_gops,valid_gops_with_missing,invalid_gops,unsigned_gops,"
+             "total_bytes,sei_bytes,seconds,megabytes_per_second,results_file\n");
+  for (guint i = 0; i < num_jobs; i++) {
+    const BatchJob *job = &jobs[i];
+    write_csv_string(f, job->filename);
+    fprintf(f, ",%s,%d,%d,%d,%d,%zu,%zu,%.3f,%.2f,", kBatchStatusNames[job->status],
+        job->valid_gops, job->valid_gops_with_missing, job->invalid_gops, job->no_sign_gops,
+        job->total_bytes, job->sei_bytes, job->seconds,
+        megabytes_per_second(job->total_bytes, job->seconds));
+    write_csv_string(f, job->has_results_file ? job->results_file : "");
+    fputc('\n', f);
+  }
+  fclose(f);
+
+  return true;
+}
+
+static bool
+write_json(const gchar *filename, const BatchJob *jobs, guint num_jobs, gdouble seconds)
+{
+  FILE *f = fopen(filename, "w");
+  guint num_files[BATCH_STATUS_MEMORY_LIMIT + 1] = {0};
+  gsize total_bytes = 0;
+
+  if (!f) {
+    g_warning("Could not open %s for writing", filename);
+    return false;
+  }
+  fprintf(f, "{\"validator_version\":\"%s\",\"files\":[", VALIDATOR_VERSION);
+  for (guint i = 0; i < num_jobs; i++) {
+    const BatchJob *job = &jobs[i];
+    num_files[job->status]++;
+    total_bytes += job->total_bytes;
+    fprintf(f, "%s\n{\"file\":", i > 0 ? "," : "");
+    reporter_write_json_string(f, job->filename);
+    fprintf(f,
+        ",\"status\":\"%s\",\"valid_gops\":%d,\"valid_gops_with_missing\":%d,"
+        "\"invalid_gops\":%d,\"unsigned_gops\":%d,\"total_bytes\":%zu,\"sei_bytes\":%zu,"
+        "\"seconds\":%.3f,\"megabytes_per_second\":%.2f,\"results_file\":",
+        kBatchStatusNames[job->status], job->valid_gops, job->valid_gops_with_missing,
+        job->invalid_gops, job->no_sign_gops, job->total_bytes, job->sei_bytes, job->seconds,
+        megabytes_per_second(job->total_bytes, job->seconds));
+    if (job->has_results_file) {
+      reporter_write_json_string(f, job->results_file);
+    } else {
+      fprintf(f, "null");
+    }
+    fputc('}', f);
+  }
+  fprintf(f, "],\n\"summary\":{\"files\":%u", num_jobs);
+  for (guint i = 0; i <= BATCH_STATUS_MEMORY_LIMIT; i++) {
+    fprintf(f, ",\"%s\":%u", kBatchStatusNames[i], num_files[i]);
+  }
+  fprintf(f, ",\"total_bytes\":%zu,\"seconds\":%.3f,\"megabytes_per_second\":%.2f}}\n",
+      total_bytes, seconds, megabytes_per_second(total_bytes, seconds));
+  fclose(f);
+
+  return true;
+}
+
+bool
+batch_validation_run(gchar **filenames, guint num_files, const BatchOptions *options)
+{
+  BatchJob *jobs = g_new0(BatchJob, num_files);
+  GThreadPool *pool = NULL;
+  GError *error = NULL;
+  gint64 start = g_get_monotonic_time();
+  gdouble seconds = 0.0;
+  gchar *csv_file = NULL;
+  gchar *json_file = NULL;
+  bool success = false;
+
+  if (g_mkdir_with_parents(options->output_dir, 0755) != 0) {
+    g_warning("could not create directory '%s'", options->output_dir);
+    goto out;
+  }
+
+  pool = g_thread_pool_new(validate_file, NULL, MAX(options->num_workers, 1), TRUE, &error);
+  if (!pool) {
+    g_warning("failed to create thread pool: %s", error->message);
+    g_error_free(error);
+    goto out;
+  }
+  g_message("Validating %u files on %u threads", num_files, MAX(options->num_workers, 1));
+  for (guint i = 0; i < num_files; i++) {
+    gchar *basename = g_path_get_basename(filenames[i]);
+    gchar *results_name = g_strdup_printf("%u_%s_%s", i, basename, RESULTS_FILE);
+    jobs[i].options = options;
+    jobs[i].index = i;
+    jobs[i].filename = filenames[i];
+    jobs[i].results_file = g_build_filename(options->output_dir, results_name, NULL);
+    g_free(results_name);
+    g_free(basename);
+    g_thread_pool_push(pool, &jobs[i], NULL);
+  }
+  // Wait for all files to be validated.
+  g_thread_pool_free(pool, FALSE, TRUE);
+  seconds = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+
+  csv_file = g_build_filename(options->output_dir, BATCH_RESULTS_CSV, NULL);
+  json_file = g_build_filename(options->output_dir, BATCH_RESULTS_JSON, NULL);
+  success = write_csv(csv_file, jobs, num_files);
+  success = write_json(json_file, jobs, num_files, seconds) && success;
+  if (success) {
+    g_message("Batch complete in %.2f s. Results printed to '%s' and '%s'.", seconds, csv_file,
+        json_file);
+  }
+  for (guint i = 0; i < num_files; i++) {
+    if (jobs[i].status == BATCH_STATUS_ERROR || jobs[i].limit_exceeded) success = false;
+  }
+
+out:
+  for (guint i = 0; i < num_files; i++) {
+    g_free(jobs[i].results_file);
+  }
+  g_free(jobs);
+  g_free(csv_file);
+  g_free(json_file);
+
+  return success;
+}
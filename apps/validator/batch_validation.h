@@ -0,0 +1,56 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __BATCH_VALIDATION_H__
+#define __BATCH_VALIDATION_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_common.h>
+
+/* Validation of many files in one process. Every file is validated by a worker thread with its
+ * own ValidationData, and pipeline if the file cannot be read by the built-in container reader.
+ * The summary of every file is written to the output directory as
+ * <index>_<basename>_validation_results.txt, and the results of all files are aggregated in
+ * BATCH_RESULTS_CSV and BATCH_RESULTS_JSON. */
+
+#define BATCH_RESULTS_CSV "batch_results.csv"
+#define BATCH_RESULTS_JSON "batch_results.json"
+
+typedef struct {
+  SignedVideoCodec codec;
+  const gchar *codec_str;
+  guint num_workers;  // Number of files validated at the same time
+  guint time_limit;  // Seconds a file may take, 0 for no limit
+  gsize memory_limit;  // Bytes a file may add since its latest validated GOP, 0 for no limit
+  bool use_gstreamer;  // Reads MP4 and Matroska files with GStreamer as well
+  bool use_checkpoints;  // Resumes MP4 and Matroska files from their checkpoints, see checkpoint.h
+  const gchar *output_dir;  // Directory of the results, created if needed
+} BatchOptions;
+
+/* Validates the |num_files| files in |filenames| as specified by |options| and writes the
+ * results. GStreamer has to be initialized. Returns false if a file could not be validated, e.g.,
+ * did not exist or hit a limit, or if the results could not be written. */
+bool
+batch_validation_run(gchar **filenames, guint num_files, const BatchOptions *options);
+
+#endif  // __BATCH_VALIDATION_H__
@@ -0,0 +1,324 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "checkpoint.h"
+
+#include <gst/gst.h>  // GST_READ_*_BE, GST_WRITE_*_BE
+#include <string.h>  // memcmp, memcpy, memset
+
+#include <signed-video-framework/signed_video_auth.h>
+
+/* File layout, all numbers big-endian:
+ *   magic (4), format version (1), codec (1), reserved (2), first sample to replay (4), first
+ *   sample to validate (4), byte offset of the first sample to replay (8), valid GOPs (4), valid
+ *   GOPs with missing BUs (4), invalid GOPs (4), GOPs without signature (4), total bytes (8), SEI
+ *   bytes (8), first timestamp (8), last timestamp (8), SHA-256 digest of the samples to replay */
+#define CHECKPOINT_MAGIC "SVCP"
+#define CHECKPOINT_FORMAT_VERSION 1
+#define CHECKPOINT_DIGEST_SIZE 32
+#define CHECKPOINT_SIZE (72 + CHECKPOINT_DIGEST_SIZE)
+
+typedef struct {
+  gint valid_gops;
+  gint valid_gops_with_missing;
+  gint invalid_gops;
+  gint no_sign_gops;
+  gsize total_bytes;
+  gsize sei_bytes;
+} CheckpointCounters;
+
+struct _Checkpoint {
+  gchar *path;
+  SignedVideoCodec codec;
+
+  // The loaded checkpoint, all zero if the recording is validated from the start.
+  guint replay_start;  // First sample to replay
+  guint resume;  // First sample to validate
+  CheckpointCounters counters;
+  gint64 first_timestamp;
+  gint64 last_timestamp;
+
+  // The latest validated GOP of this run.
+  guint next_resume;
+  CheckpointCounters next_counters;
+  gint64 next_first_timestamp;
+  gint64 next_last_timestamp;
+};
+
+/* Sets the timestamps of the first and last frame validated so far by |data|, including those of
+ * the loaded checkpoint. */
+static void
+get_timestamps(const Checkpoint *self, ValidationData *data, gint64 *first, gint64 *last)
+{
+  signed_video_authenticity_t *report = signed_video_get_authenticity_report(data->sv);
+
+  *first = self->first_timestamp;
+  *last = self->last_timestamp;
+  if (report && report->accumulated_validation.has_timestamp) {
+    if (!*first) *first = report->accumulated_validation.first_timestamp;
+    *last = report->accumulated_validation.last_timestamp;
+  }
+  signed_video_authenticity_report_free(report);
+}
+
+static void
+counters_get(const ValidationData *data, CheckpointCounters *counters)
+{
+  counters->valid_gops = data->valid_gops;
+  counters->valid_gops_with_missing = data->valid_gops_with_missing;
+  counters->invalid_gops = data->invalid_gops;
+  counters->no_sign_gops = data->no_sign_gops;
+  counters->total_bytes = data->total_bytes;
+  counters->sei_bytes = data->sei_bytes;
+}
+
+static void
+counters_set(ValidationData *data, const CheckpointCounters *counters)
+{
+  data->valid_gops = counters->valid_gops;
+  data->valid_gops_with_missing = counters->valid_gops_with_missing;
+  data->invalid_gops = counters->invalid_gops;
+  data->no_sign_gops = counters->no_sign_gops;
+  data->total_bytes = counters->total_bytes;
+  data->sei_bytes = counters->sei_bytes;
+}
+
+static gint
+counters_num_gops(const CheckpointCounters *counters)
+{
+  return counters->valid_gops + counters->valid_gops_with_missing + counters->invalid_gops +
+      counters->no_sign_gops;
+}
+
+/* Computes the digest of samples |first| up to, but not including, |last|. */
+static void
+compute_digest(ContainerReader *reader, guint first, guint last, guint8 *digest)
+{
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  gsize digest_size = CHECKPOINT_DIGEST_SIZE;
+
+  for (guint i = first; i < last; i++) {
+    ContainerReaderSampleInfo info = {0};
+    if (container_reader_get_sample_info(reader, i, &info)) {
+      g_checksum_update(checksum, info.data, info.size);
+    }
+  }
+  g_checksum_get_digest(checksum, digest, &digest_size);
+  g_checksum_free(checksum);
+}
+
+/* Parses the checkpoint |data| of |length| bytes. Returns FALSE if it does not match the samples
+ * of |reader|. */
+static gboolean
+checkpoint_parse(Checkpoint *self, const guint8 *data, gsize length, ContainerReader *reader)
+{
+  ContainerReaderSampleInfo info = {0};
+  guint8 digest[CHECKPOINT_DIGEST_SIZE];
+
+  if (length != CHECKPOINT_SIZE || memcmp(data, CHECKPOINT_MAGIC, 4) != 0 ||
+      data[4] != CHECKPOINT_FORMAT_VERSION || data[5] != (guint8)self->codec) {
+    return FALSE;
+  }
+  self->replay_start = GST_READ_UINT32_BE(data + 8);
+  self->resume = GST_READ_UINT32_BE(data + 12);
+  const guint64 replay_offset = GST_READ_UINT64_BE(data + 16);
+  self->counters.valid_gops = (gint)GST_READ_UINT32_BE(data + 24);
+  self->counters.valid_gops_with_missing = (gint)GST_READ_UINT32_BE(data + 28);
+  self->counters.invalid_gops = (gint)GST_READ_UINT32_BE(data + 32);
+  self->counters.no_sign_gops = (gint)GST_READ_UINT32_BE(data + 36);
+  self->counters.total_bytes = GST_READ_UINT64_BE(data + 40);
+  self->counters.sei_bytes = GST_READ_UINT64_BE(data + 48);
+  self->first_timestamp = (gint64)GST_READ_UINT64_BE(data + 56);
+  self->last_timestamp = (gint64)GST_READ_UINT64_BE(data + 64);
+
+  // The samples to replay have to be unchanged, otherwise the session cannot be rebuilt.
+  if (self->replay_start >= self->resume ||
+      self->resume > container_reader_get_num_samples(reader) ||
+      !container_reader_get_sample_info(reader, self->replay_start, &info) ||
+      info.offset != replay_offset) {
+    return FALSE;
+  }
+  compute_digest(reader, self->replay_start, self->resume, digest);
+
+  return memcmp(digest, data + 72, CHECKPOINT_DIGEST_SIZE) == 0;
+}
+
+Checkpoint *
+checkpoint_new(const gchar *filename, ContainerReader *reader, SignedVideoCodec codec)
+{
+  Checkpoint *self = NULL;
+  gchar *contents = NULL;
+  gsize length = 0;
+
+  if (!container_reader_is_matroska(reader)) {
+    g_message("Checkpoints need a Matroska recording, validating the whole file");
+    return NULL;
+  }
+
+  self = g_new0(Checkpoint, 1);
+  self->path = g_strconcat(filename, CHECKPOINT_SUFFIX, NULL);
+  self->codec = codec;
+
+  if (g_file_get_contents(self->path, &contents, &length, NULL)) {
+    if (!checkpoint_parse(self, (const guint8 *)contents, length, reader)) {
+      g_message("'%s' does not match the recording, validating from the start", self->path);
+      self->replay_start = 0;
+      self->resume = 0;
+      memset(&self->counters, 0, sizeof(self->counters));
+      self->first_timestamp = 0;
+      self->last_timestamp = 0;
+    }
+    g_free(contents);
+  }
+  self->next_resume = self->resume;
+  self->next_counters = self->counters;
+  self->next_first_timestamp = self->first_timestamp;
+  self->next_last_timestamp = self->last_timestamp;
+
+  return self;
+}
+
+/* Called for every nalu, or OBU, of a replayed sample. */
+static gboolean
+on_nalu_replay(const guint8 *nalu, gsize nalu_size, gpointer user_data)
+{
+  // The GOPs have been reported by a previous run.
+  g_free(validation_validate_nalu((ValidationData *)user_data, nalu, nalu_size));
+
+  return TRUE;
+}
+
+ContainerReaderResult
+checkpoint_run(Checkpoint *self, ContainerReader *reader, ValidationData *data,
+    ContainerReaderFunc func, gpointer user_data)
+{
+  const guint num_samples = container_reader_get_num_samples(reader);
+  const guint first = self->resume > 0 ? self->replay_start : 0;
+  Reporter *reporter = data->reporter;
+  bool is_replaying = self->resume > 0;
+  ContainerReaderResult result = CONTAINER_READER_OK;
+
+  if (is_replaying) {
+    g_message("Resuming at sample %u of %u, replaying from sample %u", self->resume, num_samples,
+        self->replay_start);
+    data->reporter = NULL;
+    data->first_timestamp = self->first_timestamp;
+    data->last_timestamp = self->last_timestamp;
+  }
+
+  for (guint i = first; i < num_samples && result == CONTAINER_READER_OK; i++) {
+    const bool is_replay = i < self->resume;
+    const ContainerReaderFunc sample_func = is_replay ? on_nalu_replay : func;
+    gpointer sample_data = is_replay ? data : user_data;
+    CheckpointCounters counters = {0};
+
+    counters_get(data, &counters);
+    const gint num_gops = counters_num_gops(&counters);
+    // The parameter sets of the decoder configuration go in front of the first sample.
+    if (i == first) {
+      result = container_reader_run_range(reader, i, i + 1, sample_func, sample_data);
+    } else {
+      result = container_reader_run_sample(reader, i, sample_func, sample_data);
+    }
+
+    if (is_replay) {
+      if (i + 1 == self->resume) {
+        counters_set(data, &self->counters);
+        data->reporter = reporter;
+        is_replaying = false;
+      }
+      continue;
+    }
+    // A checkpoint is only taken at the end of a sample in which a GOP was validated.
+    counters_get(data, &counters);
+    if (counters_num_gops(&counters) != num_gops && result == CONTAINER_READER_OK) {
+      self->next_resume = i + 1;
+      self->next_counters = counters;
+      // Later frames are validated again when resuming, hence not covered by the checkpoint.
+      get_timestamps(self, data, &self->next_first_timestamp, &self->next_last_timestamp);
+    }
+  }
+  if (is_replaying) {
+    // The replay failed, hence report the results of the checkpoint.
+    counters_set(data, &self->counters);
+    data->reporter = reporter;
+  }
+
+  return result;
+}
+
+bool
+checkpoint_save(Checkpoint *self, ContainerReader *reader)
+{
+  ContainerReaderSampleInfo info = {0};
+  guint8 buf[CHECKPOINT_SIZE] = {0};
+  guint keyframes[2] = {0};
+  guint num_keyframes = 0;
+  guint replay_start = 0;
+  GError *error = NULL;
+
+  // Nothing has been validated yet.
+  if (self->next_resume == 0) return true;
+
+  // Replay from the keyframe of the GOP in front of the one holding the latest validated SEI, so
+  // the next GOP can be linked to it.
+  for (guint i = self->next_resume; i > 0 && num_keyframes < 2; i--) {
+    if (container_reader_get_sample_info(reader, i - 1, &info) && info.is_keyframe) {
+      keyframes[num_keyframes++] = i - 1;
+    }
+  }
+  replay_start = num_keyframes > 0 ? keyframes[num_keyframes - 1] : 0;
+  container_reader_get_sample_info(reader, replay_start, &info);
+
+  memcpy(buf, CHECKPOINT_MAGIC, 4);
+  buf[4] = CHECKPOINT_FORMAT_VERSION;
+  buf[5] = (guint8)self->codec;
+  GST_WRITE_UINT32_BE(buf + 8, replay_start);
+  GST_WRITE_UINT32_BE(buf + 12, self->next_resume);
+  GST_WRITE_UINT64_BE(buf + 16, info.offset);
+  GST_WRITE_UINT32_BE(buf + 24, self->next_counters.valid_gops);
+  GST_WRITE_UINT32_BE(buf + 28, self->next_counters.valid_gops_with_missing);
+  GST_WRITE_UINT32_BE(buf + 32, self->next_counters.invalid_gops);
+  GST_WRITE_UINT32_BE(buf + 36, self->next_counters.no_sign_gops);
+  GST_WRITE_UINT64_BE(buf + 40, self->next_counters.total_bytes);
+  GST_WRITE_UINT64_BE(buf + 48, self->next_counters.sei_bytes);
+  GST_WRITE_UINT64_BE(buf + 56, self->next_first_timestamp);
+  GST_WRITE_UINT64_BE(buf + 64, self->next_last_timestamp);
+  compute_digest(reader, replay_start, self->next_resume, buf + 72);
+
+  if (!g_file_set_contents(self->path, (const gchar *)buf, sizeof(buf), &error)) {
+    g_warning("could not save the checkpoint: %s", error->message);
+    g_error_free(error);
+    return false;
+  }
+  g_message("Checkpoint saved to '%s' at sample %u", self->path, self->next_resume);
+
+  return true;
+}
+
+void
+checkpoint_free(Checkpoint *self)
+{
+  if (!self) return;
+
+  g_free(self->path);
+  g_free(self);
+}
@@ -0,0 +1,66 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_common.h>
+
+#include "container_reader.h"
+#include "validation.h"
+
+/* Incremental validation of Matroska recordings that are still growing. MP4 recordings cannot be
+ * resumed, since their sample tables are only written when the recording is finalized, and
+ * fragmented MP4 is not read by the built-in reader. After a run, a checkpoint is saved
+ * next to the recording, |filename| + CHECKPOINT_SUFFIX, with the counters of ValidationData up to
+ * the latest validated GOP and the samples needed to rebuild the Signed Video session from there.
+ * The next run replays these samples, without counting or reporting their GOPs again, and then
+ * validates only what has been added since. The replayed samples are still in the recording, hence
+ * the checkpoint only stores where they are and a digest to detect that they have changed. */
+
+#define CHECKPOINT_SUFFIX ".svcheckpoint"
+
+typedef struct _Checkpoint Checkpoint;
+
+/* Loads the checkpoint of |filename|, read by |reader|, if there is one. A checkpoint which does
+ * not match the recording, e.g., if it has been replaced, is ignored and the recording is
+ * validated from the start. Returns NULL if |reader| is not reading Matroska. */
+Checkpoint *
+checkpoint_new(const gchar *filename, ContainerReader *reader, SignedVideoCodec codec);
+
+/* Validates the samples of |reader| added since the checkpoint, passing their nalus, or OBUs, to
+ * |func|, after replaying the samples of the checkpoint on |data|. The counters of |data| are
+ * restored from the checkpoint when the replay is done. |data| has to validate sequentially. */
+ContainerReaderResult
+checkpoint_run(Checkpoint *self, ContainerReader *reader, ValidationData *data,
+    ContainerReaderFunc func, gpointer user_data);
+
+/* Saves a checkpoint at the latest GOP validated by checkpoint_run(). */
+bool
+checkpoint_save(Checkpoint *self, ContainerReader *reader);
+
+void
+checkpoint_free(Checkpoint *self);
+
+#endif  // __CHECKPOINT_H__
@@ -0,0 +1,1044 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Reads the video track of MP4 and Matroska files without GStreamer.
+ *
+ * The file is memory-mapped and only the parts needed to locate the samples of the video track are
+ * parsed, i.e., the sample tables of MP4 and the block headers of Matroska. The index is built
+ * before any nalu is passed on, so a file that cannot be handled is detected before validation has
+ * started, and can be validated with GStreamer instead. Nalus are passed on as pointers into the
+ * mapped file. Only 4 byte nalu lengths are supported, since they can then be passed on as is.
+ */
+
+#include "container_reader.h"
+
+#include <gst/gst.h>  // GST_READ_UINT*_BE
+#include <string.h>  // memcmp, strcmp
+
+#include "validation.h"  // av1_get_obu_size
+
+#define FOURCC(a, b, c, d) \
+  (((guint32)(a) << 24) | ((guint32)(b) << 16) | ((guint32)(c) << 8) | (guint32)(d))
+
+#define BOX_MOOV FOURCC('m', 'o', 'o', 'v')
+#define BOX_MOOF FOURCC('m', 'o', 'o', 'f')
+#define BOX_MVEX FOURCC('m', 'v', 'e', 'x')
+#define BOX_TRAK FOURCC('t', 'r', 'a', 'k')
+#define BOX_MDIA FOURCC('m', 'd', 'i', 'a')
+#define BOX_HDLR FOURCC('h', 'd', 'l', 'r')
+#define BOX_MINF FOURCC('m', 'i', 'n', 'f')
+#define BOX_STBL FOURCC('s', 't', 'b', 'l')
+#define BOX_MDHD FOURCC('m', 'd', 'h', 'd')
+#define BOX_STSD FOURCC('s', 't', 's', 'd')
+#define BOX_STTS FOURCC('s', 't', 't', 's')
+#define BOX_CTTS FOURCC('c', 't', 't', 's')
+#define BOX_STSS FOURCC('s', 't', 's', 's')
+#define BOX_STSC FOURCC('s', 't', 's', 'c')
+#define BOX_STSZ FOURCC('s', 't', 's', 'z')
+#define BOX_STCO FOURCC('s', 't', 'c', 'o')
+#define BOX_CO64 FOURCC('c', 'o', '6', '4')
+#define BOX_AVCC FOURCC('a', 'v', 'c', 'C')
+#define BOX_HVCC FOURCC('h', 'v', 'c', 'C')
+#define HANDLER_VIDEO FOURCC('v', 'i', 'd', 'e')
+
+#define BOX_HEADER_SIZE 8
+#define FULL_BOX_HEADER_SIZE 4  // Version and flags
+// Size of the VisualSampleEntry fields, in front of its child boxes.
+#define VISUAL_SAMPLE_ENTRY_SIZE 78
+
+#define EBML_ID_HEADER 0x1A45DFA3
+#define EBML_ID_SEGMENT 0x18538067
+#define EBML_ID_SEEKHEAD 0x114D9B74
+#define EBML_ID_INFO 0x1549A966
+#define EBML_ID_TRACKS 0x1654AE6B
+#define EBML_ID_CUES 0x1C53BB6B
+#define EBML_ID_TAGS 0x1254C367
+#define EBML_ID_CHAPTERS 0x1043A770
+#define EBML_ID_ATTACHMENTS 0x1941A469
+#define EBML_ID_CLUSTER 0x1F43B675
+#define EBML_ID_TRACKENTRY 0xAE
+#define EBML_ID_TRACKNUMBER 0xD7
+#define EBML_ID_TRACKTYPE 0x83
+#define EBML_ID_CODECID 0x86
+#define EBML_ID_CODECPRIVATE 0x63A2
+#define EBML_ID_CONTENTENCODINGS 0x6D80
+#define EBML_ID_SIMPLEBLOCK 0xA3
+#define EBML_ID_BLOCKGROUP 0xA0
+#define EBML_ID_BLOCK 0xA1
+#define EBML_ID_REFERENCEBLOCK 0xFB
+#define EBML_ID_TIMECODE 0xE7
+#define EBML_ID_TIMECODESCALE 0x2AD7B1
+#define EBML_UNKNOWN_SIZE G_MAXUINT64
+#define MKV_TRACK_TYPE_VIDEO 1
+#define MKV_DEFAULT_TIMECODE_SCALE 1000000  // Nanoseconds
+
+#define NALU_LENGTH_SIZE 4
+#define H264_NALU_TYPE_SPS 7
+#define H265_NALU_TYPE_SPS 33
+
+#define NANOSECONDS_PER_SECOND G_GINT64_CONSTANT(1000000000)
+
+/* A sample in the mapped file. */
+typedef struct {
+  const guint8 *data;
+  gsize size;
+  gint64 pts;  // In nanoseconds
+  gboolean is_keyframe;
+} ReaderSample;
+
+/* A block of a Matroska track. */
+typedef struct {
+  guint64 track;
+  gint64 timecode;  // In units of the timecode scale
+  ReaderSample sample;
+} MkvBlock;
+
+/* A box, or an EBML element. |data| points at the payload. */
+typedef struct {
+  guint32 id;
+  const guint8 *data;
+  guint64 size;
+} ReaderElement;
+
+struct _ContainerReader {
+  GMappedFile *file;
+  const guint8 *data;
+  gsize size;
+  gboolean is_matroska;
+  SignedVideoCodec codec;
+  const gchar *reason;  // Why the file cannot be read without GStreamer
+  GArray *samples;  // ReaderSample of the video track in decode order
+  GByteArray *param_sets;  // Parameter sets of the decoder configuration, each with a 4 byte size
+};
+
+/* MP4 */
+
+/* Reads the box at |pos| of |data| and moves |pos| past it. Returns FALSE at the end, or if the
+ * box does not fit, in which case |pos| is not moved. */
+static gboolean
+next_box(const guint8 *data, guint64 size, guint64 *pos, ReaderElement *box)
+{
+  const guint8 *header = data + *pos;
+  const guint64 available = size - *pos;
+  guint64 box_size = 0;
+  guint header_size = BOX_HEADER_SIZE;
+
+  if (*pos >= size || available < BOX_HEADER_SIZE) return FALSE;
+
+  box_size = GST_READ_UINT32_BE(header);
+  box->id = GST_READ_UINT32_BE(header + 4);
+  if (box_size == 1) {
+    if (available < BOX_HEADER_SIZE + 8) return FALSE;
+    box_size = GST_READ_UINT64_BE(header + BOX_HEADER_SIZE);
+    header_size += 8;
+  } else if (box_size == 0) {
+    // The box extends to the end of the file.
+    box_size = available;
+  }
+  if (box_size < header_size || box_size > available) return FALSE;
+
+  box->data = header + header_size;
+  box->size = box_size - header_size;
+  *pos += box_size;
+
+  return TRUE;
+}
+
+/* Finds the first child of |parent| of type |type|. */
+static gboolean
+find_box(const ReaderElement *parent, guint32 type, ReaderElement *box)
+{
+  guint64 pos = 0;
+
+  while (next_box(parent->data, parent->size, &pos, box)) {
+    if (box->id == type) return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns the payload of a full box, i.e., after version and flags, and sets |size| to its size.
+ * Returns NULL if the box is too small to hold |min_size| bytes of payload. */
+static const guint8 *
+full_box_payload(const ReaderElement *box, guint64 min_size, guint64 *size)
+{
+  if (box->size < FULL_BOX_HEADER_SIZE + min_size) return NULL;
+
+  *size = box->size - FULL_BOX_HEADER_SIZE;
+  return box->data + FULL_BOX_HEADER_SIZE;
+}
+
+/* Gets the codec of the sample description |stsd| and its decoder configuration, if any. */
+static gboolean
+mp4_get_codec(ContainerReader *self, const ReaderElement *stsd, SignedVideoCodec *codec,
+    ReaderElement *config)
+{
+  guint64 size = 0;
+  const guint8 *payload = full_box_payload(stsd, 4, &size);
+  guint64 pos = 4;
+  ReaderElement entry = {0};
+  guint32 config_type = 0;
+
+  if (!payload || GST_READ_UINT32_BE(payload) != 1) {
+    self->reason = "the video track has more than one sample description";
+    return FALSE;
+  }
+  if (!next_box(payload, size, &pos, &entry) || entry.size < VISUAL_SAMPLE_ENTRY_SIZE) {
+    self->reason = "the sample description could not be parsed";
+    return FALSE;
+  }
+
+  switch (entry.id) {
+    case FOURCC('a', 'v', 'c', '1'):
+    case FOURCC('a', 'v', 'c', '3'):
+      *codec = SV_CODEC_H264;
+      config_type = BOX_AVCC;
+      break;
+    case FOURCC('h', 'v', 'c', '1'):
+    case FOURCC('h', 'e', 'v', '1'):
+      *codec = SV_CODEC_H265;
+      config_type = BOX_HVCC;
+      break;
+    case FOURCC('a', 'v', '0', '1'):
+      *codec = SV_CODEC_AV1;
+      return TRUE;
+    default:
+      self->reason = "the video codec is not supported";
+      return FALSE;
+  }
+
+  // Look for the decoder configuration among the child boxes of the sample entry.
+  ReaderElement children = {
+      .data = entry.data + VISUAL_SAMPLE_ENTRY_SIZE,
+      .size = entry.size - VISUAL_SAMPLE_ENTRY_SIZE,
+  };
+  if (!find_box(&children, config_type, config)) {
+    self->reason = "the decoder configuration is missing";
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Lists the samples of the track with sample table |stbl| from the sizes, the chunk offsets and
+ * the sample-to-chunk table. */
+static gboolean
+mp4_load_samples(ContainerReader *self, const ReaderElement *stbl)
+{
+  ReaderElement stsz = {0};
+  ReaderElement stsc = {0};
+  ReaderElement stco = {0};
+  const guint8 *sizes = NULL;
+  const guint8 *chunks = NULL;
+  const guint8 *entries = NULL;
+  guint64 size = 0;
+  guint entry_size = 4;
+  guint32 sample = 0;
+
+  if (!find_box(stbl, BOX_STSZ, &stsz) || !find_box(stbl, BOX_STSC, &stsc)) goto corrupt;
+  if (!find_box(stbl, BOX_STCO, &stco)) {
+    if (!find_box(stbl, BOX_CO64, &stco)) goto corrupt;
+    entry_size = 8;
+  }
+
+  sizes = full_box_payload(&stsz, 8, &size);
+  if (!sizes) goto corrupt;
+  const guint32 sample_size = GST_READ_UINT32_BE(sizes);
+  const guint32 num_samples = GST_READ_UINT32_BE(sizes + 4);
+  if (sample_size == 0 && (size - 8) / 4 < num_samples) goto corrupt;
+  // A constant sample size leaves the number of samples unchecked by the size table.
+  if (sample_size != 0 && (guint64)num_samples * sample_size > self->size) goto corrupt;
+
+  chunks = full_box_payload(&stco, 4, &size);
+  if (!chunks) goto corrupt;
+  const guint32 num_chunks = GST_READ_UINT32_BE(chunks);
+  if ((size - 4) / entry_size < num_chunks) goto corrupt;
+
+  entries = full_box_payload(&stsc, 4, &size);
+  if (!entries) goto corrupt;
+  const guint32 num_entries = GST_READ_UINT32_BE(entries);
+  if ((size - 4) / 12 < num_entries) goto corrupt;
+
+  // The chunks have to hold exactly the listed samples, which is checked before allocating them.
+  guint64 total_samples = 0;
+  for (guint32 i = 0; i < num_entries; i++) {
+    const guint8 *entry = entries + 4 + 12 * (guint64)i;
+    const guint64 first_chunk = GST_READ_UINT32_BE(entry);
+    const guint64 next_first_chunk =
+        i + 1 < num_entries ? GST_READ_UINT32_BE(entry + 12) : (guint64)num_chunks + 1;
+
+    if (first_chunk == 0 || next_first_chunk <= first_chunk) goto corrupt;
+    if (first_chunk > num_chunks) continue;
+    total_samples += (MIN(next_first_chunk, (guint64)num_chunks + 1) - first_chunk) *
+        GST_READ_UINT32_BE(entry + 4);
+    if (total_samples > num_samples) goto corrupt;
+  }
+  if (total_samples != num_samples) goto corrupt;
+
+  g_array_set_size(self->samples, num_samples);
+  for (guint32 i = 0; i < num_entries; i++) {
+    const guint8 *entry = entries + 4 + 12 * (guint64)i;
+    // The first chunk of each entry is 1-based and the entry runs until the next entry.
+    const guint64 first_chunk = GST_READ_UINT32_BE(entry);
+    const guint64 next_first_chunk =
+        i + 1 < num_entries ? GST_READ_UINT32_BE(entry + 12) : (guint64)num_chunks + 1;
+    const guint32 samples_per_chunk = GST_READ_UINT32_BE(entry + 4);
+
+    if (first_chunk == 0 || next_first_chunk <= first_chunk) goto corrupt;
+    for (guint64 chunk = first_chunk - 1; chunk < next_first_chunk - 1 && chunk < num_chunks;
+         chunk++) {
+      const guint8 *chunk_entry = chunks + 4 + entry_size * chunk;
+      guint64 offset =
+          entry_size == 8 ? GST_READ_UINT64_BE(chunk_entry) : GST_READ_UINT32_BE(chunk_entry);
+
+      for (guint32 j = 0; j < samples_per_chunk; j++, sample++) {
+        if (sample >= num_samples) goto corrupt;
+        ReaderSample *s = &g_array_index(self->samples, ReaderSample, sample);
+        s->size = sample_size != 0 ? sample_size : GST_READ_UINT32_BE(sizes + 8 + 4 * sample);
+        if (offset > self->size || s->size > self->size - offset) {
+          self->reason = "a sample is outside the file, it may be truncated";
+          return FALSE;
+        }
+        s->data = self->data + offset;
+        offset += s->size;
+      }
+    }
+  }
+  if (sample != num_samples) goto corrupt;
+
+  return TRUE;
+
+corrupt:
+  self->reason = "the sample tables could not be parsed";
+  return FALSE;
+}
+
+/* Converts |time| in units of |timescale| per second to nanoseconds, without overflowing for long
+ * recordings. */
+static gint64
+to_nanoseconds(gint64 time, guint32 timescale)
+{
+  return (time / timescale) * NANOSECONDS_PER_SECOND +
+      (time % timescale) * NANOSECONDS_PER_SECOND / timescale;
+}
+
+/* Sets the presentation timestamps of the samples from the decoding time deltas, and the
+ * composition offsets if any, and marks the sync samples as keyframes. Without a sync sample table
+ * every sample is a keyframe. */
+static gboolean
+mp4_load_timing(ContainerReader *self, const ReaderElement *mdia, const ReaderElement *stbl)
+{
+  ReaderElement mdhd = {0};
+  ReaderElement stts = {0};
+  ReaderElement box = {0};
+  const guint8 *payload = NULL;
+  guint64 size = 0;
+  guint32 timescale = 0;
+  gint64 dts = 0;
+  guint32 sample = 0;
+  gboolean is_version_1 = FALSE;
+
+  // The timescale follows the creation and modification times, which are 64 bits in version 1.
+  if (!find_box(mdia, BOX_MDHD, &mdhd) || !find_box(stbl, BOX_STTS, &stts)) goto corrupt;
+  payload = full_box_payload(&mdhd, 12, &size);
+  if (!payload) goto corrupt;
+  is_version_1 = mdhd.data[0] == 1;
+  if (is_version_1 && size < 20) goto corrupt;
+  timescale = GST_READ_UINT32_BE(payload + (is_version_1 ? 16 : 8));
+  if (timescale == 0) goto corrupt;
+
+  payload = full_box_payload(&stts, 4, &size);
+  if (!payload) goto corrupt;
+  const guint32 num_entries = GST_READ_UINT32_BE(payload);
+  if ((size - 4) / 8 < num_entries) goto corrupt;
+  for (guint32 i = 0; i < num_entries && sample < self->samples->len; i++) {
+    const guint32 count = GST_READ_UINT32_BE(payload + 4 + 8 * (guint64)i);
+    const guint32 delta = GST_READ_UINT32_BE(payload + 8 + 8 * (guint64)i);
+
+    for (guint32 j = 0; j < count && sample < self->samples->len; j++, sample++) {
+      ReaderSample *s = &g_array_index(self->samples, ReaderSample, sample);
+      s->pts = dts;
+      s->is_keyframe = TRUE;
+      dts += delta;
+    }
+  }
+  if (sample != self->samples->len) goto corrupt;
+
+  // Composition offsets are signed in version 1, but negative offsets are also found in version 0.
+  if (find_box(stbl, BOX_CTTS, &box)) {
+    payload = full_box_payload(&box, 4, &size);
+    if (!payload) goto corrupt;
+    const guint32 num_offsets = GST_READ_UINT32_BE(payload);
+    if ((size - 4) / 8 < num_offsets) goto corrupt;
+    sample = 0;
+    for (guint32 i = 0; i < num_offsets && sample < self->samples->len; i++) {
+      const guint32 count = GST_READ_UINT32_BE(payload + 4 + 8 * (guint64)i);
+      const gint32 offset = (gint32)GST_READ_UINT32_BE(payload + 8 + 8 * (guint64)i);
+
+      for (guint32 j = 0; j < count && sample < self->samples->len; j++, sample++) {
+        g_array_index(self->samples, ReaderSample, sample).pts += offset;
+      }
+    }
+  }
+
+  for (guint i = 0; i < self->samples->len; i++) {
+    ReaderSample *s = &g_array_index(self->samples, ReaderSample, i);
+    s->pts = to_nanoseconds(s->pts, timescale);
+  }
+
+  if (find_box(stbl, BOX_STSS, &box)) {
+    payload = full_box_payload(&box, 4, &size);
+    if (!payload) goto corrupt;
+    const guint32 num_sync = GST_READ_UINT32_BE(payload);
+    if ((size - 4) / 4 < num_sync) goto corrupt;
+    for (guint i = 0; i < self->samples->len; i++) {
+      g_array_index(self->samples, ReaderSample, i).is_keyframe = FALSE;
+    }
+    for (guint32 i = 0; i < num_sync; i++) {
+      // Sample numbers are 1-based.
+      const guint32 number = GST_READ_UINT32_BE(payload + 4 + 4 * (guint64)i);
+      if (number == 0 || number > self->samples->len) goto corrupt;
+      g_array_index(self->samples, ReaderSample, number - 1).is_keyframe = TRUE;
+    }
+  }
+
+  return TRUE;
+
+corrupt:
+  self->reason = "the timing of the samples could not be parsed";
+  return FALSE;
+}
+
+static gboolean
+mp4_parse(ContainerReader *self, ReaderElement *config)
+{
+  ReaderElement file = {.data = self->data, .size = self->size};
+  ReaderElement moov = {0};
+  ReaderElement box = {0};
+  guint64 pos = 0;
+  gboolean has_moov = FALSE;
+
+  while (next_box(file.data, file.size, &pos, &box)) {
+    if (box.id == BOX_MOOF) {
+      self->reason = "fragmented MP4 is not supported";
+      return FALSE;
+    }
+    if (box.id == BOX_MOOV && !has_moov) {
+      moov = box;
+      has_moov = TRUE;
+    }
+  }
+  if (!has_moov) {
+    self->reason = "there is no moov box";
+    return FALSE;
+  }
+  if (find_box(&moov, BOX_MVEX, &box)) {
+    self->reason = "fragmented MP4 is not supported";
+    return FALSE;
+  }
+
+  // Use the first video track.
+  pos = 0;
+  while (next_box(moov.data, moov.size, &pos, &box)) {
+    ReaderElement mdia = {0};
+    ReaderElement hdlr = {0};
+    ReaderElement minf = {0};
+    ReaderElement stbl = {0};
+    ReaderElement stsd = {0};
+    const guint8 *payload = NULL;
+    guint64 size = 0;
+    SignedVideoCodec codec = SV_CODEC_H264;
+
+    if (box.id != BOX_TRAK) continue;
+    if (!find_box(&box, BOX_MDIA, &mdia) || !find_box(&mdia, BOX_HDLR, &hdlr)) continue;
+    // The handler type follows a pre-defined field.
+    payload = full_box_payload(&hdlr, 8, &size);
+    if (!payload || GST_READ_UINT32_BE(payload + 4) != HANDLER_VIDEO) continue;
+
+    if (!find_box(&mdia, BOX_MINF, &minf) || !find_box(&minf, BOX_STBL, &stbl) ||
+        !find_box(&stbl, BOX_STSD, &stsd)) {
+      self->reason = "the video track has no sample table";
+      return FALSE;
+    }
+    if (!mp4_get_codec(self, &stsd, &codec, config)) return FALSE;
+    if (codec != self->codec) {
+      self->reason = "the video track is coded with another codec";
+      return FALSE;
+    }
+    return mp4_load_samples(self, &stbl) && mp4_load_timing(self, &mdia, &stbl);
+  }
+
+  self->reason = "there is no video track";
+  return FALSE;
+}
+
+/* Matroska */
+
+/* Reads a variable size integer of at most |max_len| bytes at |pos| and moves |pos| past it. The
+ * length marker is kept for element IDs and removed for sizes and track numbers. */
+static gboolean
+read_vint(const guint8 *data, guint64 size, guint64 *pos, guint max_len, gboolean keep_marker,
+    guint64 *value)
+{
+  guint len = 1;
+  guint64 mask = 0x80;
+
+  if (*pos >= size) return FALSE;
+  while (len <= max_len && !(data[*pos] & mask)) {
+    len++;
+    mask >>= 1;
+  }
+  if (len > max_len || size - *pos < len) return FALSE;
+
+  guint64 v = keep_marker ? data[*pos] : (data[*pos] & (mask - 1));
+  gboolean all_ones = (v == mask - 1);
+  for (guint i = 1; i < len; i++) {
+    v = (v << 8) | data[*pos + i];
+    all_ones &= (data[*pos + i] == 0xff);
+  }
+  *pos += len;
+  // A size with all bits set is unknown.
+  *value = (!keep_marker && all_ones && max_len == 8) ? EBML_UNKNOWN_SIZE : v;
+
+  return TRUE;
+}
+
+/* Reads the header of the element at |pos| and moves |pos| to its payload. An unknown size is
+ * returned as EBML_UNKNOWN_SIZE, otherwise the payload has to fit in |size|. If |truncate| is set,
+ * a payload that does not fit is truncated instead, which happens at the end of a file that was
+ * not closed properly. */
+static gboolean
+next_element(const guint8 *data, guint64 size, guint64 *pos, gboolean truncate,
+    ReaderElement *element)
+{
+  guint64 id = 0;
+
+  if (!read_vint(data, size, pos, 4, TRUE, &id)) return FALSE;
+  if (!read_vint(data, size, pos, 8, FALSE, &element->size)) return FALSE;
+  if (element->size != EBML_UNKNOWN_SIZE && element->size > size - *pos) {
+    if (!truncate) return FALSE;
+    element->size = size - *pos;
+  }
+  element->id = (guint32)id;
+  element->data = data + *pos;
+
+  return TRUE;
+}
+
+static guint64
+read_uint(const ReaderElement *element)
+{
+  guint64 value = 0;
+
+  for (guint64 i = 0; i < element->size && i < 8; i++) {
+    value = (value << 8) | element->data[i];
+  }
+
+  return value;
+}
+
+static gboolean
+is_level1_id(guint32 id)
+{
+  return id == EBML_ID_SEEKHEAD || id == EBML_ID_INFO || id == EBML_ID_TRACKS ||
+      id == EBML_ID_CUES || id == EBML_ID_TAGS || id == EBML_ID_CHAPTERS ||
+      id == EBML_ID_ATTACHMENTS || id == EBML_ID_CLUSTER;
+}
+
+/* Checks if |parent|, of known size, has a child element |id|. */
+static gboolean
+mkv_has_child(const ReaderElement *parent, guint32 id)
+{
+  guint64 pos = 0;
+  ReaderElement child = {0};
+
+  while (next_element(parent->data, parent->size, &pos, FALSE, &child) &&
+      child.size != EBML_UNKNOWN_SIZE) {
+    if (child.id == id) return TRUE;
+    pos += child.size;
+  }
+
+  return FALSE;
+}
+
+/* Adds the frame of a SimpleBlock, or Block, to |blocks|. The timecode of the block is relative to
+ * |cluster_timecode|. */
+static gboolean
+mkv_add_block(
+    ContainerReader *self, const ReaderElement *block, guint64 cluster_timecode, GArray *blocks)
+{
+  guint64 pos = 0;
+  MkvBlock b = {0};
+
+  // Track number, relative timecode (2 bytes) and flags (1 byte).
+  if (!read_vint(block->data, block->size, &pos, 8, FALSE, &b.track) || block->size - pos < 3) {
+    self->reason = "a block could not be parsed";
+    return FALSE;
+  }
+  b.timecode = (gint64)cluster_timecode + (gint16)GST_READ_UINT16_BE(block->data + pos);
+  const guint8 flags = block->data[pos + 2];
+  // The keyframe flag only exists in SimpleBlocks, see mkv_parse_blocks() for Blocks.
+  b.sample.is_keyframe = block->id == EBML_ID_SIMPLEBLOCK ? (flags & 0x80) != 0 : TRUE;
+  pos += 3;
+  if (flags & 0x06) {
+    self->reason = "laced blocks are not supported";
+    return FALSE;
+  }
+  b.sample.data = block->data + pos;
+  b.sample.size = block->size - pos;
+  g_array_append_val(blocks, b);
+
+  return TRUE;
+}
+
+/* Parses the cluster, or block group, payload starting at |pos| until |end|. If |end| is unknown,
+ * the parsing stops at the next top level element. |pos| is moved past the parsed elements.
+ * |cluster_timecode| is updated from the Timecode element of the cluster. */
+static gboolean
+mkv_parse_blocks(ContainerReader *self, guint64 *pos, guint64 end, guint64 *cluster_timecode,
+    GArray *blocks)
+{
+  const guint64 limit = end == EBML_UNKNOWN_SIZE ? self->size : end;
+
+  while (*pos < limit) {
+    guint64 next = *pos;
+    ReaderElement element = {0};
+
+    if (!next_element(self->data, limit, &next, FALSE, &element)) break;
+    if (end == EBML_UNKNOWN_SIZE && is_level1_id(element.id)) return TRUE;
+    if (element.size == EBML_UNKNOWN_SIZE) {
+      self->reason = "an element of unknown size could not be parsed";
+      return FALSE;
+    }
+    *pos = next;
+    if (element.id == EBML_ID_SIMPLEBLOCK || element.id == EBML_ID_BLOCK) {
+      if (!mkv_add_block(self, &element, *cluster_timecode, blocks)) return FALSE;
+    } else if (element.id == EBML_ID_TIMECODE) {
+      *cluster_timecode = read_uint(&element);
+    } else if (element.id == EBML_ID_BLOCKGROUP) {
+      guint64 group_pos = *pos;
+      const guint first_block = blocks->len;
+      if (!mkv_parse_blocks(self, &group_pos, *pos + element.size, cluster_timecode, blocks)) {
+        return FALSE;
+      }
+      // The block of a group is a keyframe unless it references other blocks.
+      if (blocks->len > first_block && mkv_has_child(&element, EBML_ID_REFERENCEBLOCK)) {
+        g_array_index(blocks, MkvBlock, blocks->len - 1).sample.is_keyframe = FALSE;
+      }
+    }
+    *pos += element.size;
+  }
+  if (*pos < limit && limit < self->size) {
+    self->reason = "a cluster could not be parsed";
+    return FALSE;
+  }
+  // A truncated file may end within the last block.
+  *pos = limit;
+
+  return TRUE;
+}
+
+/* Finds the first video track and gets its number, codec and private data. */
+static gboolean
+mkv_parse_tracks(ContainerReader *self, const ReaderElement *tracks, guint64 *track_number,
+    ReaderElement *config)
+{
+  guint64 pos = 0;
+  ReaderElement entry = {0};
+
+  while (pos < tracks->size && next_element(tracks->data, tracks->size, &pos, FALSE, &entry)) {
+    guint64 entry_pos = 0;
+    ReaderElement element = {0};
+    guint64 type = 0;
+    guint64 number = 0;
+    gchar *codec_id = NULL;
+    gboolean is_encoded = FALSE;
+    ReaderElement private = {0};
+
+    if (entry.size == EBML_UNKNOWN_SIZE) break;
+    pos += entry.size;
+    if (entry.id != EBML_ID_TRACKENTRY) continue;
+
+    while (entry_pos < entry.size &&
+        next_element(entry.data, entry.size, &entry_pos, FALSE, &element) &&
+        element.size != EBML_UNKNOWN_SIZE) {
+      entry_pos += element.size;
+      switch (element.id) {
+        case EBML_ID_TRACKNUMBER:
+          number = read_uint(&element);
+          break;
+        case EBML_ID_TRACKTYPE:
+          type = read_uint(&element);
+          break;
+        case EBML_ID_CODECID:
+          g_free(codec_id);
+          codec_id = g_strndup((const gchar *)element.data, element.size);
+          break;
+        case EBML_ID_CODECPRIVATE:
+          private = element;
+          break;
+        case EBML_ID_CONTENTENCODINGS:
+          is_encoded = TRUE;
+          break;
+        default:
+          break;
+      }
+    }
+    if (type != MKV_TRACK_TYPE_VIDEO) {
+      g_free(codec_id);
+      continue;
+    }
+
+    SignedVideoCodec codec = -1;
+    if (codec_id && strcmp(codec_id, "V_MPEG4/ISO/AVC") == 0) {
+      codec = SV_CODEC_H264;
+    } else if (codec_id && strcmp(codec_id, "V_MPEGH/ISO/HEVC") == 0) {
+      codec = SV_CODEC_H265;
+    } else if (codec_id && strcmp(codec_id, "V_AV1") == 0) {
+      codec = SV_CODEC_AV1;
+    }
+    g_free(codec_id);
+    if (codec != self->codec) {
+      self->reason = "the video track is coded with another codec";
+      return FALSE;
+    }
+    if (is_encoded) {
+      self->reason = "compressed or encrypted tracks are not supported";
+      return FALSE;
+    }
+    *track_number = number;
+    *config = private;
+    return TRUE;
+  }
+
+  self->reason = "there is no video track";
+  return FALSE;
+}
+
+static gboolean
+mkv_parse(ContainerReader *self, ReaderElement *config)
+{
+  GArray *blocks = g_array_new(FALSE, FALSE, sizeof(MkvBlock));
+  ReaderElement element = {0};
+  guint64 pos = 0;
+  guint64 segment_end = 0;
+  guint64 track_number = 0;
+  guint64 timecode_scale = MKV_DEFAULT_TIMECODE_SCALE;
+  gboolean has_tracks = FALSE;
+  gboolean success = FALSE;
+
+  // The EBML header, followed by the segment.
+  if (!next_element(self->data, self->size, &pos, FALSE, &element) ||
+      element.id != EBML_ID_HEADER || element.size == EBML_UNKNOWN_SIZE) {
+    self->reason = "the EBML header is missing";
+    goto out;
+  }
+  pos += element.size;
+  if (!next_element(self->data, self->size, &pos, TRUE, &element) ||
+      element.id != EBML_ID_SEGMENT) {
+    self->reason = "the segment is missing";
+    goto out;
+  }
+  segment_end = element.size == EBML_UNKNOWN_SIZE ? self->size : pos + element.size;
+
+  while (pos < segment_end) {
+    if (!next_element(self->data, segment_end, &pos, TRUE, &element)) break;
+    if (element.id == EBML_ID_CLUSTER) {
+      guint64 end = element.size == EBML_UNKNOWN_SIZE ? EBML_UNKNOWN_SIZE : pos + element.size;
+      guint64 cluster_timecode = 0;
+      if (!mkv_parse_blocks(self, &pos, end, &cluster_timecode, blocks)) goto out;
+      continue;
+    }
+    if (element.size == EBML_UNKNOWN_SIZE) {
+      self->reason = "an element of unknown size could not be parsed";
+      goto out;
+    }
+    if (element.id == EBML_ID_TRACKS && !has_tracks) {
+      if (!mkv_parse_tracks(self, &element, &track_number, config)) goto out;
+      has_tracks = TRUE;
+    }
+    if (element.id == EBML_ID_INFO) {
+      guint64 info_pos = 0;
+      ReaderElement child = {0};
+      while (next_element(element.data, element.size, &info_pos, FALSE, &child) &&
+          child.size != EBML_UNKNOWN_SIZE) {
+        if (child.id == EBML_ID_TIMECODESCALE && read_uint(&child) > 0) {
+          timecode_scale = read_uint(&child);
+        }
+        info_pos += child.size;
+      }
+    }
+    pos += element.size;
+  }
+  if (!has_tracks) {
+    self->reason = "there are no tracks";
+    goto out;
+  }
+
+  for (guint i = 0; i < blocks->len; i++) {
+    MkvBlock *block = &g_array_index(blocks, MkvBlock, i);
+    if (block->track != track_number) continue;
+    block->sample.pts = block->timecode * (gint64)timecode_scale;
+    g_array_append_val(self->samples, block->sample);
+  }
+  success = TRUE;
+
+out:
+  g_array_free(blocks, TRUE);
+  return success;
+}
+
+/* Common */
+
+/* Adds a parameter set of the decoder configuration with a 4 byte size in front. */
+static void
+add_param_set(ContainerReader *self, const guint8 *data, guint16 size)
+{
+  guint8 prefix[NALU_LENGTH_SIZE];
+
+  GST_WRITE_UINT32_BE(prefix, size);
+  g_byte_array_append(self->param_sets, prefix, NALU_LENGTH_SIZE);
+  g_byte_array_append(self->param_sets, data, size);
+}
+
+/* Checks the nalu length size and collects the parameter sets of an avcC, or hvcC, payload. */
+static gboolean
+parse_decoder_config(ContainerReader *self, const ReaderElement *config)
+{
+  const guint8 *data = config->data;
+  const guint64 size = config->size;
+  guint64 pos = 0;
+  guint num_arrays = 0;
+
+  if (self->codec == SV_CODEC_AV1) return TRUE;
+  if (!data || size < (self->codec == SV_CODEC_H264 ? 7 : 23)) goto corrupt;
+  if ((data[self->codec == SV_CODEC_H264 ? 4 : 21] & 0x03) + 1 != NALU_LENGTH_SIZE) {
+    self->reason = "the nalu length size is not 4 bytes";
+    return FALSE;
+  }
+
+  // H264 has an array of SPS followed by an array of PPS, H265 has arrays of any type.
+  if (self->codec == SV_CODEC_H264) {
+    num_arrays = 2;
+    pos = 5;
+  } else {
+    num_arrays = data[22];
+    pos = 23;
+  }
+  for (guint i = 0; i < num_arrays; i++) {
+    guint num_nalus = 0;
+
+    if (self->codec == SV_CODEC_H264) {
+      if (pos + 1 > size) goto corrupt;
+      num_nalus = data[pos] & (i == 0 ? 0x1f : 0xff);
+      pos += 1;
+    } else {
+      if (pos + 3 > size) goto corrupt;
+      num_nalus = GST_READ_UINT16_BE(data + pos + 1);
+      pos += 3;
+    }
+    for (guint j = 0; j < num_nalus; j++) {
+      if (pos + 2 > size) goto corrupt;
+      const guint16 nalu_size = GST_READ_UINT16_BE(data + pos);
+      pos += 2;
+      if (pos + nalu_size > size) goto corrupt;
+      add_param_set(self, data + pos, nalu_size);
+      pos += nalu_size;
+    }
+  }
+
+  return TRUE;
+
+corrupt:
+  self->reason = "the decoder configuration could not be parsed";
+  return FALSE;
+}
+
+/* Checks if |sample| carries an SPS in-band, in which case the parameter sets of the decoder
+ * configuration are not needed. */
+static gboolean
+has_sps(const ContainerReader *self, const ReaderSample *sample)
+{
+  gsize pos = 0;
+
+  while (pos + NALU_LENGTH_SIZE < sample->size) {
+    const guint8 *nalu = sample->data + pos + NALU_LENGTH_SIZE;
+    guint type = self->codec == SV_CODEC_H264 ? (nalu[0] & 0x1f) : ((nalu[0] & 0x7e) >> 1);
+
+    if (type == (self->codec == SV_CODEC_H264 ? H264_NALU_TYPE_SPS : H265_NALU_TYPE_SPS)) {
+      return TRUE;
+    }
+    pos += NALU_LENGTH_SIZE + (gsize)GST_READ_UINT32_BE(sample->data + pos);
+  }
+
+  return FALSE;
+}
+
+ContainerReader *
+container_reader_new(const gchar *filename, SignedVideoCodec codec, ContainerReaderResult *result)
+{
+  ContainerReader *self = g_new0(ContainerReader, 1);
+  ReaderElement config = {0};
+  GError *error = NULL;
+  gboolean parsed = FALSE;
+
+  *result = CONTAINER_READER_ERROR;
+  self->codec = codec;
+  self->samples = g_array_new(FALSE, FALSE, sizeof(ReaderSample));
+  self->param_sets = g_byte_array_new();
+
+  self->file = g_mapped_file_new(filename, FALSE, &error);
+  if (!self->file) {
+    g_warning("failed to map '%s': %s", filename, error->message);
+    g_error_free(error);
+    goto fail;
+  }
+  self->data = (const guint8 *)g_mapped_file_get_contents(self->file);
+  self->size = g_mapped_file_get_length(self->file);
+
+  if (self->size >= 8 && GST_READ_UINT32_BE(self->data) == EBML_ID_HEADER) {
+    self->is_matroska = TRUE;
+    parsed = mkv_parse(self, &config);
+  } else if (self->size >= 8) {
+    parsed = mp4_parse(self, &config);
+  } else {
+    self->reason = "the file is too small";
+  }
+  if (parsed) parsed = parse_decoder_config(self, &config);
+  if (!parsed) {
+    g_message("'%s' cannot be read without GStreamer: %s", filename, self->reason);
+    *result = CONTAINER_READER_UNSUPPORTED;
+    goto fail;
+  }
+
+  *result = CONTAINER_READER_OK;
+  return self;
+
+fail:
+  container_reader_free(self);
+  return NULL;
+}
+
+gboolean
+container_reader_is_matroska(const ContainerReader *self)
+{
+  return self->is_matroska;
+}
+
+guint
+container_reader_get_num_samples(const ContainerReader *self)
+{
+  return self->samples->len;
+}
+
+gboolean
+container_reader_get_sample_info(
+    const ContainerReader *self, guint index, ContainerReaderSampleInfo *info)
+{
+  if (index >= self->samples->len) return FALSE;
+
+  const ReaderSample *sample = &g_array_index(self->samples, ReaderSample, index);
+  info->data = sample->data;
+  info->size = sample->size;
+  info->offset = sample->data - self->data;
+  info->pts = sample->pts;
+  info->is_keyframe = sample->is_keyframe;
+
+  return TRUE;
+}
+
+ContainerReaderResult
+container_reader_run_sample(
+    ContainerReader *self, guint index, ContainerReaderFunc func, gpointer user_data)
+{
+  if (index >= self->samples->len) return CONTAINER_READER_ERROR;
+
+  const ReaderSample *sample = &g_array_index(self->samples, ReaderSample, index);
+  gsize pos = 0;
+
+  while (pos < sample->size) {
+    const guint8 *nalu = sample->data + pos;
+    const gsize available = sample->size - pos;
+    gsize nalu_size = 0;
+
+    if (self->codec == SV_CODEC_AV1) {
+      // The last OBU of a sample may omit the size field.
+      nalu_size = av1_get_obu_size(nalu, available);
+    } else if (available >= NALU_LENGTH_SIZE) {
+      nalu_size = NALU_LENGTH_SIZE + (gsize)GST_READ_UINT32_BE(nalu);
+    }
+    if (nalu_size == 0 || nalu_size > available) {
+      g_warning("sample %u is corrupt", index);
+      return CONTAINER_READER_ERROR;
+    }
+    if (!func(nalu, nalu_size, user_data)) return CONTAINER_READER_ERROR;
+    pos += nalu_size;
+  }
+
+  return CONTAINER_READER_OK;
+}
+
+ContainerReaderResult
+container_reader_run_range(
+    ContainerReader *self, guint first, guint last, ContainerReaderFunc func, gpointer user_data)
+{
+  last = MIN(last, self->samples->len);
+  if (first >= last) return CONTAINER_READER_OK;
+
+  // Like h264parse and h265parse, put the parameter sets of the decoder configuration in front
+  // of the first sample, unless it has them in-band.
+  const ReaderSample *sample = &g_array_index(self->samples, ReaderSample, first);
+  if (self->param_sets->len > 0 && !has_sps(self, sample)) {
+    gsize pos = 0;
+    while (pos < self->param_sets->len) {
+      const gsize nalu_size = NALU_LENGTH_SIZE + GST_READ_UINT32_BE(self->param_sets->data + pos);
+      if (!func(self->param_sets->data + pos, nalu_size, user_data)) {
+        return CONTAINER_READER_ERROR;
+      }
+      pos += nalu_size;
+    }
+  }
+
+  for (guint i = first; i < last; i++) {
+    ContainerReaderResult result = container_reader_run_sample(self, i, func, user_data);
+    if (result != CONTAINER_READER_OK) return result;
+  }
+
+  return CONTAINER_READER_OK;
+}
+
+ContainerReaderResult
+container_reader_run(ContainerReader *self, ContainerReaderFunc func, gpointer user_data)
+{
+  return container_reader_run_range(self, 0, self->samples->len, func, user_data);
+}
+
+void
+container_reader_free(ContainerReader *self)
+{
+  if (!self) return;
+
+  if (self->file) g_mapped_file_unref(self->file);
+  g_array_free(self->samples, TRUE);
+  g_byte_array_free(self->param_sets, TRUE);
+  g_free(self);
+}
@@ -0,0 +1,94 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CONTAINER_READER_H__
+#define __CONTAINER_READER_H__
+
+#include <glib.h>
+
+#include <signed-video-framework/signed_video_common.h>
+
+typedef enum {
+  CONTAINER_READER_OK = 0,
+  CONTAINER_READER_UNSUPPORTED,  // The file has to be read with GStreamer
+  CONTAINER_READER_ERROR,
+} ContainerReaderResult;
+
+typedef struct _ContainerReader ContainerReader;
+
+/* Called for every nalu, or OBU, of the video track in decode order. H264 and H265 nalus have a
+ * 4 byte size in front, i.e., the same layout as from the GStreamer pipeline. |nalu| points into
+ * the mapped file and stays valid until the reader is freed. Returns FALSE to stop reading. */
+typedef gboolean (*ContainerReaderFunc)(const guint8 *nalu, gsize nalu_size, gpointer user_data);
+
+/* Memory-maps an MP4 or Matroska file and indexes the samples of its video track, which has to be
+ * coded with |codec|. Returns NULL and sets |result| to UNSUPPORTED if the file cannot be read
+ * without GStreamer, e.g., fragmented MP4 or laced Matroska blocks, and to ERROR if it cannot be
+ * read at all. */
+ContainerReader *
+container_reader_new(const gchar *filename, SignedVideoCodec codec, ContainerReaderResult *result);
+
+/* Checks if the file is Matroska, which is written block by block, hence a recording that is
+ * still growing can be read up to its latest complete block. The sample tables of MP4 are only
+ * written when the recording is finalized. */
+gboolean
+container_reader_is_matroska(const ContainerReader *self);
+
+/* Passes every nalu, or OBU, of the video track to |func|. */
+ContainerReaderResult
+container_reader_run(ContainerReader *self, ContainerReaderFunc func, gpointer user_data);
+
+/* Position and timing of a sample, i.e., an access unit, or temporal unit, of the video track. */
+typedef struct {
+  const guint8 *data;  // Points into the mapped file
+  gsize size;
+  guint64 offset;  // Byte offset of the sample in the file
+  gint64 pts;  // Presentation timestamp in nanoseconds, as stored in the file
+  gboolean is_keyframe;  // A sync sample of MP4, or a keyframe block of Matroska
+} ContainerReaderSampleInfo;
+
+/* Returns the number of samples of the video track. */
+guint
+container_reader_get_num_samples(const ContainerReader *self);
+
+/* Gets the position and timing of sample |index| in decode order. Returns FALSE if there is no
+ * such sample. */
+gboolean
+container_reader_get_sample_info(
+    const ContainerReader *self, guint index, ContainerReaderSampleInfo *info);
+
+/* Passes the nalus, or OBUs, of sample |index| to |func|, without any parameter sets of the
+ * decoder configuration. */
+ContainerReaderResult
+container_reader_run_sample(
+    ContainerReader *self, guint index, ContainerReaderFunc func, gpointer user_data);
+
+/* Passes every nalu, or OBU, of samples |first| up to, but not including, |last| to |func|. The
+ * parameter sets of the decoder configuration are passed first, unless sample |first| carries
+ * them in-band, hence validation can start at any keyframe. */
+ContainerReaderResult
+container_reader_run_range(
+    ContainerReader *self, guint first, guint last, ContainerReaderFunc func, gpointer user_data);
+
+void
+container_reader_free(ContainerReader *self);
+
+#endif  // __CONTAINER_READER_H__
@@ -0,0 +1,284 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gop_index.h"
+
+#include <glib/gstdio.h>  // g_stat
+#include <string.h>  // memcmp, memcpy
+
+#include "validation.h"  // is_signed_video_sei
+
+/* File layout, all numbers big-endian:
+ *   header: magic (4), format version (1), codec (1), reserved (2), size of the recording (8),
+ *           modification time of the recording in seconds (8), number of samples (4), number of
+ *           entries (4), presentation timestamp of the first sample in nanoseconds (8)
+ *   entries: sample index (4), flags (4), byte offset (8), presentation timestamp (8) */
+#define GOP_INDEX_MAGIC "SVIX"
+#define GOP_INDEX_FORMAT_VERSION 1
+#define GOP_INDEX_HEADER_SIZE 40
+#define GOP_INDEX_ENTRY_SIZE 24
+
+#define GOP_INDEX_FLAG_KEYFRAME 0x01
+#define GOP_INDEX_FLAG_SIGNED_VIDEO_SEI 0x02
+
+#define NANOSECONDS_PER_SECOND 1e9
+
+/* A keyframe, or a sample carrying a Signed Video SEI, or both. */
+typedef struct {
+  guint32 sample;
+  guint32 flags;
+  guint64 offset;
+  gint64 pts;  // In nanoseconds
+} GopIndexEntry;
+
+struct _GopIndex {
+  SignedVideoCodec codec;
+  guint64 file_size;
+  gint64 file_mtime;
+  guint32 num_samples;
+  gint64 start_pts;  // Earliest presentation timestamp of the recording
+  GArray *entries;  // GopIndexEntry in decode order
+};
+
+/* Context when scanning a sample for Signed Video SEIs. */
+typedef struct {
+  SignedVideoCodec codec;
+  gboolean has_sei;
+} SampleScan;
+
+static guint64
+read_be(const guint8 *data, guint num_bytes)
+{
+  guint64 value = 0;
+
+  for (guint i = 0; i < num_bytes; i++) value = (value << 8) | data[i];
+
+  return value;
+}
+
+static void
+write_be(guint8 *data, guint64 value, guint num_bytes)
+{
+  for (guint i = num_bytes; i > 0; i--) {
+    data[i - 1] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static gboolean
+on_nalu_scan_for_sei(const guint8 *nalu, gsize nalu_size, gpointer user_data)
+{
+  SampleScan *scan = (SampleScan *)user_data;
+
+  scan->has_sei = is_signed_video_sei(nalu, nalu_size, scan->codec);
+  // Stop at the first SEI.
+  return !scan->has_sei;
+}
+
+/* Builds the index by scanning every sample. Only the nalu headers, and the payload start of SEIs,
+ * are read, hence far less than the recording is touched. */
+static void
+gop_index_build(GopIndex *self, ContainerReader *reader)
+{
+  self->start_pts = G_MAXINT64;
+  for (guint32 i = 0; i < self->num_samples; i++) {
+    ContainerReaderSampleInfo info = {0};
+    SampleScan scan = {.codec = self->codec};
+    GopIndexEntry entry = {.sample = i};
+
+    container_reader_get_sample_info(reader, i, &info);
+    self->start_pts = MIN(self->start_pts, info.pts);
+    // A corrupt sample is reported when validated, and is not indexed.
+    container_reader_run_sample(reader, i, on_nalu_scan_for_sei, &scan);
+
+    entry.flags = (info.is_keyframe ? GOP_INDEX_FLAG_KEYFRAME : 0) |
+        (scan.has_sei ? GOP_INDEX_FLAG_SIGNED_VIDEO_SEI : 0);
+    if (entry.flags == 0) continue;
+    entry.offset = info.offset;
+    entry.pts = info.pts;
+    g_array_append_val(self->entries, entry);
+  }
+  if (self->num_samples == 0) self->start_pts = 0;
+}
+
+/* Loads the index from |path|. Returns FALSE if it is missing, belongs to another version of the
+ * recording, or does not match the samples of |reader|. */
+static gboolean
+gop_index_load(GopIndex *self, const gchar *path, ContainerReader *reader)
+{
+  gchar *contents = NULL;
+  gsize length = 0;
+  gboolean success = FALSE;
+
+  if (!g_file_get_contents(path, &contents, &length, NULL)) return FALSE;
+
+  const guint8 *data = (const guint8 *)contents;
+  if (length < GOP_INDEX_HEADER_SIZE || memcmp(data, GOP_INDEX_MAGIC, 4) != 0 ||
+      data[4] != GOP_INDEX_FORMAT_VERSION || data[5] != (guint8)self->codec ||
+      read_be(data + 8, 8) != self->file_size ||
+      (gint64)read_be(data + 16, 8) != self->file_mtime ||
+      read_be(data + 24, 4) != self->num_samples) {
+    goto out;
+  }
+  const guint32 num_entries = read_be(data + 28, 4);
+  if ((length - GOP_INDEX_HEADER_SIZE) / GOP_INDEX_ENTRY_SIZE != num_entries) goto out;
+  self->start_pts = (gint64)read_be(data + 32, 8);
+
+  g_array_set_size(self->entries, num_entries);
+  for (guint32 i = 0; i < num_entries; i++) {
+    const guint8 *e = data + GOP_INDEX_HEADER_SIZE + GOP_INDEX_ENTRY_SIZE * (gsize)i;
+    GopIndexEntry *entry = &g_array_index(self->entries, GopIndexEntry, i);
+    ContainerReaderSampleInfo info = {0};
+
+    entry->sample = read_be(e, 4);
+    entry->flags = read_be(e + 4, 4);
+    entry->offset = read_be(e + 8, 8);
+    entry->pts = (gint64)read_be(e + 16, 8);
+    // The samples have to be where the index says, otherwise the index is rebuilt.
+    if (!container_reader_get_sample_info(reader, entry->sample, &info) ||
+        info.offset != entry->offset || info.pts != entry->pts) {
+      goto out;
+    }
+  }
+  success = TRUE;
+
+out:
+  if (!success) g_array_set_size(self->entries, 0);
+  g_free(contents);
+  return success;
+}
+
+static void
+gop_index_save(const GopIndex *self, const gchar *path)
+{
+  const gsize length = GOP_INDEX_HEADER_SIZE + GOP_INDEX_ENTRY_SIZE * (gsize)self->entries->len;
+  guint8 *data = g_malloc0(length);
+  GError *error = NULL;
+
+  memcpy(data, GOP_INDEX_MAGIC, 4);
+  data[4] = GOP_INDEX_FORMAT_VERSION;
+  data[5] = (guint8)self->codec;
+  write_be(data + 8, self->file_size, 8);
+  write_be(data + 16, (guint64)self->file_mtime, 8);
+  write_be(data + 24, self->num_samples, 4);
+  write_be(data + 28, self->entries->len, 4);
+  write_be(data + 32, (guint64)self->start_pts, 8);
+  for (guint i = 0; i < self->entries->len; i++) {
+    const GopIndexEntry *entry = &g_array_index(self->entries, GopIndexEntry, i);
+    guint8 *e = data + GOP_INDEX_HEADER_SIZE + GOP_INDEX_ENTRY_SIZE * (gsize)i;
+
+    write_be(e, entry->sample, 4);
+    write_be(e + 4, entry->flags, 4);
+    write_be(e + 8, entry->offset, 8);
+    write_be(e + 16, (guint64)entry->pts, 8);
+  }
+
+  // The recording may be on read-only storage, in which case the index is built every time.
+  if (!g_file_set_contents(path, (const gchar *)data, length, &error)) {
+    g_message("could not save the index: %s", error->message);
+    g_error_free(error);
+  }
+  g_free(data);
+}
+
+GopIndex *
+gop_index_new(const gchar *filename, ContainerReader *reader, SignedVideoCodec codec)
+{
+  GopIndex *self = NULL;
+  GStatBuf st;
+  gchar *path = NULL;
+
+  if (g_stat(filename, &st) != 0) {
+    g_warning("failed to get the size of '%s'", filename);
+    return NULL;
+  }
+
+  self = g_new0(GopIndex, 1);
+  self->codec = codec;
+  self->file_size = st.st_size;
+  self->file_mtime = st.st_mtime;
+  self->num_samples = container_reader_get_num_samples(reader);
+  self->entries = g_array_new(FALSE, FALSE, sizeof(GopIndexEntry));
+
+  path = g_strconcat(filename, GOP_INDEX_SUFFIX, NULL);
+  if (gop_index_load(self, path, reader)) {
+    g_message("Using the index '%s'", path);
+  } else {
+    g_message("Building the index '%s'", path);
+    gop_index_build(self, reader);
+    gop_index_save(self, path);
+  }
+  g_free(path);
+
+  return self;
+}
+
+void
+gop_index_get_range(const GopIndex *self, gdouble from, gdouble to, guint *first, guint *last)
+{
+  const GopIndexEntry *previous_keyframe = NULL;
+  const GopIndexEntry *from_keyframe = NULL;
+  const GopIndexEntry *to_keyframe = NULL;
+
+  *first = 0;
+  *last = self->num_samples;
+
+  for (guint i = 0; i < self->entries->len; i++) {
+    const GopIndexEntry *entry = &g_array_index(self->entries, GopIndexEntry, i);
+    const gdouble time = (entry->pts - self->start_pts) / NANOSECONDS_PER_SECOND;
+
+    if (to_keyframe) {
+      // The first SEI after the GOP holding |to|.
+      if (entry->flags & GOP_INDEX_FLAG_SIGNED_VIDEO_SEI) {
+        *last = entry->sample + 1;
+        break;
+      }
+      continue;
+    }
+    if (!(entry->flags & GOP_INDEX_FLAG_KEYFRAME)) continue;
+    if (time <= from) {
+      previous_keyframe = from_keyframe;
+      from_keyframe = entry;
+    } else if (to >= 0 && time > to) {
+      to_keyframe = entry;
+      // The keyframe may carry the SEI itself.
+      if (entry->flags & GOP_INDEX_FLAG_SIGNED_VIDEO_SEI) {
+        *last = entry->sample + 1;
+        break;
+      }
+    }
+  }
+
+  if (previous_keyframe) {
+    *first = previous_keyframe->sample;
+  } else if (from_keyframe) {
+    *first = from_keyframe->sample;
+  }
+}
+
+void
+gop_index_free(GopIndex *self)
+{
+  if (!self) return;
+
+  g_array_free(self->entries, TRUE);
+  g_free(self);
+}
@@ -0,0 +1,60 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GOP_INDEX_H__
+#define __GOP_INDEX_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_common.h>
+
+#include "container_reader.h"
+
+/* An index of the keyframes and Signed Video SEIs of a recording read by the built-in container
+ * reader, with their byte offsets and presentation timestamps. It is stored as a sidecar file next
+ * to the recording, |filename| + GOP_INDEX_SUFFIX, and reused as long as the recording has not
+ * changed. With the index, a time range of a long recording can be validated without reading it
+ * from the start. */
+
+#define GOP_INDEX_SUFFIX ".svindex"
+
+typedef struct _GopIndex GopIndex;
+
+/* Loads the sidecar index of |filename|, read by |reader|, if it is up to date. Otherwise the index
+ * is built by scanning the nalus, or OBUs, of every sample for Signed Video SEIs, and saved for the
+ * next time. Failing to save the index is not an error. Returns NULL if the index could not be
+ * built. */
+GopIndex *
+gop_index_new(const gchar *filename, ContainerReader *reader, SignedVideoCodec codec);
+
+/* Gets the samples to validate, from |first| up to, but not including, |last|, to cover the time
+ * range |from| to |to| in seconds from the start of the recording. A negative |to| means the end
+ * of the recording. The range starts at the keyframe of the GOP in front of the one holding |from|,
+ * since the first GOP after a seek cannot be linked to a previous GOP, and ends with the first
+ * Signed Video SEI after the GOP holding |to|, which is the SEI signing that GOP. */
+void
+gop_index_get_range(const GopIndex *self, gdouble from, gdouble to, guint *first, guint *last);
+
+void
+gop_index_free(GopIndex *self);
+
+#endif  // __GOP_INDEX_H__
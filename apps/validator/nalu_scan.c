@@ -0,0 +1,311 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nalu_scan.h"
+
+#include <string.h>  // memcmp
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NALU_SCAN_X86
+#include <immintrin.h>
+#endif
+
+#define NALU_LENGTH_SIZE 4
+#define H264_NALU_TYPE_IDR 5
+#define H264_NALU_TYPE_SEI 6
+#define H265_NALU_TYPE_BLA_W_LP 16
+#define H265_NALU_TYPE_RSV_IRAP_23 23
+#define H265_NALU_TYPE_PREFIX_SEI 39
+#define SEI_TYPE_USER_DATA_UNREGISTERED 5
+
+const guint8 kUuidSignedVideo[16] = {
+    0x53, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x56, 0x69, 0x64, 0x65, 0x6f, 0x2e, 0x2e, 0x2e, 0x30};
+
+/* A three byte start code is searched for, i.e., 0x00 0x00 0x01. The functions return the offset
+ * of its first byte, or |size| if there is none. */
+typedef gsize (*FindStartCodeFunc)(const guint8 *data, gsize size, gsize offset);
+typedef bool (*IsUuidFunc)(const guint8 *data);
+
+typedef struct {
+  const gchar *name;
+  FindStartCodeFunc find_start_code;
+  IsUuidFunc is_uuid;
+} NaluScanImplementation;
+
+static gsize
+find_start_code_scalar(const guint8 *data, gsize size, gsize offset)
+{
+  gsize i = offset + 2;
+
+  // Look at the last byte of a possible start code. Neither a start code ending at |i|, nor at
+  // the two following bytes, is possible if it is larger than 1.
+  while (i < size) {
+    if (data[i] > 1) {
+      i += 3;
+    } else if (data[i] == 0) {
+      i++;
+    } else {
+      if (data[i - 1] == 0 && data[i - 2] == 0) return i - 2;
+      i += 3;
+    }
+  }
+  return size;
+}
+
+static bool
+is_uuid_scalar(const guint8 *data)
+{
+  return memcmp(data, kUuidSignedVideo, sizeof(kUuidSignedVideo)) == 0;
+}
+
+#ifdef NALU_SCAN_X86
+/* Checks 16 positions at a time by comparing three shifted loads, with 0, 0 and 1, and combining
+ * the results. The last bytes are left to the scalar version. */
+__attribute__((target("sse2"))) static gsize
+find_start_code_sse2(const guint8 *data, gsize size, gsize offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  gsize i = offset;
+
+  while (size >= 18 && i <= size - 18) {
+    __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), zero);
+    __m128i second = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 1)), zero);
+    __m128i third = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 2)), one);
+    int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(first, second), third));
+    if (mask) return i + __builtin_ctz(mask);
+    i += 16;
+  }
+  return find_start_code_scalar(data, size, i);
+}
+
+__attribute__((target("sse2"))) static bool
+is_uuid_sse2(const guint8 *data)
+{
+  __m128i uuid = _mm_loadu_si128((const __m128i *)kUuidSignedVideo);
+  __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, uuid)) == 0xffff;
+}
+
+/* Same as the SSE2 version, but 32 positions at a time. */
+__attribute__((target("avx2"))) static gsize
+find_start_code_avx2(const guint8 *data, gsize size, gsize offset)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  gsize i = offset;
+
+  while (size >= 34 && i <= size - 34) {
+    __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), zero);
+    __m256i second = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 1)), zero);
+    __m256i third = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 2)), one);
+    guint32 mask =
+        (guint32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(first, second), third));
+    if (mask) return i + __builtin_ctz(mask);
+    i += 32;
+  }
+  return find_start_code_sse2(data, size, i);
+}
+#endif
+
+/* In order of preference. The UUID is only 16 bytes, hence compared with SSE2 also by AVX2. */
+static const NaluScanImplementation kImplementations[] = {
+#ifdef NALU_SCAN_X86
+    {"avx2", find_start_code_avx2, is_uuid_sse2},
+    {"sse2", find_start_code_sse2, is_uuid_sse2},
+#endif
+    {"scalar", find_start_code_scalar, is_uuid_scalar},
+};
+
+static const NaluScanImplementation *implementation = NULL;
+
+static bool
+is_supported(const NaluScanImplementation *impl)
+{
+#ifdef NALU_SCAN_X86
+  if (strcmp(impl->name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+  if (strcmp(impl->name, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+  return true;
+}
+
+static const NaluScanImplementation *
+get_implementation(void)
+{
+  const NaluScanImplementation *impl = g_atomic_pointer_get(&implementation);
+
+  if (impl) return impl;
+
+  // Picking the same implementation in several threads at once is harmless.
+  for (guint i = 0; i < G_N_ELEMENTS(kImplementations); i++) {
+    if (is_supported(&kImplementations[i])) {
+      impl = &kImplementations[i];
+      break;
+    }
+  }
+  g_atomic_pointer_set(&implementation, (gpointer)impl);
+
+  return impl;
+}
+
+static guint32
+read_uint32_be(const guint8 *data)
+{
+  return ((guint32)data[0] << 24) | ((guint32)data[1] << 16) | ((guint32)data[2] << 8) | data[3];
+}
+
+gsize
+nalu_scan_prefix_size(const guint8 *nalu, gsize nalu_size, NaluPrefixType *type)
+{
+  NaluPrefixType prefix_type = NALU_PREFIX_NONE;
+  gsize prefix_size = 0;
+
+  if (nalu_size >= 4 && nalu[0] == 0 && nalu[1] == 0 && nalu[2] == 0 && nalu[3] == 1) {
+    prefix_type = NALU_PREFIX_START_CODE;
+    prefix_size = 4;
+  } else if (nalu_size >= NALU_LENGTH_SIZE &&
+      read_uint32_be(nalu) == nalu_size - NALU_LENGTH_SIZE) {
+    // Checked before three byte start codes, since, e.g., 0x00 0x00 0x01 0x20 is a valid size.
+    prefix_type = NALU_PREFIX_LENGTH;
+    prefix_size = NALU_LENGTH_SIZE;
+  } else if (nalu_size >= 3 && nalu[0] == 0 && nalu[1] == 0 && nalu[2] == 1) {
+    prefix_type = NALU_PREFIX_START_CODE;
+    prefix_size = 3;
+  } else if (nalu_size >= NALU_LENGTH_SIZE) {
+    prefix_type = NALU_PREFIX_LENGTH;
+    prefix_size = NALU_LENGTH_SIZE;
+  }
+
+  if (type) *type = prefix_type;
+  return prefix_size;
+}
+
+gsize
+nalu_scan_find_start_code(const guint8 *data, gsize size, gsize offset)
+{
+  gsize pos = offset;
+
+  if (offset >= size) return size;
+
+  pos = get_implementation()->find_start_code(data, size, offset);
+  if (pos < size && pos > offset && data[pos - 1] == 0) pos--;
+
+  return pos;
+}
+
+bool
+nalu_scan_is_signed_video_uuid(const guint8 *data)
+{
+  return get_implementation()->is_uuid(data);
+}
+
+bool
+nalu_scan_is_signed_video_sei(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec)
+{
+  gsize idx = nalu_scan_prefix_size(nalu, nalu_size, NULL);
+
+  // Determine if this is a SEI of type user data unregistered.
+  if (codec == SV_CODEC_H264) {
+    // H.264: 0x06 0x05
+    if (idx + 2 > nalu_size) return false;
+    if ((nalu[idx] & 0x1f) != H264_NALU_TYPE_SEI) return false;
+    if (nalu[idx + 1] != SEI_TYPE_USER_DATA_UNREGISTERED) return false;
+    idx += 2;
+  } else if (codec == SV_CODEC_H265) {
+    // H.265: 0x4e 0x?? 0x05
+    if (idx + 3 > nalu_size) return false;
+    if ((nalu[idx] & 0x7e) >> 1 != H265_NALU_TYPE_PREFIX_SEI) return false;
+    if (nalu[idx + 2] != SEI_TYPE_USER_DATA_UNREGISTERED) return false;
+    idx += 3;
+  } else {
+    return false;
+  }
+
+  // Move past payload size.
+  while (idx < nalu_size && nalu[idx] == 0xff) {
+    idx++;
+  }
+  idx++;
+
+  // Verify Signed Video UUID (16 bytes).
+  if (idx + sizeof(kUuidSignedVideo) > nalu_size) return false;
+  return get_implementation()->is_uuid(&nalu[idx]);
+}
+
+bool
+nalu_scan_is_keyframe(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec)
+{
+  gsize idx = nalu_scan_prefix_size(nalu, nalu_size, NULL);
+  guint8 type = 0;
+
+  if (idx >= nalu_size) return false;
+
+  if (codec == SV_CODEC_H264) return (nalu[idx] & 0x1f) == H264_NALU_TYPE_IDR;
+  if (codec != SV_CODEC_H265) return false;
+
+  type = (nalu[idx] & 0x7e) >> 1;
+  return type >= H265_NALU_TYPE_BLA_W_LP && type <= H265_NALU_TYPE_RSV_IRAP_23;
+}
+
+gsize
+nalu_scan_find_signed_video_sei(
+    const guint8 *data, gsize size, gsize offset, SignedVideoCodec codec)
+{
+  const NaluScanImplementation *impl = get_implementation();
+  gsize pos = impl->find_start_code(data, size, offset);
+
+  while (pos < size) {
+    const gsize header = pos + 3;
+    bool is_sei = false;
+
+    if (header < size) {
+      is_sei = codec == SV_CODEC_H264 ? (data[header] & 0x1f) == H264_NALU_TYPE_SEI
+                                      : (data[header] & 0x7e) >> 1 == H265_NALU_TYPE_PREFIX_SEI;
+    }
+    // Only SEIs are delimited, by the next start code, and checked further.
+    gsize next = impl->find_start_code(data, size, header);
+    if (is_sei && nalu_scan_is_signed_video_sei(data + pos, next - pos, codec)) {
+      return (pos > offset && data[pos - 1] == 0) ? pos - 1 : pos;
+    }
+    pos = next;
+  }
+
+  return size;
+}
+
+const gchar *
+nalu_scan_get_implementation(void)
+{
+  return get_implementation()->name;
+}
+
+bool
+nalu_scan_set_implementation(const gchar *name)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(kImplementations); i++) {
+    if (strcmp(kImplementations[i].name, name) == 0 && is_supported(&kImplementations[i])) {
+      g_atomic_pointer_set(&implementation, (gpointer)&kImplementations[i]);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,86 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NALU_SCAN_H__
+#define __NALU_SCAN_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_common.h>
+
+/* Classification of H.26x nalus, and scanning of byte-streams, as done for every nalu by the
+ * validator. Start codes and the Signed Video UUID are searched with AVX2 or SSE2 if the CPU
+ * supports it, otherwise with plain C. The implementation is picked at first use. */
+
+/* How a nalu is delimited. */
+typedef enum {
+  NALU_PREFIX_NONE = 0,
+  NALU_PREFIX_START_CODE,  // 3 or 4 byte start code
+  NALU_PREFIX_LENGTH,  // 4 byte big-endian size, e.g., as stored in MP4 and Matroska files
+} NaluPrefixType;
+
+/* Need to be the same as in signed-video-framework. */
+extern const guint8 kUuidSignedVideo[16];
+
+/* Returns the size of the start code, or length prefix, in front of the nalu header of |nalu|,
+ * and sets |type|, if not NULL. A prefix holding the size of the rest of |nalu| is taken as a
+ * length, also if it looks like a start code. Without a recognizable prefix, the first 4 bytes are
+ * assumed to be a size, since that is common in, e.g., GStreamer. */
+gsize
+nalu_scan_prefix_size(const guint8 *nalu, gsize nalu_size, NaluPrefixType *type);
+
+/* Returns the offset of the first start code at, or after, |offset|, or |size| if there is none.
+ * A zero byte in front of a three byte start code is included, i.e., four byte start codes are
+ * returned as such. */
+gsize
+nalu_scan_find_start_code(const guint8 *data, gsize size, gsize offset);
+
+/* Checks if the 16 bytes at |data| are the Signed Video UUID. */
+bool
+nalu_scan_is_signed_video_uuid(const guint8 *data);
+
+/* Checks if |nalu|, with or without prefix, is a SEI of type user data unregistered generated by
+ * Signed Video. Never reads outside |nalu_size| bytes. */
+bool
+nalu_scan_is_signed_video_sei(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec);
+
+/* Checks if |nalu|, with or without prefix, is a slice of a keyframe, i.e., an IDR picture for
+ * H.264, or an IRAP picture for H.265. */
+bool
+nalu_scan_is_keyframe(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec);
+
+/* Returns the offset of the start code of the first Signed Video SEI at, or after, |offset| in the
+ * byte-stream |data|, or |size| if there is none. */
+gsize
+nalu_scan_find_signed_video_sei(
+    const guint8 *data, gsize size, gsize offset, SignedVideoCodec codec);
+
+/* Returns the name of the implementation in use, i.e., "avx2", "sse2" or "scalar". */
+const gchar *
+nalu_scan_get_implementation(void);
+
+/* Uses the implementation |name| from now on, e.g., to benchmark them against each other. Returns
+ * false if |name| is unknown, or not supported by the CPU. */
+bool
+nalu_scan_set_implementation(const gchar *name);
+
+#endif  // __NALU_SCAN_H__
@@ -0,0 +1,344 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "parallel_validation.h"
+
+#define RANGE_NUM_GOPS 16  // Number of GOPs, starting at a SEI or a keyframe, in a range
+#define RANGE_MAX_NALUS 8192  // Number of nalus after which a range is closed anyway
+#define RANGE_MAX_BYTES (64 * 1024 * 1024)  // Number of bytes after which a range is closed anyway
+#define RANGE_OVERLAP_SEIS 2  // Number of SEIs of the previous range to validate again
+
+/* A nalu to validate. Either |mem| is set, or |data| stays valid until the validation has
+ * finished. */
+typedef struct {
+  GstMemory *mem;
+  const guint8 *data;
+  gsize size;  // Also set for |mem|
+  bool is_sei;  // Classified once, when added
+} ParallelNalu;
+
+typedef struct {
+  guint index;
+  GArray *nalus;  // ParallelNalu of the range, including the overlap with the previous range
+  guint owned_from;  // Index of the first nalu belonging to this range
+  guint num_owned;  // Number of nalus belonging to this range
+  ValidationData result;
+  signed_video_authenticity_t *report;  // Accumulated validation of the range
+} ValidationRange;
+
+struct _ParallelValidation {
+  SignedVideoCodec codec;
+  bool no_container;
+  gchar *this_version;
+
+  GThreadPool *pool;
+  guint max_pending;
+  GMutex lock;
+  GCond cond;
+  guint pending;  // Ranges pushed, but not yet validated
+  GPtrArray *ranges;  // All ranges in stream order
+
+  GArray *window;  // ParallelNalu of the current range, preceded by the overlap
+  GArray *seis;  // Indices in |window| of Signed Video SEIs
+  guint range_start;  // Index in |window| of the first nalu of the current range
+  guint num_range_gops;
+  gsize num_range_bytes;
+  bool in_gop_start;  // The latest nalu was a Signed Video SEI, or a keyframe
+};
+
+static void
+parallel_nalu_clear(ParallelNalu *nalu)
+{
+  if (nalu->mem) gst_memory_unref(nalu->mem);
+}
+
+static void
+validation_range_free(ValidationRange *range)
+{
+  if (!range) return;
+
+  if (range->nalus) g_array_unref(range->nalus);
+  signed_video_free(range->result.sv);
+  g_free(range->result.this_version);
+  g_free(range->result.version_on_signing_side);
+  signed_video_authenticity_report_free(range->report);
+  g_free(range);
+}
+
+/* Worker thread function validating one range with a Signed Video session of its own. */
+static void
+validate_range(ValidationRange *range, ParallelValidation *self)
+{
+  ValidationData *data = &range->result;
+  GstMapInfo info;
+
+  data->sv = signed_video_create(self->codec);
+  if (!data->sv) {
+    g_critical("failed creating a Signed Video session for range %u", range->index);
+    goto done;
+  }
+
+  for (guint i = 0; i < range->nalus->len; i++) {
+    ParallelNalu *nalu = &g_array_index(range->nalus, ParallelNalu, i);
+    bool is_owned = (i >= range->owned_from);
+
+    if (nalu->mem) {
+      if (!gst_memory_map(nalu->mem, &info, GST_MAP_READ)) {
+        g_critical("failed to map memory in range %u", range->index);
+        goto done;
+      }
+    } else {
+      info.data = (guint8 *)nalu->data;
+      info.size = nalu->size;
+    }
+    if (is_owned) {
+      data->total_bytes += info.size;
+      data->sei_bytes += nalu->is_sei ? info.size : 0;
+    }
+    SignedVideoReturnCode status = validation_add_nalu(data, info.data, info.size);
+    if (nalu->mem) gst_memory_unmap(nalu->mem, &info);
+
+    if (status != SV_OK) {
+      if (is_owned) g_critical("error during verification of signed video: %d", status);
+    } else if (data->auth_report && is_owned) {
+      g_free(validation_handle_report(data));
+    } else if (data->auth_report) {
+      // Validation of a GOP belonging to the previous range.
+      signed_video_authenticity_report_free(data->auth_report);
+      data->auth_report = NULL;
+    }
+  }
+  range->report = signed_video_get_authenticity_report(data->sv);
+
+  g_message("Validated range %u (%u nalus): %d valid, %d valid with missing, %d invalid and %d "
+            "unsigned GOPs",
+      range->index, range->num_owned, data->valid_gops,
+      data->valid_gops_with_missing, data->invalid_gops, data->no_sign_gops);
+
+done:
+  // Release the nalus as soon as possible, the session is not needed either.
+  g_array_unref(range->nalus);
+  range->nalus = NULL;
+  signed_video_free(data->sv);
+  data->sv = NULL;
+
+  g_mutex_lock(&self->lock);
+  self->pending--;
+  g_cond_signal(&self->cond);
+  g_mutex_unlock(&self->lock);
+}
+
+/* Pushes the first |num_nalus| nalus of the window as a range to the worker threads. */
+static void
+push_range(ParallelValidation *self, guint num_nalus)
+{
+  ValidationRange *range = g_new0(ValidationRange, 1);
+
+  range->index = self->ranges->len;
+  range->owned_from = self->range_start;
+  range->num_owned = num_nalus - self->range_start;
+  range->nalus = g_array_sized_new(FALSE, FALSE, sizeof(ParallelNalu), num_nalus);
+  g_array_set_clear_func(range->nalus, (GDestroyNotify)parallel_nalu_clear);
+  g_array_append_vals(range->nalus, self->window->data, num_nalus);
+  for (guint i = 0; i < num_nalus; i++) {
+    ParallelNalu *nalu = &g_array_index(range->nalus, ParallelNalu, i);
+    if (nalu->mem) gst_memory_ref(nalu->mem);
+  }
+  range->result.codec = self->codec;
+  range->result.no_container = self->no_container;
+  range->result.this_version = g_strdup(self->this_version);
+  g_ptr_array_add(self->ranges, range);
+
+  // Wait for a worker thread if too many ranges are queued, to limit the memory usage.
+  g_mutex_lock(&self->lock);
+  while (self->pending >= self->max_pending) {
+    g_cond_wait(&self->cond, &self->lock);
+  }
+  self->pending++;
+  g_mutex_unlock(&self->lock);
+
+  g_thread_pool_push(self->pool, range, NULL);
+}
+
+ParallelValidation *
+parallel_validation_new(const ValidationData *data, guint num_threads)
+{
+  ParallelValidation *self = g_new0(ParallelValidation, 1);
+  GError *error = NULL;
+
+  self->codec = data->codec;
+  self->no_container = data->no_container;
+  self->this_version = g_strdup(data->this_version);
+  self->max_pending = 2 * num_threads;
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->cond);
+  self->ranges = g_ptr_array_new_with_free_func((GDestroyNotify)validation_range_free);
+  self->window = g_array_new(FALSE, FALSE, sizeof(ParallelNalu));
+  g_array_set_clear_func(self->window, (GDestroyNotify)parallel_nalu_clear);
+  self->seis = g_array_new(FALSE, FALSE, sizeof(guint));
+  self->pool = g_thread_pool_new((GFunc)validate_range, self, num_threads, FALSE, &error);
+  if (!self->pool) {
+    g_warning("failed creating thread pool: %s", error->message);
+    g_error_free(error);
+    parallel_validation_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+/* Closes the current range in front of the next nalu. The next range is preceded by the nalus
+ * from RANGE_OVERLAP_SEIS SEIs back, or as many as there are. The overlap is skipped if that is
+ * too far back, since the window would otherwise grow without the SEIs of a signed stream. */
+static void
+cut_range(ParallelValidation *self)
+{
+  guint cut = self->window->len;
+  guint overlap_start = cut;
+  guint num_overlap_seis = MIN(self->seis->len, RANGE_OVERLAP_SEIS);
+
+  if (num_overlap_seis > 0) {
+    overlap_start = g_array_index(self->seis, guint, self->seis->len - num_overlap_seis);
+  }
+  if (cut - overlap_start > RANGE_MAX_NALUS) {
+    overlap_start = cut;
+    num_overlap_seis = 0;
+  }
+
+  push_range(self, cut);
+  g_array_remove_range(self->window, 0, overlap_start);
+  g_array_remove_range(self->seis, 0, self->seis->len - num_overlap_seis);
+  for (guint i = 0; i < self->seis->len; i++) {
+    g_array_index(self->seis, guint, i) -= overlap_start;
+  }
+  self->range_start = cut - overlap_start;
+  self->num_range_gops = 0;
+  self->num_range_bytes = 0;
+}
+
+static void
+add_nalu(ParallelValidation *self, const ParallelNalu *nalu, bool is_keyframe)
+{
+  // A GOP starts at a SEI, or at a keyframe unless right after a SEI, or another keyframe slice.
+  bool is_gop_start = nalu->is_sei || (is_keyframe && !self->in_gop_start);
+  guint num_range_nalus = self->window->len - self->range_start;
+
+  self->in_gop_start = nalu->is_sei || is_keyframe;
+  if ((is_gop_start && self->num_range_gops >= RANGE_NUM_GOPS) ||
+      num_range_nalus >= RANGE_MAX_NALUS || self->num_range_bytes >= RANGE_MAX_BYTES) {
+    cut_range(self);
+  }
+
+  if (nalu->is_sei) {
+    guint index = self->window->len;
+    g_array_append_val(self->seis, index);
+  }
+  if (is_gop_start) self->num_range_gops++;
+  self->num_range_bytes += nalu->size;
+  g_array_append_vals(self->window, nalu, 1);
+}
+
+void
+parallel_validation_add_memory(
+    ParallelValidation *self, GstMemory *mem, bool is_sei, bool is_keyframe)
+{
+  ParallelNalu nalu = {.mem = gst_memory_ref(mem),
+      .size = gst_memory_get_sizes(mem, NULL, NULL),
+      .is_sei = is_sei};
+
+  add_nalu(self, &nalu, is_keyframe);
+}
+
+void
+parallel_validation_add_data(
+    ParallelValidation *self, const guint8 *data, gsize size, bool is_sei, bool is_keyframe)
+{
+  ParallelNalu nalu = {.data = data, .size = size, .is_sei = is_sei};
+
+  add_nalu(self, &nalu, is_keyframe);
+}
+
+signed_video_authenticity_t *
+parallel_validation_finish(ParallelValidation *self, ValidationData *data)
+{
+  signed_video_authenticity_t *report = NULL;
+  guint num_nalus = 0;
+  bool public_key_not_ok = false;
+  bool public_key_has_changed = false;
+  bool has_timestamp = false;
+  gint64 first_timestamp = 0;
+  gint64 last_timestamp = 0;
+
+  if (self->window->len > self->range_start) push_range(self, self->window->len);
+  g_array_set_size(self->window, 0);
+  // Wait for all ranges to be validated.
+  g_thread_pool_free(self->pool, FALSE, TRUE);
+  self->pool = NULL;
+
+  for (guint i = 0; i < self->ranges->len; i++) {
+    ValidationRange *range = g_ptr_array_index(self->ranges, i);
+    signed_video_accumulated_validation_t *acc = NULL;
+
+    validation_merge(data, &range->result);
+    if (!range->report) continue;
+
+    acc = &range->report->accumulated_validation;
+    num_nalus += range->num_owned;
+    public_key_not_ok |= (acc->public_key_validation == SV_PUBKEY_VALIDATION_NOT_OK);
+    public_key_has_changed |= acc->public_key_has_changed;
+    if (acc->has_timestamp) {
+      if (!has_timestamp) first_timestamp = acc->first_timestamp;
+      last_timestamp = acc->last_timestamp;
+      has_timestamp = true;
+    }
+    // The report of the last range carries the state at the end of the stream.
+    signed_video_authenticity_report_free(report);
+    report = range->report;
+    range->report = NULL;
+  }
+
+  if (report) {
+    signed_video_accumulated_validation_t *acc = &report->accumulated_validation;
+    acc->number_of_received_nalus = num_nalus;
+    acc->public_key_has_changed = public_key_has_changed;
+    if (public_key_not_ok) acc->public_key_validation = SV_PUBKEY_VALIDATION_NOT_OK;
+    acc->has_timestamp = has_timestamp;
+    acc->first_timestamp = first_timestamp;
+    acc->last_timestamp = last_timestamp;
+  }
+
+  return report;
+}
+
+void
+parallel_validation_free(ParallelValidation *self)
+{
+  if (!self) return;
+
+  if (self->pool) g_thread_pool_free(self->pool, TRUE, TRUE);
+  g_array_unref(self->window);
+  g_array_free(self->seis, TRUE);
+  g_ptr_array_unref(self->ranges);
+  g_mutex_clear(&self->lock);
+  g_cond_clear(&self->cond);
+  g_free(self->this_version);
+  g_free(self);
+}
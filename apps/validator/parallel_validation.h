@@ -0,0 +1,69 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PARALLEL_VALIDATION_H__
+#define __PARALLEL_VALIDATION_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_auth.h>
+
+#include "validation.h"
+
+/* Parallel validation splits the stream into ranges of a fixed number of GOPs, each starting at a
+ * Signed Video SEI, or at a keyframe. A range is also closed once it holds too many nalus, or
+ * bytes, e.g., for unsigned streams, or streams with very long GOPs. Every range is validated by
+ * its own Signed Video session on a worker thread. To still check the linking between GOPs across
+ * a border, a range is preceded by the last nalus of the previous range, starting a few SEIs back.
+ * Authenticity reports triggered by these nalus are ignored, since they belong to the previous
+ * range. */
+
+/* Creates a parallel validation using up to |num_threads| worker threads. The codec, container
+ * and version are taken from |data|. */
+ParallelValidation *
+parallel_validation_new(const ValidationData *data, guint num_threads);
+
+/* Adds a nalu, or OBU, to be validated. A reference to |mem| is kept until its range has been
+ * validated. Ranges are only cut in front of a Signed Video SEI, |is_sei|, or a keyframe,
+ * |is_keyframe|, unless they grow too large. Blocks if too many ranges are waiting for a worker
+ * thread. */
+void
+parallel_validation_add_memory(
+    ParallelValidation *self, GstMemory *mem, bool is_sei, bool is_keyframe);
+
+/* Same as parallel_validation_add_memory(), but for a nalu in |data|, which has to stay valid
+ * until parallel_validation_finish() has returned. */
+void
+parallel_validation_add_data(
+    ParallelValidation *self, const guint8 *data, gsize size, bool is_sei, bool is_keyframe);
+
+/* Validates the remaining nalus, waits for all ranges and merges their results into |data|.
+ * Returns the accumulated authenticity report of all ranges, which the caller frees with
+ * signed_video_authenticity_report_free(), or NULL if there is none. */
+signed_video_authenticity_t *
+parallel_validation_finish(ParallelValidation *self, ValidationData *data);
+
+void
+parallel_validation_free(ParallelValidation *self);
+
+#endif  // __PARALLEL_VALIDATION_H__
@@ -0,0 +1,404 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "reporter.h"
+
+#include <stdio.h>  // FILE, fdopen, fopen, fprintf, fwrite
+#include <string.h>  // memset
+#include <unistd.h>  // close, dup, STDOUT_FILENO
+
+#define WRITE_BUFFER_SIZE (1024 * 1024)
+#define GOP_RECORD_SIZE 32
+#define ERROR_RECORD_SIZE 8
+#define SUMMARY_RECORD_SIZE 56
+
+typedef enum {
+  REPORTER_ITEM_REPORT,
+  REPORTER_ITEM_ERROR,
+  REPORTER_ITEM_SUMMARY,
+  REPORTER_ITEM_STOP,
+} ReporterItemType;
+
+/* The counters and accumulated validation written as summary. */
+typedef struct {
+  gint valid_gops;
+  gint valid_gops_with_missing;
+  gint invalid_gops;
+  gint no_sign_gops;
+  SignedVideoPublicKeyValidation public_key_validation;
+  bool has_timestamp;
+  gint64 first_timestamp;
+  gint64 last_timestamp;
+  guint64 total_bytes;
+  guint64 sei_bytes;
+} ReporterSummary;
+
+typedef struct {
+  ReporterItemType type;
+  guint32 index;
+  SignedVideoReturnCode status;
+  signed_video_authenticity_t *report;
+  ReporterSummary summary;
+} ReporterItem;
+
+struct _Reporter {
+  ReporterFormat format;
+  FILE *out;  // Opened by the reporter, also for stdout
+  gchar *buffer;  // Write buffer of |out|
+  GThread *thread;
+  GAsyncQueue *queue;  // ReporterItem to write
+  guint32 num_reports;
+};
+
+static const gchar *
+authenticity_to_string(SignedVideoAuthenticityResult authenticity)
+{
+  switch (authenticity) {
+    case SV_AUTH_RESULT_OK:
+      return "valid";
+    case SV_AUTH_RESULT_NOT_OK:
+      return "invalid";
+    case SV_AUTH_RESULT_OK_WITH_MISSING_INFO:
+      return "missing";
+    case SV_AUTH_RESULT_NOT_SIGNED:
+      return "unsigned";
+    case SV_AUTH_RESULT_SIGNATURE_PRESENT:
+      return "signed";
+    case SV_AUTH_RESULT_VERSION_MISMATCH:
+      return "version_mismatch";
+    default:
+      return "unknown";
+  }
+}
+
+static const gchar *
+public_key_validation_to_string(SignedVideoPublicKeyValidation validation)
+{
+  switch (validation) {
+    case SV_PUBKEY_VALIDATION_OK:
+      return "ok";
+    case SV_PUBKEY_VALIDATION_NOT_OK:
+      return "not_ok";
+    default:
+      return "not_feasible";
+  }
+}
+
+void
+reporter_write_json_string(FILE *out, const gchar *str)
+{
+  fputc('"', out);
+  for (const gchar *c = str ? str : ""; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', out);
+      fputc(*c, out);
+    } else if ((guchar)*c < 0x20) {
+      fprintf(out, "\\u%04x", (guchar)*c);
+    } else {
+      fputc(*c, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static void
+write_json(FILE *out, const ReporterItem *item)
+{
+  switch (item->type) {
+    case REPORTER_ITEM_REPORT: {
+      const signed_video_latest_validation_t *latest = &item->report->latest_validation;
+      fprintf(out,
+          "{\"type\":\"gop\",\"index\":%u,\"authenticity\":\"%s\",\"public_key\":\"%s\","
+          "\"expected_nalus\":%d,\"received_nalus\":%d,\"pending_nalus\":%d,",
+          item->index, authenticity_to_string(latest->authenticity),
+          public_key_validation_to_string(latest->public_key_validation),
+          latest->number_of_expected_picture_nalus, latest->number_of_received_picture_nalus,
+          latest->number_of_pending_picture_nalus);
+      if (latest->has_timestamp) {
+        fprintf(out, "\"timestamp\":%" G_GINT64_FORMAT ",", (gint64)latest->timestamp);
+      }
+      fputs("\"nalus\":", out);
+      reporter_write_json_string(out, latest->nalu_str);
+      fputs(",\"validation\":", out);
+      reporter_write_json_string(out, latest->validation_str);
+      fputs("}\n", out);
+    } break;
+    case REPORTER_ITEM_ERROR:
+      fprintf(out, "{\"type\":\"error\",\"status\":%d}\n", item->status);
+      break;
+    case REPORTER_ITEM_SUMMARY: {
+      const ReporterSummary *summary = &item->summary;
+      fprintf(out,
+          "{\"type\":\"summary\",\"public_key\":\"%s\",\"valid_gops\":%d,"
+          "\"valid_gops_with_missing\":%d,\"invalid_gops\":%d,\"no_sign_gops\":%d,",
+          public_key_validation_to_string(summary->public_key_validation), summary->valid_gops,
+          summary->valid_gops_with_missing, summary->invalid_gops, summary->no_sign_gops);
+      if (summary->has_timestamp) {
+        fprintf(out,
+            "\"first_timestamp\":%" G_GINT64_FORMAT ",\"last_timestamp\":%" G_GINT64_FORMAT ",",
+            summary->first_timestamp, summary->last_timestamp);
+      }
+      fprintf(out, "\"total_bytes\":%" G_GUINT64_FORMAT ",\"sei_bytes\":%" G_GUINT64_FORMAT "}\n",
+          summary->total_bytes, summary->sei_bytes);
+    } break;
+    default:
+      break;
+  }
+}
+
+static guint8 *
+put_u32(guint8 *dst, guint32 value)
+{
+  for (int i = 0; i < 4; i++) {
+    dst[i] = (guint8)(value >> (8 * i));
+  }
+  return dst + 4;
+}
+
+static guint8 *
+put_u64(guint8 *dst, guint64 value)
+{
+  for (int i = 0; i < 8; i++) {
+    dst[i] = (guint8)(value >> (8 * i));
+  }
+  return dst + 8;
+}
+
+static void
+write_binary(FILE *out, const ReporterItem *item)
+{
+  guint8 record[SUMMARY_RECORD_SIZE] = {0};
+  guint8 *pos = record;
+
+  switch (item->type) {
+    case REPORTER_ITEM_REPORT: {
+      const signed_video_latest_validation_t *latest = &item->report->latest_validation;
+      *pos++ = REPORTER_RECORD_GOP;
+      *pos++ = (guint8)latest->authenticity;
+      *pos++ = (guint8)latest->public_key_validation;
+      *pos++ = latest->has_timestamp ? 1 : 0;
+      pos = put_u32(pos, item->index);
+      pos = put_u32(pos, (guint32)latest->number_of_expected_picture_nalus);
+      pos = put_u32(pos, (guint32)latest->number_of_received_picture_nalus);
+      pos = put_u32(pos, (guint32)latest->number_of_pending_picture_nalus);
+      pos = put_u32(pos, 0);
+      pos = put_u64(pos, latest->has_timestamp ? (guint64)latest->timestamp : 0);
+    } break;
+    case REPORTER_ITEM_ERROR:
+      *pos++ = REPORTER_RECORD_ERROR;
+      pos += 3;
+      pos = put_u32(pos, (guint32)item->status);
+      break;
+    case REPORTER_ITEM_SUMMARY: {
+      const ReporterSummary *summary = &item->summary;
+      *pos++ = REPORTER_RECORD_SUMMARY;
+      *pos++ = (guint8)summary->public_key_validation;
+      *pos++ = summary->has_timestamp ? 1 : 0;
+      pos++;
+      pos = put_u32(pos, (guint32)summary->valid_gops);
+      pos = put_u32(pos, (guint32)summary->valid_gops_with_missing);
+      pos = put_u32(pos, (guint32)summary->invalid_gops);
+      pos = put_u32(pos, (guint32)summary->no_sign_gops);
+      pos = put_u32(pos, 0);
+      pos = put_u64(pos, (guint64)summary->first_timestamp);
+      pos = put_u64(pos, (guint64)summary->last_timestamp);
+      pos = put_u64(pos, summary->total_bytes);
+      pos = put_u64(pos, summary->sei_bytes);
+    } break;
+    default:
+      return;
+  }
+  fwrite(record, 1, pos - record, out);
+}
+
+/* Thread function formatting and writing the queued items until a STOP item. */
+static gpointer
+writer_thread(gpointer user_data)
+{
+  Reporter *self = user_data;
+
+  while (true) {
+    ReporterItem *item = g_async_queue_pop(self->queue);
+    bool stop = (item->type == REPORTER_ITEM_STOP);
+
+    if (self->format == REPORTER_FORMAT_JSON) {
+      write_json(self->out, item);
+    } else {
+      write_binary(self->out, item);
+    }
+    // Summaries of live streams are read while validating, hence not left in the buffer.
+    if (item->type == REPORTER_ITEM_SUMMARY) fflush(self->out);
+    signed_video_authenticity_report_free(item->report);
+    g_free(item);
+    if (stop) break;
+  }
+  fflush(self->out);
+
+  return NULL;
+}
+
+static void
+push_item(Reporter *self, ReporterItem *item)
+{
+  if (self->thread) {
+    g_async_queue_push(self->queue, item);
+  } else {
+    // Quiet, nothing to write.
+    signed_video_authenticity_report_free(item->report);
+    g_free(item);
+  }
+}
+
+bool
+reporter_format_from_string(const gchar *str, ReporterFormat *format)
+{
+  if (g_strcmp0(str, "text") == 0) {
+    *format = REPORTER_FORMAT_TEXT;
+  } else if (g_strcmp0(str, "quiet") == 0) {
+    *format = REPORTER_FORMAT_QUIET;
+  } else if (g_strcmp0(str, "json") == 0) {
+    *format = REPORTER_FORMAT_JSON;
+  } else if (g_strcmp0(str, "binary") == 0) {
+    *format = REPORTER_FORMAT_BINARY;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+Reporter *
+reporter_new(ReporterFormat format, const gchar *filename)
+{
+  Reporter *self = g_new0(Reporter, 1);
+
+  self->format = format;
+  if (format == REPORTER_FORMAT_QUIET) return self;
+
+  const gchar *mode = format == REPORTER_FORMAT_BINARY ? "wb" : "w";
+  if (filename) {
+    self->out = fopen(filename, mode);
+  } else {
+    // A stream of its own on a duplicate of stdout, since the buffer of stdout cannot be replaced
+    // once it has been used. Anything already printed is flushed first to keep the order.
+    int fd = -1;
+
+    fflush(stdout);
+    fd = dup(STDOUT_FILENO);
+    self->out = fd >= 0 ? fdopen(fd, mode) : NULL;
+    if (!self->out && fd >= 0) close(fd);
+  }
+  if (!self->out) {
+    g_warning("could not open '%s' for writing", filename ? filename : "stdout");
+    g_free(self);
+    return NULL;
+  }
+  // Write in large chunks, since records are small. The stream has not been used yet.
+  self->buffer = g_malloc(WRITE_BUFFER_SIZE);
+  setvbuf(self->out, self->buffer, _IOFBF, WRITE_BUFFER_SIZE);
+  if (format == REPORTER_FORMAT_BINARY) fwrite(REPORTER_BINARY_MAGIC, 1, 4, self->out);
+
+  self->queue = g_async_queue_new();
+  self->thread = g_thread_new("reporter", writer_thread, self);
+
+  return self;
+}
+
+void
+reporter_add_report(Reporter *self, signed_video_authenticity_t *report)
+{
+  ReporterItem *item = g_new0(ReporterItem, 1);
+
+  item->type = REPORTER_ITEM_REPORT;
+  item->index = self->num_reports++;
+  item->report = report;
+  push_item(self, item);
+}
+
+void
+reporter_add_error(Reporter *self, SignedVideoReturnCode status)
+{
+  ReporterItem *item = g_new0(ReporterItem, 1);
+
+  item->type = REPORTER_ITEM_ERROR;
+  item->status = status;
+  push_item(self, item);
+}
+
+void
+reporter_add_summary(Reporter *self, const ValidationData *data)
+{
+  ReporterItem *item = NULL;
+
+  if (!self || !self->thread) return;
+
+  item = g_new0(ReporterItem, 1);
+  item->type = REPORTER_ITEM_SUMMARY;
+  item->summary.valid_gops = data->valid_gops;
+  item->summary.valid_gops_with_missing = data->valid_gops_with_missing;
+  item->summary.invalid_gops = data->invalid_gops;
+  item->summary.no_sign_gops = data->no_sign_gops;
+  item->summary.total_bytes = data->total_bytes;
+  item->summary.sei_bytes = data->sei_bytes;
+  if (data->auth_report) {
+    const signed_video_accumulated_validation_t *acc = &data->auth_report->accumulated_validation;
+    item->summary.public_key_validation = acc->public_key_validation;
+    item->summary.has_timestamp = acc->has_timestamp;
+    item->summary.first_timestamp = acc->first_timestamp;
+    item->summary.last_timestamp = acc->last_timestamp;
+  } else {
+    item->summary.public_key_validation = SV_PUBKEY_VALIDATION_NOT_FEASIBLE;
+  }
+  g_async_queue_push(self->queue, item);
+}
+
+void
+reporter_finish(Reporter *self, const ValidationData *data)
+{
+  ReporterItem *item = NULL;
+
+  if (!self || !self->thread) return;
+
+  reporter_add_summary(self, data);
+  item = g_new0(ReporterItem, 1);
+  item->type = REPORTER_ITEM_STOP;
+  g_async_queue_push(self->queue, item);
+  g_thread_join(self->thread);
+  self->thread = NULL;
+}
+
+void
+reporter_free(Reporter *self)
+{
+  if (!self) return;
+
+  if (self->thread) {
+    ReporterItem *item = g_new0(ReporterItem, 1);
+    item->type = REPORTER_ITEM_STOP;
+    g_async_queue_push(self->queue, item);
+    g_thread_join(self->thread);
+  }
+  if (self->queue) g_async_queue_unref(self->queue);
+  // Also flushes the stream, before its buffer is freed.
+  if (self->out) fclose(self->out);
+  g_free(self->buffer);
+  g_free(self);
+}
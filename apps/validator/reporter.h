@@ -0,0 +1,95 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __REPORTER_H__
+#define __REPORTER_H__
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>  // FILE
+
+#include <signed-video-framework/signed_video_auth.h>
+
+#include "validation.h"
+
+/* How the result of every validated GOP is reported. TEXT posts the results on the bus and
+ * prints them, as the validator always has, and does not use a Reporter. The other formats are
+ * written by a Reporter. */
+typedef enum {
+  REPORTER_FORMAT_TEXT = 0,
+  REPORTER_FORMAT_QUIET,  // Only the counters are updated
+  REPORTER_FORMAT_JSON,  // One JSON object per line
+  REPORTER_FORMAT_BINARY,  // Fixed size little-endian records, see below
+} ReporterFormat;
+
+/* The binary format starts with the 4 byte magic REPORTER_BINARY_MAGIC, followed by records.
+ * Every record starts with a 1 byte type and a 1 byte authenticity result, or public key
+ * validation for summaries, using the values of the Signed Video lib.
+ *
+ * GOP record (REPORTER_RECORD_GOP), 32 bytes:
+ *   u8 type, u8 authenticity, u8 public_key_validation, u8 has_timestamp, u32 index,
+ *   i32 expected_nalus, i32 received_nalus, i32 pending_nalus, u32 reserved, i64 timestamp
+ * Error record (REPORTER_RECORD_ERROR), 8 bytes:
+ *   u8 type, u8 reserved[3], i32 status
+ * Summary record (REPORTER_RECORD_SUMMARY), 56 bytes:
+ *   u8 type, u8 public_key_validation, u8 has_timestamp, u8 reserved, i32 valid_gops,
+ *   i32 valid_gops_with_missing, i32 invalid_gops, i32 no_sign_gops, u32 reserved,
+ *   i64 first_timestamp, i64 last_timestamp, u64 total_bytes, u64 sei_bytes */
+#define REPORTER_BINARY_MAGIC "SVR1"
+#define REPORTER_RECORD_GOP 1
+#define REPORTER_RECORD_ERROR 2
+#define REPORTER_RECORD_SUMMARY 3
+
+/* Gets the format from its name, i.e., 'text', 'quiet', 'json' or 'binary'. */
+bool
+reporter_format_from_string(const gchar *str, ReporterFormat *format);
+
+/* Creates a reporter writing to |filename|, or to stdout if NULL. JSON and binary records are
+ * formatted and written by a thread of the reporter. Returns NULL on failure. */
+Reporter *
+reporter_new(ReporterFormat format, const gchar *filename);
+
+/* Reports the latest validation of |report| and takes ownership of it. */
+void
+reporter_add_report(Reporter *self, signed_video_authenticity_t *report);
+
+/* Reports that the Signed Video lib failed with |status|. */
+void
+reporter_add_error(Reporter *self, SignedVideoReturnCode status);
+
+/* Reports the summary of |data| so far, using the accumulated validation of |data|->auth_report if
+ * set. */
+void
+reporter_add_summary(Reporter *self, const ValidationData *data);
+
+/* Reports the summary of |data|, as reporter_add_summary(), and waits until everything has been
+ * written. */
+void
+reporter_finish(Reporter *self, const ValidationData *data);
+
+void
+reporter_free(Reporter *self);
+
+/* Writes |str| to |out| as a JSON string, including the quotes. */
+void
+reporter_write_json_string(FILE *out, const gchar *str);
+
+#endif  // __REPORTER_H__
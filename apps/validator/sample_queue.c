@@ -0,0 +1,167 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sample_queue.h"
+
+struct _SampleQueue {
+  GstAppSink *sink;
+  SampleQueueFunc func;
+  gpointer user_data;
+  GThread *thread;
+
+  GMutex lock;
+  GCond not_empty;  // Signaled by the streaming thread
+  GCond not_full;  // Signaled by the validation thread
+  GstSample **ring;
+  guint capacity;
+  guint head;  // Index of the oldest sample
+  guint count;  // Number of samples in |ring|
+  gboolean failed;  // Set when |func| has stopped the validation
+  gboolean closing;  // Set by sample_queue_finish()
+};
+
+/* Called from the streaming thread for every new sample of the appsink. */
+static GstFlowReturn
+on_new_sample(GstAppSink *sink, gpointer user_data)
+{
+  SampleQueue *self = (SampleQueue *)user_data;
+  GstSample *sample = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  // Pull every sample available, without blocking, and wait for room in the ring if needed.
+  while (ret == GST_FLOW_OK && (sample = gst_app_sink_try_pull_sample(sink, 0))) {
+    g_mutex_lock(&self->lock);
+    while (self->count == self->capacity && !self->failed && !self->closing) {
+      g_cond_wait(&self->not_full, &self->lock);
+    }
+    if (self->failed || self->closing) {
+      ret = self->failed ? GST_FLOW_ERROR : GST_FLOW_EOS;
+      gst_sample_unref(sample);
+    } else {
+      self->ring[(self->head + self->count) % self->capacity] = sample;
+      self->count++;
+      g_cond_signal(&self->not_empty);
+    }
+    g_mutex_unlock(&self->lock);
+  }
+
+  return ret;
+}
+
+static gpointer
+validation_thread(gpointer user_data)
+{
+  SampleQueue *self = (SampleQueue *)user_data;
+  GstSample **batch = g_new0(GstSample *, self->capacity);
+  gboolean failed = FALSE;
+
+  g_mutex_lock(&self->lock);
+  while (TRUE) {
+    while (self->count == 0 && !self->closing) g_cond_wait(&self->not_empty, &self->lock);
+    // Closing, and every sample has been validated.
+    if (self->count == 0) break;
+
+    // Take all queued samples at once, so the streaming thread can refill the ring meanwhile.
+    const guint num_samples = self->count;
+    for (guint i = 0; i < num_samples; i++) {
+      batch[i] = self->ring[(self->head + i) % self->capacity];
+    }
+    self->head = (self->head + num_samples) % self->capacity;
+    self->count = 0;
+    g_cond_signal(&self->not_full);
+    g_mutex_unlock(&self->lock);
+
+    for (guint i = 0; i < num_samples; i++) {
+      // After a failure the remaining samples are only released.
+      if (!failed) failed = !self->func(self->sink, batch[i], self->user_data);
+      gst_sample_unref(batch[i]);
+    }
+
+    g_mutex_lock(&self->lock);
+    if (failed && !self->failed) {
+      self->failed = TRUE;
+      g_cond_signal(&self->not_full);
+    }
+  }
+  g_mutex_unlock(&self->lock);
+  g_free(batch);
+
+  return NULL;
+}
+
+SampleQueue *
+sample_queue_new(GstAppSink *sink, guint capacity, SampleQueueFunc func, gpointer user_data)
+{
+  SampleQueue *self = g_new0(SampleQueue, 1);
+  GstAppSinkCallbacks callbacks = {.new_sample = on_new_sample};
+
+  self->sink = gst_object_ref(sink);
+  self->func = func;
+  self->user_data = user_data;
+  self->capacity = MAX(capacity, 1);
+  self->ring = g_new0(GstSample *, self->capacity);
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->not_empty);
+  g_cond_init(&self->not_full);
+  self->thread = g_thread_new("validation", validation_thread, self);
+
+  // Without a limit, appsink queues every buffer the pipeline produces while validation lags
+  // behind. With the callbacks, signals are not needed.
+  gst_app_sink_set_max_buffers(sink, self->capacity);
+  gst_app_sink_set_drop(sink, FALSE);
+  gst_app_sink_set_emit_signals(sink, FALSE);
+  gst_app_sink_set_callbacks(sink, &callbacks, self, NULL);
+
+  return self;
+}
+
+void
+sample_queue_finish(SampleQueue *self)
+{
+  if (!self || !self->thread) return;
+
+  g_mutex_lock(&self->lock);
+  self->closing = TRUE;
+  g_cond_signal(&self->not_empty);
+  g_cond_signal(&self->not_full);
+  g_mutex_unlock(&self->lock);
+  g_thread_join(self->thread);
+  self->thread = NULL;
+}
+
+void
+sample_queue_free(SampleQueue *self)
+{
+  if (!self) return;
+
+  sample_queue_finish(self);
+  GstAppSinkCallbacks no_callbacks = {0};
+  gst_app_sink_set_callbacks(self->sink, &no_callbacks, NULL, NULL);
+  for (guint i = 0; i < self->count; i++) {
+    gst_sample_unref(self->ring[(self->head + i) % self->capacity]);
+  }
+  g_free(self->ring);
+  g_mutex_clear(&self->lock);
+  g_cond_clear(&self->not_empty);
+  g_cond_clear(&self->not_full);
+  gst_object_unref(self->sink);
+  g_free(self);
+}
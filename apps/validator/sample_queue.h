@@ -0,0 +1,59 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SAMPLE_QUEUE_H__
+#define __SAMPLE_QUEUE_H__
+
+#include <glib.h>
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+
+/* Hands the samples of an appsink over to a validation thread of its own, hence reading, demuxing
+ * and parsing in the streaming thread overlap with validation instead of waiting for it. Samples
+ * are pulled in batches of all samples available and go through a ring of fixed capacity, taken
+ * by the validation thread a whole ring at a time. When the ring is full the streaming thread
+ * waits, which holds back the pipeline instead of letting samples pile up in memory. At most three
+ * times the capacity of samples are pending at any time: in the appsink, which holds up to the
+ * capacity, in the ring, and in the batch being validated. */
+
+#define SAMPLE_QUEUE_CAPACITY 32  // Samples, i.e., nalus or OBUs, since alignment=nal or obu
+
+typedef struct _SampleQueue SampleQueue;
+
+/* Called on the validation thread for every sample, in order. Returns FALSE to stop validating,
+ * in which case the pipeline fails with an error. */
+typedef gboolean (*SampleQueueFunc)(GstAppSink *sink, GstSample *sample, gpointer user_data);
+
+/* Sets the callbacks of |sink|, limits its internal queue and starts the validation thread,
+ * which passes the samples to |func|. */
+SampleQueue *
+sample_queue_new(GstAppSink *sink, guint capacity, SampleQueueFunc func, gpointer user_data);
+
+/* Waits until the queued samples have been validated and stops the validation thread. Samples
+ * arriving later end the stream. Safe to call more than once. */
+void
+sample_queue_finish(SampleQueue *self);
+
+/* Finishes |self|, if not already done, and frees it. The pipeline has to be stopped. */
+void
+sample_queue_free(SampleQueue *self);
+
+#endif  // __SAMPLE_QUEUE_H__
@@ -0,0 +1,752 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Validation of the buffers pulled from the appsink of the validator pipeline. Kept apart from the
+ * application so the same path can be benchmarked.
+ */
+
+#include "validation.h"
+
+#include "nalu_scan.h"
+#include "parallel_validation.h"
+#include "reporter.h"
+#include "sample_queue.h"
+
+#include <glib/gstdio.h>  // g_remove, g_rename
+#include <gst/app/gstappsink.h>
+#include <stdio.h>  // FILE, fopen, fclose
+#include <string.h>  // strcpy, strcmp, strlen, strstr
+#include <time.h>  // time_t, struct tm, strftime, gmtime_r
+
+#define VALIDATION_VALID    "valid    : "
+#define VALIDATION_INVALID  "invalid  : "
+#define VALIDATION_UNSIGNED "unsigned : "
+#define VALIDATION_SIGNED   "signed   : "
+#define VALIDATION_MISSING  "missing  : "
+#define VALIDATION_ERROR    "error    : "
+#define NALU_TYPES_PREFACE  "   nalus : "
+
+/* AV1 */
+/* Helpers when parsing OBUs if av1parse cannot be used. OBUs within a sample are validated as
+ * sub-memories of the sample. Only an OBU split between two samples is copied, into
+ * |data|->pending_obu, until it is complete. */
+const bool parse_av1_manually = true;
+#define METADATA_TYPE_USER_PRIVATE 25
+// Space allocated up front for an OBU split between two samples, which grows if it is larger.
+#define MAX_PENDING_OBU_PREALLOC (1024 * 1024)
+
+/* Helper function to copy signed_video_product_info_t. */
+static gint
+copy_product_info(signed_video_product_info_t *dst, const signed_video_product_info_t *src)
+{
+  if (!src || !dst) return 0;
+
+  strcpy(dst->hardware_id, src->hardware_id);
+  strcpy(dst->firmware_version, src->firmware_version);
+  strcpy(dst->serial_number, src->serial_number);
+  strcpy(dst->manufacturer, src->manufacturer);
+  strcpy(dst->address, src->address);
+
+  return 1;
+}
+
+/* Copies the product info and version strings of |report| to |data|, for the summary. */
+static void
+update_signing_side(ValidationData *data, const signed_video_authenticity_t *report)
+{
+  if (!copy_product_info(&(data->product_info), &(report->product_info))) {
+    g_warning("product info could not be transfered from authenticity report");
+  }
+  // Allocate memory and copy version strings. They do not change once the signing side is known.
+  if (!data->version_on_signing_side) {
+    if (strlen(report->this_version) > 0) {
+      if (strstr(report->this_version, "ONVIF") != NULL) {
+        g_free(data->this_version);
+        data->this_version = g_strdup(report->this_version);
+      }
+      if (strcmp(data->this_version, report->this_version) != 0) {
+        g_error("unexpected mismatch in 'this_version'");
+      }
+    }
+    if (strlen(report->version_on_signing_side) > 0) {
+      data->version_on_signing_side = g_strdup(report->version_on_signing_side);
+    }
+  }
+}
+
+static void
+post_validation_result_message(GstAppSink *sink, GstBus *bus, const gchar *result)
+{
+  GstStructure *structure = gst_structure_new(
+      VALIDATION_STRUCTURE_NAME, VALIDATION_FIELD_NAME, G_TYPE_STRING, result, NULL);
+
+  if (!gst_bus_post(bus, gst_message_new_element(GST_OBJECT(sink), structure))) {
+    g_error("failed to post validation results message");
+  }
+}
+
+ValidationData *
+validation_data_new(SignedVideoCodec codec, bool no_container)
+{
+  ValidationData *data = g_new0(ValidationData, 1);
+
+  data->sv = signed_video_create(codec);
+  if (!data->sv) {
+    g_warning("init failed: sv = (%p)", data->sv);
+    g_free(data);
+    return NULL;
+  }
+  data->no_container = no_container;
+  data->codec = codec;
+  data->this_version = g_strdup(signed_video_get_version());
+  data->summary_time = g_get_monotonic_time();
+
+  return data;
+}
+
+void
+validation_data_free(ValidationData *data)
+{
+  if (!data) return;
+
+  if (data->source) gst_object_unref(data->source);
+  // Stops the validation thread before anything it uses is freed.
+  sample_queue_free(data->queue);
+  parallel_validation_free(data->parallel);
+  reporter_free(data->reporter);
+  if (data->loop) g_main_loop_unref(data->loop);
+  signed_video_free(data->sv);
+  signed_video_authenticity_report_free(data->auth_report);
+  if (data->pending_obu) g_byte_array_free(data->pending_obu, TRUE);
+  g_free(data->this_version);
+  g_free(data->version_on_signing_side);
+  g_free(data);
+}
+
+const gchar *
+validation_demux_from_filename(const gchar *filename)
+{
+  if (strstr(filename, ".mkv")) {
+    // Matroska container (.mkv)
+    return "! matroskademux";
+  } else if (strstr(filename, ".mp4")) {
+    // MP4 container (.mp4)
+    return "! qtdemux";
+  }
+  return "";  // No container
+}
+
+ValidationInput
+validation_input_from_name(const gchar *input)
+{
+  if (strcmp(input, "-") == 0) return VALIDATION_INPUT_STDIN;
+  if (g_str_has_prefix(input, VALIDATION_SHM_PREFIX)) return VALIDATION_INPUT_SHM;
+  if (g_str_has_prefix(input, VALIDATION_UDP_PREFIX)) return VALIDATION_INPUT_UDP;
+  return VALIDATION_INPUT_FILE;
+}
+
+/* Returns the description of the source, including depayloader or demuxer, of |input|, which the
+ * caller frees, or NULL if |input| is not valid. */
+static gchar *
+source_description(const gchar *input, const gchar *codec_str)
+{
+  switch (validation_input_from_name(input)) {
+    case VALIDATION_INPUT_STDIN:
+      return g_strdup("fdsrc fd=0");
+    case VALIDATION_INPUT_SHM:
+      // The writer of the shared memory, e.g., shmsink, delivers an elementary stream.
+      return g_strdup_printf("shmsrc socket-path=\"%s\" is-live=true do-timestamp=true",
+          input + strlen(VALIDATION_SHM_PREFIX));
+    case VALIDATION_INPUT_UDP: {
+      const gchar *address = input + strlen(VALIDATION_UDP_PREFIX);
+      const gchar *port = strrchr(address, ':');
+      gchar *host = NULL;
+      gchar *encoding_name = NULL;
+      gchar *source = NULL;
+
+      if (!port || strlen(port + 1) == 0) {
+        g_warning("no port in '%s', expected udp://host:port", input);
+        return NULL;
+      }
+      // Listen on the loopback interface if no host is given.
+      host = (port > address) ? g_strndup(address, port - address) : g_strdup("127.0.0.1");
+      encoding_name = g_ascii_strup(codec_str, -1);
+      source = g_strdup_printf(
+          "udpsrc address=%s port=%s "
+          "caps=\"application/x-rtp,media=video,clock-rate=90000,encoding-name=%s\" ! "
+          "rtpjitterbuffer ! rtp%sdepay",
+          host, port + 1, encoding_name, codec_str);
+      g_free(host);
+      g_free(encoding_name);
+      return source;
+    }
+    case VALIDATION_INPUT_FILE:
+    default:
+      return g_strdup_printf(
+          "filesrc location=\"%s\" %s", input, validation_demux_from_filename(input));
+  }
+}
+
+gchar *
+validation_pipeline_description(const gchar *input, SignedVideoCodec codec, const gchar *codec_str)
+{
+  gchar *source = source_description(input, codec_str);
+  gchar *pipeline = NULL;
+
+  if (!source) return NULL;
+
+  if (codec == SV_CODEC_AV1 && parse_av1_manually) {
+    pipeline = g_strdup_printf("%s ! appsink name=validatorsink", source);
+  } else if (parse_av1_manually) {
+    pipeline = g_strdup_printf(
+        "%s ! %sparse ! "
+        "video/x-%s,stream-format=byte-stream,alignment=(string)nal ! appsink "
+        "name=validatorsink",
+        source, codec_str, codec_str);
+  } else {
+    pipeline = g_strdup_printf(
+        "%s ! %sparse ! "
+        "video/x-%s,stream-format=%s ! appsink "
+        "name=validatorsink",
+        source, codec_str, codec_str,
+        codec == SV_CODEC_AV1 ? "obu-stream,alignment=(string)obu"
+                              : "byte-stream,alignment=(string)nal");
+  }
+  g_free(source);
+
+  return pipeline;
+}
+
+/* Writes a summary of |data|, using the accumulated validation of |data|->auth_report if set, to
+ * |results_file|. The summary is written to a temporary file replacing |results_file| when
+ * complete, hence a rolling summary can be read at any time. */
+static bool
+write_summary(const ValidationData *data, const gchar *results_file)
+{
+  gchar *tmp_file = NULL;
+  FILE *f = NULL;
+  char *this_version = NULL;
+  char *signing_version = NULL;
+  char first_ts_str[80] = {'\0'};
+  char last_ts_str[80] = {'\0'};
+  bool has_timestamp = false;
+  float bitrate_increase = 0.0f;
+  bool is_unsigned = false;
+
+  this_version = data->this_version;
+  signing_version = data->version_on_signing_side;
+  if (data->total_bytes) {
+    bitrate_increase = 100.0f * data->sei_bytes / (float)(data->total_bytes - data->sei_bytes);
+  }
+  // A validation resumed from a checkpoint started before the frames of this session.
+  gint64 first_timestamp = data->first_timestamp;
+  gint64 last_timestamp = data->last_timestamp;
+  if (data->auth_report && data->auth_report->accumulated_validation.has_timestamp) {
+    const signed_video_accumulated_validation_t *acc = &data->auth_report->accumulated_validation;
+    if (!first_timestamp) first_timestamp = acc->first_timestamp;
+    last_timestamp = acc->last_timestamp;
+  }
+  if (first_timestamp) {
+    // Results of several files may be written at the same time, hence gmtime_r().
+    time_t first_sec = first_timestamp / 1000000;
+    struct tm first_ts;
+    gmtime_r(&first_sec, &first_ts);
+    strftime(first_ts_str, sizeof(first_ts_str), "%a %Y-%m-%d %H:%M:%S %Z", &first_ts);
+    time_t last_sec = last_timestamp / 1000000;
+    struct tm last_ts;
+    gmtime_r(&last_sec, &last_ts);
+    strftime(last_ts_str, sizeof(last_ts_str), "%a %Y-%m-%d %H:%M:%S %Z", &last_ts);
+    has_timestamp = true;
+  }
+  tmp_file = g_strconcat(results_file, ".tmp", NULL);
+  f = fopen(tmp_file, "w");
+  if (!f) {
+    g_warning("Could not open %s for writing", tmp_file);
+    g_free(tmp_file);
+    return false;
+  }
+  fprintf(f, "-----------------------------\n");
+  if (data->auth_report) {
+    SignedVideoPublicKeyValidation public_key_validation =
+        data->auth_report->accumulated_validation.public_key_validation;
+    if (public_key_validation == SV_PUBKEY_VALIDATION_OK) {
+      fprintf(f, "PUBLIC KEY IS VALID!\n");
+    } else if (public_key_validation == SV_PUBKEY_VALIDATION_NOT_OK) {
+      fprintf(f, "PUBLIC KEY IS NOT VALID!\n");
+    } else {
+      fprintf(f, "PUBLIC KEY COULD NOT BE VALIDATED!\n");
+    }
+  } else {
+    fprintf(f, "PUBLIC KEY COULD NOT BE VALIDATED!\n");
+  }
+  fprintf(f, "-----------------------------\n");
+  if (data->invalid_gops > 0) {
+    fprintf(f, "VIDEO IS INVALID!\n");
+  } else if (data->valid_gops_with_missing > 0) {
+    fprintf(f, "VIDEO IS VALID, BUT HAS MISSING FRAMES!\n");
+  } else if (data->valid_gops > 0) {
+    fprintf(f, "VIDEO IS VALID!\n");
+  } else if (data->no_sign_gops > 0) {
+    fprintf(f, "VIDEO IS NOT SIGNED!\n");
+  } else if (data->auth_report) {
+    fprintf(f, "VIDEO IS NOT SIGNED!\n");
+    is_unsigned = true;
+  } else {
+    fprintf(f, "NO COMPLETE GOPS FOUND!\n");
+  }
+  bool has_signed_gops = data->invalid_gops || data->valid_gops_with_missing || data->valid_gops;
+  gint num_unsigned_gops = has_signed_gops ? 0 : data->no_sign_gops;
+  if (is_unsigned) {
+    fprintf(f, "Number of unsigned Bitstream Units: %u\n",
+        data->auth_report->accumulated_validation.number_of_received_nalus);
+  } else {
+    fprintf(f, "Number of valid GOPs: %d\n", data->valid_gops);
+    fprintf(f, "Number of valid GOPs with missing BUs: %d\n", data->valid_gops_with_missing);
+    fprintf(f, "Number of invalid GOPs: %d\n", data->invalid_gops);
+    fprintf(f, "Number of GOPs without signature: %d\n", num_unsigned_gops);
+  }
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "\nProduct Info\n");
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "Hardware ID:      %s\n", data->product_info.hardware_id);
+  fprintf(f, "Serial Number:    %s\n", data->product_info.serial_number);
+  fprintf(f, "Firmware version: %s\n", data->product_info.firmware_version);
+  fprintf(f, "Manufacturer:     %s\n", data->product_info.manufacturer);
+  fprintf(f, "Address:          %s\n", data->product_info.address);
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "\nSigned Video timestamps\n");
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "First frame:           %s\n", has_timestamp ? first_ts_str : "N/A");
+  fprintf(f, "Last validated frame:  %s\n", has_timestamp ? last_ts_str : "N/A");
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "\nSigned Video size footprint\n");
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "Total video:       %8zu B\n", data->total_bytes);
+  fprintf(f, "Signed Video data: %8zu B\n", data->sei_bytes);
+  fprintf(f, "Bitrate increase: %9.2f %%\n", bitrate_increase);
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "\nVersions of signed-video-framework\n");
+  fprintf(f, "-----------------------------\n");
+  fprintf(f, "Validator (%s) runs: %s\n", VALIDATOR_VERSION, this_version);
+  fprintf(f, "Camera runs:             %s\n", signing_version ? signing_version : "N/A");
+  fprintf(f, "-----------------------------\n");
+  fclose(f);
+  if (g_rename(tmp_file, results_file) != 0) {
+    g_warning("Could not replace %s", results_file);
+    g_remove(tmp_file);
+    g_free(tmp_file);
+    return false;
+  }
+  g_free(tmp_file);
+
+  return true;
+}
+
+bool
+validation_write_results(ValidationData *data, const gchar *results_file)
+{
+  bool success = false;
+
+  // Validate the samples still queued by the pipeline.
+  sample_queue_finish(data->queue);
+  if (data->parallel) {
+    // Wait for all ranges and merge their results.
+    data->auth_report = parallel_validation_finish(data->parallel, data);
+  } else {
+    data->auth_report = signed_video_get_authenticity_report(data->sv);
+  }
+  if (data->reporter && data->auth_report) update_signing_side(data, data->auth_report);
+  success = write_summary(data, results_file);
+  if (success) {
+    const gchar *signing_version = data->version_on_signing_side;
+    g_message("Validation performed with Signed Video version %s", data->this_version);
+    if (signing_version) {
+      g_message("Signing was performed with Signed Video version %s", signing_version);
+    }
+    g_message("Validation complete. Results printed to '%s'.", results_file);
+  }
+  // Write the summary record, if any, and wait for all records to be written.
+  reporter_finish(data->reporter, data);
+  signed_video_authenticity_report_free(data->auth_report);
+  data->auth_report = NULL;
+
+  return success;
+}
+
+bool
+validation_write_summary_if_due(ValidationData *data, const gchar *results_file)
+{
+  gint num_gops = data->valid_gops + data->valid_gops_with_missing + data->invalid_gops +
+      data->no_sign_gops;
+  gint64 now = 0;
+  bool success = false;
+
+  if (!data->summary_interval && !data->summary_gops) return true;
+  now = g_get_monotonic_time();
+  bool gops_due =
+      data->summary_gops && num_gops - data->summary_num_gops >= (gint)data->summary_gops;
+  bool time_due = data->summary_interval &&
+      now - data->summary_time >= (gint64)data->summary_interval * G_USEC_PER_SEC;
+  if (!gops_due && !time_due) return true;
+
+  // The accumulated validation so far. The session continues as if nothing happened.
+  data->auth_report = signed_video_get_authenticity_report(data->sv);
+  if (data->reporter && data->auth_report) update_signing_side(data, data->auth_report);
+  success = write_summary(data, results_file);
+  reporter_add_summary(data->reporter, data);
+  signed_video_authenticity_report_free(data->auth_report);
+  data->auth_report = NULL;
+  data->summary_time = now;
+  data->summary_num_gops = num_gops;
+  if (success && !data->reporter) {
+    g_message("Summary of %d GOPs written to '%s'", num_gops, results_file);
+  }
+
+  return success;
+}
+
+bool
+is_signed_video_sei(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec)
+{
+  gsize idx = 0;
+
+  if (codec != SV_CODEC_AV1) return nalu_scan_is_signed_video_sei(nalu, nalu_size, codec);
+
+  // Determine if OBU is of type metadata
+  if (nalu_size < 1 || (nalu[idx] & 0x78) >> 3 != 5) return false;
+  idx++;
+
+  // Move past payload size
+  int shift_bits = 0;
+  int payload_size = 0;
+  // Get payload size (including uuid).
+  while (idx < nalu_size && shift_bits < 32) {
+    int byte = nalu[idx] & 0xff;
+    payload_size |= (byte & 0x7F) << shift_bits;
+    idx++;
+    if ((byte & 0x80) == 0) break;
+    shift_bits += 7;
+  }
+  if (payload_size < 20) return false;
+
+  // Determine if this is an OBU Metadata of type user private (25).
+  if (idx >= nalu_size || nalu[idx] != METADATA_TYPE_USER_PRIVATE) return false;
+  idx++;
+
+  // Move past intermediate trailing byte
+  idx++;
+
+  // Verify Signed Video UUID (16 bytes).
+  if (idx + 16 > nalu_size) return false;
+  return nalu_scan_is_signed_video_uuid(&nalu[idx]);
+}
+
+bool
+is_keyframe(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec)
+{
+  if (codec != SV_CODEC_AV1) return nalu_scan_is_keyframe(nalu, nalu_size, codec);
+
+  // Determine if OBU is of type sequence header
+  return nalu_size >= 1 && (nalu[0] & 0x78) >> 3 == 1;
+}
+
+gsize
+av1_get_obu_size(const guint8 *data, gsize size)
+{
+  gsize idx = 0;
+  guint64 obu_length = 0;
+
+  if (size < 1) return 0;
+  idx = (data[0] & 0x04) ? 2 : 1;  // Move past OBU header, including extension header
+  if (idx > size) return 0;
+  // Without obu_has_size_field the OBU fills the rest of the data.
+  if (!(data[0] & 0x02)) return size;
+
+  // OBU length leb128()
+  for (gint i = 0; i < 8; i++, idx++) {
+    if (idx >= size) return 0;
+    obu_length |= (guint64)(data[idx] & 0x7f) << (7 * i);
+    if ((data[idx] & 0x80) == 0) break;
+  }
+
+  return idx + 1 + obu_length;
+}
+
+/* Creates a memory for the OBU at |offset| of |mem| without copying the data, if possible. */
+static GstMemory *
+av1_share_obu(GstMemory *mem, gsize offset, gsize obu_size)
+{
+  if (GST_MEMORY_FLAG_IS_SET(mem, GST_MEMORY_FLAG_NO_SHARE)) {
+    return gst_memory_copy(mem, offset, obu_size);
+  }
+  return gst_memory_share(mem, offset, obu_size);
+}
+
+SignedVideoReturnCode
+validation_add_nalu(ValidationData *data, const guint8 *nalu, gsize nalu_size)
+{
+  if (data->no_container || data->codec == SV_CODEC_AV1) {
+    return signed_video_add_nalu_and_authenticate(data->sv, nalu, nalu_size, &(data->auth_report));
+  }
+  // Pass nalu to the signed video session, excluding its 3 or 4 byte start code, or the size which
+  // might have replaced it.
+  gsize prefix_size = nalu_scan_prefix_size(nalu, nalu_size, NULL);
+  return signed_video_add_nalu_and_authenticate(
+      data->sv, nalu + prefix_size, nalu_size - prefix_size, &(data->auth_report));
+}
+
+gchar *
+validation_handle_report(ValidationData *data)
+{
+  signed_video_authenticity_t *report = data->auth_report;
+  const gchar *preface = "";
+  gchar *result = NULL;
+
+  switch (report->latest_validation.authenticity) {
+    case SV_AUTH_RESULT_OK:
+      data->valid_gops++;
+      preface = VALIDATION_VALID;
+      break;
+    case SV_AUTH_RESULT_NOT_OK:
+      data->invalid_gops++;
+      preface = VALIDATION_INVALID;
+      break;
+    case SV_AUTH_RESULT_OK_WITH_MISSING_INFO:
+      data->valid_gops_with_missing++;
+      g_debug("gops with missing info since last verification");
+      preface = VALIDATION_MISSING;
+      break;
+    case SV_AUTH_RESULT_NOT_SIGNED:
+      data->no_sign_gops++;
+      g_debug("gop is not signed");
+      preface = VALIDATION_UNSIGNED;
+      break;
+    case SV_AUTH_RESULT_SIGNATURE_PRESENT:
+      g_debug("gop is signed, but not yet validated");
+      preface = VALIDATION_SIGNED;
+      break;
+    default:
+      break;
+  }
+  data->auth_report = NULL;
+
+  if (data->reporter) {
+    // Formatted, if at all, and freed by the reporter, which takes the product info and versions
+    // from the report itself. They are copied to |data| from the accumulated report when a summary
+    // is written.
+    reporter_add_report(data->reporter, report);
+    return NULL;
+  }
+  update_signing_side(data, report);
+
+  // Starting with a new-line character to align strings.
+  result = g_strconcat("\n", NALU_TYPES_PREFACE, report->latest_validation.nalu_str, "\n", preface,
+      report->latest_validation.validation_str, NULL);
+  signed_video_authenticity_report_free(report);
+
+  return result;
+}
+
+void
+validation_merge(ValidationData *dst, const ValidationData *src)
+{
+  dst->total_bytes += src->total_bytes;
+  dst->sei_bytes += src->sei_bytes;
+  dst->valid_gops += src->valid_gops;
+  dst->valid_gops_with_missing += src->valid_gops_with_missing;
+  dst->invalid_gops += src->invalid_gops;
+  dst->no_sign_gops += src->no_sign_gops;
+  // Product info of the last range wins, as it would for a sequential validation.
+  if (src->valid_gops + src->valid_gops_with_missing + src->invalid_gops + src->no_sign_gops > 0) {
+    copy_product_info(&(dst->product_info), &(src->product_info));
+  }
+  if (!dst->version_on_signing_side && src->version_on_signing_side) {
+    dst->version_on_signing_side = g_strdup(src->version_on_signing_side);
+  }
+  if (src->this_version && (!dst->this_version || strcmp(dst->this_version, src->this_version))) {
+    g_free(dst->this_version);
+    dst->this_version = g_strdup(src->this_version);
+  }
+}
+
+gchar *
+validation_validate_nalu(ValidationData *data, const guint8 *nalu, gsize nalu_size)
+{
+  SignedVideoReturnCode status = SV_UNKNOWN_FAILURE;
+
+  if (data->parallel) {
+    parallel_validation_add_data(data->parallel, nalu, nalu_size,
+        is_signed_video_sei(nalu, nalu_size, data->codec),
+        is_keyframe(nalu, nalu_size, data->codec));
+    return NULL;
+  }
+
+  // Update the total video and SEI sizes.
+  data->total_bytes += nalu_size;
+  data->sei_bytes += is_signed_video_sei(nalu, nalu_size, data->codec) ? nalu_size : 0;
+
+  status = validation_add_nalu(data, nalu, nalu_size);
+  if (status != SV_OK) {
+    g_critical("error during verification of signed video: %d", status);
+    if (data->reporter) {
+      reporter_add_error(data->reporter, status);
+      return NULL;
+    }
+    return g_strdup(VALIDATION_ERROR);
+  }
+
+  return data->auth_report ? validation_handle_report(data) : NULL;
+}
+
+/* Validates |mem|, holding one nalu, or OBU, and posts the latest result, if any, on |bus|. */
+static gboolean
+validate_memory(ValidationData *data, GstAppSink *sink, GstBus *bus, GstMemory *mem)
+{
+  GstMapInfo info;
+
+  if (!gst_memory_map(mem, &info, GST_MAP_READ)) {
+    g_debug("failed to map memory");
+    return FALSE;
+  }
+
+  if (data->parallel) {
+    // Validated later on a worker thread, which also counts the sizes.
+    parallel_validation_add_memory(data->parallel, mem,
+        is_signed_video_sei(info.data, info.size, data->codec),
+        is_keyframe(info.data, info.size, data->codec));
+  } else {
+    gchar *result = validation_validate_nalu(data, info.data, info.size);
+    if (result) post_validation_result_message(sink, bus, result);
+    g_free(result);
+  }
+  gst_memory_unmap(mem, &info);
+
+  return TRUE;
+}
+
+/* Splits |mem|, the next chunk of an AV1 OBU stream, into OBUs and validates them. An OBU
+ * continuing in the next chunk is kept in |data|->pending_obu. */
+static gboolean
+validate_av1_memory(ValidationData *data, GstAppSink *sink, GstBus *bus, GstMemory *mem)
+{
+  GstMapInfo info;
+  gsize offset = 0;
+  gboolean success = FALSE;
+
+  if (!gst_memory_map(mem, &info, GST_MAP_READ)) {
+    g_debug("failed to map memory");
+    return FALSE;
+  }
+
+  // Complete the OBU carried over from the previous chunk, one byte at a time until its size is
+  // known.
+  while (data->pending_obu && offset < info.size) {
+    // An OBU without size field continues to the end of this chunk.
+    const bool has_size_field = (data->pending_obu->data[0] & 0x02) != 0;
+    gsize obu_size = has_size_field
+        ? av1_get_obu_size(data->pending_obu->data, data->pending_obu->len)
+        : data->pending_obu->len + info.size - offset;
+    gsize needed = obu_size ? obu_size - data->pending_obu->len : 1;
+    gsize copy_size = MIN(needed, info.size - offset);
+
+    g_byte_array_append(data->pending_obu, info.data + offset, copy_size);
+    offset += copy_size;
+    if (obu_size && data->pending_obu->len == obu_size) {
+      GstMemory *obu = gst_memory_new_wrapped(
+          0, data->pending_obu->data, obu_size, 0, obu_size, data->pending_obu->data, g_free);
+      g_byte_array_free(data->pending_obu, FALSE);
+      data->pending_obu = NULL;
+      gboolean validated = validate_memory(data, sink, bus, obu);
+      gst_memory_unref(obu);
+      if (!validated) goto out;
+    }
+  }
+
+  while (offset < info.size) {
+    gsize obu_size = av1_get_obu_size(info.data + offset, info.size - offset);
+    if (obu_size == 0 || obu_size > info.size - offset) {
+      // Store slack data. The size field is not trusted for allocating more than needed so far.
+      data->pending_obu = g_byte_array_sized_new(
+          MAX(info.size - offset, MIN(obu_size, MAX_PENDING_OBU_PREALLOC)));
+      g_byte_array_append(data->pending_obu, info.data + offset, info.size - offset);
+      break;
+    }
+    GstMemory *obu = av1_share_obu(mem, offset, obu_size);
+    gboolean validated = obu && validate_memory(data, sink, bus, obu);
+    if (obu) gst_memory_unref(obu);
+    if (!validated) goto out;
+    offset += obu_size;
+  }
+  success = TRUE;
+
+out:
+  gst_memory_unmap(mem, &info);
+  return success;
+}
+
+gboolean
+validation_validate_sample(ValidationData *data, GstAppSink *sink, GstSample *sample)
+{
+  GstBuffer *sample_buffer = gst_sample_get_buffer(sample);
+  GstBus *bus = NULL;
+  gboolean success = TRUE;
+
+  if ((sample_buffer == NULL) || (gst_buffer_n_memory(sample_buffer) == 0)) {
+    g_debug("no buffer, or no memories in buffer");
+    return FALSE;
+  }
+
+  bus = gst_element_get_bus(GST_ELEMENT(sink));
+  for (guint i = 0; i < gst_buffer_n_memory(sample_buffer) && success; i++) {
+    GstMemory *mem = gst_buffer_peek_memory(sample_buffer, i);
+    if (data->codec == SV_CODEC_AV1 && parse_av1_manually) {
+      success = validate_av1_memory(data, sink, bus, mem);
+    } else {
+      success = validate_memory(data, sink, bus, mem);
+    }
+  }
+  gst_object_unref(bus);
+
+  return success;
+}
+
+GstFlowReturn
+on_new_sample_from_sink(GstElement *elt, ValidationData *data)
+{
+  g_assert(elt != NULL);
+
+  GstAppSink *sink = GST_APP_SINK(elt);
+  GstSample *sample = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  // Get the sample from appsink.
+  sample = gst_app_sink_pull_sample(sink);
+  // If sample is NULL the appsink is stopped or EOS is reached. Both are valid, hence proceed.
+  if (sample == NULL) return GST_FLOW_OK;
+
+  if (!validation_validate_sample(data, sink, sample)) ret = GST_FLOW_ERROR;
+  // Memories kept for parallel validation hold references of their own, and a pending OBU is
+  // copied, hence the sample can be released right away.
+  gst_sample_unref(sample);
+
+  return ret;
+}
@@ -0,0 +1,182 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Axis Communications AB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next paragraph) shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VALIDATION_H__
+#define __VALIDATION_H__
+
+#include <glib.h>
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+#include <stdbool.h>
+
+#include <signed-video-framework/signed_video_auth.h>
+#include <signed-video-framework/signed_video_common.h>
+
+#define RESULTS_FILE "validation_results.txt"
+// Increment VALIDATOR_VERSION when a change is affecting the code.
+#define VALIDATOR_VERSION "v2.9.5"  // Requires at least signed-video-framework v2.2.5
+
+/* Prefixes of the names of live inputs, see validation_input_from_name(). */
+#define VALIDATION_SHM_PREFIX "shm://"
+#define VALIDATION_UDP_PREFIX "udp://"
+
+/* Where the video to validate is read from. */
+typedef enum {
+  VALIDATION_INPUT_FILE = 0,
+  VALIDATION_INPUT_STDIN,  // '-', an elementary stream on stdin
+  VALIDATION_INPUT_SHM,  // 'shm://socket-path', an elementary stream written by shmsink
+  VALIDATION_INPUT_UDP,  // 'udp://host:port', RTP, listening on localhost if no host is given
+} ValidationInput;
+
+typedef struct _ParallelValidation ParallelValidation;
+typedef struct _Reporter Reporter;
+typedef struct _SampleQueue SampleQueue;
+
+typedef struct {
+  GMainLoop *loop;
+  GstElement *source;
+  GstElement *sink;
+
+  signed_video_t *sv;
+  signed_video_authenticity_t *auth_report;
+  signed_video_product_info_t product_info;
+  char *version_on_signing_side;
+  char *this_version;
+  bool no_container;
+  SignedVideoCodec codec;
+  gsize total_bytes;
+  gsize sei_bytes;
+
+  gint valid_gops;
+  gint valid_gops_with_missing;
+  gint invalid_gops;
+  gint no_sign_gops;
+  // Signed Video timestamps, in microseconds, of the first and last validated frames of previous
+  // runs if resumed from a checkpoint, otherwise 0.
+  gint64 first_timestamp;
+  gint64 last_timestamp;
+  // Rolling summaries, if any, are written every |summary_interval| seconds, or every
+  // |summary_gops| GOPs, whichever comes first. 0 disables either.
+  guint summary_interval;
+  guint summary_gops;
+  gint64 summary_time;  // Monotonic time of the latest summary, or of the start
+  gint summary_num_gops;  // GOPs counted at the latest summary
+
+  ParallelValidation *parallel;  // If set, nalus are validated in ranges on worker threads
+  Reporter *reporter;  // If set, results are reported by it instead of posted on the bus
+  SampleQueue *queue;  // If set, samples of the appsink are validated on a thread of its own
+  GByteArray *pending_obu;  // AV1 OBU continuing in the next chunk, if parsed manually
+} ValidationData;
+
+/* Element message posted on the bus with the latest authenticity result. */
+#define VALIDATION_STRUCTURE_NAME "validation-result"
+#define VALIDATION_FIELD_NAME "result"
+
+/* If set to 'false', will use av1parse, which currently cannot parse OBU Metadata of type
+ * user private. */
+extern const bool parse_av1_manually;
+
+/* Creates the validation data of a file, including its Signed Video session. Returns NULL on
+ * failure. */
+ValidationData *
+validation_data_new(SignedVideoCodec codec, bool no_container);
+
+/* Frees |data| and everything it owns, i.e., pipeline, main loop, session, reporter and parallel
+ * validation. */
+void
+validation_data_free(ValidationData *data);
+
+/* Returns the demuxer for |filename|, as a part of a pipeline description, or "" if the file is
+ * not a container. */
+const gchar *
+validation_demux_from_filename(const gchar *filename);
+
+/* Gets the kind of |input|, i.e., a file name, '-' for stdin, 'shm://socket-path' or
+ * 'udp://host:port'. */
+ValidationInput
+validation_input_from_name(const gchar *input);
+
+/* Returns the description of the pipeline feeding the appsink "validatorsink" with |input|, which
+ * the caller frees, or NULL if |input| is not valid. */
+gchar *
+validation_pipeline_description(const gchar *input, SignedVideoCodec codec, const gchar *codec_str);
+
+/* Finishes the validation and writes a summary of the results to |results_file|. Returns false if
+ * the file could not be written. */
+bool
+validation_write_results(ValidationData *data, const gchar *results_file);
+
+/* Writes a summary of the results so far to |results_file|, and to the reporter if any, if
+ * |data|->summary_interval seconds, or |data|->summary_gops GOPs, have passed since the latest
+ * one. The validation continues. Has to be called where nalus are validated, and not together with
+ * a parallel validation. Returns false if the file could not be written. */
+bool
+validation_write_summary_if_due(ValidationData *data, const gchar *results_file);
+
+/* Checks if the |nalu| is a SEI/OBU Metadata generated by Signed Video. Never reads outside
+ * |nalu_size| bytes. */
+bool
+is_signed_video_sei(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec);
+
+/* Checks if |nalu| starts, or is part of, a keyframe, i.e., is a keyframe slice, or an AV1
+ * Sequence Header OBU, which precedes every keyframe of a signed stream. */
+bool
+is_keyframe(const guint8 *nalu, gsize nalu_size, SignedVideoCodec codec);
+
+/* Adds |nalu|, as delivered by the appsink, to the Signed Video session of |data| for
+ * authentication. A new authenticity report, if any, is stored in |data|->auth_report. */
+SignedVideoReturnCode
+validation_add_nalu(ValidationData *data, const guint8 *nalu, gsize nalu_size);
+
+/* Counts the latest validation of |data|->auth_report in |data| and frees the report. Returns the
+ * result as a string, which the caller frees. If |data|->reporter is set, the report is handed
+ * over to it instead and NULL is returned. */
+gchar *
+validation_handle_report(ValidationData *data);
+
+/* Validates |nalu|, as delivered by the appsink, and counts its size. If |data|->parallel is set,
+ * |nalu| is only queued and has to stay valid until parallel_validation_finish() has returned.
+ * Returns the latest result as a string, which the caller frees, if a GOP was validated and there
+ * is no |data|->reporter, otherwise NULL. */
+gchar *
+validation_validate_nalu(ValidationData *data, const guint8 *nalu, gsize nalu_size);
+
+/* Returns the size of the AV1 OBU starting at |data|, including header and size field. An OBU
+ * without size field extends to the end, i.e., |size| is returned. Returns 0 if |size| bytes are
+ * not enough to read the size field. */
+gsize
+av1_get_obu_size(const guint8 *data, gsize size);
+
+/* Adds the counters, sizes, product info and versions of |src| to |dst|. */
+void
+validation_merge(ValidationData *dst, const ValidationData *src);
+
+/* Validates every memory of the buffer of |sample| as one nalu, or OBU. The latest result is
+ * posted as an element message on the bus of |sink|. Returns FALSE on failure. */
+gboolean
+validation_validate_sample(ValidationData *data, GstAppSink *sink, GstSample *sample);
+
+/* Called when the appsink notifies us that there is a new buffer ready for processing. Pulls the
+ * sample and validates it in the streaming thread with validation_validate_sample(). */
+GstFlowReturn
+on_new_sample_from_sink(GstElement *elt, ValidationData *data);
+
+#endif  // __VALIDATION_H__